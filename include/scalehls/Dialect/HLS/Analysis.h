@@ -9,22 +9,33 @@
 
 #include "scalehls/Dialect/HLS/HLS.h"
 #include "scalehls/Dialect/HLS/Utils.h"
+#include "llvm/ADT/EquivalenceClasses.h"
 
 namespace mlir {
 namespace scalehls {
 
 using namespace hls;
 
-/// Node and Schedule complexity analysis.
+/// Node and Schedule complexity analysis. If the operator latency and DSP
+/// usage maps are provided, each operation is weighted by its profiled cost and
+/// memory accesses are weighted by the number of ports of the accessed memory.
+/// Otherwise, only the trip-count-weighted loop nesting is counted.
 class ComplexityAnalysis {
 public:
-  ComplexityAnalysis(func::FuncOp func);
+  ComplexityAnalysis(func::FuncOp func,
+                     const llvm::StringMap<int64_t> *latencyMap = nullptr,
+                     const llvm::StringMap<int64_t> *dspUsageMap = nullptr);
 
   Optional<unsigned long> getScheduleComplexity(ScheduleOp schedule) const;
   Optional<unsigned long> getNodeComplexity(NodeOp node) const;
 
 private:
   Optional<unsigned long> calculateBlockComplexity(Block *block) const;
+  unsigned long getOperationComplexity(Operation *op) const;
+  unsigned long getMemoryComplexity(Value memref, unsigned numAccesses) const;
+
+  const llvm::StringMap<int64_t> *latencyMap;
+  const llvm::StringMap<int64_t> *dspUsageMap;
   llvm::SmallDenseMap<NodeOp, unsigned long> nodeComplexityMap;
 };
 
@@ -36,9 +47,7 @@ public:
               hls::BufferLikeInterface buffer,
               SmallVector<int64_t> sourceToTargetMap,
               SmallVector<int64_t> targetToSourceMap)
-      : sourceNode(sourceNode), targetNode(targetNode), buffer(buffer),
-        sourceToTargetMap(sourceToTargetMap),
-        targetToSourceMap(targetToSourceMap) {
+      : sourceNode(sourceNode), targetNode(targetNode), buffer(buffer) {
     // Make sure the source-to-target and target-to-source map is valid.
     if (!sourceToTargetMap.empty()) {
       assert(getNodeLoopBand(targetNode).size() == sourceToTargetMap.size() &&
@@ -80,63 +89,44 @@ public:
     return isSourceNode(currentNode) ? targetNode : sourceNode;
   }
 
-  SmallVector<int64_t> getCorrelateMap(NodeOp currentNode) const {
-    if (isSourceNode(currentNode))
-      return sourceToTargetMap;
-    else
-      return targetToSourceMap;
-  }
-
-  // Permute factors of the current node to the correlated node.
-  FactorList permuteFactors(NodeOp currentNode, FactorList &factors) {
-    assert(factors.size() == getNodeLoopBand(currentNode).size() &&
-           "invalid permutation factors");
-    auto correlateMap = getCorrelateMap(currentNode);
-    return permuteFactorsWithMap(factors, correlateMap);
-  }
-
 private:
-  /// Permute "factors" with "map" and return the permuted factors. Note that
-  /// "-1" in the permutation map indicates the output factor on the
-  /// corresponding position is one.
-  FactorList permuteFactorsWithMap(FactorList &factors,
-                                   SmallVectorImpl<int64_t> &map) const {
-    FactorList permutedFactors;
-    for (auto i : map) {
-      if (i >= 0 && i < (int64_t)factors.size())
-        permutedFactors.push_back(factors[i]);
-      else if (i == -1)
-        permutedFactors.push_back(1);
-      else
-        llvm_unreachable("invalid factors or map");
-    }
-    return permutedFactors;
-  }
-
   NodeOp sourceNode;
   NodeOp targetNode;
   hls::BufferLikeInterface buffer;
-  SmallVector<int64_t> sourceToTargetMap;
-  SmallVector<int64_t> targetToSourceMap;
 };
 
-/// Correlations analysis between dataflow nodes.
+/// Correlations analysis between dataflow nodes. Apart from the pairwise
+/// correlations, the loops of all nodes are partitioned into equivalence
+/// classes, where two loops are in the same class if they are transitively
+/// correlated through a chain of shared buffers.
 class CorrelationAnalysis {
   using CorrelationList = SmallVector<Correlation, 4>;
 
 public:
+  /// A loop is identified by its node and depth in the node's loop band.
+  using NodeLoop = std::pair<Operation *, unsigned>;
+
   CorrelationAnalysis(func::FuncOp func);
 
   CorrelationList getCorrelations(NodeOp node) const {
     return nodeCorrelationMap.lookup(node);
   }
 
+  /// Get the representative loop of the class that the loop at "depth" of the
+  /// node's loop band belongs to. Uncorrelated loops represent themselves.
+  NodeLoop getLoopClassLeader(NodeOp node, unsigned depth) const {
+    auto loop = NodeLoop(node, depth);
+    auto leader = loopClasses.findLeader(loop);
+    return leader == loopClasses.member_end() ? loop : *leader;
+  }
+
   auto begin() { return nodeCorrelationMap.begin(); }
   auto end() { return nodeCorrelationMap.end(); }
 
 private:
   // SmallVector<Correlation> correlations;
   llvm::SmallDenseMap<NodeOp, CorrelationList> nodeCorrelationMap;
+  llvm::EquivalenceClasses<NodeLoop> loopClasses;
 };
 
 } // namespace scalehls
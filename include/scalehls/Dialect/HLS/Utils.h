@@ -45,6 +45,16 @@ TaskOp fuseOpsIntoTask(ArrayRef<Operation *> ops, PatternRewriter &rewriter,
 /// Fuse multiple nodes into a new node.
 NodeOp fuseNodeOps(ArrayRef<NodeOp> nodes, PatternRewriter &rewriter);
 
+/// Pass the output of the node to its consumers through a chain of buffers and
+/// copy nodes, one for each dataflow level, such that every consumer reads a
+/// buffer produced at the adjacent level. "consumers" holds the level
+/// difference and consumer pairs in a descending order of level difference,
+/// and is consumed by this method.
+void insertCopyNodeChain(
+    NodeOp node, Value output,
+    SmallVectorImpl<std::pair<unsigned, NodeOp>> &consumers,
+    PatternRewriter &rewriter);
+
 /// Get the consumer/producer nodes of the given buffer expect the given op.
 SmallVector<NodeOp> getConsumersExcept(Value buffer, NodeOp except);
 SmallVector<NodeOp> getProducersExcept(Value buffer, NodeOp except);
@@ -63,6 +73,11 @@ hls::BufferLikeInterface findBufferOp(Value memref);
 
 bool isExternalBuffer(Value memref);
 
+/// Return the number of BRAM18K blocks occupied by one copy of an on-chip
+/// buffer of the given type. This is an upper bound, as small buffers may be
+/// implemented with LUTRAMs or registers by the HLS tool.
+unsigned getNumBram(Type type);
+
 /// Check whether the given use has read/write semantics.
 bool isRead(OpOperand &use);
 bool isWritten(OpOperand &use);
@@ -178,6 +193,114 @@ func::FuncOp getTopFunc(ModuleOp module, std::string topFuncName = "");
 
 func::FuncOp getRuntimeFunc(ModuleOp module, std::string runtimeFuncName = "");
 
+/// Return whether the operation `op`, which could be executed after `start` and
+/// prior to `memOp`, may have the memory effect `EffectType` on `memOp`. This
+/// is the check applied to each intervening operation in
+/// `hasNoInterveningEffect`, which is exposed such that indexed queries can
+/// only check the operations that are known to be relevant.
+template <typename EffectType>
+bool mayHaveInterveningEffect(Operation *op, Operation *start,
+                              Operation *memOp, Value memref) {
+  auto isLocallyAllocated = [](Value memref) {
+    auto *defOp = memref.getDefiningOp();
+    return defOp && hasSingleEffect<MemoryEffects::Allocate>(defOp, memref);
+  };
+
+  if (auto memEffect = dyn_cast<MemoryEffectOpInterface>(op)) {
+    SmallVector<MemoryEffects::EffectInstance, 1> effects;
+    memEffect.getEffects(effects);
+
+    bool opMayHaveEffect = false;
+    for (auto effect : effects) {
+      // If op causes EffectType on a potentially aliasing location for memOp,
+      // mark as having the effect.
+      if (isa<EffectType>(effect.getEffect())) {
+        // TODO: This should be replaced with a check for no aliasing.
+        // Aliasing information should be passed to this method.
+        if (effect.getValue() && effect.getValue() != memref &&
+            isLocallyAllocated(memref) && isLocallyAllocated(effect.getValue()))
+          continue;
+        opMayHaveEffect = true;
+        break;
+      }
+    }
+
+    if (!opMayHaveEffect)
+      return false;
+
+    // If the side effect comes from an affine read or write, try to prove the
+    // side effecting `op` cannot reach `memOp`.
+    if (isa<AffineReadOpInterface, AffineWriteOpInterface>(op) &&
+        isa<AffineReadOpInterface, AffineWriteOpInterface>(memOp)) {
+      MemRefAccess srcAccess(op);
+      MemRefAccess destAccess(memOp);
+
+      // FIXME: This is unsafe as the two memref may be alias with each other.
+      // This is also one of the most important change from the MLIR in-tree
+      // scalar replacement.
+      if (srcAccess.memref != destAccess.memref)
+        return false;
+
+      // Affine dependence analysis here is applicable only if both ops operate
+      // on the same memref and if `op`, `memOp`, and `start` are in the same
+      // AffineScope.
+      if (getAffineScope(op) == getAffineScope(memOp) &&
+          getAffineScope(op) == getAffineScope(start)) {
+        // Number of loops containing the start op and the ending operation.
+        unsigned minSurroundingLoops =
+            getNumCommonSurroundingLoops(*start, *memOp);
+
+        // Number of loops containing the operation `op` which has the
+        // potential memory side effect and can occur on a path between `start`
+        // and `memOp`.
+        unsigned nsLoops = getNumCommonSurroundingLoops(*op, *memOp);
+
+        // For ease, let's consider the case that `op` is a store and we're
+        // looking for other potential stores (e.g `op`) that overwrite memory
+        // after `start`, and before being read in `memOp`. In this case, we
+        // only need to consider other potential stores with depth >
+        // minSurrounding loops since `start` would overwrite any store with a
+        // smaller number of surrounding loops before.
+        unsigned d;
+        FlatAffineValueConstraints dependenceConstraints;
+        for (d = nsLoops + 1; d > minSurroundingLoops; d--) {
+          DependenceResult result = checkMemrefAccessDependence(
+              srcAccess, destAccess, d, &dependenceConstraints,
+              /*dependenceComponents=*/nullptr);
+          // A dependence failure or the presence of a dependence implies a
+          // side effect.
+          if (!noDependence(result))
+            return true;
+        }
+
+        // No side effect was seen, simply return.
+        return false;
+      }
+      // TODO: Check here if the memrefs alias: there is no side effect if
+      // `srcAccess.memref` and `destAccess.memref` don't alias.
+    }
+    // We have an op with a memory effect and we cannot prove if it
+    // intervenes.
+    return true;
+  }
+
+  if (op->hasTrait<OpTrait::HasRecursiveMemoryEffects>()) {
+    // Recurse into the regions for this op and check whether the internal
+    // operations may have the side effect `EffectType` on memOp.
+    for (Region &region : op->getRegions())
+      for (Block &block : region)
+        for (Operation &nestedOp : block)
+          if (mayHaveInterveningEffect<EffectType>(&nestedOp, start, memOp,
+                                                   memref))
+            return true;
+    return false;
+  }
+
+  // Otherwise, conservatively assume generic operations have the effect on the
+  // operation.
+  return true;
+}
+
 /// Ensure that all operations that could be executed after `start`
 /// (noninclusive) and prior to `memOp` (e.g. on a control flow/op path between
 /// the operations) do not have the potential memory effect `EffectType` on
@@ -187,116 +310,17 @@ func::FuncOp getRuntimeFunc(ModuleOp module, std::string runtimeFuncName = "");
 /// change the read within `memOp`.
 template <typename EffectType>
 bool hasNoInterveningEffect(Operation *start, Operation *memOp, Value memref) {
-  auto isLocallyAllocated = [](Value memref) {
-    auto *defOp = memref.getDefiningOp();
-    return defOp && hasSingleEffect<MemoryEffects::Allocate>(defOp, memref);
-  };
-
   // A boolean representing whether an intervening operation could have impacted
   // memOp.
   bool hasSideEffect = false;
 
   // Check whether the effect on memOp can be caused by a given operation op.
-  std::function<void(Operation *)> checkOperation = [&](Operation *op) {
+  auto checkOperation = [&](Operation *op) {
     // If the effect has alreay been found, early exit,
     if (hasSideEffect)
       return;
-
-    if (auto memEffect = dyn_cast<MemoryEffectOpInterface>(op)) {
-      SmallVector<MemoryEffects::EffectInstance, 1> effects;
-      memEffect.getEffects(effects);
-
-      bool opMayHaveEffect = false;
-      for (auto effect : effects) {
-        // If op causes EffectType on a potentially aliasing location for memOp,
-        // mark as having the effect.
-        if (isa<EffectType>(effect.getEffect())) {
-          // TODO: This should be replaced with a check for no aliasing.
-          // Aliasing information should be passed to this method.
-          if (effect.getValue() && effect.getValue() != memref &&
-              isLocallyAllocated(memref) &&
-              isLocallyAllocated(effect.getValue()))
-            continue;
-          opMayHaveEffect = true;
-          break;
-        }
-      }
-
-      if (!opMayHaveEffect)
-        return;
-
-      // If the side effect comes from an affine read or write, try to prove the
-      // side effecting `op` cannot reach `memOp`.
-      if (isa<AffineReadOpInterface, AffineWriteOpInterface>(op) &&
-          isa<AffineReadOpInterface, AffineWriteOpInterface>(memOp)) {
-        MemRefAccess srcAccess(op);
-        MemRefAccess destAccess(memOp);
-
-        // FIXME: This is unsafe as the two memref may be alias with each other.
-        // This is also one of the most important change from the MLIR in-tree
-        // scalar replacement.
-        if (srcAccess.memref != destAccess.memref)
-          return;
-
-        // Affine dependence analysis here is applicable only if both ops
-        // operate on the same memref and if `op`, `memOp`, and `start` are in
-        // the same AffineScope.
-        if (getAffineScope(op) == getAffineScope(memOp) &&
-            getAffineScope(op) == getAffineScope(start)) {
-          // Number of loops containing the start op and the ending operation.
-          unsigned minSurroundingLoops =
-              getNumCommonSurroundingLoops(*start, *memOp);
-
-          // Number of loops containing the operation `op` which has the
-          // potential memory side effect and can occur on a path between
-          // `start` and `memOp`.
-          unsigned nsLoops = getNumCommonSurroundingLoops(*op, *memOp);
-
-          // For ease, let's consider the case that `op` is a store and we're
-          // looking for other potential stores (e.g `op`) that overwrite memory
-          // after `start`, and before being read in `memOp`. In this case, we
-          // only need to consider other potential stores with depth >
-          // minSurrounding loops since `start` would overwrite any store with a
-          // smaller number of surrounding loops before.
-          unsigned d;
-          FlatAffineValueConstraints dependenceConstraints;
-          for (d = nsLoops + 1; d > minSurroundingLoops; d--) {
-            DependenceResult result = checkMemrefAccessDependence(
-                srcAccess, destAccess, d, &dependenceConstraints,
-                /*dependenceComponents=*/nullptr);
-            // A dependence failure or the presence of a dependence implies a
-            // side effect.
-            if (!noDependence(result)) {
-              hasSideEffect = true;
-              return;
-            }
-          }
-
-          // No side effect was seen, simply return.
-          return;
-        }
-        // TODO: Check here if the memrefs alias: there is no side effect if
-        // `srcAccess.memref` and `destAccess.memref` don't alias.
-      }
-      // We have an op with a memory effect and we cannot prove if it
-      // intervenes.
-      hasSideEffect = true;
-      return;
-    }
-
-    if (op->hasTrait<OpTrait::HasRecursiveMemoryEffects>()) {
-      // Recurse into the regions for this op and check whether the internal
-      // operations may have the side effect `EffectType` on memOp.
-      for (Region &region : op->getRegions())
-        for (Block &block : region)
-          for (Operation &op : block)
-            checkOperation(&op);
-      return;
-    }
-
-    // Otherwise, conservatively assume generic operations have the effect
-    // on the operation.
-    hasSideEffect = true;
+    hasSideEffect =
+        mayHaveInterveningEffect<EffectType>(op, start, memOp, memref);
   };
 
   // Check all paths from ancestor op `parent` to the operation `to` for the
@@ -370,6 +394,54 @@ bool hasNoInterveningEffect(Operation *start, Operation *memOp, Value memref) {
   return !hasSideEffect;
 }
 
+//===----------------------------------------------------------------------===//
+// Function structure utils
+//===----------------------------------------------------------------------===//
+
+/// Return whether the operation materializes a constant value or buffer, which
+/// can be lifted into a function argument.
+bool isLiftableConstant(Operation *op);
+
+/// Get a hash of the function that is invariant to the function name and the
+/// names of values, such that structurally equivalent functions have the same
+/// hash. If "ignoreConstants" is true, the values of liftable constants are not
+/// hashed.
+llvm::hash_code getStructuralHash(func::FuncOp func,
+                                  bool ignoreConstants = false);
+
+/// Check whether the two functions are structurally equivalent, i.e., they
+/// have the same type, attributes, and body, apart from the function name and
+/// the estimation results. If "constantPairs" is provided, liftable constants
+/// are allowed to have different values and all pairs of them are collected.
+bool isStructurallyEquivalent(
+    func::FuncOp lhs, func::FuncOp rhs,
+    SmallVectorImpl<std::pair<Operation *, Operation *>> *constantPairs =
+        nullptr);
+
+/// Collect the functions transitively called by the "roots", including the
+/// roots themselves, into "levels" in a bottom-up order, such that a function
+/// is always placed in a higher level than all its callees. Functions in the
+/// same level never call each other and can be processed in parallel. Callees
+/// are resolved through "symbolTable", while external functions and recursive
+/// calls are ignored.
+void getFuncLevels(ArrayRef<func::FuncOp> roots, SymbolTable &symbolTable,
+                   SmallVectorImpl<SmallVector<func::FuncOp, 4>> &levels);
+
+//===----------------------------------------------------------------------===//
+// Operator profiling utils
+//===----------------------------------------------------------------------===//
+
+/// Get the profiling key of an operator of the given kind and bit width, e.g.,
+/// "mul_i8" for 8-bit integer multipliers and "fadd_f64" for double precision
+/// adders. Single precision float operators are keyed by the kind alone, such
+/// as "fadd", to stay compatible with existing target specs.
+std::string getOperatorKey(StringRef kind, unsigned width, bool isFloat);
+
+/// Get the profiling key of the operation, which is keyed by the operator kind,
+/// the element type, and the bit width of the operation. Return an empty string
+/// if the operation is not profiled, e.g., it only operates on index values.
+std::string getOperatorKey(Operation *op);
+
 //===----------------------------------------------------------------------===//
 // PtrLikeMemRefAccess Struct Declaration
 //===----------------------------------------------------------------------===//
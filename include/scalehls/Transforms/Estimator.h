@@ -16,11 +16,43 @@
 namespace mlir {
 namespace scalehls {
 
-// Get the operator name to latency/DSP usage mapping.
+/// Get the profile of the targeted device. If the target spec selects a "part"
+/// from its "devices" library, the profile of the part is returned. Otherwise,
+/// the target spec itself is the profile.
+llvm::json::Object *getDeviceProfile(llvm::json::Object *config);
+
+// Get the operator key to latency/DSP/LUT usage mapping. All operator kinds
+// are tabulated at each supported bit width, where uncharacterized frequencies
+// and bit widths are interpolated from the characterized ones.
 void getLatencyMap(llvm::json::Object *config,
                    llvm::StringMap<int64_t> &latencyMap);
 void getDspUsageMap(llvm::json::Object *config,
                     llvm::StringMap<int64_t> &dspUsageMap);
+void getLutUsageMap(llvm::json::Object *config,
+                    llvm::StringMap<int64_t> &lutUsageMap);
+
+/// Get the operator key to combinational delay mapping in nanoseconds, and the
+/// clock period of the targeted frequency in nanoseconds.
+void getDelayMap(llvm::json::Object *config, llvm::StringMap<double> &delayMap);
+double getClockPeriod(llvm::json::Object *config);
+
+/// Parse the target spec JSON file into "config". If "targetSpec" is empty,
+/// "config" is left empty such that all default values are used.
+LogicalResult parseTargetSpec(StringRef targetSpec, llvm::json::Object &config,
+                              std::string &errorMessage);
+
+/// The operator profiles of the targeted device collected from the target spec,
+/// which are shared by all estimators created with them. Default values are
+/// based on Xilinx PYNQ-Z1 board.
+struct TargetProfile {
+  explicit TargetProfile(llvm::json::Object *config);
+
+  llvm::StringMap<int64_t> latencyMap;
+  llvm::StringMap<int64_t> dspUsageMap;
+  llvm::StringMap<int64_t> lutUsageMap;
+  llvm::StringMap<double> delayMap;
+  double clockPeriod;
+};
 
 //===----------------------------------------------------------------------===//
 // ScaleHLSEstimator Class Declaration
@@ -34,11 +66,41 @@ public:
                              bool depAnalysis)
       : latencyMap(latencyMap), dspUsageMap(dspUsageMap),
         depAnalysis(depAnalysis) {}
-
-  // Entry for estimating function and loop.
+  explicit ScaleHLSEstimator(TargetProfile &profile, bool depAnalysis)
+      : latencyMap(profile.latencyMap), dspUsageMap(profile.dspUsageMap),
+        lutUsageMap(&profile.lutUsageMap), delayMap(&profile.delayMap),
+        clockPeriod(profile.clockPeriod), depAnalysis(depAnalysis) {}
+
+  // Entry for estimating function and loop. Sub-functions called by the
+  // function are estimated bottom-up over the call graph, unless they are
+  // marked as estimated through "setEstimatedSubFuncs".
   void estimateFunc(func::FuncOp func);
   void estimateLoop(AffineForOp loop, func::FuncOp func);
 
+  /// Estimate a standalone loop nest, where only the attributes inside of the
+  /// loop nest are touched. Return false if the estimation failed.
+  bool estimateLoop(AffineForOp loop);
+
+  /// Return the number of dependence queries issued so far, including the
+  /// queries issued when estimating sub-functions.
+  unsigned getNumDependenceQueries() const { return numDependenceQueries; }
+
+  /// Resolve sub-functions through the symbol table and reuse their existing
+  /// estimation results rather than estimating them at each call site. This is
+  /// required when functions are estimated in parallel from the leaf ones.
+  void setEstimatedSubFuncs(SymbolTable *symbolTable) {
+    subFuncTable = symbolTable;
+  }
+
+  /// Chain combinational operators against the clock period with their
+  /// profiled delays, such that operators share a cycle as long as their summed
+  /// delay fits in the clock period. Without the delays, combinational
+  /// operators are always chained.
+  void setOperatorDelays(llvm::StringMap<double> *delays, double period) {
+    delayMap = delays;
+    clockPeriod = period;
+  }
+
   using HLSVisitorBase::visitOp;
   bool visitUnhandledOp(Operation *op, int64_t begin) {
     // Default latency of any unhandled operation is 0.
@@ -67,24 +129,66 @@ public:
   }
 
   /// Handle operations with profiled latency.
-#define HANDLE(OPTYPE, KEYNAME)                                                \
+#define HANDLE(OPTYPE)                                                         \
   bool visitOp(OPTYPE op, int64_t begin) {                                     \
-    auto latency = latencyMap[KEYNAME] + 1;                                    \
-    setTiming(op, begin, begin + latency, latency, 1);                         \
-    for (unsigned i = 0; i < latency; ++i)                                     \
-      ++numOperatorMap[begin + i][KEYNAME];                                    \
-    ++totalNumOperatorMap[KEYNAME];                                            \
-    return true;                                                               \
+    return estimateOperatorTiming(op, begin), true;                            \
   }
-  HANDLE(arith::AddFOp, "fadd");
-  HANDLE(arith::SubFOp, "fadd");
-  HANDLE(arith::MulFOp, "fmul");
-  HANDLE(arith::DivFOp, "fdiv");
-  HANDLE(arith::CmpFOp, "fcmp");
-  HANDLE(math::ExpOp, "fexp");
+  // Unary expressions.
+  HANDLE(math::AbsIOp);
+  HANDLE(math::CosOp);
+  HANDLE(math::SinOp);
+  HANDLE(math::TanhOp);
+  HANDLE(math::SqrtOp);
+  HANDLE(math::RsqrtOp);
+  HANDLE(math::ExpOp);
+  HANDLE(math::Exp2Op);
+  HANDLE(math::LogOp);
+  HANDLE(math::Log2Op);
+  HANDLE(math::Log10Op);
+
+  // Float binary expressions.
+  HANDLE(arith::CmpFOp);
+  HANDLE(arith::AddFOp);
+  HANDLE(arith::SubFOp);
+  HANDLE(arith::MulFOp);
+  HANDLE(arith::DivFOp);
+  HANDLE(arith::RemFOp);
+  HANDLE(arith::MaxFOp);
+  HANDLE(arith::MinFOp);
+  HANDLE(math::PowFOp);
+
+  // Integer binary expressions.
+  HANDLE(arith::CmpIOp);
+  HANDLE(arith::AddIOp);
+  HANDLE(arith::SubIOp);
+  HANDLE(arith::MulIOp);
+  HANDLE(arith::DivSIOp);
+  HANDLE(arith::RemSIOp);
+  HANDLE(arith::DivUIOp);
+  HANDLE(arith::RemUIOp);
+  HANDLE(arith::XOrIOp);
+  HANDLE(arith::AndIOp);
+  HANDLE(arith::OrIOp);
+  HANDLE(arith::ShLIOp);
+  HANDLE(arith::ShRSIOp);
+  HANDLE(arith::ShRUIOp);
+  HANDLE(arith::MaxSIOp);
+  HANDLE(arith::MinSIOp);
+  HANDLE(arith::MaxUIOp);
+  HANDLE(arith::MinUIOp);
+
+  // Special expressions.
+  HANDLE(arith::TruncFOp);
+  HANDLE(arith::UIToFPOp);
+  HANDLE(arith::SIToFPOp);
+  HANDLE(arith::FPToSIOp);
+  HANDLE(arith::FPToUIOp);
 #undef HANDLE
 
 private:
+  /// Profiled operator related methods.
+  void estimateOperatorTiming(Operation *op, int64_t begin);
+
   /// LoadOp and StoreOp related methods.
   void getPartitionIndices(Operation *op);
   void estimateLoadStoreTiming(Operation *op, int64_t begin);
@@ -94,7 +198,11 @@ private:
   int64_t getDepMinII(int64_t II, func::FuncOp func, MemAccessesMap &map);
   int64_t getDepMinII(int64_t II, AffineForOp forOp, MemAccessesMap &map);
 
+  /// Sub-function related methods.
+  void estimateSubFuncs(func::FuncOp func, SymbolTable &symbolTable);
+
   /// Block scheduler and estimator.
+  void chainOperation(Operation *op);
   ResourceAttr calculateResource(Operation *funcOrLoop);
   TimingAttr estimateBlock(Block &block, int64_t begin = 0);
   void reverseTiming(Block &block);
@@ -120,12 +228,23 @@ private:
   NumOperatorMap numOperatorMap;
   llvm::StringMap<int64_t> totalNumOperatorMap;
 
-  // Store the operator name to latency/DSP usage mapping.
+  // Store the operator key to latency/DSP/LUT usage mapping. LUT usage is
+  // only estimated when the mapping is provided.
   llvm::StringMap<int64_t> &latencyMap;
   llvm::StringMap<int64_t> &dspUsageMap;
+  llvm::StringMap<int64_t> *lutUsageMap = nullptr;
+
+  // Store the operator key to delay mapping and the clock period for chaining
+  // combinational operators. For each scheduled operation, hold the summed
+  // delay of the combinational chain starting from the operation.
+  llvm::StringMap<double> *delayMap = nullptr;
+  double clockPeriod = 0;
+  DenseMap<Operation *, double> chainDelayMap;
 
   DominanceInfo DT;
   bool depAnalysis = true;
+  unsigned numDependenceQueries = 0;
+  SymbolTable *subFuncTable = nullptr;
 };
 
 } // namespace scalehls
@@ -173,7 +173,8 @@ public:
 
   bool evaluateFuncPipeline(func::FuncOp func);
   bool simplifyLoopNests(func::FuncOp func);
-  bool optimizeLoopBands(func::FuncOp func, bool directiveOnly);
+  bool optimizeLoopBands(func::FuncOp func, bool directiveOnly,
+                         StringRef csvRootPath);
   bool exploreDesignSpace(func::FuncOp func, bool directiveOnly,
                           StringRef outputRootPath, StringRef csvRootPath);
 
@@ -199,6 +200,12 @@ public:
 
   // The maximum distance in the neighbor search of DSE.
   float maxDistance;
+
+  // The number of evaluated loop design points, found function pareto points,
+  // and scored loop orders, which are reported as pass statistics.
+  unsigned numEvaluatedPoints = 0;
+  unsigned numParetoPoints = 0;
+  unsigned numScoredLoopOrders = 0;
 };
 
 } // namespace scalehls
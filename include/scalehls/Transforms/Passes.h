@@ -33,12 +33,14 @@ void registerScaleFlowCppPipeline();
 void registerTransformsPasses();
 
 void addCreateSubviewPasses(OpPassManager &pm,
-                            CreateSubviewMode mode = CreateSubviewMode::Point);
+                            CreateSubviewMode mode = CreateSubviewMode::Point,
+                            bool haloWindow = false);
 void addSimplifyCopyPasses(OpPassManager &pm);
 void addSimplifyAffineLoopPasses(OpPassManager &pm);
 
 std::unique_ptr<Pass>
 createDesignSpaceExplorePass(std::string dseTargetSpec = "");
+std::unique_ptr<Pass> createFuncDeduplicationPass(bool liftConstants = true);
 std::unique_ptr<Pass> createFuncDuplicationPass();
 std::unique_ptr<Pass>
 createFuncPreprocessPass(std::string hlsTopFunc = "forward");
@@ -46,19 +48,23 @@ createFuncPreprocessPass(std::string hlsTopFunc = "forward");
 /// Dataflow-related passes.
 std::unique_ptr<Pass> createBalanceDataflowNodePass();
 std::unique_ptr<Pass> createBufferizeDataflowPass();
-std::unique_ptr<Pass>
-createConvertDataflowToFuncPass(bool splitExternalAccess = true);
+std::unique_ptr<Pass> createConvertDataflowToFuncPass(
+    bool splitExternalAccess = true, bool estimatorAware = false,
+    unsigned maxCallOverhead = 1, std::string targetSpec = "");
 std::unique_ptr<Pass> createCreateDataflowFromTosaPass();
 std::unique_ptr<Pass> createCreateDataflowFromLinalgPass();
 std::unique_ptr<Pass> createCreateDataflowFromAffinePass();
 std::unique_ptr<Pass> createCreateTokenStreamPass();
 std::unique_ptr<Pass> createEliminateMultiConsumerPass();
 std::unique_ptr<Pass> createEliminateMultiProducerPass();
-std::unique_ptr<Pass> createLegalizeDataflowPass();
+std::unique_ptr<Pass> createLegalizeDataflowPass(bool costAware = false,
+                                                 unsigned bramBudget = 0,
+                                                 std::string targetSpec = "");
 std::unique_ptr<Pass> createLowerDataflowPass(bool splitExternalAccess = true);
 std::unique_ptr<Pass> createParallelizeDataflowNodePass(
     unsigned loopUnrollFactor = 1, bool unrollPointLoopOnly = false,
-    bool complexityAware = true, bool correlationAware = true);
+    bool complexityAware = true, bool correlationAware = true,
+    bool opAware = false, std::string targetSpec = "");
 std::unique_ptr<Pass>
 createPlaceDataflowBufferPass(bool placeExternalBuffer = true);
 std::unique_ptr<Pass>
@@ -76,7 +82,8 @@ std::unique_ptr<Pass> createTosaSimplifyGraphPass();
 std::unique_ptr<Pass> createAffineLoopFusionPass(
     double computeToleranceThreshold = 0.3, unsigned fastMemorySpace = 0,
     uint64_t localBufSizeThreshold = 0, bool maximalFusion = false,
-    enum AffineFusionMode fusionMode = AffineFusionMode::Greedy);
+    enum AffineFusionMode fusionMode = AffineFusionMode::Greedy,
+    bool estimatorAware = false, std::string targetSpec = "");
 std::unique_ptr<Pass> createAffineLoopOrderOptPass();
 std::unique_ptr<Pass> createAffineLoopPerfectionPass();
 std::unique_ptr<Pass> createAffineLoopTilePass(unsigned loopTileSize = 1);
@@ -85,20 +92,25 @@ createAffineLoopUnrollJamPass(unsigned loopUnrollFactor = 1,
                               bool unrollPointLoopOnly = false);
 std::unique_ptr<Pass> createDetectReductionPass();
 std::unique_ptr<Pass> createMaterializeReductionPass();
-std::unique_ptr<Pass> createRemoveVariableBoundPass();
+std::unique_ptr<Pass>
+createRemoveVariableBoundPass(bool splitIterSpace = false);
 
 /// Memory-related passes.
 std::unique_ptr<Pass> createAffineStoreForwardPass();
 std::unique_ptr<Pass> createCollapseMemrefUnitDimsPass();
+std::unique_ptr<Pass> createCreateLineBufferPass();
 std::unique_ptr<Pass>
 createCreateLocalBufferPass(bool externalBufferOnly = true,
-                            bool registerOnly = false);
+                            bool registerOnly = false,
+                            bool doubleBuffer = false, unsigned bramBudget = 0);
 std::unique_ptr<Pass> createCreateMemrefSubviewPass(
-    CreateSubviewMode createSubviewMode = CreateSubviewMode::Point);
+    CreateSubviewMode createSubviewMode = CreateSubviewMode::Point,
+    bool haloWindow = false);
 std::unique_ptr<Pass>
 createLowerCopyToAffinePass(bool internalCopyOnly = false);
 std::unique_ptr<Pass> createRaiseAffineToCopyPass();
-std::unique_ptr<Pass> createReduceInitialIntervalPass();
+std::unique_ptr<Pass> createReduceInitialIntervalPass(bool fastMath = false,
+                                                      unsigned numPartials = 0);
 std::unique_ptr<Pass> createSimplifyAffineIfPass();
 std::unique_ptr<Pass> createSimplifyCopyPass();
 
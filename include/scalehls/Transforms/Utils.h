@@ -18,15 +18,55 @@ using namespace hls;
 /// into the innermost loop of the input loop band.
 bool applyAffineLoopPerfection(AffineLoopBand &band);
 
-/// Optimize loop order. Loops associated with memory access dependencies are
-/// moved to an as outer as possible location of the input loop band. If
-/// "reverse" is true, as inner as possible.
+/// The cost of a loop order of a perfect loop band, where the innermost loop is
+/// pipelined. Costs are compared in the order of II, non-burst accesses, reuse
+/// distance, and carried depth, and the lower the better.
+struct LoopOrderCost {
+  /// The II of the pipelined loop bounded by the loop-carried dependencies and
+  /// by the memory ports of each partition.
+  unsigned dependenceII = 1;
+  unsigned portII = 1;
+
+  /// The number of accesses to external memories that can't be bursted along
+  /// the pipelined loop.
+  unsigned numNonBurstAccesses = 0;
+
+  /// The sum of the reuse distance of each memref, which is the number of
+  /// iterations between two accesses to the same element.
+  int64_t reuseDistance = 0;
+
+  /// The sum of the locations of the loops carrying each dependency, which
+  /// prefers dependencies to be carried by outer loops.
+  unsigned carriedDepth = 0;
+
+  unsigned getII() const { return std::max(dependenceII, portII); }
+  bool operator<(const LoopOrderCost &rhs) const;
+};
+
+/// A loop order represented by its permutation map, where "permMap[i]" is the
+/// new location of the i-th loop, and its cost.
+using LoopOrderCandidate = std::pair<SmallVector<unsigned, 8>, LoopOrderCost>;
+
+/// Score the legal loop orders of the perfect loop band and return them in
+/// "candidates" sorted from the best to the worst. Bands deeper than
+/// "maxExhaustiveDepth" only have a pruned subset of loop orders scored.
+bool getLoopOrderCandidates(AffineLoopBand &band,
+                            SmallVectorImpl<LoopOrderCandidate> &candidates,
+                            unsigned maxExhaustiveDepth = 6);
+
+/// Optimize loop order. If "permMap" is not provided, the best legal loop order
+/// is picked by the cost model. If "reverse" is true, loops associated with
+/// memory access dependencies are instead moved to an as inner as possible
+/// location of the input loop band.
 bool applyAffineLoopOrderOpt(AffineLoopBand &band,
                              ArrayRef<unsigned> permMap = {},
                              bool reverse = false);
 
-/// Try to rectangularize the input band.
-bool applyRemoveVariableBound(AffineLoopBand &band);
+/// Try to rectangularize the input band. If "splitIterSpace" is true, split the
+/// iteration space into full tiles plus a remainder instead of creating guards
+/// where possible.
+bool applyRemoveVariableBound(AffineLoopBand &band,
+                              bool splitIterSpace = false);
 
 /// Apply loop tiling to the input loop band and sink all intra-tile loops to
 /// the innermost loop with the original loop order.
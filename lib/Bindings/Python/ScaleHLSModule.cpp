@@ -12,8 +12,10 @@
 #include "mlir/../../lib/Bindings/Python/IRModule.h"
 #include "mlir/CAPI/IR.h"
 #include "mlir/Dialect/Affine/Analysis/LoopAnalysis.h"
+#include "mlir/IR/Threading.h"
 #include "scalehls-c/EmitHLSCpp.h"
 #include "scalehls-c/HLS.h"
+#include "scalehls/Transforms/Estimator.h"
 #include "scalehls/Transforms/Utils.h"
 
 #include "llvm-c/ErrorHandling.h"
@@ -117,10 +119,43 @@ private:
   size_t nextIndex = 0;
 };
 
+/// The QoR estimator. Each estimation returns an N x 4 int64 numpy array, where
+/// each row holds the latency, interval, DSP, and BRAM of a function or loop.
+/// Results are directly written into the numpy buffer without any attribute or
+/// string round-trip.
+class PyEstimator {
+public:
+  PyEstimator(std::string targetSpec, bool depAnalysis)
+      : profile(getTargetProfile(targetSpec)), depAnalysis(depAnalysis) {}
+
+  /// Estimate the function. The first row is the function itself, and the
+  /// following rows are the outermost loops of each loop band, which follow the
+  /// order of LoopBandList.
+  py::object estimateFunc(MlirOperation op);
+
+  /// Estimate each loop of the loop band as a standalone loop nest, from the
+  /// outermost loop to the innermost loop.
+  py::object estimateBand(PyAffineLoopBand band);
+
+private:
+  static TargetProfile getTargetProfile(StringRef targetSpec) {
+    llvm::json::Object config;
+    std::string errorMessage;
+    if (failed(parseTargetSpec(targetSpec, config, errorMessage)))
+      throw SetPyError(PyExc_ValueError, errorMessage);
+    return TargetProfile(&config);
+  }
+
+  TargetProfile profile;
+  bool depAnalysis;
+};
+
 //===----------------------------------------------------------------------===//
 // Numpy array retrieval utils
 //===----------------------------------------------------------------------===//
 
+/// Retrieve the elements of a numpy array. This accesses Python objects and may
+/// raise Python errors, thus must be called while holding the GIL.
 static void getVectorFromUnsignedNpArray(PyObject *object,
                                          SmallVectorImpl<unsigned> &vector) {
   _import_array();
@@ -142,45 +177,128 @@ static void getVectorFromUnsignedNpArray(PyObject *object,
   }
 }
 
+//===----------------------------------------------------------------------===//
+// QoR estimation APIs
+//===----------------------------------------------------------------------===//
+
+/// Create an N x 4 int64 numpy array. This must be called while holding the
+/// GIL, while the returned data can be filled after releasing the GIL.
+static py::object createQoRNpArray(int64_t numRows, int64_t *&data) {
+  _import_array();
+  npy_intp dims[2] = {numRows, 4};
+  auto object = PyArray_SimpleNew(2, dims, NPY_INT64);
+  if (!object)
+    throw py::error_already_set();
+  data = reinterpret_cast<int64_t *>(
+      PyArray_DATA(reinterpret_cast<PyArrayObject *>(object)));
+  return py::reinterpret_steal<py::object>(object);
+}
+
+/// Write the estimated QoR of the function or loop into the row. All entries
+/// are set to -1 if the operation has not been successfully estimated.
+static void getQoRRow(Operation *op, int64_t *row) {
+  auto timing = getTiming(op);
+  auto resource = getResource(op);
+  if (!timing || !resource) {
+    std::fill(row, row + 4, -1);
+    return;
+  }
+  row[0] = timing.getLatency();
+  row[1] = timing.getInterval();
+  row[2] = resource.getDsp();
+  row[3] = resource.getBram();
+}
+
+py::object PyEstimator::estimateFunc(MlirOperation op) {
+  auto func = dyn_cast<func::FuncOp>(unwrap(op));
+  if (!func)
+    throw SetPyError(PyExc_ValueError, "targeted operation not a function");
+  if (!llvm::hasSingleElement(func.getBody()))
+    throw SetPyError(PyExc_ValueError, "function must have single block");
+
+  AffineLoopBands bands;
+  getLoopBands(func.front(), bands);
+  int64_t *data = nullptr;
+  auto array = createQoRNpArray(bands.size() + 1, data);
+  {
+    py::gil_scoped_release release;
+    // The loop bands are estimated first, such that the final timing
+    // attributes are consistent with the function-level estimation.
+    for (auto band : llvm::enumerate(bands)) {
+      auto estimator = ScaleHLSEstimator(profile, depAnalysis);
+      estimator.estimateLoop(band.value().front(), func);
+      getQoRRow(band.value().front(), data + (band.index() + 1) * 4);
+    }
+
+    // Drop stale results such that a failed estimation can be detected.
+    func->removeAttr("timing");
+    func->removeAttr("resource");
+    auto estimator = ScaleHLSEstimator(profile, depAnalysis);
+    estimator.estimateFunc(func);
+    getQoRRow(func, data);
+  }
+  return array;
+}
+
+py::object PyEstimator::estimateBand(PyAffineLoopBand band) {
+  int64_t *data = nullptr;
+  auto array = createQoRNpArray(band.depth(), data);
+  {
+    py::gil_scoped_release release;
+    // Estimate from the innermost loop, such that the final timing attributes
+    // are consistent with the estimation of the outermost loop.
+    auto &loops = band.get();
+    for (unsigned i = loops.size(); i > 0; --i) {
+      auto loop = loops[i - 1];
+      auto estimator = ScaleHLSEstimator(profile, depAnalysis);
+      if (estimator.estimateLoop(loop))
+        getQoRRow(loop, data + (i - 1) * 4);
+      else
+        std::fill(data + (i - 1) * 4, data + i * 4, -1);
+    }
+  }
+  return array;
+}
+
 //===----------------------------------------------------------------------===//
 // Loop transform APIs
 //===----------------------------------------------------------------------===//
 
 static bool loopPerfectization(PyAffineLoopBand band) {
-  py::gil_scoped_release();
+  py::gil_scoped_release release;
   return applyAffineLoopPerfection(band.get());
 }
 
 static bool loopOrderOpt(PyAffineLoopBand band) {
-  py::gil_scoped_release();
+  py::gil_scoped_release release;
   return applyAffineLoopOrderOpt(band.get());
 }
 
 static bool loopPermutation(PyAffineLoopBand band, py::object permMapObject) {
-  py::gil_scoped_release();
   SmallVector<unsigned, 8> permMap;
   getVectorFromUnsignedNpArray(permMapObject.ptr(), permMap);
+  py::gil_scoped_release release;
   return applyAffineLoopOrderOpt(band.get(), permMap);
 }
 
 /// Loop variable bound elimination.
 static bool loopVarBoundRemoval(PyAffineLoopBand band) {
-  py::gil_scoped_release();
+  py::gil_scoped_release release;
   return applyRemoveVariableBound(band.get());
 }
 
 static bool loopTiling(PyAffineLoopBand band, py::object factorsObject) {
-  py::gil_scoped_release();
   llvm::SmallVector<unsigned, 8> factors;
   getVectorFromUnsignedNpArray(factorsObject.ptr(), factors);
+  py::gil_scoped_release release;
   return applyLoopTiling(band.get(), factors);
 }
 
 static bool loopPipelining(PyAffineLoopBand band, int64_t pipelineLoc,
                            int64_t targetII) {
-  py::gil_scoped_release();
   if (pipelineLoc < 0 || pipelineLoc >= (int64_t)band.depth() || targetII < 1)
     throw SetPyError(PyExc_ValueError, "invalid location or targeted II");
+  py::gil_scoped_release release;
   return applyLoopPipelining(band.get(), pipelineLoc, targetII);
 }
 
@@ -189,26 +307,26 @@ static bool loopPipelining(PyAffineLoopBand band, int64_t pipelineLoc,
 //===----------------------------------------------------------------------===//
 
 static bool funcPreprocess(MlirOperation op, bool topFunc) {
-  py::gil_scoped_release();
   auto func = dyn_cast<func::FuncOp>(unwrap(op));
   if (!func)
     throw SetPyError(PyExc_ValueError, "targeted operation not a function");
+  py::gil_scoped_release release;
   return applyFuncPreprocess(func, topFunc);
 }
 
 static bool memoryOpts(MlirOperation op) {
-  py::gil_scoped_release();
   auto func = dyn_cast<func::FuncOp>(unwrap(op));
   if (!func)
     throw SetPyError(PyExc_ValueError, "targeted operation not a function");
+  py::gil_scoped_release release;
   return applyMemoryOpts(func);
 }
 
 static bool autoArrayPartition(MlirOperation op) {
-  py::gil_scoped_release();
   auto func = dyn_cast<func::FuncOp>(unwrap(op));
   if (!func)
     throw SetPyError(PyExc_ValueError, "targeted operation not a function");
+  py::gil_scoped_release release;
   return applyAutoArrayPartition(func);
 }
 
@@ -219,9 +337,9 @@ static bool autoArrayPartition(MlirOperation op) {
 /// TODO: Support to apply different partition kind to different dimension.
 static bool arrayPartition(MlirValue array, py::object factorsObject,
                            std::string kind) {
-  py::gil_scoped_release();
   llvm::SmallVector<unsigned, 4> factors;
   getVectorFromUnsignedNpArray(factorsObject.ptr(), factors);
+  py::gil_scoped_release release;
   llvm::SmallVector<hls::PartitionKind, 4> kinds(
       factors.size(), kind == "cyclic"  ? hls::PartitionKind::CYCLIC
                       : kind == "block" ? hls::PartitionKind::BLOCK
@@ -229,13 +347,108 @@ static bool arrayPartition(MlirValue array, py::object factorsObject,
   return applyArrayPartition(unwrap(array), factors, kinds);
 }
 
+//===----------------------------------------------------------------------===//
+// Batch transform APIs
+//===----------------------------------------------------------------------===//
+
+namespace {
+/// A loop optimization strategy, which is composed of the index of the targeted
+/// loop band, the tile factors, the pipeline location, and the targeted II.
+struct LoopStrategy {
+  unsigned bandIdx;
+  FactorList tileFactors;
+  unsigned pipelineLoc;
+  unsigned targetII;
+};
+} // namespace
+
+/// Apply each strategy to an independent clone of the function. Strategies
+/// are (band index, tile factors, pipeline location, targeted II) tuples. The
+/// clones are inserted after the original function and transformed in
+/// parallel with the GIL released. Return a list of (clone, success) tuples.
+static py::list applyStrategies(MlirOperation op, py::list strategyObjects) {
+  auto func = dyn_cast<func::FuncOp>(unwrap(op));
+  if (!func)
+    throw SetPyError(PyExc_ValueError, "targeted operation not a function");
+  if (!llvm::hasSingleElement(func.getBody()))
+    throw SetPyError(PyExc_ValueError, "function must have single block");
+  auto module = func->getParentOfType<ModuleOp>();
+  if (!module)
+    throw SetPyError(PyExc_ValueError, "function must be nested in a module");
+
+  AffineLoopBands bands;
+  getLoopBands(func.front(), bands);
+
+  // Parse and verify all strategies while holding the GIL.
+  SmallVector<LoopStrategy, 16> strategies;
+  for (auto object : strategyObjects) {
+    if (!py::isinstance<py::tuple>(object) || py::len(object) != 4)
+      throw SetPyError(PyExc_ValueError,
+                       "expect (band, factors, location, II) tuple");
+    auto tuple = object.cast<py::tuple>();
+    auto bandIdx = tuple[0].cast<int64_t>();
+    if (bandIdx < 0 || bandIdx >= (int64_t)bands.size())
+      throw SetPyError(PyExc_ValueError, "invalid loop band index");
+
+    LoopStrategy strategy;
+    strategy.bandIdx = bandIdx;
+    getVectorFromUnsignedNpArray(tuple[1].ptr(), strategy.tileFactors);
+    if (strategy.tileFactors.size() != bands[bandIdx].size())
+      throw SetPyError(PyExc_ValueError, "tile factors mismatch band depth");
+
+    auto pipelineLoc = tuple[2].cast<int64_t>();
+    auto targetII = tuple[3].cast<int64_t>();
+    if (pipelineLoc < 0 || pipelineLoc >= (int64_t)bands[bandIdx].size() ||
+        targetII < 1)
+      throw SetPyError(PyExc_ValueError, "invalid location or targeted II");
+    strategy.pipelineLoc = pipelineLoc;
+    strategy.targetII = targetII;
+    strategies.push_back(strategy);
+  }
+
+  // Cloning mutates the module and its symbol table, which is not thread-safe,
+  // thus the clones are created serially.
+  SymbolTable symbolTable(module);
+  SmallVector<func::FuncOp, 16> clones;
+  auto insertPt = std::next(func->getIterator());
+  for (unsigned i = 0, e = strategies.size(); i < e; ++i) {
+    auto clone = func.clone();
+    clone.setName((func.getName() + "_strategy" + Twine(i)).str());
+    symbolTable.insert(clone, insertPt);
+    insertPt = std::next(clone->getIterator());
+    clones.push_back(clone);
+  }
+
+  // Each clone is isolated from above and only touched by one thread, such that
+  // the strategies can be applied in parallel.
+  SmallVector<char, 16> results(strategies.size(), false);
+  {
+    py::gil_scoped_release release;
+    parallelFor(func.getContext(), 0, clones.size(), [&](size_t i) {
+      auto &strategy = strategies[i];
+      AffineLoopBands cloneBands;
+      getLoopBands(clones[i].front(), cloneBands);
+      auto &band = cloneBands[strategy.bandIdx];
+      results[i] = applyLoopTiling(band, strategy.tileFactors) &&
+                   applyLoopPipelining(band, strategy.pipelineLoc,
+                                       strategy.targetII);
+    });
+  }
+
+  py::list resultList;
+  for (unsigned i = 0, e = clones.size(); i < e; ++i)
+    resultList.append(py::make_tuple(wrap(clones[i].getOperation()),
+                                     (bool)results[i]));
+  return resultList;
+}
+
 //===----------------------------------------------------------------------===//
 // Emission APIs
 //===----------------------------------------------------------------------===//
 
 static bool emitHlsCpp(MlirModule mod, py::object fileObject) {
   PyFileAccumulator accum(fileObject, false);
-  py::gil_scoped_release();
+  py::gil_scoped_release release;
   return mlirLogicalResultIsSuccess(
       mlirEmitHlsCpp(mod, accum.getCallback(), accum.getUserData()));
 }
@@ -275,6 +488,9 @@ PYBIND11_MODULE(_scalehls, m) {
   // Array transform APIs.
   m.def("array_partition", &arrayPartition);
 
+  // Batch transform APIs.
+  m.def("apply_strategies", &applyStrategies);
+
   // Emission APIs.
   m.def("emit_hlscpp", &emitHlsCpp);
 
@@ -291,6 +507,12 @@ PYBIND11_MODULE(_scalehls, m) {
       .def("__iter__", &PyAffineLoopBandList::dunderIter)
       .def("__next__", &PyAffineLoopBandList::dunderNext);
 
+  py::class_<PyEstimator>(m, "Estimator", py::module_local())
+      .def(py::init<std::string, bool>(), py::arg("target_spec") = "",
+           py::arg("dep_analysis") = true)
+      .def("estimate_func", &PyEstimator::estimateFunc, py::arg("op"))
+      .def("estimate_band", &PyEstimator::estimateBand, py::arg("band"));
+
   py::class_<PyArrayList>(m, "ArrayList", py::module_local())
       .def(py::init<MlirOperation>(), py::arg("op"))
       .def_property_readonly("size", &PyArrayList::size)
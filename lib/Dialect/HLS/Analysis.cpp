@@ -6,6 +6,7 @@
 
 #include "scalehls/Dialect/HLS/Analysis.h"
 #include "scalehls/Transforms/Utils.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/Support/Debug.h"
 
 #define DEBUG_TYPE "dataflow-analysis"
@@ -14,7 +15,10 @@ using namespace mlir;
 using namespace scalehls;
 using namespace hls;
 
-ComplexityAnalysis::ComplexityAnalysis(func::FuncOp func) {
+ComplexityAnalysis::ComplexityAnalysis(
+    func::FuncOp func, const llvm::StringMap<int64_t> *latencyMap,
+    const llvm::StringMap<int64_t> *dspUsageMap)
+    : latencyMap(latencyMap), dspUsageMap(dspUsageMap) {
   func.walk([&](NodeOp node) {
     auto nodeComplexity = calculateBlockComplexity(&node.getBody().front());
     if (!nodeComplexity.has_value()) {
@@ -46,10 +50,58 @@ ComplexityAnalysis::getNodeComplexity(NodeOp node) const {
   return Optional<unsigned long>();
 }
 
+/// Get the profiled complexity of a single operation, which is the latency
+/// plus the DSP usage of the operator. Operators that are not profiled are
+/// counted as one, while constants and index computations are free.
+unsigned long ComplexityAnalysis::getOperationComplexity(Operation *op) const {
+  if (op->hasTrait<OpTrait::IsTerminator>() ||
+      op->hasTrait<OpTrait::ConstantLike>() || isa<AffineApplyOp>(op))
+    return 0;
+
+  auto keyName = getOperatorKey(op);
+  if (keyName.empty())
+    return 1;
+
+  // Align with the estimator, where the latency of a profiled operator is one
+  // cycle longer than the profiled number, unless the operator is purely
+  // combinational and chained with its users.
+  auto latency = latencyMap->lookup(keyName);
+  if (latency)
+    ++latency;
+  auto dspUsage = dspUsageMap ? dspUsageMap->lookup(keyName) : 0;
+  return std::max((int64_t)1, latency + dspUsage);
+}
+
+/// Get the complexity of accessing the given memory for "numAccesses" times in
+/// one iteration, which is the number of cycles to serve all the accesses with
+/// the available memory ports. Single-element memories are implemented with
+/// registers and thus are free, while dynamically shaped memories are
+/// conservatively assumed to have a single port.
+unsigned long
+ComplexityAnalysis::getMemoryComplexity(Value memref,
+                                        unsigned numAccesses) const {
+  auto memrefType = memref.getType().cast<MemRefType>();
+  if (!memrefType.hasStaticShape())
+    return numAccesses;
+  if (memrefType.getNumElements() == 1)
+    return 0;
+
+  // External memories are accessed through a single AXI port, while on-chip
+  // memories have two ports by default.
+  auto kind = MemoryKind(memrefType.getMemorySpaceAsInt());
+  unsigned long numPorts = 2;
+  if (isRam1P(kind) || isDram(kind))
+    numPorts = 1;
+  if (!isDram(kind))
+    numPorts *= getPartitionFactors(memrefType);
+  return llvm::divideCeil(numAccesses, numPorts);
+}
+
 /// A helper to get the complexity of the given block
 Optional<unsigned long>
 ComplexityAnalysis::calculateBlockComplexity(Block *block) const {
   unsigned long complexity = 0;
+  llvm::SmallMapVector<Value, unsigned, 8> numAccessesMap;
   for (auto &op : block->getOperations()) {
     assert(!isa<NodeOp>(op) && "must not be node op");
 
@@ -80,10 +132,26 @@ ComplexityAnalysis::calculateBlockComplexity(Block *block) const {
         ifComplexity = std::max(ifComplexity, elseComplexity.value());
       }
       complexity += ifComplexity;
+
+    } else if (latencyMap) {
+      // Memory accesses are accumulated and weighted by the memory ports
+      // afterwards, while other operations are weighted by their profiled
+      // latency and DSP usage.
+      if (auto read = dyn_cast<mlir::AffineReadOpInterface>(op))
+        ++numAccessesMap[read.getMemRef()];
+      else if (auto write = dyn_cast<mlir::AffineWriteOpInterface>(op))
+        ++numAccessesMap[write.getMemRef()];
+      else if (auto load = dyn_cast<memref::LoadOp>(op))
+        ++numAccessesMap[load.getMemRef()];
+      else if (auto store = dyn_cast<memref::StoreOp>(op))
+        ++numAccessesMap[store.getMemRef()];
+      else
+        complexity += getOperationComplexity(&op);
     }
-    // else if (!op.hasTrait<OpTrait::IsTerminator>())
-    //   complexity += 1;
   }
+
+  for (auto &memrefAndNum : numAccessesMap)
+    complexity += getMemoryComplexity(memrefAndNum.first, memrefAndNum.second);
   return complexity;
 }
 
@@ -208,6 +276,12 @@ CorrelationAnalysis::CorrelationAnalysis(func::FuncOp func) {
         // correlations.push_back(corr);
         nodeCorrelationMap[producer].push_back(corr);
         nodeCorrelationMap[consumer].push_back(corr);
+
+        // Merge the classes of each pair of correlated loops.
+        for (auto i : llvm::enumerate(sourceToTargetMap))
+          if (i.value() != -1)
+            loopClasses.unionSets(NodeLoop(producer, i.value()),
+                                  NodeLoop(consumer, i.index()));
       }
     }
     return WalkResult::advance();
@@ -8,6 +8,8 @@
 #include "mlir/Dialect/Affine/Analysis/AffineAnalysis.h"
 #include "mlir/Dialect/Affine/Analysis/LoopAnalysis.h"
 #include "mlir/Dialect/Affine/Analysis/Utils.h"
+#include "mlir/Dialect/Arith/IR/Arith.h"
+#include "mlir/Dialect/Math/IR/Math.h"
 #include "mlir/Dialect/MemRef/IR/MemRef.h"
 #include "mlir/Dialect/SCF/IR/SCF.h"
 #include "mlir/Dialect/Tosa/IR/TosaOps.h"
@@ -172,6 +174,59 @@ NodeOp scalehls::fuseNodeOps(ArrayRef<NodeOp> nodes,
   return newNode;
 }
 
+/// Pass the output of the node to its consumers through a chain of buffers and
+/// copy nodes, one for each dataflow level, such that every consumer reads a
+/// buffer produced at the adjacent level. "consumers" holds the level
+/// difference and consumer pairs in a descending order of level difference,
+/// and is consumed by this method.
+void scalehls::insertCopyNodeChain(
+    NodeOp node, Value output,
+    SmallVectorImpl<std::pair<unsigned, NodeOp>> &consumers,
+    PatternRewriter &rewriter) {
+  if (consumers.empty())
+    return;
+  auto maxDiff = consumers.front().first;
+
+  auto currentBuf = output;
+  auto currentNode = node;
+  for (unsigned i = 2; i <= maxDiff; ++i) {
+    // Create a new buffer.
+    auto loc = rewriter.getUnknownLoc();
+    rewriter.setInsertionPoint(currentNode);
+    auto newBuf = rewriter.create<BufferOp>(loc, output.getType()).getMemref();
+
+    // Construct a new node for data copy.
+    rewriter.setInsertionPointAfter(currentNode);
+    auto newNode = rewriter.create<NodeOp>(loc, ValueRange(currentBuf),
+                                           ValueRange(newBuf));
+    newNode.setLevelAttr(
+        rewriter.getI32IntegerAttr(node.getLevel().value() + 1 - i));
+    auto block = rewriter.createBlock(&newNode.getBody());
+    block->addArguments(TypeRange({currentBuf.getType(), newBuf.getType()}),
+                        {currentBuf.getLoc(), newBuf.getLoc()});
+
+    // Create an explicit copy operation.
+    rewriter.setInsertionPointToStart(block);
+    rewriter.create<memref::CopyOp>(loc, block->getArgument(0),
+                                    block->getArgument(1));
+
+    // Replace all uses at the current level.
+    llvm::SmallDenseSet<Operation *, 4> levelConsumers;
+    while (!consumers.empty() && (consumers.back().first == i))
+      levelConsumers.insert(consumers.pop_back_val().second);
+    for (auto consumer : levelConsumers)
+      rewriter.updateRootInPlace(consumer, [&]() {
+        output.replaceUsesWithIf(newBuf, [&](OpOperand &use) {
+          return use.getOwner() == consumer;
+        });
+      });
+
+    // Finally, we can update current buffer and current node.
+    currentBuf = newBuf;
+    currentNode = newNode;
+  }
+}
+
 static auto getUsersExcept(Value buffer, OperandKind kind, NodeOp except) {
   SmallVector<NodeOp> nodes;
   for (auto &use : buffer.getUses())
@@ -246,6 +301,18 @@ bool scalehls::isExternalBuffer(Value memref) {
   return false;
 }
 
+/// Return the number of BRAM18K blocks occupied by one copy of an on-chip
+/// buffer of the given type. This is an upper bound, as small buffers may be
+/// implemented with LUTRAMs or registers by the HLS tool.
+unsigned scalehls::getNumBram(Type type) {
+  auto memrefType = type.dyn_cast<MemRefType>();
+  if (!memrefType || !memrefType.hasStaticShape() ||
+      !memrefType.getElementType().isIntOrFloat())
+    return 0;
+  auto bits = memrefType.getNumElements() * memrefType.getElementTypeBitWidth();
+  return (bits + 18 * 1024 - 1) / (18 * 1024);
+}
+
 /// Check whether the given use has read/write semantics.
 bool scalehls::isRead(OpOperand &use) {
   // For NodeOp and ScheduleOp, we don't rely on memory effect interface.
@@ -668,7 +735,7 @@ scalehls::getBoundOfAffineMap(AffineMap map, ValueRange operands) {
   for (unsigned i = 0, e = pow(2, operandNum); i < e; ++i) {
     SmallVector<AffineExpr, 4> replacements;
     for (unsigned pos = 0; pos < operandNum; ++pos) {
-      if (i >> pos % 2 == 0)
+      if (((i >> pos) & 1) == 0)
         replacements.push_back(getAffineConstantExpr(lbs[pos], context));
       else
         replacements.push_back(getAffineConstantExpr(ubs[pos], context));
@@ -944,6 +1011,259 @@ func::FuncOp scalehls::getRuntimeFunc(ModuleOp module,
   return runtimeFunc;
 }
 
+//===----------------------------------------------------------------------===//
+// Function structure utils
+//===----------------------------------------------------------------------===//
+
+/// Return whether the operation materializes a constant value or buffer, which
+/// can be lifted into a function argument.
+bool scalehls::isLiftableConstant(Operation *op) {
+  return op->getNumOperands() == 0 && op->getNumRegions() == 0 &&
+         op->getNumResults() == 1 &&
+         (op->hasTrait<OpTrait::ConstantLike>() ||
+          isa<ConstBufferOp, memref::GetGlobalOp>(op));
+}
+
+/// Get a hash of the function that is invariant to the function name and the
+/// names of values, such that structurally equivalent functions have the same
+/// hash. If "ignoreConstants" is true, the values of liftable constants are not
+/// hashed.
+llvm::hash_code scalehls::getStructuralHash(func::FuncOp func,
+                                            bool ignoreConstants) {
+  auto hash = llvm::hash_value(func.getFunctionType());
+  func.walk([&](Operation *op) {
+    if (op == func.getOperation())
+      return;
+    if (ignoreConstants && isLiftableConstant(op))
+      hash = llvm::hash_combine(hash, op->getName());
+    else
+      hash = llvm::hash_combine(hash, op->getName(), op->getAttrDictionary(),
+                                op->getNumOperands(), op->getNumRegions());
+    for (auto type : op->getResultTypes())
+      hash = llvm::hash_combine(hash, type);
+  });
+  return hash;
+}
+
+using ConstantPairs = SmallVectorImpl<std::pair<Operation *, Operation *>>;
+
+static bool isStructurallyEquivalent(Region &lhs, Region &rhs,
+                                     DenseMap<Value, Value> &valueMap,
+                                     ConstantPairs *constantPairs);
+
+/// Check whether the two operations are structurally equivalent. The operands
+/// are compared through "valueMap", which maps the values of the lhs to the
+/// values of the rhs and is updated with the results and block arguments.
+static bool isStructurallyEquivalent(Operation *lhs, Operation *rhs,
+                                     DenseMap<Value, Value> &valueMap,
+                                     ConstantPairs *constantPairs) {
+  if (constantPairs && isLiftableConstant(lhs) && isLiftableConstant(rhs) &&
+      lhs->getName() == rhs->getName() &&
+      lhs->getResultTypes() == rhs->getResultTypes()) {
+    constantPairs->push_back({lhs, rhs});
+    valueMap[lhs->getResult(0)] = rhs->getResult(0);
+    return true;
+  }
+
+  if (lhs->getName() != rhs->getName() ||
+      lhs->getAttrDictionary() != rhs->getAttrDictionary() ||
+      lhs->getResultTypes() != rhs->getResultTypes() ||
+      lhs->getNumOperands() != rhs->getNumOperands() ||
+      lhs->getNumRegions() != rhs->getNumRegions() ||
+      lhs->getNumSuccessors() || rhs->getNumSuccessors())
+    return false;
+
+  for (auto t : llvm::zip(lhs->getOperands(), rhs->getOperands())) {
+    auto it = valueMap.find(std::get<0>(t));
+    if (it == valueMap.end() || it->second != std::get<1>(t))
+      return false;
+  }
+  for (auto t : llvm::zip(lhs->getRegions(), rhs->getRegions()))
+    if (!isStructurallyEquivalent(std::get<0>(t), std::get<1>(t), valueMap,
+                                  constantPairs))
+      return false;
+  for (auto t : llvm::zip(lhs->getResults(), rhs->getResults()))
+    valueMap[std::get<0>(t)] = std::get<1>(t);
+  return true;
+}
+
+static bool isStructurallyEquivalent(Region &lhs, Region &rhs,
+                                     DenseMap<Value, Value> &valueMap,
+                                     ConstantPairs *constantPairs) {
+  if (lhs.getBlocks().size() != rhs.getBlocks().size())
+    return false;
+
+  for (auto b : llvm::zip(lhs, rhs)) {
+    auto &lhsBlock = std::get<0>(b);
+    auto &rhsBlock = std::get<1>(b);
+    if (lhsBlock.getArgumentTypes() != rhsBlock.getArgumentTypes() ||
+        lhsBlock.getOperations().size() != rhsBlock.getOperations().size())
+      return false;
+
+    for (auto t :
+         llvm::zip(lhsBlock.getArguments(), rhsBlock.getArguments()))
+      valueMap[std::get<0>(t)] = std::get<1>(t);
+    for (auto t : llvm::zip(lhsBlock, rhsBlock))
+      if (!isStructurallyEquivalent(&std::get<0>(t), &std::get<1>(t),
+                                    valueMap, constantPairs))
+        return false;
+  }
+  return true;
+}
+
+/// Check whether the two functions are structurally equivalent, i.e., they
+/// have the same type, attributes, and body, apart from the function name and
+/// the estimation results. If "constantPairs" is provided, liftable constants
+/// are allowed to have different values and all pairs of them are collected.
+bool scalehls::isStructurallyEquivalent(
+    func::FuncOp lhs, func::FuncOp rhs,
+    SmallVectorImpl<std::pair<Operation *, Operation *>> *constantPairs) {
+  auto getComparedAttrs = [](func::FuncOp func) {
+    SmallVector<NamedAttribute, 4> attrs;
+    for (auto attr : func->getAttrs())
+      if (attr.getName() != SymbolTable::getSymbolAttrName() &&
+          attr.getName() != "timing" && attr.getName() != "resource")
+        attrs.push_back(attr);
+    return attrs;
+  };
+  if (lhs.getFunctionType() != rhs.getFunctionType() ||
+      getComparedAttrs(lhs) != getComparedAttrs(rhs))
+    return false;
+
+  DenseMap<Value, Value> valueMap;
+  return ::isStructurallyEquivalent(lhs.getBody(), rhs.getBody(), valueMap,
+                                    constantPairs);
+}
+
+/// Return the level of the function, which is the length of the longest call
+/// chain from the function to a leaf function.
+static unsigned getFuncLevel(func::FuncOp func, SymbolTable &symbolTable,
+                             DenseMap<Operation *, unsigned> &levelMap,
+                             SmallPtrSetImpl<Operation *> &visiting,
+                             SmallVectorImpl<func::FuncOp> &funcs) {
+  auto it = levelMap.find(func);
+  if (it != levelMap.end())
+    return it->second;
+
+  visiting.insert(func);
+  unsigned level = 0;
+  func.walk([&](func::CallOp call) {
+    auto callee = symbolTable.lookup<func::FuncOp>(call.getCallee());
+    if (!callee || callee.isExternal() || visiting.count(callee))
+      return;
+    auto calleeLevel =
+        getFuncLevel(callee, symbolTable, levelMap, visiting, funcs);
+    level = std::max(level, calleeLevel + 1);
+  });
+  visiting.erase(func);
+
+  levelMap[func] = level;
+  funcs.push_back(func);
+  return level;
+}
+
+/// Collect the functions transitively called by the "roots", including the
+/// roots themselves, into "levels" in a bottom-up order, such that a function
+/// is always placed in a higher level than all its callees. Functions in the
+/// same level never call each other and can be processed in parallel. Callees
+/// are resolved through "symbolTable", while external functions and recursive
+/// calls are ignored.
+void scalehls::getFuncLevels(
+    ArrayRef<func::FuncOp> roots, SymbolTable &symbolTable,
+    SmallVectorImpl<SmallVector<func::FuncOp, 4>> &levels) {
+  DenseMap<Operation *, unsigned> levelMap;
+  SmallPtrSet<Operation *, 16> visiting;
+  SmallVector<func::FuncOp, 16> funcs;
+  for (auto root : roots)
+    if (!root.isExternal())
+      getFuncLevel(root, symbolTable, levelMap, visiting, funcs);
+
+  // Functions are bucketed in the order they are finished by the traversal,
+  // such that the result is deterministic.
+  levels.clear();
+  for (auto func : funcs) {
+    auto level = levelMap.lookup(func);
+    if (levels.size() <= level)
+      levels.resize(level + 1);
+    levels[level].push_back(func);
+  }
+}
+
+//===----------------------------------------------------------------------===//
+// Operator profiling utils
+//===----------------------------------------------------------------------===//
+
+/// Get the profiling key of an operator of the given kind and bit width, e.g.,
+/// "mul_i8" for 8-bit integer multipliers and "fadd_f64" for double precision
+/// adders. Single precision float operators are keyed by the kind alone, such
+/// as "fadd", to stay compatible with existing target specs.
+std::string scalehls::getOperatorKey(StringRef kind, unsigned width,
+                                     bool isFloat) {
+  if (isFloat && width == 32)
+    return kind.str();
+  return (kind + (isFloat ? "_f" : "_i") + Twine(width)).str();
+}
+
+/// Get the profiling key of the operation, which is keyed by the operator kind,
+/// the element type, and the bit width of the operation. Return an empty string
+/// if the operation is not profiled, e.g., it only operates on index values.
+std::string scalehls::getOperatorKey(Operation *op) {
+  // Comparisons and conversions from float are typed by their operand, while
+  // all other operators are typed by their result.
+  StringRef kind;
+  auto type = op->getNumResults() ? op->getResult(0).getType() : Type();
+  if (isa<arith::AddFOp, arith::SubFOp>(op))
+    kind = "fadd";
+  else if (isa<arith::MulFOp>(op))
+    kind = "fmul";
+  else if (isa<arith::DivFOp, arith::RemFOp>(op))
+    kind = "fdiv";
+  else if (isa<arith::CmpFOp, arith::MaxFOp, arith::MinFOp>(op))
+    kind = "fcmp", type = op->getOperand(0).getType();
+  else if (isa<math::ExpOp, math::Exp2Op>(op))
+    kind = "fexp";
+  else if (isa<math::LogOp, math::Log2Op, math::Log10Op>(op))
+    kind = "flog";
+  else if (isa<math::SqrtOp, math::RsqrtOp>(op))
+    kind = "fsqrt";
+  else if (isa<math::PowFOp>(op))
+    kind = "fpow";
+  else if (isa<math::TanhOp>(op))
+    kind = "ftanh";
+  else if (isa<math::SinOp, math::CosOp>(op))
+    kind = "fsin";
+  else if (isa<arith::SIToFPOp, arith::UIToFPOp>(op))
+    kind = "fcvt";
+  else if (isa<arith::FPToSIOp, arith::FPToUIOp, arith::TruncFOp>(op))
+    kind = "fcvt", type = op->getOperand(0).getType();
+  else if (isa<arith::AddIOp, arith::SubIOp, math::AbsIOp>(op))
+    kind = "add";
+  else if (isa<arith::MulIOp>(op))
+    kind = "mul";
+  else if (isa<arith::DivSIOp, arith::DivUIOp, arith::RemSIOp,
+               arith::RemUIOp>(op))
+    kind = "div";
+  else if (isa<arith::CmpIOp, arith::MaxSIOp, arith::MinSIOp, arith::MaxUIOp,
+               arith::MinUIOp>(op))
+    kind = "cmp", type = op->getOperand(0).getType();
+  else if (isa<arith::AndIOp, arith::OrIOp, arith::XOrIOp>(op))
+    kind = "logic";
+  else if (isa<arith::ShLIOp, arith::ShRSIOp, arith::ShRUIOp>(op))
+    kind = "shift";
+  if (kind.empty())
+    return std::string();
+
+  // Fixed-point operators are lowered to integer operators, thus are profiled
+  // by the integer bit width. Operators wider than 64 bits are profiled as the
+  // 64-bit ones, and index computations are not profiled at all.
+  auto elementType = getElementTypeOrSelf(type);
+  if (auto floatType = elementType.dyn_cast<FloatType>())
+    return getOperatorKey(kind, std::min(floatType.getWidth(), 64u), true);
+  if (auto intType = elementType.dyn_cast<IntegerType>())
+    return getOperatorKey(kind, std::min(intType.getWidth(), 64u), false);
+  return std::string();
+}
+
 //===----------------------------------------------------------------------===//
 // PtrLikeMemRefAccess Struct Definition
 //===----------------------------------------------------------------------===//
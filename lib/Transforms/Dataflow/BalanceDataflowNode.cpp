@@ -60,42 +60,7 @@ struct InsertCopyNode : public OpRewritePattern<NodeOp> {
       // Otherwise, we need to construct a chain of buffers to hold data at each
       // level and construct explicit copies to pass data between different
       // dataflow levels.
-      auto currentBuf = output;
-      auto currentNode = node;
-      for (unsigned i = 2; i <= maxDiff; ++i) {
-        // Create a new buffer.
-        auto loc = rewriter.getUnknownLoc();
-        rewriter.setInsertionPoint(currentNode);
-        auto newBuf =
-            rewriter.create<BufferOp>(loc, output.getType()).getMemref();
-
-        // Construct a new node for data copy.
-        rewriter.setInsertionPointAfter(currentNode);
-        auto newNode = rewriter.create<NodeOp>(loc, ValueRange(currentBuf),
-                                               ValueRange(newBuf));
-        newNode.setLevelAttr(
-            rewriter.getI32IntegerAttr(node.getLevel().value() + 1 - i));
-        auto block = rewriter.createBlock(&newNode.getBody());
-        block->addArguments(TypeRange({currentBuf.getType(), newBuf.getType()}),
-                            {currentBuf.getLoc(), newBuf.getLoc()});
-
-        // Create an explicit copy operation.
-        rewriter.setInsertionPointToStart(block);
-        rewriter.create<memref::CopyOp>(loc, block->getArgument(0),
-                                        block->getArgument(1));
-
-        // Replace all uses at the current level.
-        llvm::SmallDenseSet<Operation *, 4> consumers;
-        while (!worklist.empty() && (worklist.back().first == i))
-          consumers.insert(worklist.pop_back_val().second);
-        output.replaceUsesWithIf(newBuf, [&](OpOperand &use) {
-          return consumers.count(use.getOwner());
-        });
-
-        // Finally, we can update current buffer and current node.
-        currentBuf = newBuf;
-        currentNode = newNode;
-      }
+      insertCopyNodeChain(node, output, worklist, rewriter);
     }
     return success();
   }
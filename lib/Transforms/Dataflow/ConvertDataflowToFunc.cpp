@@ -7,8 +7,10 @@
 #include "mlir/Dialect/Affine/LoopUtils.h"
 #include "mlir/Transforms/DialectConversion.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "scalehls/Transforms/Estimator.h"
 #include "scalehls/Transforms/Passes.h"
 #include "scalehls/Transforms/Utils.h"
+#include "llvm/ADT/MapVector.h"
 
 using namespace mlir;
 using namespace scalehls;
@@ -178,10 +180,21 @@ struct InlineSchedule : public OpRewritePattern<ScheduleOp> {
 };
 } // namespace
 
+/// Check whether the node can be inlined into its parent, which is true if the
+/// node has no hierarchy and only contains a single loop nest. In this way, the
+/// loop nest is still a standalone process after the node is inlined.
+static bool canInlineNode(NodeOp node) {
+  return !cast<hls::StageLikeInterface>(node.getOperation()).hasHierarchy() &&
+         llvm::hasSingleElement(node.getOps<AffineForOp>());
+}
+
 namespace {
 struct ConvertNodeToFunc : public OpRewritePattern<NodeOp> {
-  ConvertNodeToFunc(MLIRContext *context, StringRef prefix, unsigned &nodeIdx)
-      : OpRewritePattern<NodeOp>(context), prefix(prefix), nodeIdx(nodeIdx) {}
+  ConvertNodeToFunc(MLIRContext *context, StringRef prefix, unsigned &nodeIdx,
+                    SmallVectorImpl<func::FuncOp> &nodeFuncs,
+                    llvm::SmallDenseSet<Operation *> *inlineCandidates)
+      : OpRewritePattern<NodeOp>(context), prefix(prefix), nodeIdx(nodeIdx),
+        nodeFuncs(nodeFuncs), inlineCandidates(inlineCandidates) {}
 
   LogicalResult matchAndRewrite(NodeOp node,
                                 PatternRewriter &rewriter) const override {
@@ -191,10 +204,15 @@ struct ConvertNodeToFunc : public OpRewritePattern<NodeOp> {
         node.getLoc(), prefix.str() + "_node" + std::to_string(nodeIdx++),
         rewriter.getFunctionType(node.getOperandTypes(), TypeRange()));
 
-    // FIXME: A better method to judge whether to inline the node.
-    if (!cast<hls::StageLikeInterface>(node.getOperation()).hasHierarchy() &&
-        llvm::hasSingleElement(node.getOps<AffineForOp>()))
-      subFunc->setAttr("inline", rewriter.getUnitAttr());
+    // If the inline candidates are collected, the decision is deferred to the
+    // estimator. Otherwise, all nodes that can be inlined are inlined.
+    nodeFuncs.push_back(subFunc);
+    if (canInlineNode(node)) {
+      if (inlineCandidates)
+        inlineCandidates->insert(subFunc);
+      else
+        subFunc->setAttr("inline", rewriter.getUnitAttr());
+    }
 
     // Inline the contents of the dataflow node.
     rewriter.inlineRegionBefore(node.getBodyRegion(), subFunc.getBody(),
@@ -212,15 +230,50 @@ struct ConvertNodeToFunc : public OpRewritePattern<NodeOp> {
 private:
   StringRef prefix;
   unsigned &nodeIdx;
+  SmallVectorImpl<func::FuncOp> &nodeFuncs;
+  llvm::SmallDenseSet<Operation *> *inlineCandidates;
 };
 } // namespace
 
+/// The number of cycles of the block-level handshake between a dataflow
+/// process function and its caller, which is paid by every invocation.
+static constexpr int64_t kCallOverhead = 3;
+
+/// Decide whether to inline the node function with the estimator. A function
+/// is inlined if the handshake overhead is larger than "maxCallOverhead"
+/// percent of its latency. However, a function that is shared by "numCalls"
+/// calls after deduplication and occupies DSPs is always kept, such that it is
+/// only synthesized once.
+static bool shouldInlineFunc(func::FuncOp func, unsigned numCalls,
+                             ScaleHLSEstimator &estimator,
+                             unsigned maxCallOverhead) {
+  auto loop = *func.getOps<AffineForOp>().begin();
+
+  // Estimate a detached clone to avoid leaving attributes in the IR.
+  auto clonedLoop = cast<AffineForOp>(loop->clone());
+  auto success = estimator.estimateLoop(clonedLoop);
+  auto latency = success ? getTiming(clonedLoop).getLatency() : 0;
+  auto dspNum = success ? getResource(clonedLoop).getDsp() : 0;
+  clonedLoop.erase();
+  if (!success)
+    return true;
+
+  if (numCalls > 1 && dspNum > 0)
+    return false;
+  return kCallOverhead * 100 > latency * maxCallOverhead;
+}
+
 namespace {
 struct ConvertDataflowToFunc
     : public ConvertDataflowToFuncBase<ConvertDataflowToFunc> {
   ConvertDataflowToFunc() = default;
-  explicit ConvertDataflowToFunc(bool argSplitExternalAccess) {
+  ConvertDataflowToFunc(bool argSplitExternalAccess, bool argEstimatorAware,
+                        unsigned argMaxCallOverhead,
+                        std::string argTargetSpec) {
     splitExternalAccess = argSplitExternalAccess;
+    estimatorAware = argEstimatorAware;
+    maxCallOverhead = argMaxCallOverhead;
+    targetSpec = argTargetSpec;
   }
 
   void runOnOperation() override {
@@ -234,6 +287,8 @@ struct ConvertDataflowToFunc
       (void)applyPatternsAndFoldGreedily(module, std::move(patterns));
     }
 
+    SmallVector<func::FuncOp, 32> nodeFuncs;
+    llvm::SmallDenseSet<Operation *> inlineCandidates;
     for (auto func :
          llvm::make_early_inc_range(module.getOps<func::FuncOp>())) {
       ConversionTarget target(*context);
@@ -243,12 +298,57 @@ struct ConvertDataflowToFunc
       unsigned nodeIdx = 0;
       mlir::RewritePatternSet patterns(context);
       patterns.add<InlineSchedule>(context);
-      patterns.add<ConvertNodeToFunc>(context, func.getName(), nodeIdx);
+      patterns.add<ConvertNodeToFunc>(
+          context, func.getName(), nodeIdx, nodeFuncs,
+          estimatorAware ? &inlineCandidates : nullptr);
       (void)applyPatternsAndFoldGreedily(func, std::move(patterns));
       // if (failed(applyPartialConversion(func, target, std::move(patterns))))
       //   return signalPassFailure();
     }
 
+    // Decide whether to inline each candidate with the estimator, where
+    // default values are based on Xilinx PYNQ-Z1 board.
+    if (estimatorAware) {
+      llvm::json::Object config;
+      std::string errorMessage;
+      if (failed(parseTargetSpec(targetSpec, config, errorMessage))) {
+        llvm::errs() << errorMessage << "\n";
+        return signalPassFailure();
+      }
+      auto profile = TargetProfile(&config);
+      auto estimator = ScaleHLSEstimator(profile, true);
+
+      // Each node function is called once. Structurally equivalent candidates
+      // will be merged by the func-dedup pass, thus they are decided together
+      // such that they are still equivalent after the decision.
+      llvm::MapVector<size_t, SmallVector<SmallVector<func::FuncOp, 4>, 1>>
+          hashToClassesMap;
+      for (auto func : nodeFuncs) {
+        if (!inlineCandidates.count(func))
+          continue;
+        auto &classes = hashToClassesMap[getStructuralHash(func, true)];
+        auto it = llvm::find_if(classes, [&](auto &funcClass) {
+          SmallVector<std::pair<Operation *, Operation *>, 16> constantPairs;
+          return isStructurallyEquivalent(funcClass.front(), func,
+                                          &constantPairs);
+        });
+        if (it != classes.end())
+          it->push_back(func);
+        else
+          classes.push_back({func});
+      }
+
+      auto builder = Builder(context);
+      for (auto &p : hashToClassesMap)
+        for (auto &funcClass : p.second)
+          if (shouldInlineFunc(funcClass.front(), funcClass.size(), estimator,
+                               maxCallOverhead))
+            for (auto func : funcClass) {
+              func->setAttr("inline", builder.getUnitAttr());
+              ++numInlinedNodes;
+            }
+    }
+
     // Remove memref global operations.
     for (auto global :
          llvm::make_early_inc_range(module.getOps<memref::GlobalOp>()))
@@ -257,7 +357,9 @@ struct ConvertDataflowToFunc
 };
 } // namespace
 
-std::unique_ptr<Pass>
-scalehls::createConvertDataflowToFuncPass(bool splitExternalAccess) {
-  return std::make_unique<ConvertDataflowToFunc>(splitExternalAccess);
+std::unique_ptr<Pass> scalehls::createConvertDataflowToFuncPass(
+    bool splitExternalAccess, bool estimatorAware, unsigned maxCallOverhead,
+    std::string targetSpec) {
+  return std::make_unique<ConvertDataflowToFunc>(
+      splitExternalAccess, estimatorAware, maxCallOverhead, targetSpec);
 }
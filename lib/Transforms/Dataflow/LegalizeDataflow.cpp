@@ -6,28 +6,199 @@
 
 #include "mlir/IR/Dominance.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
+#include "scalehls/Transforms/Estimator.h"
 #include "scalehls/Transforms/Passes.h"
 #include "scalehls/Transforms/Utils.h"
+#include "llvm/ADT/MapVector.h"
 
 using namespace mlir;
 using namespace scalehls;
 using namespace hls;
 
+namespace {
+/// A cost model to choose among the legal alternatives of merging dataflow
+/// nodes, duplicating shared buffers, and copying bypassed buffers. The II of a
+/// dataflow schedule is approximated with the largest node latency, where a
+/// merged node runs its sub-nodes sequentially.
+class DataflowCostModel {
+public:
+  DataflowCostModel(ScaleHLSEstimator &estimator, unsigned bramBudget,
+                    unsigned usedBram)
+      : estimator(estimator), bramBudget(bramBudget), usedBram(usedBram) {}
+
+  /// Get the estimated latency of the node, which is the overall latency of
+  /// all loops and copies in the node. Return None if the node has hierarchy
+  /// or any loop failed to be estimated.
+  Optional<int64_t> getNodeLatency(NodeOp node) {
+    int64_t latency = 0;
+    for (auto &op : node.getBody().front()) {
+      if (isa<ScheduleOp>(op))
+        return Optional<int64_t>();
+      if (auto copy = dyn_cast<memref::CopyOp>(op)) {
+        latency += getCopyLatency(copy.getTarget());
+        continue;
+      }
+      auto loop = dyn_cast<mlir::AffineForOp>(op);
+      if (!loop)
+        continue;
+
+      // Estimate a detached clone to avoid leaving attributes in the IR.
+      auto clonedLoop = cast<mlir::AffineForOp>(loop->clone());
+      auto success = estimator.estimateLoop(clonedLoop);
+      if (success)
+        latency += getTiming(clonedLoop).getLatency();
+      clonedLoop.erase();
+      if (!success)
+        return Optional<int64_t>();
+    }
+    return latency;
+  }
+
+  /// Get the overall latency of the given nodes as if they are merged.
+  Optional<int64_t> getMergedLatency(ArrayRef<NodeOp> nodes) {
+    int64_t latency = 0;
+    for (auto node : nodes) {
+      auto nodeLatency = getNodeLatency(node);
+      if (!nodeLatency)
+        return Optional<int64_t>();
+      latency += nodeLatency.value();
+    }
+    return latency;
+  }
+
+  /// Get the latency of copying the whole buffer, one element per cycle.
+  int64_t getCopyLatency(Value buffer) {
+    return buffer.getType().cast<MemRefType>().getNumElements();
+  }
+
+  /// Try to reserve the given number of BRAMs from the budget, where a zero
+  /// budget means unlimited.
+  bool reserveBram(unsigned numBram) {
+    if (bramBudget && usedBram + numBram > bramBudget)
+      return false;
+    usedBram += numBram;
+    return true;
+  }
+
+  unsigned numDuplicatedBuffers = 0;
+  unsigned numCopiedBypassPaths = 0;
+
+private:
+  ScaleHLSEstimator &estimator;
+  unsigned bramBudget;
+  unsigned usedBram;
+};
+} // namespace
+
+/// Return whether the input can be duplicated for each of its consumers, which
+/// is true if the input is an on-chip buffer that is only read in the schedule.
+static bool isDuplicableInput(Value input) {
+  auto defOp = input.getDefiningOp();
+  if (!defOp || !isa<BufferOp, ConstBufferOp>(defOp) ||
+      isExternalBuffer(input))
+    return false;
+  return getProducers(input).empty();
+}
+
+/// Collect the nodes that are connected to the given node through shared
+/// inputs. If "ignoreDuplicable" is set, duplicable inputs are not considered
+/// as shared.
 static void collectNodes(llvm::SmallDenseSet<NodeOp> const &allNodes,
                          llvm::SmallDenseSet<NodeOp> &visitedNodes,
-                         SmallVector<NodeOp> &nodesToMerge, NodeOp node) {
+                         SmallVector<NodeOp> &nodesToMerge, NodeOp node,
+                         bool ignoreDuplicable = false) {
   if (!visitedNodes.insert(node).second)
     return;
   nodesToMerge.push_back(node);
-  for (auto input : node.getInputs())
+  for (auto input : node.getInputs()) {
+    if (ignoreDuplicable && isDuplicableInput(input))
+      continue;
     for (auto consumer : getConsumersExcept(input, node))
       if (allNodes.count(consumer))
-        collectNodes(allNodes, visitedNodes, nodesToMerge, consumer);
+        collectNodes(allNodes, visitedNodes, nodesToMerge, consumer,
+                     ignoreDuplicable);
+  }
+}
+
+/// Try to duplicate the duplicable inputs shared by the given nodes instead of
+/// merging all of them, which is applied only if the estimated II is reduced
+/// and the BRAM budget allows. The nodes that still need to be merged are
+/// returned in "groups".
+static bool tryDuplicateInputs(ArrayRef<NodeOp> nodes,
+                               SmallVectorImpl<SmallVector<NodeOp>> &groups,
+                               DataflowCostModel &model,
+                               PatternRewriter &rewriter) {
+  // Group the nodes that are still connected by non-duplicable inputs.
+  auto allNodes = llvm::SmallDenseSet<NodeOp>(nodes.begin(), nodes.end());
+  llvm::SmallDenseSet<NodeOp> visitedNodes;
+  SmallVector<SmallVector<NodeOp>> newGroups;
+  for (auto node : nodes) {
+    if (visitedNodes.count(node))
+      continue;
+    SmallVector<NodeOp> group;
+    collectNodes(allNodes, visitedNodes, group, node,
+                 /*ignoreDuplicable=*/true);
+    newGroups.push_back(group);
+  }
+  if (newGroups.size() == 1)
+    return false;
+
+  // Compare the II of merging all nodes and the II after the duplication.
+  auto mergedLatency = model.getMergedLatency(nodes);
+  if (!mergedLatency)
+    return false;
+  int64_t latency = 0;
+  for (auto &group : newGroups) {
+    auto groupLatency = model.getMergedLatency(group);
+    if (!groupLatency)
+      return false;
+    latency = std::max(latency, groupLatency.value());
+  }
+  if (latency >= mergedLatency.value())
+    return false;
+
+  // Collect the consumers of each duplicable input and the BRAM cost.
+  llvm::SmallMapVector<Value, SmallVector<NodeOp, 4>, 4> inputConsumersMap;
+  for (auto node : nodes)
+    for (auto input : node.getInputs())
+      if (isDuplicableInput(input)) {
+        auto &consumers = inputConsumersMap[input];
+        if (llvm::find(consumers, node) == consumers.end())
+          consumers.push_back(node);
+      }
+
+  unsigned numBram = 0;
+  for (auto &p : inputConsumersMap)
+    numBram += getNumBram(p.first.getType()) * getBufferDepth(p.first) *
+               (p.second.size() - 1);
+  if (!model.reserveBram(numBram))
+    return false;
+
+  // Create a copy of the buffer for each consumer except the first one.
+  for (auto &p : inputConsumersMap) {
+    auto input = p.first;
+    for (auto consumer : llvm::drop_begin(p.second)) {
+      rewriter.setInsertionPointAfter(input.getDefiningOp());
+      auto newBuffer = rewriter.clone(*input.getDefiningOp())->getResult(0);
+      rewriter.updateRootInPlace(consumer, [&]() {
+        input.replaceUsesWithIf(newBuffer, [&](OpOperand &use) {
+          return use.getOwner() == consumer;
+        });
+      });
+      ++model.numDuplicatedBuffers;
+    }
+  }
+
+  for (auto &group : newGroups)
+    if (group.size() > 1)
+      groups.push_back(group);
+  return true;
 }
 
 namespace {
 struct FuseMultiConsumer : public OpRewritePattern<ScheduleOp> {
-  using OpRewritePattern<ScheduleOp>::OpRewritePattern;
+  FuseMultiConsumer(MLIRContext *context, DataflowCostModel *model)
+      : OpRewritePattern<ScheduleOp>(context), model(model) {}
 
   LogicalResult matchAndRewrite(ScheduleOp schedule,
                                 PatternRewriter &rewriter) const override {
@@ -54,8 +225,17 @@ struct FuseMultiConsumer : public OpRewritePattern<ScheduleOp> {
           continue;
         SmallVector<NodeOp> nodesToMerge;
         collectNodes(p.second, visitedNodes, nodesToMerge, node);
-        if (nodesToMerge.size() > 1)
-          worklist.push_back(nodesToMerge);
+        if (nodesToMerge.size() < 2)
+          continue;
+
+        // If the cost model is available, shared buffers may be duplicated to
+        // avoid merging nodes and destroying the dataflow overlap.
+        if (model && tryDuplicateInputs(nodesToMerge, worklist, *model,
+                                        rewriter)) {
+          hasChanged = true;
+          continue;
+        }
+        worklist.push_back(nodesToMerge);
       }
 
       for (auto nodesToMerge : worklist) {
@@ -70,6 +250,9 @@ struct FuseMultiConsumer : public OpRewritePattern<ScheduleOp> {
     // schedule.setIsLegalAttr(rewriter.getUnitAttr());
     return success(hasChanged);
   }
+
+private:
+  DataflowCostModel *model;
 };
 } // namespace
 
@@ -118,9 +301,65 @@ static void collectBypassNodes(
   }
 }
 
+/// Try to copy the on-chip outputs of the nodes at the target level through a
+/// chain of copy nodes instead of merging the bypassed levels, which is applied
+/// only if the estimated II is reduced and the BRAM budget allows.
+static bool tryCopyBypassPaths(
+    llvm::SmallDenseMap<unsigned, llvm::SmallDenseSet<NodeOp>> const &map,
+    unsigned targetLevel, DataflowCostModel &model,
+    PatternRewriter &rewriter) {
+  bool hasChanged = false;
+  for (auto node : map.lookup(targetLevel)) {
+    for (auto output : node.getOutputs()) {
+      if (output.isa<BlockArgument>() || isExternalBuffer(output))
+        continue;
+
+      SmallVector<std::pair<unsigned, NodeOp>, 4> bypassNodes;
+      for (auto consumer : getDependentConsumers(output, node)) {
+        auto diff = node.getLevel().value() - consumer.getLevel().value();
+        if (diff > 1)
+          bypassNodes.push_back({diff, consumer});
+      }
+      if (bypassNodes.empty())
+        continue;
+
+      // Sort all consumers in a descending order of level difference.
+      llvm::sort(bypassNodes, [](auto a, auto b) { return a.first > b.first; });
+      auto maxDiff = bypassNodes.front().first;
+
+      // Compare the II of merging the bypassed levels and the II after the
+      // copy nodes are inserted.
+      SmallVector<NodeOp> bypassedNodes;
+      for (unsigned diff = 1; diff <= maxDiff; ++diff)
+        for (auto bypassedNode : map.lookup(targetLevel - diff))
+          bypassedNodes.push_back(bypassedNode);
+      auto mergedLatency = model.getMergedLatency(bypassedNodes);
+      if (!mergedLatency)
+        continue;
+      auto latency = model.getCopyLatency(output);
+      for (auto bypassedNode : bypassedNodes)
+        latency = std::max(latency,
+                           model.getNodeLatency(bypassedNode).value_or(0));
+      if (latency >= mergedLatency.value())
+        continue;
+
+      auto numBram =
+          getNumBram(output.getType()) * getBufferDepth(output) * (maxDiff - 1);
+      if (!model.reserveBram(numBram))
+        continue;
+
+      insertCopyNodeChain(node, output, bypassNodes, rewriter);
+      ++model.numCopiedBypassPaths;
+      hasChanged = true;
+    }
+  }
+  return hasChanged;
+}
+
 namespace {
 struct FuseBypassPath : public OpRewritePattern<ScheduleOp> {
-  using OpRewritePattern<ScheduleOp>::OpRewritePattern;
+  FuseBypassPath(MLIRContext *context, DataflowCostModel *model)
+      : OpRewritePattern<ScheduleOp>(context), model(model) {}
 
   LogicalResult matchAndRewrite(ScheduleOp schedule,
                                 PatternRewriter &rewriter) const override {
@@ -135,6 +374,18 @@ struct FuseBypassPath : public OpRewritePattern<ScheduleOp> {
         return failure();
     }
 
+    // If the cost model is available, try to insert copy nodes before merging
+    // the bypass paths. As the copy nodes change the dataflow levels, the
+    // pattern will be applied again to merge the remaining bypass paths.
+    if (model) {
+      bool hasCopied = false;
+      for (auto level = maxLevel; level > 0; --level)
+        hasCopied |=
+            tryCopyBypassPaths(levelToNodesMap, level, *model, rewriter);
+      if (hasCopied)
+        return success();
+    }
+
     // Traverse all dataflow node levels.
     llvm::SmallDenseSet<unsigned> mergedLevels;
     SmallVector<SmallVector<NodeOp>> worklist;
@@ -162,6 +413,9 @@ struct FuseBypassPath : public OpRewritePattern<ScheduleOp> {
     }
     return success(hasChanged);
   }
+
+private:
+  DataflowCostModel *model;
 };
 } // namespace
 
@@ -200,14 +454,48 @@ struct AllocateInternalBuffer : public OpRewritePattern<BufferOp> {
 
 namespace {
 struct LegalizeDataflow : public LegalizeDataflowBase<LegalizeDataflow> {
+  LegalizeDataflow() = default;
+  LegalizeDataflow(bool argCostAware, unsigned argBramBudget,
+                   std::string argTargetSpec) {
+    costAware = argCostAware;
+    bramBudget = argBramBudget;
+    targetSpec = argTargetSpec;
+  }
+
   void runOnOperation() override {
     auto func = getOperation();
     auto context = func.getContext();
 
+    // Initialize the cost model if the cost-aware legalization is enabled,
+    // where default values are based on Xilinx PYNQ-Z1 board.
+    llvm::json::Object config;
+    Optional<TargetProfile> profile;
+    Optional<ScaleHLSEstimator> estimator;
+    Optional<DataflowCostModel> model;
+    if (costAware) {
+      std::string errorMessage;
+      if (failed(parseTargetSpec(targetSpec, config, errorMessage))) {
+        llvm::errs() << errorMessage << "\n";
+        return signalPassFailure();
+      }
+      profile.emplace(&config);
+      estimator.emplace(*profile, true);
+
+      // Count the BRAMs that are already occupied by on-chip buffers.
+      unsigned usedBram = 0;
+      func.walk([&](hls::BufferLikeInterface buffer) {
+        if (!isExternalBuffer(buffer.getMemref()))
+          usedBram +=
+              getNumBram(buffer.getMemrefType()) * buffer.getBufferDepth();
+      });
+      model.emplace(*estimator, bramBudget, usedBram);
+    }
+    auto modelPtr = model ? &*model : nullptr;
+
     // Fuse multi consumer and bypass path dataflow nodes.
     mlir::RewritePatternSet patterns(context);
-    patterns.add<FuseMultiConsumer>(context);
-    patterns.add<FuseBypassPath>(context);
+    patterns.add<FuseMultiConsumer>(context, modelPtr);
+    patterns.add<FuseBypassPath>(context, modelPtr);
     auto frozenPatterns = FrozenRewritePatternSet(std::move(patterns));
 
     func.walk([&](ScheduleOp schedule) {
@@ -217,6 +505,10 @@ struct LegalizeDataflow : public LegalizeDataflowBase<LegalizeDataflow> {
                        [](NodeOp node) { return node.getLevel(); }))
         schedule.setIsLegalAttr(UnitAttr::get(context));
     });
+    if (model) {
+      numDuplicatedBuffers += model->numDuplicatedBuffers;
+      numCopiedBypassPaths += model->numCopiedBypassPaths;
+    }
 
     // // Reallocate internal buffers.
     // patterns.clear();
@@ -226,6 +518,7 @@ struct LegalizeDataflow : public LegalizeDataflowBase<LegalizeDataflow> {
 };
 } // namespace
 
-std::unique_ptr<Pass> scalehls::createLegalizeDataflowPass() {
-  return std::make_unique<LegalizeDataflow>();
+std::unique_ptr<Pass> scalehls::createLegalizeDataflowPass(
+    bool costAware, unsigned bramBudget, std::string targetSpec) {
+  return std::make_unique<LegalizeDataflow>(costAware, bramBudget, targetSpec);
 }
@@ -8,6 +8,7 @@
 #include "mlir/Dialect/Affine/LoopUtils.h"
 #include "mlir/Dialect/Affine/Utils.h"
 #include "scalehls/Dialect/HLS/Analysis.h"
+#include "scalehls/Transforms/Estimator.h"
 #include "scalehls/Transforms/Passes.h"
 #include "scalehls/Transforms/Utils.h"
 #include "llvm/Support/Debug.h"
@@ -44,17 +45,36 @@ struct ParallelizeDataflowNode
     : public ParallelizeDataflowNodeBase<ParallelizeDataflowNode> {
   ParallelizeDataflowNode() = default;
   ParallelizeDataflowNode(unsigned loopUnrollFactor, bool unrollPointLoopOnly,
-                          bool argComplexityAware, bool argCorrelationAware) {
+                          bool argComplexityAware, bool argCorrelationAware,
+                          bool argOpAware, std::string argTargetSpec) {
     maxUnrollFactor = loopUnrollFactor;
     pointLoopOnly = unrollPointLoopOnly;
     complexityAware = argComplexityAware;
     correlationAware = argCorrelationAware;
+    opAware = argOpAware;
+    targetSpec = argTargetSpec;
+  }
+
+  /// Collect the profiled latency and DSP usage of operators from the target
+  /// spec, where default values are based on Xilinx PYNQ-Z1 board.
+  LogicalResult initOperatorMaps() {
+    llvm::json::Object config;
+    std::string errorMessage;
+    if (failed(parseTargetSpec(targetSpec, config, errorMessage))) {
+      llvm::errs() << errorMessage << "\n";
+      return failure();
+    }
+    profile.emplace(&config);
+    return success();
   }
 
   /// Try to calculate the unroll factors of the nodes contained in each
   /// dataflow schedule.
   void getNodeParallelFactorMap(func::FuncOp func) {
-    auto compAnal = ComplexityAnalysis(func);
+    auto compAnal =
+        opAware ? ComplexityAnalysis(func, &profile->latencyMap,
+                                     &profile->dspUsageMap)
+                : ComplexityAnalysis(func);
     nodeParallelFactorMap.clear();
 
     func.walk<WalkOrder::PreOrder>([&](ScheduleOp schedule) {
@@ -125,6 +145,7 @@ struct ParallelizeDataflowNode
       }
     });
 
+    bool hasUnrolled = false;
     for (auto &band : bands) {
       // For loop band that has effect on external buffers, we should directly
       // unroll them without considering whether it's point loop.
@@ -141,8 +162,10 @@ struct ParallelizeDataflowNode
       auto factors = FactorList(band.size(), 1);
       if (failed(getEvenlyDistributedFactors(unrollFactor, factors, band)))
         factors = getDistributedFactors(unrollFactor, band);
-      applyLoopUnrollJam(band, factors);
+      hasUnrolled |= applyLoopUnrollJam(band, factors);
     }
+    if (hasUnrolled)
+      ++numUnrolledNodes;
   }
 
   /// Unroll loops based on the correlations between dataflow nodes.
@@ -159,6 +182,7 @@ struct ParallelizeDataflowNode
 
     // Optimize the unroll factors from the most critical node.
     llvm::SmallDenseMap<NodeOp, FactorList> nodeUnrollFactorsMap;
+    DenseMap<CorrelationAnalysis::NodeLoop, unsigned> loopClassFactorMap;
     for (auto nodeAndNum : nodeAndNums) {
       auto node = nodeAndNum.first;
       auto corrList = corrAnal.getCorrelations(node);
@@ -176,12 +200,15 @@ struct ParallelizeDataflowNode
       auto band = getNodeLoopBand(node);
       auto factors = FactorList(band.size(), 1);
 
-      // If the unroll factors already exist, which means the node is correlated
-      // with a visited node, we overwrite the initialized unroll factors with
-      // the existing one.
-      if (nodeUnrollFactorsMap.count(node)) {
-        assert(factors.size() == band.size() && "incorrect factor number");
-        factors = nodeUnrollFactorsMap.lookup(node);
+      // If a loop is transitively correlated with a loop of a visited node, we
+      // overwrite the initialized unroll factor with the factor of its class,
+      // such that the factors are aligned along the whole correlation chain.
+      for (auto i : llvm::enumerate(band)) {
+        auto leader = corrAnal.getLoopClassLeader(node, i.index());
+        auto factor = loopClassFactorMap.lookup(leader);
+        auto tripCount = getConstantTripCount(i.value());
+        if (factor > 1 && tripCount && tripCount.value() % factor == 0)
+          factors[i.index()] = factor;
       }
 
       if (failed(getEvenlyDistributedFactors(parallelFactor, factors, band)))
@@ -200,36 +227,24 @@ struct ParallelizeDataflowNode
       );
       nodeUnrollFactorsMap[node] = factors;
 
-      for (auto corr : corrList) {
-        auto corrNode = corr.getCorrelatedNode(node);
-        if (nodeUnrollFactorsMap.count(corrNode))
-          continue;
-        auto corrFactors = corr.permuteFactors(node, factors);
-
-        LLVM_DEBUG(
-            // clang-format off
-            llvm::dbgs() << "----------\n";
-            llvm::dbgs() << "Correlate Map: { ";
-            for (auto factor : corr.getCorrelateMap(node))
-              llvm::dbgs() << factor << " ";
-            llvm::dbgs() << "}\n";
-            llvm::dbgs() << "Correlated Factors: { ";
-            for (auto factor : corrFactors)
-              llvm::dbgs() << factor << " ";
-            llvm::dbgs() << "}\n";
-            llvm::dbgs() << "Correlated Node at " << corrNode.getLoc() << ": \n"
-                         << corrNode << "\n";
-            // clang-format on
-        );
-        nodeUnrollFactorsMap[corrNode] = corrFactors;
-      }
+      // Record the factor of each loop class. The factors of more critical
+      // nodes are always respected in case of conflicts. A loop that is not
+      // unrolled doesn't constrain its class, which is aligned with the first
+      // node that actually unrolls a loop of the class.
+      for (auto i : llvm::enumerate(factors))
+        if (i.value() > 1)
+          loopClassFactorMap.try_emplace(
+              corrAnal.getLoopClassLeader(node, i.index()), i.value());
     }
 
     // Apply unroll and jam to loops that is successfully calculated for
     // correlation-aware unroll factors.
     for (auto p : nodeUnrollFactorsMap) {
       auto band = getNodeLoopBand(p.first);
-      applyLoopUnrollJam(band, p.second);
+      if (applyLoopUnrollJam(band, p.second)) {
+        ++numUnrolledNodes;
+        ++numCorrelatedNodes;
+      }
     }
 
     // Apply naive unroll to other loops.
@@ -240,6 +255,8 @@ struct ParallelizeDataflowNode
 
   void runOnOperation() override {
     auto func = getOperation();
+    if (opAware && failed(initOperatorMaps()))
+      return signalPassFailure();
     getNodeParallelFactorMap(func);
     if (correlationAware)
       applyCorrelationAwareUnroll(func);
@@ -250,12 +267,14 @@ struct ParallelizeDataflowNode
 
 private:
   llvm::SmallDenseMap<NodeOp, unsigned long> nodeParallelFactorMap;
+  Optional<TargetProfile> profile;
 };
 } // namespace
 
 std::unique_ptr<Pass> scalehls::createParallelizeDataflowNodePass(
     unsigned loopUnrollFactor, bool unrollPointLoopOnly, bool complexityAware,
-    bool correlationAware) {
+    bool correlationAware, bool opAware, std::string targetSpec) {
   return std::make_unique<ParallelizeDataflowNode>(
-      loopUnrollFactor, unrollPointLoopOnly, complexityAware, correlationAware);
+      loopUnrollFactor, unrollPointLoopOnly, complexityAware, correlationAware,
+      opAware, targetSpec);
 }
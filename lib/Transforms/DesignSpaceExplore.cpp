@@ -693,12 +693,43 @@ bool ScaleHLSExplorer::simplifyLoopNests(func::FuncOp func) {
   return emitQoRDebugInfo(func, "\nFinish Stage1.");
 }
 
+/// Dump the scored loop orders of a loop band to a csv output file, where each
+/// loop order is represented by the new location of each loop. The candidates
+/// are sorted from the best to the worst, and the best one is applied.
+static void dumpLoopOrders(ArrayRef<LoopOrderCandidate> candidates,
+                           StringRef csvFilePath) {
+  std::string errorMessage;
+  auto csvFile = mlir::openOutputFile(csvFilePath, &errorMessage);
+  if (!csvFile)
+    return;
+  auto &os = csvFile->os();
+
+  // Print header row.
+  for (unsigned i = 0, e = candidates.front().first.size(); i < e; ++i)
+    os << "l" << i << ",";
+  os << "ii,dependence_ii,port_ii,non_burst,reuse,type\n";
+
+  // Print all scored loop orders.
+  for (auto &candidate : candidates) {
+    auto &cost = candidate.second;
+    for (auto location : candidate.first)
+      os << location << ",";
+    os << cost.getII() << "," << cost.dependenceII << "," << cost.portII << ","
+       << cost.numNonBurstAccesses << "," << cost.reuseDistance << ","
+       << (&candidate == &candidates.front() ? "best" : "non-best") << "\n";
+  }
+
+  csvFile->keep();
+  LLVM_DEBUG(llvm::dbgs() << "Loop orders are dumped to file \""
+                          << csvFilePath << "\".\n");
+}
+
 /// DSE Stage2: Optimize leaf loop nests. Different optimization conbinations
 /// will be applied to each leaf LNs, and the best one which meets the resource
 /// constraints will be picked as the final solution.
 /// TODO: better handle variable bound kernels.
-bool ScaleHLSExplorer::optimizeLoopBands(func::FuncOp func,
-                                         bool directiveOnly) {
+bool ScaleHLSExplorer::optimizeLoopBands(func::FuncOp func, bool directiveOnly,
+                                         StringRef csvRootPath) {
   LLVM_DEBUG(llvm::dbgs() << "----------\nStage2: Apply loop perfection, loop "
                              "order opt, and remove variable loop bound...\n";);
 
@@ -714,8 +745,27 @@ bool ScaleHLSExplorer::optimizeLoopBands(func::FuncOp func,
     applyAffineLoopPerfection(band);
 
     // If only explore directive optimizations, disable loop oreder opt.
-    if (!directiveOnly)
-      applyAffineLoopOrderOpt(band);
+    // Otherwise, the loop orders are scored by the cost model and dumped to
+    // csv file for each loop band, and the best one is applied.
+    if (!directiveOnly) {
+      SmallVector<LoopOrderCandidate, 16> candidates;
+      if (getLoopOrderCandidates(band, candidates) && !candidates.empty()) {
+        numScoredLoopOrders += candidates.size();
+        LLVM_DEBUG(for (auto &candidate : candidates) {
+          auto &cost = candidate.second;
+          llvm::dbgs() << "\n  (";
+          llvm::interleaveComma(candidate.first, llvm::dbgs());
+          llvm::dbgs() << ") II=" << cost.getII()
+                       << " NonBurst=" << cost.numNonBurstAccesses
+                       << " Reuse=" << cost.reuseDistance;
+        });
+
+        auto orderCsvFilePath = csvRootPath.str() + func.getName().str() +
+                                "_loop_" + std::to_string(i) + "_orders.csv";
+        dumpLoopOrders(candidates, orderCsvFilePath);
+        applyAffineLoopOrderOpt(band, candidates.front().first);
+      }
+    }
 
     applyRemoveVariableBound(band);
   }
@@ -748,6 +798,7 @@ bool ScaleHLSExplorer::exploreDesignSpace(func::FuncOp func, bool directiveOnly,
     LLVM_DEBUG(llvm::dbgs() << "Loop band " << i << ": ";);
     space.exploreLoopDesignSpace(maxIterNum, maxDistance);
     loopSpaces.push_back(space);
+    numEvaluatedPoints += space.allPoints.size();
 
     // Dump design points to csv file for each loop band.
     auto loopCsvFilePath = csvRootPath.str() + func.getName().str() + "_loop_" +
@@ -759,6 +810,7 @@ bool ScaleHLSExplorer::exploreDesignSpace(func::FuncOp func, bool directiveOnly,
   tmpFunc = func.clone();
   auto funcSpace = FuncDesignSpace(tmpFunc, loopSpaces, estimator, maxDspNum);
   funcSpace.combLoopDesignSpaces();
+  numParetoPoints += funcSpace.paretoPoints.size();
 
   // Dump design points to csv file for each function.
   auto funcCsvFilePath =
@@ -815,7 +867,7 @@ void ScaleHLSExplorer::applyDesignSpaceExplore(func::FuncOp func,
 
   // Optimize loop bands by loop perfection, loop order permutation, and loop
   // rectangularization.
-  if (!optimizeLoopBands(func, directiveOnly))
+  if (!optimizeLoopBands(func, directiveOnly, csvRootPath))
     return;
 
   // Explore the design space through a multiple level approach.
@@ -832,25 +884,13 @@ struct DesignSpaceExplore : public DesignSpaceExploreBase<DesignSpaceExplore> {
     auto module = getOperation();
 
     // Read target specification JSON file.
+    llvm::json::Object config;
     std::string errorMessage;
-    auto configFile = mlir::openInputFile(targetSpec, &errorMessage);
-    if (!configFile) {
+    if (failed(parseTargetSpec(targetSpec, config, errorMessage))) {
       llvm::errs() << errorMessage << "\n";
       return signalPassFailure();
     }
-
-    // Parse JSON file into memory.
-    auto config = llvm::json::parse(configFile->getBuffer());
-    if (!config) {
-      llvm::errs() << "failed to parse the target spec json file\n";
-      return signalPassFailure();
-    }
-    auto configObj = config.get().getAsObject();
-    if (!configObj) {
-      llvm::errs() << "support an object in the target spec json file, found "
-                      "something else\n";
-      return signalPassFailure();
-    }
+    auto configObj = &config;
 
     // Collect DSE configurations.
     unsigned outputNum = configObj->getInteger("output_num").value_or(30);
@@ -874,30 +914,63 @@ struct DesignSpaceExplore : public DesignSpaceExploreBase<DesignSpaceExplore> {
     bool resourceConstr =
         configObj->getBoolean("resource_constr").value_or(true);
 
-    // Collect profiling latency and DSP usage data, where default values are
-    // based on Xilinx PYNQ-Z1 board.
-    llvm::StringMap<int64_t> latencyMap;
-    getLatencyMap(configObj, latencyMap);
-    llvm::StringMap<int64_t> dspUsageMap;
-    getDspUsageMap(configObj, dspUsageMap);
-
-    unsigned maxDspNum = ceil(configObj->getInteger("dsp").value_or(220) * 1.1);
+    // Collect the operator profiles, where default values are based on Xilinx
+    // PYNQ-Z1 board.
+    auto profile = TargetProfile(configObj);
+    auto deviceProfile = getDeviceProfile(configObj);
+    unsigned maxDspNum =
+        ceil(deviceProfile->getInteger("dsp").value_or(220) * 1.1);
     if (!resourceConstr)
       maxDspNum = UINT_MAX;
 
-    // Initialize an performance and resource estimator.
-    auto estimator = ScaleHLSEstimator(latencyMap, dspUsageMap, true);
-    auto explorer = ScaleHLSExplorer(estimator, outputNum, maxDspNum,
-                                     maxInitParallel, maxExplParallel,
-                                     maxLoopParallel, maxIterNum, maxDistance);
+    // Initialize an performance and resource estimator. Sub-functions are
+    // always explored and estimated before their callers, such that the
+    // estimation results of sub-functions can be reused by the callers.
+    auto symbolTable = SymbolTable(module);
+    auto estimator = ScaleHLSEstimator(profile, true);
+    estimator.setEstimatedSubFuncs(&symbolTable);
 
-    // Optimize the top function.
-    // TODO: Support to contain sub-functions.
-    for (auto func : module.getOps<func::FuncOp>()) {
+    // Collect the top functions and all their sub-functions.
+    SmallVector<func::FuncOp, 4> topFuncs;
+    for (auto func : module.getOps<func::FuncOp>())
       if (hasTopFuncAttr(func))
+        topFuncs.push_back(func);
+    SmallVector<SmallVector<func::FuncOp, 4>, 4> levels;
+    getFuncLevels(topFuncs, symbolTable, levels);
+
+    // The DSP budget is evenly distributed to all calls of sub-functions, while
+    // the top functions are explored with the whole budget. As the resource of
+    // a function includes its sub-functions, the top functions can still use
+    // the budget left by the sub-functions.
+    unsigned numCalls = 0;
+    for (auto &level : levels)
+      for (auto func : level)
+        func.walk([&](func::CallOp) { ++numCalls; });
+    auto subFuncDspNum = numCalls ? std::max(maxDspNum / numCalls, 1u) : 0u;
+
+    // Explore the functions from the leaf ones to the top ones.
+    for (auto &level : levels)
+      for (auto func : level) {
+        auto isTopFunc = hasTopFuncAttr(func);
+        auto explorer = ScaleHLSExplorer(
+            estimator, outputNum, isTopFunc ? maxDspNum : subFuncDspNum,
+            maxInitParallel, maxExplParallel, maxLoopParallel, maxIterNum,
+            maxDistance);
         explorer.applyDesignSpaceExplore(func, directiveOnly, outputPath,
                                          csvPath);
-    }
+        estimator.estimateFunc(func);
+
+        numEvaluatedPoints += explorer.numEvaluatedPoints;
+        numParetoPoints += explorer.numParetoPoints;
+        numScoredLoopOrders += explorer.numScoredLoopOrders;
+      }
+
+    // The array partition of callers may update the signatures of explored
+    // sub-functions, therefore we re-estimate all functions bottom-up.
+    for (auto &level : levels)
+      for (auto func : level)
+        estimator.estimateFunc(func);
+    numDependenceQueries += estimator.getNumDependenceQueries();
   }
 };
 } // namespace
@@ -4,6 +4,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/IR/Threading.h"
 #include "scalehls/Transforms/Passes.h"
 #include "scalehls/Transforms/Utils.h"
 
@@ -11,33 +12,40 @@ using namespace mlir;
 using namespace scalehls;
 using namespace hls;
 
+/// Align the signature of the sub-function with the operand and result types
+/// of the call. Return whether the signature is changed.
+static bool updateSubFuncSignature(func::CallOp op, func::FuncOp subFunc,
+                                   Builder builder) {
+  // Set sub-function type.
+  auto subResultTypes = op.getResultTypes();
+  auto subInputTypes = op.getOperandTypes();
+  auto newType = builder.getFunctionType(subInputTypes, subResultTypes);
+  if (subFunc.getFunctionType() == newType)
+    return false;
+  subFunc.setType(newType);
+
+  // Set arguments type.
+  unsigned index = 0;
+  for (auto inputType : op.getOperandTypes())
+    subFunc.getArgument(index++).setType(inputType);
+
+  // Set results type.
+  auto returnOp = cast<func::ReturnOp>(subFunc.front().getTerminator());
+  index = 0;
+  for (auto resultType : op.getResultTypes())
+    returnOp.getOperand(index++).setType(resultType);
+  return true;
+}
+
 static void updateSubFuncs(func::FuncOp func, Builder builder) {
   func.walk([&](func::CallOp op) {
-    auto callee = SymbolTable::lookupNearestSymbolFrom(op, op.getCalleeAttr());
-    auto subFunc = dyn_cast<func::FuncOp>(callee);
-
-    // Set sub-function type.
-    auto subResultTypes = op.getResultTypes();
-    auto subInputTypes = op.getOperandTypes();
-    auto newType = builder.getFunctionType(subInputTypes, subResultTypes);
-
-    if (subFunc.getFunctionType() != newType) {
-      subFunc.setType(newType);
+    auto subFunc = SymbolTable::lookupNearestSymbolFrom<func::FuncOp>(
+        op, op.getCalleeAttr());
 
-      // Set arguments type.
-      unsigned index = 0;
-      for (auto inputType : op.getOperandTypes())
-        subFunc.getArgument(index++).setType(inputType);
-
-      // Set results type.
-      auto returnOp = cast<func::ReturnOp>(subFunc.front().getTerminator());
-      index = 0;
-      for (auto resultType : op.getResultTypes())
-        returnOp.getOperand(index++).setType(resultType);
-
-      // Recursively apply array partition strategy.
+    // Recursively apply array partition strategy.
+    if (subFunc && !subFunc.isExternal() &&
+        updateSubFuncSignature(op, subFunc, builder))
       updateSubFuncs(subFunc, builder);
-    }
   });
 }
 
@@ -193,9 +201,21 @@ getDimAccessMaps(Operation *op, AffineValueMap valueMap, int64_t dim) {
   return maps;
 }
 
+/// Return the function called by the call operation. If "symbolTable" is
+/// provided, the callee is resolved through it instead of walking the symbol
+/// tables of the parent operations, which is safe to be done in parallel.
+static func::FuncOp getSubFunc(func::CallOp op, SymbolTable *symbolTable) {
+  if (symbolTable)
+    return symbolTable->lookup<func::FuncOp>(op.getCallee());
+  return SymbolTable::lookupNearestSymbolFrom<func::FuncOp>(
+      op, op.getCalleeAttr());
+}
+
 /// Find the suitable array partition factors and kinds for all arrays in the
-/// targeted function.
-bool scalehls::applyAutoArrayPartition(func::FuncOp func) {
+/// targeted function, where all sub-functions must have been partitioned. Only
+/// the function itself is touched, the types of sub-functions are not updated.
+static void applyLocalArrayPartition(func::FuncOp func,
+                                     SymbolTable *symbolTable) {
   // Check whether the input function is pipelined.
   bool funcPipeline = false;
   if (auto attr = getFuncDirective(func))
@@ -344,15 +364,13 @@ bool scalehls::applyAutoArrayPartition(func::FuncOp func) {
     }
   }
 
-  // Apply partition to all sub-functions and traverse all function to update
-  // the "partitionsMap".
+  // Traverse all sub-functions to update the "partitionsMap". Sub-functions
+  // that can't be resolved, e.g. when the function is a temporary clone that
+  // has not been inserted into a module, are skipped.
   func.walk([&](func::CallOp op) {
-    auto callee = SymbolTable::lookupNearestSymbolFrom(op, op.getCalleeAttr());
-    auto subFunc = dyn_cast<func::FuncOp>(callee);
-    assert(subFunc && "callable is not a function operation");
-
-    // Apply array partition to the sub-function.
-    applyAutoArrayPartition(subFunc);
+    auto subFunc = getSubFunc(op, symbolTable);
+    if (!subFunc)
+      return;
 
     auto subFuncType = subFunc.getFunctionType();
     unsigned index = 0;
@@ -413,10 +431,21 @@ bool scalehls::applyAutoArrayPartition(func::FuncOp func) {
   auto resultTypes = func.front().getTerminator()->getOperandTypes();
   auto inputTypes = func.front().getArgumentTypes();
   func.setType(builder.getFunctionType(inputTypes, resultTypes));
+}
 
-  // Update the types of all sub-functions.
-  updateSubFuncs(func, builder);
+/// Find the suitable array partition factors and kinds for all arrays in the
+/// targeted function.
+bool scalehls::applyAutoArrayPartition(func::FuncOp func) {
+  // Apply array partition to all sub-functions first.
+  func.walk([&](func::CallOp op) {
+    auto subFunc = getSubFunc(op, /*symbolTable=*/nullptr);
+    if (subFunc && !subFunc.isExternal())
+      applyAutoArrayPartition(subFunc);
+  });
+  applyLocalArrayPartition(func, /*symbolTable=*/nullptr);
 
+  // Update the types of all sub-functions.
+  updateSubFuncs(func, Builder(func));
   return true;
 }
 
@@ -440,7 +469,39 @@ struct ArrayPartition : public ArrayPartitionBase<ArrayPartition> {
       emitError(module.getLoc(), "fail to find the top function");
       return signalPassFailure();
     }
-    applyAutoArrayPartition(topFunc);
+
+    // Partition the arrays from the leaf functions. Functions in the same
+    // level are independent with each other and partitioned in parallel.
+    auto symbolTable = SymbolTable(module);
+    SmallVector<SmallVector<func::FuncOp, 4>, 4> levels;
+    getFuncLevels(topFunc, symbolTable, levels);
+    for (auto &level : levels)
+      parallelForEach(&getContext(), level, [&](func::FuncOp func) {
+        applyLocalArrayPartition(func, &symbolTable);
+      });
+
+    // Propagate the partitioned types to the sub-functions. This is done
+    // serially from the top function such that the result is deterministic.
+    auto builder = Builder(module);
+    for (auto &level : llvm::reverse(levels))
+      for (auto func : level)
+        func.walk([&](func::CallOp op) {
+          auto subFunc = symbolTable.lookup<func::FuncOp>(op.getCallee());
+          if (subFunc && !subFunc.isExternal())
+            updateSubFuncSignature(op, subFunc, builder);
+        });
+
+    // Count the partitioned arrays owned by the top function. Arrays passed to
+    // sub-functions are not counted again.
+    auto isPartitioned = [](Value value) {
+      auto memrefType = value.getType().dyn_cast<MemRefType>();
+      return memrefType && !memrefType.getLayout().isIdentity();
+    };
+    numPartitionedArrays +=
+        llvm::count_if(topFunc.getArguments(), isPartitioned);
+    topFunc.walk([&](Operation *op) {
+      numPartitionedArrays += llvm::count_if(op->getResults(), isPartitioned);
+    });
   }
 };
 } // namespace
@@ -5,9 +5,11 @@
 //===----------------------------------------------------------------------===//
 
 #include "mlir/Dialect/Affine/Analysis/Utils.h"
+#include "mlir/IR/Threading.h"
 #include "mlir/Support/FileUtilities.h"
 #include "scalehls/Transforms/Estimator.h"
 #include "scalehls/Transforms/Passes.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/Support/MemoryBuffer.h"
 
 using namespace std;
@@ -361,6 +363,7 @@ int64_t ScaleHLSEstimator::getDepMinII(int64_t II, AffineForOp forOp,
           FlatAffineValueConstraints depConstrs;
           SmallVector<DependenceComponent, 2> depComps;
 
+          ++numDependenceQueries;
           DependenceResult result = checkMemrefAccessDependence(
               srcAccess, dstAccess, depth, &depConstrs, &depComps,
               /*allowRAR=*/true);
@@ -411,6 +414,19 @@ int64_t ScaleHLSEstimator::getDepMinII(int64_t II, AffineForOp forOp,
   return II;
 }
 
+/// Return the II of a dataflow region, which is bounded by the slowest stage.
+/// Each sub-function call or loop nest in the block is a stage, where the II of
+/// a sub-function call is the interval of the sub-function, such that nested
+/// dataflow and pipelined sub-functions are correctly handled.
+static int64_t getDataflowInterval(Block &block) {
+  int64_t interval = 1;
+  for (auto &op : block)
+    if (isa<func::CallOp, AffineForOp>(op))
+      if (auto timing = getTiming(&op))
+        interval = max(interval, timing.getInterval());
+  return interval;
+}
+
 bool ScaleHLSEstimator::visitOp(AffineForOp op, int64_t begin) {
   // If a loop is marked as no_touch, then directly infer the schedule_end with
   // the exist latency.
@@ -479,6 +495,18 @@ bool ScaleHLSEstimator::visitOp(AffineForOp op, int64_t begin) {
       return true;
     }
 
+    // If the current loop is annotated as dataflow, the stages of successive
+    // iterations are overlapped and the II is bounded by the slowest stage.
+    else if (loopDirect.getDataflow()) {
+      auto II = getDataflowInterval(loopBlock);
+      auto iterLatency = end - begin;
+      setLoopInfo(op, tripCount, iterLatency, II);
+
+      auto latency = iterLatency + II * (tripCount - 1) + 2;
+      setTiming(op, begin, begin + latency, latency, latency);
+      return true;
+    }
+
     // If the current loop is annotated as flatten, it will be flattened into
     // the child pipelined loop. This will increase the flattened loop trip
     // count without changing the iteration latency.
@@ -514,6 +542,26 @@ bool ScaleHLSEstimator::visitOp(AffineForOp op, int64_t begin) {
 // Other Operation Handlers
 //===----------------------------------------------------------------------===//
 
+/// Estimate the timing of a profiled operator, which is looked up by the kind,
+/// type, and bit width of the operator. The latency of an operator is one cycle
+/// longer than the profiled number, while purely combinational operators with
+/// zero profiled latency are chained with their users and take no cycle.
+void ScaleHLSEstimator::estimateOperatorTiming(Operation *op, int64_t begin) {
+  auto key = getOperatorKey(op);
+  if (key.empty())
+    return setTiming(op, begin, begin, 0, 0);
+
+  auto latency = latencyMap.lookup(key);
+  if (latency)
+    ++latency;
+  setTiming(op, begin, begin + latency, latency, latency ? 1 : 0);
+
+  // The operator occupies its hardware in every cycle it is active.
+  for (int64_t i = 0, e = max(latency, (int64_t)1); i < e; ++i)
+    ++numOperatorMap[begin + i][key];
+  ++totalNumOperatorMap[key];
+}
+
 bool ScaleHLSEstimator::visitOp(AffineIfOp op, int64_t begin) {
   auto end = begin;
   auto thenBlock = op.getThenBlock();
@@ -565,12 +613,21 @@ bool ScaleHLSEstimator::visitOp(scf::IfOp op, int64_t begin) {
 }
 
 bool ScaleHLSEstimator::visitOp(func::CallOp op, int64_t begin) {
-  auto callee = SymbolTable::lookupNearestSymbolFrom(op, op.getCalleeAttr());
-  auto subFunc = dyn_cast<func::FuncOp>(callee);
-  assert(subFunc && "callable is not a function operation");
-
-  ScaleHLSEstimator estimator(latencyMap, dspUsageMap, depAnalysis);
-  estimator.estimateFunc(subFunc);
+  func::FuncOp subFunc;
+  if (subFuncTable) {
+    subFunc = subFuncTable->lookup<func::FuncOp>(op.getCallee());
+    assert(subFunc && "callable is not a function operation");
+  } else {
+    auto callee = SymbolTable::lookupNearestSymbolFrom(op, op.getCalleeAttr());
+    subFunc = dyn_cast<func::FuncOp>(callee);
+    assert(subFunc && "callable is not a function operation");
+
+    ScaleHLSEstimator estimator(latencyMap, dspUsageMap, depAnalysis);
+    estimator.lutUsageMap = lutUsageMap;
+    estimator.setOperatorDelays(delayMap, clockPeriod);
+    estimator.estimateFunc(subFunc);
+    numDependenceQueries += estimator.getNumDependenceQueries();
+  }
 
   // We assume enter and leave the subfunction require extra 2 clock cycles.
   if (auto timing = getTiming(subFunc)) {
@@ -626,6 +683,35 @@ static Operation *getSameLevelDstOp(Operation *srcOp, Operation *dstOp) {
   return nullptr;
 }
 
+/// Chain the operation with its users scheduled in the same cycle, which only
+/// applies to combinational operations that take no cycle. If the summed delay
+/// of the combinational chain exceeds the clock period, a register is inserted
+/// between the operation and its users, which takes one more cycle.
+void ScaleHLSEstimator::chainOperation(Operation *op) {
+  auto timing = getTiming(op);
+  auto begin = timing.getBegin();
+  if (timing.getEnd() != begin)
+    return;
+
+  // Operations without profiled delay, such as casts, are transparent to the
+  // combinational chain.
+  double userDelay = 0;
+  for (auto user : op->getUsers()) {
+    auto sameLevelUser = getSameLevelDstOp(op, user);
+    if (getTiming(sameLevelUser).getEnd() == begin)
+      userDelay = max(userDelay, chainDelayMap.lookup(sameLevelUser));
+  }
+  auto key = getOperatorKey(op);
+  auto delay = key.empty() ? 0.0 : delayMap->lookup(key);
+
+  if (userDelay + delay <= clockPeriod) {
+    chainDelayMap[op] = userDelay + delay;
+    return;
+  }
+  setTiming(op, begin, begin + 1, 1, 1);
+  chainDelayMap[op] = delay;
+}
+
 /// Estimate the latency of a block with ALAP scheduling strategy, return the
 /// estimated timing attribute.
 TimingAttr ScaleHLSEstimator::estimateBlock(Block &block, int64_t begin) {
@@ -715,6 +801,7 @@ TimingAttr ScaleHLSEstimator::estimateBlock(Block &block, int64_t begin) {
               continue;
 
             FlatAffineValueConstraints dependConstrs;
+            ++numDependenceQueries;
             DependenceResult result = checkMemrefAccessDependence(
                 opAccess, depOpAccess, depth, &dependConstrs,
                 /*dependenceComponents=*/nullptr, /*allowRAR=*/true);
@@ -727,10 +814,12 @@ TimingAttr ScaleHLSEstimator::estimateBlock(Block &block, int64_t begin) {
         }
     }
 
-    // Estimate the current operation.
-    if (dispatchVisitor(op, opBegin))
+    // Estimate the current operation and chain it with its users.
+    if (dispatchVisitor(op, opBegin)) {
+      if (delayMap)
+        chainOperation(op);
       opEnd = max(opEnd, getTiming(op).getEnd());
-    else {
+    } else {
       op->emitError("Failed to estimate op");
       return TimingAttr();
     }
@@ -803,6 +892,7 @@ void ScaleHLSEstimator::initEstimator(Block &block) {
   // Clear global maps and scheduling information.
   memPortInfosMap.clear();
   numOperatorMap.clear();
+  chainDelayMap.clear();
 
   block.walk([&](Operation *op) {
     if (!isNoTouch(op)) {
@@ -813,18 +903,65 @@ void ScaleHLSEstimator::initEstimator(Block &block) {
   });
 }
 
+/// Return the number of instances required by the calls to the same
+/// sub-function under the same surrounding operation. Calls that don't overlap
+/// in time share one instance, except those in a dataflow or pipelined region,
+/// where each call is always instantiated separately.
+static int64_t getNumSubFuncInstances(Operation *surroundingOp,
+                                      ArrayRef<func::CallOp> calls) {
+  int64_t numCalls = calls.size();
+  if (!surroundingOp)
+    return numCalls;
+  if (auto func = dyn_cast<func::FuncOp>(surroundingOp)) {
+    if (auto funcDirect = getFuncDirective(func))
+      if (funcDirect.getDataflow() || funcDirect.getPipeline())
+        return numCalls;
+  } else if (auto loopDirect = getLoopDirective(surroundingOp)) {
+    if (loopDirect.getDataflow() || loopDirect.getPipeline())
+      return numCalls;
+  }
+
+  // Find the maximum number of calls that are executed at the same time.
+  SmallVector<std::pair<int64_t, int64_t>, 8> events;
+  for (auto call : calls) {
+    auto timing = getTiming(call);
+    if (!timing)
+      return numCalls;
+    events.push_back({timing.getBegin(), 1});
+    events.push_back({max(timing.getEnd(), timing.getBegin() + 1), -1});
+  }
+  llvm::sort(events);
+
+  int64_t numInstances = 0;
+  int64_t numActiveCalls = 0;
+  for (auto event : events) {
+    numActiveCalls += event.second;
+    numInstances = max(numInstances, numActiveCalls);
+  }
+  return numInstances;
+}
+
 ResourceAttr ScaleHLSEstimator::calculateResource(Operation *funcOrLoop) {
-  // Calculate the static DSP and BRAM utilization.
+  // Calculate the static LUT, DSP, and BRAM utilization.
+  int64_t lutNum = 0;
   int64_t dspNum = 0;
   int64_t bramNum = 0;
+
+  // Calls are grouped by their surrounding operation and callee, such that the
+  // number of instances of each sub-function can be calculated.
+  using CallGroupKey = std::pair<Operation *, Attribute>;
+  llvm::MapVector<CallGroupKey, SmallVector<func::CallOp, 4>> callGroups;
+
   funcOrLoop->walk([&](Operation *op) {
-    if (isa<func::CallOp>(op) || isNoTouch(op)) {
-      // TODO: For now, we consider the resource utilization of sub-fuctions are
-      // static and not shareable. But actually this is not the truth. The
-      // resource can be shared between different sub-functions to some extent,
-      // whose shareing scheme has not been characterized by the estimator.
-      if (auto resource = getResource(op))
+    if (auto call = dyn_cast<func::CallOp>(op)) {
+      callGroups[{getSurroundingOp(call), call.getCalleeAttr()}].push_back(
+          call);
+
+    } else if (isNoTouch(op)) {
+      if (auto resource = getResource(op)) {
+        lutNum += resource.getLut();
         dspNum += resource.getDsp();
+      }
 
     } else if (isa<BufferOp>(op)) {
       auto memrefType = op->getResult(0).getType().cast<MemRefType>();
@@ -844,6 +981,26 @@ ResourceAttr ScaleHLSEstimator::calculateResource(Operation *funcOrLoop) {
     }
   });
 
+  // Different surrounding operations are always scheduled sequentially, thus
+  // the instances of a sub-function can be shared between them. Each instance
+  // owns a copy of the resource of the sub-function.
+  llvm::MapVector<Attribute, std::pair<int64_t, ResourceAttr>> subFuncMap;
+  for (auto &group : callGroups) {
+    auto resource = getResource(group.second.front());
+    if (!resource)
+      continue;
+    auto numInstances =
+        getNumSubFuncInstances(group.first.first, group.second);
+    auto &instances = subFuncMap[group.first.second];
+    instances.first = max(instances.first, numInstances);
+    instances.second = resource;
+  }
+  for (auto &pair : subFuncMap) {
+    lutNum += pair.second.first * pair.second.second.getLut();
+    dspNum += pair.second.first * pair.second.second.getDsp();
+    bramNum += pair.second.first * pair.second.second.getBram();
+  }
+
   auto timing = getTiming(funcOrLoop);
   assert(timing && "timing has not been estimated");
 
@@ -857,13 +1014,49 @@ ResourceAttr ScaleHLSEstimator::calculateResource(Operation *funcOrLoop) {
       num = max(num, nameAndNum.second);
     }
   }
-  for (auto &nameAndNum : operatorNums)
-    dspNum += dspUsageMap[nameAndNum.first()] * nameAndNum.second;
+  for (auto &nameAndNum : operatorNums) {
+    dspNum += dspUsageMap.lookup(nameAndNum.first()) * nameAndNum.second;
+    if (lutUsageMap)
+      lutNum += lutUsageMap->lookup(nameAndNum.first()) * nameAndNum.second;
+  }
 
-  return ResourceAttr::get(funcOrLoop->getContext(), 0, dspNum, bramNum);
+  return ResourceAttr::get(funcOrLoop->getContext(), lutNum, dspNum, bramNum);
+}
+
+/// Estimate all sub-functions transitively called by the function from the
+/// leaf ones, such that each sub-function is only estimated once no matter how
+/// many times it is called.
+void ScaleHLSEstimator::estimateSubFuncs(func::FuncOp func,
+                                         SymbolTable &symbolTable) {
+  SmallVector<SmallVector<func::FuncOp, 4>, 4> levels;
+  getFuncLevels(func, symbolTable, levels);
+  for (auto &level : levels)
+    for (auto subFunc : level) {
+      if (subFunc == func)
+        continue;
+      ScaleHLSEstimator estimator(latencyMap, dspUsageMap, depAnalysis);
+      estimator.lutUsageMap = lutUsageMap;
+      estimator.setOperatorDelays(delayMap, clockPeriod);
+      estimator.setEstimatedSubFuncs(&symbolTable);
+      estimator.estimateFunc(subFunc);
+      numDependenceQueries += estimator.getNumDependenceQueries();
+    }
 }
 
 void ScaleHLSEstimator::estimateFunc(func::FuncOp func) {
+  // If the sub-functions have not been estimated, estimate them bottom-up over
+  // the call graph before estimating the function itself.
+  auto hasCall = [](func::CallOp) { return WalkResult::interrupt(); };
+  if (!subFuncTable && func.walk(hasCall).wasInterrupted())
+    if (auto module = func->getParentOfType<ModuleOp>()) {
+      auto symbolTable = SymbolTable(module);
+      estimateSubFuncs(func, symbolTable);
+      subFuncTable = &symbolTable;
+      estimateFunc(func);
+      subFuncTable = nullptr;
+      return;
+    }
+
   initEstimator(func.front());
   DT = DominanceInfo(func);
 
@@ -882,12 +1075,7 @@ void ScaleHLSEstimator::estimateFunc(func::FuncOp func) {
   // Handle pipelined or dataflowed loops.
   if (auto funcDirect = getFuncDirective(func)) {
     if (funcDirect.getDataflow()) {
-      interval = 1;
-      for (auto callOp : func.getOps<func::CallOp>()) {
-        auto subFuncLatency =
-            getTiming(callOp).getEnd() - getTiming(callOp).getBegin();
-        interval = max(interval, subFuncLatency);
-      }
+      interval = getDataflowInterval(func.front());
 
     } else if (funcDirect.getPipeline()) {
       // TODO: support CallOp inside of the function.
@@ -918,31 +1106,327 @@ void ScaleHLSEstimator::estimateLoop(AffineForOp loop, func::FuncOp func) {
   setResource(loop, calculateResource(loop));
 }
 
+bool ScaleHLSEstimator::estimateLoop(AffineForOp loop) {
+  initEstimator(*loop.getBody());
+  totalNumOperatorMap.clear();
+  DT = DominanceInfo(loop);
+  if (!visitOp(loop, 0))
+    return false;
+  setResource(loop, calculateResource(loop));
+  return true;
+}
+
 //===----------------------------------------------------------------------===//
 // Entry of scalehls-opt
 //===----------------------------------------------------------------------===//
 
+/// Get the profile of the targeted device. If the target spec selects a "part"
+/// from its "devices" library, the profile of the part is returned. Otherwise,
+/// the target spec itself is the profile.
+llvm::json::Object *scalehls::getDeviceProfile(llvm::json::Object *config) {
+  if (auto part = config->getString("part"))
+    if (auto devices = config->getObject("devices"))
+      if (auto profile = devices->getObject(part.value()))
+        return profile;
+  return config;
+}
+
+namespace {
+/// The default characterization of an operator at one bit width, which is used
+/// when the operator is not characterized by the target spec. The numbers are
+/// nominal values at 100MHz, where the delay is in nanoseconds.
+struct OperatorProfile {
+  const char *key;
+  int64_t latency;
+  int64_t dspUsage;
+  double delay;
+};
+} // namespace
+
+static const OperatorProfile defaultOperatorProfiles[] = {
+    // Float operators, where the single precision ones are keyed without type
+    // suffix and their numbers are based on Xilinx PYNQ-Z1 board.
+    {"fadd", 4, 2, 7.25},      {"fadd_f16", 3, 2, 7.25},
+    {"fadd_f64", 5, 3, 7.25},  {"fmul", 3, 3, 5.7},
+    {"fmul_f16", 2, 1, 5.7},   {"fmul_f64", 6, 11, 5.7},
+    {"fdiv", 15, 0, 6.07},     {"fdiv_f16", 8, 0, 6.07},
+    {"fdiv_f64", 30, 0, 6.07}, {"fcmp", 1, 0, 6.4},
+    {"fcmp_f64", 1, 0, 6.4},   {"fexp", 8, 7, 7.68},
+    {"fexp_f64", 17, 26, 7.68}, {"flog", 13, 4, 7.68},
+    {"flog_f64", 20, 27, 7.68}, {"fsqrt", 15, 0, 6.07},
+    {"fsqrt_f64", 30, 0, 6.07}, {"fpow", 30, 26, 7.68},
+    {"fpow_f64", 50, 60, 7.68}, {"ftanh", 20, 10, 7.68},
+    {"ftanh_f64", 35, 30, 7.68}, {"fsin", 25, 16, 7.68},
+    {"fsin_f64", 40, 40, 7.68}, {"fcvt", 4, 0, 6.4},
+    {"fcvt_f64", 5, 0, 6.4},
+
+    // Integer and fixed-point operators, where the delay of combinational
+    // operators grows with the length of the carry chain.
+    {"add_i8", 0, 0, 1.2},     {"add_i64", 0, 0, 2.8},
+    {"cmp_i8", 0, 0, 1.0},     {"cmp_i64", 0, 0, 2.0},
+    {"logic_i64", 0, 0, 0.6},  {"shift_i8", 0, 0, 1.0},
+    {"shift_i64", 0, 0, 2.2},  {"mul_i8", 1, 1, 3.4},
+    {"mul_i18", 1, 1, 3.9},    {"mul_i32", 2, 3, 3.9},
+    {"mul_i64", 4, 10, 3.9},   {"div_i8", 12, 0, 1.5},
+    {"div_i64", 68, 0, 2.5}};
+
+/// Parse the profiling key into the operator kind, bit width, and whether the
+/// operator operates on floats. Keys without type suffix are single precision
+/// float operators. Return false if the key is not an operator key, e.g., the
+/// "fadd_delay" key.
+static bool parseOperatorKey(StringRef key, StringRef &kind, unsigned &width,
+                             bool &isFloat) {
+  auto suffix = key.rsplit('_').second;
+  kind = key.rsplit('_').first;
+  if (suffix.empty()) {
+    width = 32, isFloat = true;
+    return !kind.empty();
+  }
+  if (suffix.consume_front("f"))
+    isFloat = true;
+  else if (suffix.consume_front("i"))
+    isFloat = false;
+  else
+    return false;
+  return !suffix.getAsInteger(10, width) && width;
+}
+
+/// Collect all numbers of the JSON object into "table".
+static void getNumberTable(const llvm::json::Object *object,
+                           llvm::StringMap<double> &table) {
+  if (!object)
+    return;
+  for (auto &entry : *object)
+    if (auto number = entry.second.getAsNumber())
+      table[StringRef(entry.first)] = number.value();
+}
+
+/// Parse the clock frequency name, e.g., "100MHz", into the number of MHz.
+static bool parseFrequency(StringRef name, double &frequency) {
+  return name.consume_back("MHz") && !name.getAsDouble(frequency);
+}
+
+/// Get the table of the given clock frequency from the device profile. If the
+/// frequency is not characterized, each number is linearly interpolated between
+/// the two closest characterized frequencies. The closest one is used if the
+/// frequency is out of the characterized range.
+static void getFrequencyTable(const llvm::json::Object *profile,
+                              StringRef frequency,
+                              llvm::StringMap<double> &table) {
+  if (auto object = profile->getObject(frequency))
+    return getNumberTable(object, table);
+
+  double target;
+  if (!parseFrequency(frequency, target))
+    return;
+
+  const llvm::json::Object *lower = nullptr;
+  const llvm::json::Object *upper = nullptr;
+  double lowerFrequency = 0, upperFrequency = 0;
+  for (auto &entry : *profile) {
+    double current;
+    auto object = entry.second.getAsObject();
+    if (!object || !parseFrequency(entry.first, current))
+      continue;
+    if (current <= target && (!lower || current > lowerFrequency))
+      lower = object, lowerFrequency = current;
+    if (current >= target && (!upper || current < upperFrequency))
+      upper = object, upperFrequency = current;
+  }
+  if (!lower || !upper || lower == upper)
+    return getNumberTable(lower ? lower : upper, table);
+
+  llvm::StringMap<double> lowerTable, upperTable;
+  getNumberTable(lower, lowerTable);
+  getNumberTable(upper, upperTable);
+  auto ratio = (target - lowerFrequency) / (upperFrequency - lowerFrequency);
+  for (auto &entry : lowerTable) {
+    auto upperEntry = upperTable.find(entry.first());
+    if (upperEntry == upperTable.end())
+      table[entry.first()] = entry.second;
+    else
+      table[entry.first()] =
+          entry.second + ratio * (upperEntry->second - entry.second);
+  }
+  for (auto &entry : upperTable)
+    table.try_emplace(entry.first(), entry.second);
+}
+
+/// The characterized numbers of an operator kind indexed by bit width, and
+/// whether the operator operates on floats.
+using WidthPoints = std::map<unsigned, double>;
+using OperatorPoints = llvm::StringMap<std::pair<bool, WidthPoints>>;
+
+/// Collect the numbers of all operator keys in "table" into "kinds".
+static void getOperatorPoints(const llvm::StringMap<double> &table,
+                              OperatorPoints &kinds) {
+  for (auto &entry : table) {
+    StringRef kind;
+    unsigned width;
+    bool isFloat;
+    if (!parseOperatorKey(entry.first(), kind, width, isFloat))
+      continue;
+    auto &points = kinds[kind];
+    points.first = isFloat;
+    points.second[width] = entry.second;
+  }
+}
+
+/// Linearly interpolate the number at the given bit width between the two
+/// closest characterized bit widths. The closest one is used if the bit width
+/// is out of the characterized range.
+static double interpolateWidth(const WidthPoints &points, unsigned width) {
+  auto upper = points.lower_bound(width);
+  if (upper == points.end())
+    return std::prev(upper)->second;
+  if (upper->first == width || upper == points.begin())
+    return upper->second;
+  auto lower = std::prev(upper);
+  auto ratio = double(width - lower->first) / (upper->first - lower->first);
+  return lower->second + ratio * (upper->second - lower->second);
+}
+
+/// Tabulate all operator kinds of "defaults" at each supported bit width into
+/// "operatorMap", where integer operators are tabulated at every bit width up
+/// to 64 and float operators are tabulated at 16, 32, and 64. The numbers of
+/// an operator kind are taken from "table" if the kind is characterized by the
+/// target spec, and rounded up if "operatorMap" holds integers. All keys are
+/// tabulated ahead of time, such that the map is never modified during the
+/// estimation and can be shared between estimators running in parallel.
+template <typename T>
+static void tabulateOperators(const llvm::StringMap<double> &table,
+                              const llvm::StringMap<double> &defaults,
+                              llvm::StringMap<T> &operatorMap) {
+  OperatorPoints kinds, defaultKinds;
+  getOperatorPoints(table, kinds);
+  getOperatorPoints(defaults, defaultKinds);
+
+  for (auto &entry : defaultKinds) {
+    auto kind = entry.first();
+    auto isFloat = entry.second.first;
+    auto characterized = kinds.find(kind);
+
+    auto tabulate = [&](unsigned width) {
+      // Float operators of different precisions are implemented with different
+      // hardware, thus each precision falls back to the defaults separately.
+      auto *points = &entry.second.second;
+      if (characterized != kinds.end() &&
+          (!isFloat || characterized->second.second.count(width)))
+        points = &characterized->second.second;
+
+      // Tolerate the rounding error of the interpolation.
+      auto number = interpolateWidth(*points, width);
+      if (std::is_integral<T>::value)
+        number = ceil(number - 1e-6);
+      operatorMap[getOperatorKey(kind, width, isFloat)] = (T)number;
+    };
+    if (isFloat)
+      for (auto width : {16u, 32u, 64u})
+        tabulate(width);
+    else
+      for (unsigned width = 1; width <= 64; ++width)
+        tabulate(width);
+  }
+}
+
+/// Get the targeted clock frequency, which can be overridden by the target spec
+/// even if a part is selected from the device library.
+static StringRef getFrequency(llvm::json::Object *config) {
+  auto frequency = config->getString("frequency");
+  if (!frequency)
+    frequency = getDeviceProfile(config)->getString("frequency");
+  return frequency.value_or("100MHz");
+}
+
 void scalehls::getLatencyMap(llvm::json::Object *config,
                              llvm::StringMap<int64_t> &latencyMap) {
-  auto frequency =
-      config->getObject(config->getString("frequency").value_or("100MHz"));
+  llvm::StringMap<double> table;
+  getFrequencyTable(getDeviceProfile(config), getFrequency(config), table);
+  llvm::StringMap<double> defaults;
+  for (auto &operatorProfile : defaultOperatorProfiles)
+    defaults[operatorProfile.key] = operatorProfile.latency;
+  tabulateOperators(table, defaults, latencyMap);
+}
+
+void scalehls::getDelayMap(llvm::json::Object *config,
+                           llvm::StringMap<double> &delayMap) {
+  // Delays are characterized along with the latencies, e.g., "fadd_delay".
+  llvm::StringMap<double> table, delayTable;
+  getFrequencyTable(getDeviceProfile(config), getFrequency(config), table);
+  for (auto &entry : table) {
+    auto key = entry.first();
+    if (key.consume_back("_delay"))
+      delayTable[key] = entry.second;
+  }
+  llvm::StringMap<double> defaults;
+  for (auto &operatorProfile : defaultOperatorProfiles)
+    defaults[operatorProfile.key] = operatorProfile.delay;
+  tabulateOperators(delayTable, defaults, delayMap);
+}
 
-  latencyMap["fadd"] = frequency->getInteger("fadd").value_or(4);
-  latencyMap["fmul"] = frequency->getInteger("fmul").value_or(3);
-  latencyMap["fdiv"] = frequency->getInteger("fdiv").value_or(15);
-  latencyMap["fcmp"] = frequency->getInteger("fcmp").value_or(1);
-  latencyMap["fexp"] = frequency->getInteger("fexp").value_or(8);
+double scalehls::getClockPeriod(llvm::json::Object *config) {
+  double frequency;
+  if (!parseFrequency(getFrequency(config), frequency) || frequency <= 0)
+    return 10.0;
+  return 1000.0 / frequency;
 }
 
 void scalehls::getDspUsageMap(llvm::json::Object *config,
                               llvm::StringMap<int64_t> &dspUsageMap) {
-  auto dspUsage = config->getObject("dsp_usage");
+  llvm::StringMap<double> table;
+  getNumberTable(getDeviceProfile(config)->getObject("dsp_usage"), table);
+  llvm::StringMap<double> defaults;
+  for (auto &operatorProfile : defaultOperatorProfiles)
+    defaults[operatorProfile.key] = operatorProfile.dspUsage;
+  tabulateOperators(table, defaults, dspUsageMap);
+}
+
+void scalehls::getLutUsageMap(llvm::json::Object *config,
+                              llvm::StringMap<int64_t> &lutUsageMap) {
+  // There is no default LUT usage, thus LUT usage is only estimated when the
+  // operators are characterized by the target spec.
+  llvm::StringMap<double> table;
+  getNumberTable(getDeviceProfile(config)->getObject("lut_usage"), table);
+  llvm::StringMap<double> defaults;
+  for (auto &operatorProfile : defaultOperatorProfiles)
+    defaults[operatorProfile.key] = 0;
+  tabulateOperators(table, defaults, lutUsageMap);
+}
 
-  dspUsageMap["fadd"] = dspUsage->getInteger("fadd").value_or(2);
-  dspUsageMap["fmul"] = dspUsage->getInteger("fmul").value_or(3);
-  dspUsageMap["fdiv"] = dspUsage->getInteger("fdiv").value_or(0);
-  dspUsageMap["fcmp"] = dspUsage->getInteger("fcmp").value_or(0);
-  dspUsageMap["fexp"] = dspUsage->getInteger("fexp").value_or(7);
+/// Parse the target spec JSON file into "config". If "targetSpec" is empty,
+/// "config" is left empty such that all default values are used.
+LogicalResult scalehls::parseTargetSpec(StringRef targetSpec,
+                                        llvm::json::Object &config,
+                                        std::string &errorMessage) {
+  if (targetSpec.empty())
+    return success();
+
+  auto configFile = mlir::openInputFile(targetSpec, &errorMessage);
+  if (!configFile)
+    return failure();
+
+  auto json = llvm::json::parse(configFile->getBuffer());
+  if (!json) {
+    llvm::consumeError(json.takeError());
+    errorMessage = "failed to parse the target spec json file";
+    return failure();
+  }
+  auto object = json.get().getAsObject();
+  if (!object) {
+    errorMessage = "support an object in the target spec json file, found "
+                   "something else";
+    return failure();
+  }
+  config = std::move(*object);
+  return success();
+}
+
+TargetProfile::TargetProfile(llvm::json::Object *config) {
+  getLatencyMap(config, latencyMap);
+  getDspUsageMap(config, dspUsageMap);
+  getLutUsageMap(config, lutUsageMap);
+  getDelayMap(config, delayMap);
+  clockPeriod = getClockPeriod(config);
 }
 
 namespace {
@@ -953,40 +1437,36 @@ struct QoREstimation : public scalehls::QoREstimationBase<QoREstimation> {
   void runOnOperation() override {
     auto module = getOperation();
 
-    // Read target specification JSON file.
+    // Read target specification JSON file and collect the operator profiles.
+    llvm::json::Object config;
     std::string errorMessage;
-    auto configFile = mlir::openInputFile(targetSpec, &errorMessage);
-    if (!configFile) {
+    if (failed(parseTargetSpec(targetSpec, config, errorMessage))) {
       llvm::errs() << errorMessage << "\n";
       return signalPassFailure();
     }
-
-    // Parse JSON file into memory.
-    auto config = llvm::json::parse(configFile->getBuffer());
-    if (!config) {
-      llvm::errs() << "failed to parse the target spec json file\n";
-      return signalPassFailure();
-    }
-    auto configObj = config.get().getAsObject();
-    if (!configObj) {
-      llvm::errs() << "support an object in the target spec json file, found "
-                      "something else\n";
-      return signalPassFailure();
-    }
-
-    // Collect profiling latency and DSP usage data, where default values are
-    // based on Xilinx PYNQ-Z1 board.
-    llvm::StringMap<int64_t> latencyMap;
-    getLatencyMap(configObj, latencyMap);
-    llvm::StringMap<int64_t> dspUsageMap;
-    getDspUsageMap(configObj, dspUsageMap);
-
-    // Estimate performance and resource utilization. If any other functions are
-    // called by the top function, it will be estimated in the procedure of
-    // estimating the top function.
+    auto profile = TargetProfile(&config);
+
+    // Estimate performance and resource utilization. The functions called by
+    // the top functions are estimated from the leaf ones, such that each
+    // function is only estimated once and the estimation results can be
+    // reused by its callers. Functions in the same level are independent with
+    // each other and estimated in parallel.
+    SmallVector<func::FuncOp, 4> topFuncs;
     for (auto func : module.getOps<func::FuncOp>())
       if (hasTopFuncAttr(func))
-        ScaleHLSEstimator(latencyMap, dspUsageMap, true).estimateFunc(func);
+        topFuncs.push_back(func);
+
+    auto symbolTable = SymbolTable(module);
+    SmallVector<SmallVector<func::FuncOp, 4>, 4> levels;
+    getFuncLevels(topFuncs, symbolTable, levels);
+    for (auto &level : levels)
+      parallelForEach(&getContext(), level, [&](func::FuncOp func) {
+        auto estimator = ScaleHLSEstimator(profile, true);
+        estimator.setEstimatedSubFuncs(&symbolTable);
+        estimator.estimateFunc(func);
+        numDependenceQueries += estimator.getNumDependenceQueries();
+      });
+    numEstimatedFuncs += topFuncs.size();
   }
 };
 } // namespace
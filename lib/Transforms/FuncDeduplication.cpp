@@ -0,0 +1,246 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright 2020-2021 The ScaleHLS Authors.
+//
+//===----------------------------------------------------------------------===//
+
+#include "scalehls/Transforms/Passes.h"
+#include "scalehls/Transforms/Utils.h"
+#include "llvm/ADT/MapVector.h"
+#include "llvm/ADT/SetVector.h"
+
+using namespace mlir;
+using namespace scalehls;
+using namespace hls;
+
+/// Return whether the index constant determines a loop bound or a memref size,
+/// either directly or through index computations. Lifting such a constant turns
+/// a static bound or size into a dynamic one, which breaks the affine analyses
+/// and transforms applied later.
+static bool isBoundOrSizeConstant(Operation *constant) {
+  auto value = constant->getResult(0);
+  if (!value.getType().isIndex())
+    return false;
+
+  SmallVector<Value, 8> worklist({value});
+  DenseSet<Value> visited;
+  while (!worklist.empty()) {
+    auto current = worklist.pop_back_val();
+    if (!visited.insert(current).second)
+      continue;
+    for (auto user : current.getUsers()) {
+      if (isa<AffineForOp, scf::ForOp>(user) ||
+          llvm::any_of(user->getResultTypes(),
+                       [](Type type) { return type.isa<MemRefType>(); }))
+        return true;
+      if (isa<AffineApplyOp, AffineMinOp, AffineMaxOp>(user) ||
+          isa<arith::ArithDialect>(user->getDialect()))
+        for (auto result : user->getResults())
+          if (result.getType().isIndex())
+            worklist.push_back(result);
+    }
+  }
+  return false;
+}
+
+namespace {
+/// The calls of each function in the module, which are collected once from the
+/// symbol uses and kept updated while the calls are redirected.
+using CallsMap = DenseMap<Operation *, SmallVector<func::CallOp, 4>>;
+} // namespace
+
+/// Redirect all calls of "func" to "leader". The constants of "func" that
+/// are lifted into arguments of "leader" are cloned before each call and
+/// passed as extra operands. The estimation results of "func" are kept on the
+/// call sites such that the per-call-site QoR information is not lost.
+static void redirectCalls(func::FuncOp func, func::FuncOp leader,
+                          ArrayRef<Operation *> liftedConstants,
+                          CallsMap &callsMap) {
+  auto calls = std::move(callsMap[func]);
+  callsMap.erase(func);
+  for (auto call : calls) {
+    auto builder = OpBuilder(call);
+
+    SmallVector<Value, 16> operands(call.getOperands());
+    for (auto constant : liftedConstants)
+      operands.push_back(builder.clone(*constant)->getResult(0));
+
+    auto newCall = builder.create<func::CallOp>(call.getLoc(), leader,
+                                                ValueRange(operands));
+    for (auto attr : call->getAttrs())
+      if (attr.getName() != call.getCalleeAttrName())
+        newCall->setAttr(attr.getName(), attr.getValue());
+    for (auto name : {"timing", "resource"})
+      if (!newCall->hasAttr(name))
+        if (auto attr = func->getAttr(name))
+          newCall->setAttr(name, attr);
+
+    call.replaceAllUsesWith(newCall.getResults());
+    call.erase();
+    callsMap[leader].push_back(newCall);
+  }
+}
+
+namespace {
+/// A class of structurally equivalent functions. Each member is associated
+/// with a map from the constants of the leader to its own constants.
+struct FuncClass {
+  FuncClass(func::FuncOp leader) : leader(leader) {}
+
+  func::FuncOp leader;
+  SmallVector<std::pair<func::FuncOp, DenseMap<Operation *, Operation *>>>
+      members;
+};
+} // namespace
+
+namespace {
+struct FuncDeduplication : public FuncDeduplicationBase<FuncDeduplication> {
+  FuncDeduplication() = default;
+  FuncDeduplication(bool argLiftConstants) {
+    liftConstants = argLiftConstants;
+  }
+
+  /// Try to add the function into one of the existing classes.
+  bool tryAddToClass(func::FuncOp func, SmallVectorImpl<FuncClass> &classes) {
+    for (auto &funcClass : classes) {
+      auto leader = funcClass.leader;
+      SmallVector<std::pair<Operation *, Operation *>, 16> constantPairs;
+      if (!isStructurallyEquivalent(leader, func,
+                                    liftConstants ? &constantPairs : nullptr))
+        continue;
+
+      // Constants with different values can only be lifted when they are not
+      // nested in an isolated region, e.g., a nested function.
+      auto canLift = [&](std::pair<Operation *, Operation *> pair) {
+        if (pair.first->getAttrDictionary() ==
+            pair.second->getAttrDictionary())
+          return true;
+        if (isBoundOrSizeConstant(pair.first) ||
+            isBoundOrSizeConstant(pair.second))
+          return false;
+        using IsolatedTrait = OpTrait::IsIsolatedFromAbove;
+        return pair.first->getParentWithTrait<IsolatedTrait>() == leader &&
+               pair.second->getParentWithTrait<IsolatedTrait>() == func;
+      };
+      if (!llvm::all_of(constantPairs, canLift))
+        continue;
+
+      DenseMap<Operation *, Operation *> constantMap(constantPairs.begin(),
+                                                     constantPairs.end());
+      funcClass.members.push_back({func, std::move(constantMap)});
+      return true;
+    }
+    return false;
+  }
+
+  /// Merge all members of the class into its leader.
+  void mergeClass(FuncClass &funcClass, CallsMap &callsMap) {
+    auto leader = funcClass.leader;
+
+    // Collect the constants of the leader that must be lifted into arguments,
+    // i.e., constants of which at least one member has a different value.
+    llvm::SetVector<Operation *> liftedSet;
+    for (auto &member : funcClass.members)
+      for (auto pair : member.second)
+        if (pair.first->getAttrDictionary() !=
+            pair.second->getAttrDictionary())
+          liftedSet.insert(pair.first);
+
+    // Keep the original order of the constants such that the order of the new
+    // arguments is deterministic.
+    SmallVector<Operation *, 16> liftedConstants;
+    leader.walk([&](Operation *op) {
+      if (liftedSet.count(op))
+        liftedConstants.push_back(op);
+    });
+
+    // Pass the original constants to the calls of the leader. This must be
+    // done before redirecting the calls of the members.
+    if (!liftedConstants.empty())
+      redirectCalls(leader, leader, liftedConstants, callsMap);
+
+    // Redirect all calls of the members to the leader.
+    for (auto &member : funcClass.members) {
+      SmallVector<Operation *, 16> memberConstants;
+      for (auto constant : liftedConstants)
+        memberConstants.push_back(member.second.lookup(constant));
+      redirectCalls(member.first, leader, memberConstants, callsMap);
+
+      // The calls nested in the erased member are no longer valid.
+      member.first.walk([&](func::CallOp call) {
+        auto it = callsMap.find(symbolTable->lookup(call.getCallee()));
+        if (it != callsMap.end())
+          llvm::erase_value(it->second, call);
+      });
+      symbolTable->erase(member.first);
+    }
+    if (liftedConstants.empty())
+      return;
+
+    // Lift the constants into arguments of the leader.
+    for (auto constant : liftedConstants) {
+      auto arg = leader.front().addArgument(
+          constant->getResult(0).getType(), constant->getLoc());
+      constant->getResult(0).replaceAllUsesWith(arg);
+      constant->erase();
+    }
+    leader.setType(FunctionType::get(leader.getContext(),
+                                     leader.front().getArgumentTypes(),
+                                     leader.getResultTypes()));
+    numLiftedConstants += liftedConstants.size();
+  }
+
+  void runOnOperation() override {
+    auto module = getOperation();
+    auto moduleSymbolTable = SymbolTable(module);
+    symbolTable = &moduleSymbolTable;
+
+    // Collect the calls of all functions at once. Functions referenced by
+    // anything other than calls can't be safely redirected and are skipped.
+    SymbolTableCollection symbolTables;
+    SymbolUserMap userMap(symbolTables, module);
+    CallsMap callsMap;
+    for (auto func : module.getOps<func::FuncOp>()) {
+      auto users = userMap.getUsers(func);
+      if (func.isExternal() || users.empty() ||
+          !llvm::all_of(users, [](Operation *user) {
+            return isa<func::CallOp>(user);
+          }))
+        continue;
+      auto &calls = callsMap[func];
+      for (auto user : users)
+        calls.push_back(cast<func::CallOp>(user));
+    }
+
+    // Group the functions with their structural hash.
+    llvm::MapVector<size_t, SmallVector<func::FuncOp, 4>> hashToFuncsMap;
+    for (auto func : module.getOps<func::FuncOp>())
+      if (callsMap.count(func))
+        hashToFuncsMap[getStructuralHash(func, liftConstants)].push_back(func);
+
+    for (auto &p : hashToFuncsMap) {
+      if (p.second.size() < 2)
+        continue;
+
+      // Partition the functions into classes of equivalent functions.
+      SmallVector<FuncClass, 4> classes;
+      for (auto func : p.second)
+        if (!tryAddToClass(func, classes))
+          classes.push_back(FuncClass(func));
+
+      for (auto &funcClass : classes) {
+        numDedupedFuncs += funcClass.members.size();
+        mergeClass(funcClass, callsMap);
+      }
+    }
+  }
+
+private:
+  SymbolTable *symbolTable = nullptr;
+};
+} // namespace
+
+std::unique_ptr<Pass>
+scalehls::createFuncDeduplicationPass(bool liftConstants) {
+  return std::make_unique<FuncDeduplication>(liftConstants);
+}
@@ -21,6 +21,7 @@
 #include "mlir/IR/Builders.h"
 #include "mlir/Transforms/Passes.h"
 #include "scalehls/Dialect/HLS/Utils.h"
+#include "scalehls/Transforms/Estimator.h"
 #include "scalehls/Transforms/Passes.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DenseSet.h"
@@ -50,12 +51,15 @@ struct LoopFusion : public AffineLoopFusionBase<LoopFusion> {
   LoopFusion() = default;
   LoopFusion(double computeToleranceThreshold, unsigned fastMemorySpace,
              uint64_t localBufSizeThresholdBytes, bool maximalFusion,
-             enum AffineFusionMode affineFusionMode) {
+             enum AffineFusionMode affineFusionMode, bool estimatorAware,
+             std::string fusionTargetSpec) {
     this->computeToleranceThreshold = computeToleranceThreshold;
     this->fastMemorySpace = fastMemorySpace;
     this->localBufSizeThreshold = localBufSizeThresholdBytes / 1024;
     this->maximalFusion = maximalFusion;
     this->affineFusionMode = affineFusionMode;
+    this->estimatorAware = estimatorAware;
+    this->targetSpec = fusionTargetSpec;
   }
 
   void runOnOperation() override;
@@ -66,10 +70,11 @@ struct LoopFusion : public AffineLoopFusionBase<LoopFusion> {
 std::unique_ptr<Pass> scalehls::createAffineLoopFusionPass(
     double computeToleranceThreshold, unsigned fastMemorySpace,
     uint64_t localBufSizeThreshold, bool maximalFusion,
-    enum AffineFusionMode affineFusionMode) {
-  return std::make_unique<LoopFusion>(computeToleranceThreshold,
-                                      fastMemorySpace, localBufSizeThreshold,
-                                      maximalFusion, affineFusionMode);
+    enum AffineFusionMode affineFusionMode, bool estimatorAware,
+    std::string targetSpec) {
+  return std::make_unique<LoopFusion>(
+      computeToleranceThreshold, fastMemorySpace, localBufSizeThreshold,
+      maximalFusion, affineFusionMode, estimatorAware, targetSpec);
 }
 
 namespace {
@@ -116,58 +121,69 @@ public:
     SmallVector<Operation *, 4> loads;
     // List of store op insts.
     SmallVector<Operation *, 4> stores;
+    // Load and store ops indexed by the accessed memref, such that per-memref
+    // queries don't need to scan all the loads and stores of the node.
+    DenseMap<Value, SmallVector<Operation *, 2>> memrefLoads;
+    DenseMap<Value, SmallVector<Operation *, 2>> memrefStores;
     Node(unsigned id, Operation *op) : id(id), op(op) {}
 
+    // Adds a load op to the node.
+    void addLoad(Operation *loadOpInst) {
+      loads.push_back(loadOpInst);
+      auto memref = cast<AffineReadOpInterface>(loadOpInst).getMemRef();
+      memrefLoads[memref].push_back(loadOpInst);
+    }
+
+    // Adds a store op to the node.
+    void addStore(Operation *storeOpInst) {
+      stores.push_back(storeOpInst);
+      auto memref = cast<AffineWriteOpInterface>(storeOpInst).getMemRef();
+      memrefStores[memref].push_back(storeOpInst);
+    }
+
+    // Clears all load and store ops of the node.
+    void clearLoadsAndStores() {
+      loads.clear();
+      stores.clear();
+      memrefLoads.clear();
+      memrefStores.clear();
+    }
+
     // Returns the load op count for 'memref'.
-    unsigned getLoadOpCount(Value memref) {
-      unsigned loadOpCount = 0;
-      for (auto *loadOpInst : loads) {
-        if (memref == cast<AffineReadOpInterface>(loadOpInst).getMemRef())
-          ++loadOpCount;
-      }
-      return loadOpCount;
+    unsigned getLoadOpCount(Value memref) const {
+      auto it = memrefLoads.find(memref);
+      return it == memrefLoads.end() ? 0 : it->second.size();
     }
 
     // Returns the store op count for 'memref'.
-    unsigned getStoreOpCount(Value memref) {
-      unsigned storeOpCount = 0;
-      for (auto *storeOpInst : stores) {
-        if (memref == cast<AffineWriteOpInterface>(storeOpInst).getMemRef())
-          ++storeOpCount;
-      }
-      return storeOpCount;
+    unsigned getStoreOpCount(Value memref) const {
+      auto it = memrefStores.find(memref);
+      return it == memrefStores.end() ? 0 : it->second.size();
     }
 
     // Returns all store ops in 'storeOps' which access 'memref'.
     void getStoreOpsForMemref(Value memref,
-                              SmallVectorImpl<Operation *> *storeOps) {
-      for (auto *storeOpInst : stores) {
-        if (memref == cast<AffineWriteOpInterface>(storeOpInst).getMemRef())
-          storeOps->push_back(storeOpInst);
-      }
+                              SmallVectorImpl<Operation *> *storeOps) const {
+      auto it = memrefStores.find(memref);
+      if (it != memrefStores.end())
+        llvm::append_range(*storeOps, it->second);
     }
 
     // Returns all load ops in 'loadOps' which access 'memref'.
     void getLoadOpsForMemref(Value memref,
-                             SmallVectorImpl<Operation *> *loadOps) {
-      for (auto *loadOpInst : loads) {
-        if (memref == cast<AffineReadOpInterface>(loadOpInst).getMemRef())
-          loadOps->push_back(loadOpInst);
-      }
+                             SmallVectorImpl<Operation *> *loadOps) const {
+      auto it = memrefLoads.find(memref);
+      if (it != memrefLoads.end())
+        llvm::append_range(*loadOps, it->second);
     }
 
     // Returns all memrefs in 'loadAndStoreMemrefSet' for which this node
     // has at least one load and store operation.
-    void getLoadAndStoreMemrefSet(DenseSet<Value> *loadAndStoreMemrefSet) {
-      llvm::SmallDenseSet<Value, 2> loadMemrefs;
-      for (auto *loadOpInst : loads) {
-        loadMemrefs.insert(cast<AffineReadOpInterface>(loadOpInst).getMemRef());
-      }
-      for (auto *storeOpInst : stores) {
-        auto memref = cast<AffineWriteOpInterface>(storeOpInst).getMemRef();
-        if (loadMemrefs.count(memref) > 0)
-          loadAndStoreMemrefSet->insert(memref);
-      }
+    void
+    getLoadAndStoreMemrefSet(DenseSet<Value> *loadAndStoreMemrefSet) const {
+      for (auto &memrefAndStores : memrefStores)
+        if (memrefLoads.count(memrefAndStores.first) > 0)
+          loadAndStoreMemrefSet->insert(memrefAndStores.first);
     }
   };
 
@@ -195,6 +211,11 @@ public:
   DenseMap<unsigned, SmallVector<Edge, 2>> inEdges;
   // Map from node id to list of output edges.
   DenseMap<unsigned, SmallVector<Edge, 2>> outEdges;
+  // Set of all the edges in the graph indexed by <src-id, dst-id, value>,
+  // which makes edge existence queries constant time.
+  DenseSet<std::tuple<unsigned, unsigned, Value>> edgeSet;
+  // Map from the top-level operation of each node to the node id.
+  DenseMap<Operation *, unsigned> opToNodeMap;
   // Map from memref to a count on the dependence edges associated with that
   // memref.
   DenseMap<Value, unsigned> memrefEdgeCount;
@@ -216,19 +237,30 @@ public:
 
   // Returns the graph node for 'forOp'.
   Node *getForOpNode(AffineForOp forOp) {
-    for (auto &idAndNode : nodes)
-      if (idAndNode.second.op == forOp.getOperation())
-        return &idAndNode.second;
-    return nullptr;
+    auto it = opToNodeMap.find(forOp.getOperation());
+    if (it == opToNodeMap.end())
+      return nullptr;
+    return getNode(it->second);
   }
 
   // Adds a node with 'op' to the graph and returns its unique identifier.
-  unsigned addNode(Operation *op) {
-    Node node(nextNodeId++, op);
+  unsigned addNode(Operation *op) { return insertNode(Node(nextNodeId++, op)); }
+
+  // Inserts 'node' to the graph and returns its unique identifier.
+  unsigned insertNode(const Node &node) {
     nodes.insert({node.id, node});
+    opToNodeMap[node.op] = node.id;
     return node.id;
   }
 
+  // Replaces the top-level operation of node 'id' with 'op'.
+  void setNodeOp(unsigned id, Operation *op) {
+    Node *node = getNode(id);
+    opToNodeMap.erase(node->op);
+    node->op = op;
+    opToNodeMap[op] = id;
+  }
+
   // Remove node 'id' (and its associated edges) from graph.
   void removeNode(unsigned id) {
     // Remove each edge in 'inEdges[id]'.
@@ -246,6 +278,9 @@ public:
       }
     }
     // Erase remaining node state.
+    auto opIt = opToNodeMap.find(getNode(id)->op);
+    if (opIt != opToNodeMap.end() && opIt->second == id)
+      opToNodeMap.erase(opIt);
     inEdges.erase(id);
     outEdges.erase(id);
     nodes.erase(id);
@@ -273,6 +308,8 @@ public:
   // is for 'value' if non-null, or for any value otherwise. Returns false
   // otherwise.
   bool hasEdge(unsigned srcId, unsigned dstId, Value value = nullptr) {
+    if (value)
+      return edgeSet.count({srcId, dstId, value}) > 0;
     if (outEdges.count(srcId) == 0 || inEdges.count(dstId) == 0) {
       return false;
     }
@@ -287,7 +324,7 @@ public:
 
   // Adds an edge from node 'srcId' to node 'dstId' for 'value'.
   void addEdge(unsigned srcId, unsigned dstId, Value value) {
-    if (!hasEdge(srcId, dstId, value)) {
+    if (edgeSet.insert({srcId, dstId, value}).second) {
       outEdges[srcId].push_back({dstId, value});
       inEdges[dstId].push_back({srcId, value});
       if (value.getType().isa<MemRefType>())
@@ -299,6 +336,7 @@ public:
   void removeEdge(unsigned srcId, unsigned dstId, Value value) {
     assert(inEdges.count(dstId) > 0);
     assert(outEdges.count(srcId) > 0);
+    edgeSet.erase({srcId, dstId, value});
     if (value.getType().isa<MemRefType>()) {
       assert(memrefEdgeCount.count(value) > 0);
       memrefEdgeCount[value]--;
@@ -326,6 +364,11 @@ public:
     // Worklist state is: <node-id, next-output-edge-index-to-visit>
     SmallVector<std::pair<unsigned, unsigned>, 4> worklist;
     worklist.push_back({srcId, 0});
+    // Nodes that have been pushed to the worklist. Each node is only visited
+    // once, otherwise nodes reachable through multiple paths are traversed
+    // repeatedly, which is exponential in the worst case.
+    DenseSet<unsigned> visited;
+    visited.insert(srcId);
     // Run DFS traversal to see if 'dstId' is reachable from 'srcId'.
     while (!worklist.empty()) {
       auto &idAndIndex = worklist.back();
@@ -343,8 +386,9 @@ public:
       Edge edge = outEdges[idAndIndex.first][idAndIndex.second];
       // Increment next output edge index for 'idAndIndex'.
       ++idAndIndex.second;
-      // Add node at 'edge.id' to worklist.
-      worklist.push_back({edge.id, 0});
+      // Add node at 'edge.id' to worklist if it has not been visited.
+      if (visited.insert(edge.id).second)
+        worklist.push_back({edge.id, 0});
     }
     return false;
   }
@@ -530,14 +574,14 @@ public:
   void addToNode(unsigned id, const SmallVectorImpl<Operation *> &loads,
                  const SmallVectorImpl<Operation *> &stores) {
     Node *node = getNode(id);
-    llvm::append_range(node->loads, loads);
-    llvm::append_range(node->stores, stores);
+    for (auto *loadOpInst : loads)
+      node->addLoad(loadOpInst);
+    for (auto *storeOpInst : stores)
+      node->addStore(storeOpInst);
   }
 
   void clearNodeLoadAndStores(unsigned id) {
-    Node *node = getNode(id);
-    node->loads.clear();
-    node->stores.clear();
+    getNode(id)->clearLoadsAndStores();
   }
 
   // Calls 'callback' for each input edge incident to node 'id' which carries a
@@ -742,9 +786,10 @@ void gatherEscapingMemrefs(unsigned id, MemRefDependenceGraph *mdg,
 bool MemRefDependenceGraph::init(hls::StageLikeInterface f) {
   LLVM_DEBUG(llvm::dbgs() << "--- Initializing MDG ---\n");
   stage = f;
+  // Map from memref to the ids of nodes accessing it. As nodes are created in
+  // program order, each list is sorted by node id.
   DenseMap<Value, SetVector<unsigned>> memrefAccesses;
 
-  DenseMap<Operation *, unsigned> forToNodeMap;
   for (auto &op : f.getBody().front()) {
     if (auto forOp = dyn_cast<AffineForOp>(op)) {
       // Create graph node 'id' to represent top-level 'forOp' and record
@@ -757,53 +802,48 @@ bool MemRefDependenceGraph::init(hls::StageLikeInterface f) {
         return false;
       Node node(nextNodeId++, &op);
       for (auto *opInst : collector.loadOpInsts) {
-        node.loads.push_back(opInst);
+        node.addLoad(opInst);
         auto memref = cast<AffineReadOpInterface>(opInst).getMemRef();
         memrefAccesses[memref].insert(node.id);
       }
       for (auto *opInst : collector.storeOpInsts) {
-        node.stores.push_back(opInst);
+        node.addStore(opInst);
         auto memref = cast<AffineWriteOpInterface>(opInst).getMemRef();
         memrefAccesses[memref].insert(node.id);
       }
-      forToNodeMap[&op] = node.id;
-      nodes.insert({node.id, node});
+      insertNode(node);
     } else if (auto loadOp = dyn_cast<AffineReadOpInterface>(op)) {
       // Create graph node for top-level load op.
       Node node(nextNodeId++, &op);
-      node.loads.push_back(&op);
+      node.addLoad(&op);
       auto memref = cast<AffineReadOpInterface>(op).getMemRef();
       memrefAccesses[memref].insert(node.id);
-      nodes.insert({node.id, node});
+      insertNode(node);
     } else if (auto storeOp = dyn_cast<AffineWriteOpInterface>(op)) {
       // Create graph node for top-level store op.
       Node node(nextNodeId++, &op);
-      node.stores.push_back(&op);
+      node.addStore(&op);
       auto memref = cast<AffineWriteOpInterface>(op).getMemRef();
       memrefAccesses[memref].insert(node.id);
-      nodes.insert({node.id, node});
+      insertNode(node);
     } else if (op.getNumRegions() != 0) {
       // Return false if another region is found (not currently supported).
       return false;
     } else if (op.getNumResults() > 0 && !op.use_empty()) {
       // Create graph node for top-level producer of SSA values, which
       // could be used by loop nest nodes.
-      Node node(nextNodeId++, &op);
-      nodes.insert({node.id, node});
+      addNode(&op);
     } else if (isa<CallOpInterface>(op)) {
       // Create graph node for top-level Call Op that takes any argument of
       // memref type. Call Op that returns one or more memref type results
       // is already taken care of, by the previous conditions.
       if (llvm::any_of(op.getOperandTypes(),
-                       [&](Type t) { return t.isa<MemRefType>(); })) {
-        Node node(nextNodeId++, &op);
-        nodes.insert({node.id, node});
-      }
+                       [&](Type t) { return t.isa<MemRefType>(); }))
+        addNode(&op);
     } else if (hasEffect<MemoryEffects::Write, MemoryEffects::Free>(&op)) {
       // Create graph node for top-level op, which could have a memory write
       // side effect.
-      Node node(nextNodeId++, &op);
-      nodes.insert({node.id, node});
+      addNode(&op);
     }
   }
 
@@ -827,26 +867,38 @@ bool MemRefDependenceGraph::init(hls::StageLikeInterface f) {
         getLoopIVs(*user, &loops);
         if (loops.empty())
           continue;
-        assert(forToNodeMap.count(loops[0].getOperation()) > 0);
-        unsigned userLoopNestId = forToNodeMap[loops[0].getOperation()];
+        assert(opToNodeMap.count(loops[0].getOperation()) > 0);
+        unsigned userLoopNestId = opToNodeMap[loops[0].getOperation()];
         addEdge(node.id, userLoopNestId, value);
       }
     }
   }
 
-  // Walk memref access lists and add graph edges between dependent nodes.
+  // Walk memref access lists and add graph edges between dependent nodes. Two
+  // nodes are dependent if any of them stores to the memref. To avoid visiting
+  // all the load-load pairs, the positions of storing nodes are collected
+  // first, such that a loading node is directly paired with the subsequent
+  // storing nodes.
   for (auto &memrefAndList : memrefAccesses) {
-    unsigned n = memrefAndList.second.size();
-    for (unsigned i = 0; i < n; ++i) {
-      unsigned srcId = memrefAndList.second[i];
-      bool srcHasStore =
-          getNode(srcId)->getStoreOpCount(memrefAndList.first) > 0;
-      for (unsigned j = i + 1; j < n; ++j) {
-        unsigned dstId = memrefAndList.second[j];
-        bool dstHasStore =
-            getNode(dstId)->getStoreOpCount(memrefAndList.first) > 0;
-        if (srcHasStore || dstHasStore)
-          addEdge(srcId, dstId, memrefAndList.first);
+    auto memref = memrefAndList.first;
+    auto &accessIds = memrefAndList.second;
+
+    SmallVector<unsigned, 8> storePositions;
+    for (unsigned i = 0, e = accessIds.size(); i < e; ++i)
+      if (getNode(accessIds[i])->getStoreOpCount(memref) > 0)
+        storePositions.push_back(i);
+
+    for (unsigned i = 0, e = accessIds.size(); i < e; ++i) {
+      unsigned srcId = accessIds[i];
+      auto storeIt = llvm::upper_bound(storePositions, i);
+      bool srcHasStore = storeIt != storePositions.begin() &&
+                         *std::prev(storeIt) == i;
+      if (srcHasStore) {
+        for (unsigned j = i + 1; j < e; ++j)
+          addEdge(srcId, accessIds[j], memref);
+      } else {
+        for (auto pos : llvm::make_range(storeIt, storePositions.end()))
+          addEdge(srcId, accessIds[pos], memref);
       }
     }
   }
@@ -858,10 +910,19 @@ bool MemRefDependenceGraph::init(hls::StageLikeInterface f) {
 // outermost (while again preserving relative order among them).
 // This can increase the loop depth at which we can fuse a slice, since we are
 // pushing loop carried dependence to a greater depth in the loop nest.
-static void sinkSequentialLoops(MemRefDependenceGraph::Node *node) {
+// Returns true if the loop order of the node is changed.
+static bool sinkSequentialLoops(MemRefDependenceGraph *mdg, unsigned id) {
+  auto *node = mdg->getNode(id);
   assert(isa<AffineForOp>(node->op));
+  SmallVector<AffineForOp, 4> loops;
+  getPerfectlyNestedLoops(loops, cast<AffineForOp>(node->op));
+
   AffineForOp newRootForOp = sinkSequentialLoops(cast<AffineForOp>(node->op));
-  node->op = newRootForOp.getOperation();
+  mdg->setNodeOp(id, newRootForOp.getOperation());
+
+  SmallVector<AffineForOp, 4> newLoops;
+  getPerfectlyNestedLoops(newLoops, newRootForOp);
+  return loops != newLoops;
 }
 
 //  TODO: improve/complete this when we have target data.
@@ -1381,14 +1442,170 @@ public:
   // pair-wise as a fraction of the total computation.
   double computeToleranceThreshold;
 
+  // Counters of the fusion process, which are reported as pass statistics.
+  unsigned numCandidates = 0;
+  unsigned numSliceComputations = 0;
+  unsigned numProducerConsumerFused = 0;
+  unsigned numSiblingFused = 0;
+  unsigned numPrivateMemrefs = 0;
+  unsigned numMemoizedQueries = 0;
+  unsigned numEstimatorRejected = 0;
+
+  // The QoR estimator used as the profitability oracle. If null, the default
+  // computation tolerance based profitability analysis is applied.
+  ScaleHLSEstimator *estimator;
+
+  // Estimated latency and DSP usage of a loop nest.
+  struct LoopNestEstimation {
+    int64_t latency;
+    int64_t dsp;
+  };
+  // Estimations of unfused loop nests indexed by <node-id, node-version>.
+  DenseMap<std::pair<unsigned, unsigned>, Optional<LoopNestEstimation>>
+      nodeEstimations;
+
+  // The version of each node is bumped whenever its loop nest is transformed.
+  // As the legality of fusion also depends on the operations in between the
+  // two nodes, the layout version of each node is bumped whenever an operation
+  // before or at its position is moved or erased. Any change in between two
+  // nodes is located before the later one of them, thus a memoized fusion
+  // query is only valid if none of these versions of the two nodes changed.
+  DenseMap<unsigned, unsigned> nodeVersions;
+  DenseMap<unsigned, unsigned> layoutVersions;
+  // The node versions at the time when sequential loops are sunk.
+  DenseMap<unsigned, unsigned> sunkNodeVersions;
+  // Fusion queries, indexed by <src-id, src-version, src-layout-version,
+  // dst-id, dst-version, dst-layout-version, memref>, that have been found
+  // illegal or unprofitable. The memref is only set for sibling fusion.
+  using FusionQueryKey = std::tuple<unsigned, unsigned, unsigned, unsigned,
+                                    unsigned, unsigned, Value>;
+  DenseSet<FusionQueryKey> infeasibleFusions;
+
   using Node = MemRefDependenceGraph::Node;
 
   GreedyFusion(MemRefDependenceGraph *mdg, unsigned localBufSizeThreshold,
                Optional<unsigned> fastMemorySpace, bool maximalFusion,
-               double computeToleranceThreshold)
+               double computeToleranceThreshold,
+               ScaleHLSEstimator *estimator = nullptr)
       : mdg(mdg), localBufSizeThreshold(localBufSizeThreshold),
         fastMemorySpace(fastMemorySpace), maximalFusion(maximalFusion),
-        computeToleranceThreshold(computeToleranceThreshold) {}
+        computeToleranceThreshold(computeToleranceThreshold),
+        estimator(estimator) {}
+
+  /// Marks the loop nest of node 'id' as changed.
+  void markNodeChanged(unsigned id) { ++nodeVersions[id]; }
+
+  /// Marks the layout of the block as changed at 'op', which is the moved
+  /// operation or the one following an erased operation. The nodes before
+  /// 'op' are not affected.
+  void markLayoutChanged(Operation *op) {
+    for (; op; op = op->getNextNode()) {
+      auto it = mdg->opToNodeMap.find(op);
+      if (it != mdg->opToNodeMap.end())
+        ++layoutVersions[it->second];
+    }
+  }
+
+  /// Returns the key of the fusion query of 'srcId' into 'dstId'.
+  FusionQueryKey getFusionQueryKey(unsigned srcId, unsigned dstId,
+                                   Value memref = nullptr) {
+    return {srcId,
+            nodeVersions.lookup(srcId),
+            layoutVersions.lookup(srcId),
+            dstId,
+            nodeVersions.lookup(dstId),
+            layoutVersions.lookup(dstId),
+            memref};
+  }
+
+  /// Estimates the latency and DSP usage of 'forOp'. The estimation is applied
+  /// to a detached clone to avoid leaving estimation attributes in the IR.
+  Optional<LoopNestEstimation> estimateLoopNest(AffineForOp forOp) {
+    auto clonedForOp = cast<AffineForOp>(forOp->clone());
+    Optional<LoopNestEstimation> estimation;
+    if (estimator->estimateLoop(clonedForOp))
+      estimation = LoopNestEstimation{getTiming(clonedForOp).getLatency(),
+                                      getResource(clonedForOp).getDsp()};
+    clonedForOp.erase();
+    return estimation;
+  }
+
+  /// Returns the estimation of node 'id', which is cached until the node is
+  /// changed.
+  Optional<LoopNestEstimation> getNodeEstimation(unsigned id) {
+    auto key = std::make_pair(id, nodeVersions.lookup(id));
+    auto it = nodeEstimations.find(key);
+    if (it != nodeEstimations.end())
+      return it->second;
+    auto estimation = estimateLoopNest(cast<AffineForOp>(mdg->getNode(id)->op));
+    nodeEstimations[key] = estimation;
+    return estimation;
+  }
+
+  /// Fuses the computation slice of node 'srcId' into node 'dstId'. If the
+  /// estimator is set, the fusion is only kept when the fused loop nest is
+  /// estimated to have a lower latency than the unfused ones, and its DSP
+  /// usage doesn't exceed the unfused ones by more than the tolerance.
+  /// Otherwise, the fusion is rolled back and false is returned.
+  bool fuseNodes(unsigned srcId, unsigned dstId,
+                 const ComputationSliceState &slice, bool removeSrcNode,
+                 bool isInnermostSiblingInsertion = false) {
+    auto srcForOp = cast<AffineForOp>(mdg->getNode(srcId)->op);
+    auto dstForOp = cast<AffineForOp>(mdg->getNode(dstId)->op);
+    if (!estimator) {
+      mlir::fuseLoops(srcForOp, dstForOp, slice, isInnermostSiblingInsertion);
+      return true;
+    }
+
+    auto srcEstimation = getNodeEstimation(srcId);
+    auto dstEstimation = getNodeEstimation(dstId);
+
+    // Keep a detached copy of the destination loop nest for rolling back.
+    auto backupOp = dstForOp->clone();
+    mlir::fuseLoops(srcForOp, dstForOp, slice, isInnermostSiblingInsertion);
+    auto fusedEstimation = estimateLoopNest(dstForOp);
+
+    if (srcEstimation && dstEstimation && fusedEstimation) {
+      // Loop nests in the same stage are executed sequentially, where the DSPs
+      // can be shared between them. If the source loop nest is not removed
+      // after the fusion, it is still executed before the fused one.
+      auto unfusedLatency = srcEstimation->latency + dstEstimation->latency;
+      auto unfusedDsp = std::max(srcEstimation->dsp, dstEstimation->dsp);
+      auto fusedLatency = fusedEstimation->latency;
+      auto fusedDsp = fusedEstimation->dsp;
+      if (!removeSrcNode) {
+        fusedLatency += srcEstimation->latency;
+        fusedDsp = std::max(fusedDsp, srcEstimation->dsp);
+      }
+
+      LLVM_DEBUG(llvm::dbgs()
+                 << "Estimated unfused latency " << unfusedLatency << " dsp "
+                 << unfusedDsp << ", fused latency " << fusedLatency << " dsp "
+                 << fusedDsp << "\n");
+      if (fusedLatency < unfusedLatency &&
+          fusedDsp <= unfusedDsp * (1 + computeToleranceThreshold)) {
+        backupOp->erase();
+        return true;
+      }
+    }
+
+    // Roll back the fusion by replacing the fused loop nest with the backup,
+    // including the uses of its iteration results.
+    LLVM_DEBUG(llvm::dbgs() << "Can't fuse: unprofitable with estimation\n");
+    dstForOp->getBlock()->getOperations().insert(Block::iterator(dstForOp),
+                                                 backupOp);
+    dstForOp->replaceAllUsesWith(backupOp);
+    dstForOp.erase();
+    mdg->setNodeOp(dstId, backupOp);
+
+    LoopNestStateCollector backupCollector;
+    backupCollector.collect(backupOp);
+    mdg->clearNodeLoadAndStores(dstId);
+    mdg->addToNode(dstId, backupCollector.loadOpInsts,
+                   backupCollector.storeOpInsts);
+    ++numEstimatorRejected;
+    return false;
+  }
 
   /// Initializes 'worklist' with nodes from 'mdg'.
   void init() {
@@ -1452,8 +1669,15 @@ public:
       // Sink sequential loops in 'dstNode' (and thus raise parallel loops)
       // while preserving relative order. This can increase the maximum loop
       // depth at which we can fuse a slice of a producer loop nest into a
-      // consumer loop nest.
-      sinkSequentialLoops(dstNode);
+      // consumer loop nest. The sinking is skipped if 'dstNode' has not been
+      // changed since the last time it was sunk.
+      auto sunkIt = sunkNodeVersions.find(dstId);
+      if (sunkIt == sunkNodeVersions.end() ||
+          sunkIt->second != nodeVersions.lookup(dstId)) {
+        if (sinkSequentialLoops(mdg, dstId))
+          markNodeChanged(dstId);
+        sunkNodeVersions[dstId] = nodeVersions.lookup(dstId);
+      }
       auto dstAffineForOp = cast<AffineForOp>(dstNode->op);
 
       // Try to fuse 'dstNode' with candidate producer loops until a fixed point
@@ -1535,13 +1759,35 @@ public:
           unsigned dstLoopDepthTest =
               getInnermostCommonLoopDepth(dstMemrefOps, &dstSurroundingLoops);
 
+          // Skip if the fusion of the two nodes has been found infeasible and
+          // neither of them has been changed since then.
+          ++numCandidates;
+          auto queryKey = getFusionQueryKey(srcId, dstId);
+          if (infeasibleFusions.count(queryKey)) {
+            ++numMemoizedQueries;
+            LLVM_DEBUG(llvm::dbgs() << "Can't fuse: memoized infeasible\n");
+            continue;
+          }
+
+          // FIXME: This is a super hacky approach to avoid fusing into
+          // reduction loops. The depths beyond the parallel band are never
+          // fused, thus their slices are not computed at all.
+          unsigned maxTestDepth = dstLoopDepthTest;
+          AffineLoopBand parallelBand;
+          AffineLoopBand reductionBand;
+          if (getParallelAndReductionLoopBand(dstSurroundingLoops, parallelBand,
+                                              reductionBand))
+            maxTestDepth =
+                std::min(maxTestDepth, (unsigned)parallelBand.size());
+
           // Check the feasibility of fusing src loop nest into dst loop nest
-          // at loop depths in range [1, dstLoopDepthTest].
+          // at loop depths in range [1, maxTestDepth].
           unsigned maxLegalFusionDepth = 0;
           SmallVector<ComputationSliceState, 8> depthSliceUnions;
           depthSliceUnions.resize(dstLoopDepthTest);
           FusionStrategy strategy(FusionStrategy::ProducerConsumer);
-          for (unsigned i = 1; i <= dstLoopDepthTest; ++i) {
+          numSliceComputations += maxTestDepth;
+          for (unsigned i = 1; i <= maxTestDepth; ++i) {
             FusionResult result = mlir::canFuseLoops(
                 srcAffineForOp, dstAffineForOp,
                 /*dstLoopDepth=*/i, &depthSliceUnions[i - 1], strategy);
@@ -1550,18 +1796,10 @@ public:
               maxLegalFusionDepth = i;
           }
 
-          // FIXME: This is a super hacky approach to avoid fusing into
-          // reduction loops.
-          AffineLoopBand parallelBand;
-          AffineLoopBand reductionBand;
-          if (getParallelAndReductionLoopBand(dstSurroundingLoops, parallelBand,
-                                              reductionBand))
-            maxLegalFusionDepth =
-                std::min(maxLegalFusionDepth, (unsigned)parallelBand.size());
-
           if (maxLegalFusionDepth == 0) {
             LLVM_DEBUG(llvm::dbgs()
                        << "Can't fuse: fusion is not legal at any depth\n");
+            infeasibleFusions.insert(queryKey);
             continue;
           }
 
@@ -1569,7 +1807,7 @@ public:
           // for maximal fusion since we already know the maximal legal depth to
           // fuse.
           unsigned bestDstLoopDepth = maxLegalFusionDepth;
-          if (!maximalFusion) {
+          if (!maximalFusion && !estimator) {
             // Retrieve producer stores from the src loop.
             SmallVector<Operation *, 2> producerStores;
             for (Operation *op : srcNode->stores)
@@ -1590,8 +1828,10 @@ public:
             else if (!isFusionProfitable(producerStores[0], producerStores[0],
                                          dstAffineForOp, depthSliceUnions,
                                          maxLegalFusionDepth, &bestDstLoopDepth,
-                                         computeToleranceThreshold))
+                                         computeToleranceThreshold)) {
+              infeasibleFusions.insert(queryKey);
               continue;
+            }
           }
 
           assert(bestDstLoopDepth > 0 && "Unexpected loop fusion depth");
@@ -1638,9 +1878,16 @@ public:
             privateMemrefs.insert(memref);
           }
 
-          // Fuse computation slice of 'srcLoopNest' into 'dstLoopNest'.
-          fuseLoops(srcAffineForOp, dstAffineForOp, bestSlice);
+          // Fuse computation slice of 'srcLoopNest' into 'dstLoopNest'. The
+          // 'dstNode' may be replaced if the fusion is rolled back.
+          if (!fuseNodes(srcId, dstId, bestSlice, removeSrcNode)) {
+            dstAffineForOp = cast<AffineForOp>(dstNode->op);
+            infeasibleFusions.insert(queryKey);
+            continue;
+          }
           dstNodeChanged = true;
+          ++numProducerConsumerFused;
+          markNodeChanged(dstId);
 
           LLVM_DEBUG(llvm::dbgs()
                      << "Fused src loop " << srcId << " into dst loop " << dstId
@@ -1648,8 +1895,10 @@ public:
                      << dstAffineForOp << "\n");
 
           // Move 'dstAffineForOp' before 'insertPointInst' if needed.
-          if (fusedLoopInsPoint != dstAffineForOp.getOperation())
+          if (fusedLoopInsPoint != dstAffineForOp.getOperation()) {
             dstAffineForOp.getOperation()->moveBefore(fusedLoopInsPoint);
+            markLayoutChanged(dstAffineForOp);
+          }
 
           // Update edges between 'srcNode' and 'dstNode'.
           mdg->updateEdges(srcNode->id, dstNode->id, privateMemrefs,
@@ -1679,6 +1928,9 @@ public:
                   dstAffineForOp, storesForMemref[0], bestDstLoopDepth,
                   fastMemorySpace, localBufSizeThreshold);
               if (newMemRef.getDefiningOp()) {
+                // The new alloc is only used by 'dstNode', which has been
+                // marked as changed, thus the layout is not marked.
+                ++numPrivateMemrefs;
                 // Create new node in dependence graph for 'newMemRef' alloc op.
                 unsigned newMemRefNodeId =
                     mdg->addNode(newMemRef.getDefiningOp());
@@ -1705,6 +1957,7 @@ public:
             LLVM_DEBUG(llvm::dbgs()
                        << "Removing src loop " << srcId << " after fusion\n");
             // srcNode is no longer valid after it is removed from mdg.
+            markLayoutChanged(srcAffineForOp->getNextNode());
             srcAffineForOp.erase();
             mdg->removeNode(srcId);
             srcNode = nullptr;
@@ -1779,12 +2032,32 @@ public:
       unsigned dstLoopDepthTest = dstLoopIVs.size();
       auto sibAffineForOp = cast<AffineForOp>(sibNode->op);
 
+      // Skip if the fusion of the two nodes on 'memref' has been found
+      // infeasible and neither of them has been changed since then.
+      ++numCandidates;
+      auto queryKey = getFusionQueryKey(sibId, dstNode->id, memref);
+      if (infeasibleFusions.count(queryKey)) {
+        ++numMemoizedQueries;
+        continue;
+      }
+
+      // FIXME: This is a super hacky approach to avoid fusing into reduction
+      // loops. The depths beyond the parallel band are never fused, thus their
+      // slices are not computed at all.
+      unsigned maxTestDepth = dstLoopDepthTest;
+      AffineLoopBand parallelBand;
+      AffineLoopBand reductionBand;
+      if (getParallelAndReductionLoopBand(dstLoopIVs, parallelBand,
+                                          reductionBand))
+        maxTestDepth = std::min(maxTestDepth, (unsigned)parallelBand.size());
+
       // Compute loop depth and slice union for fusion.
       SmallVector<ComputationSliceState, 8> depthSliceUnions;
       depthSliceUnions.resize(dstLoopDepthTest);
       unsigned maxLegalFusionDepth = 0;
       FusionStrategy strategy(memref);
-      for (unsigned i = 1; i <= dstLoopDepthTest; ++i) {
+      numSliceComputations += maxTestDepth;
+      for (unsigned i = 1; i <= maxTestDepth; ++i) {
         FusionResult result = mlir::canFuseLoops(
             sibAffineForOp, dstAffineForOp,
             /*dstLoopDepth=*/i, &depthSliceUnions[i - 1], strategy);
@@ -1793,26 +2066,21 @@ public:
           maxLegalFusionDepth = i;
       }
 
-      // FIXME: This is a super hacky approach to avoid fusing into reduction
-      // loops.
-      AffineLoopBand parallelBand;
-      AffineLoopBand reductionBand;
-      if (getParallelAndReductionLoopBand(dstLoopIVs, parallelBand,
-                                          reductionBand))
-        maxLegalFusionDepth =
-            std::min(maxLegalFusionDepth, (unsigned)parallelBand.size());
-
       // Skip if fusion is not feasible at any loop depths.
-      if (maxLegalFusionDepth == 0)
+      if (maxLegalFusionDepth == 0) {
+        infeasibleFusions.insert(queryKey);
         continue;
+      }
 
       unsigned bestDstLoopDepth = maxLegalFusionDepth;
-      if (!maximalFusion) {
+      if (!maximalFusion && !estimator) {
         // Check if fusion would be profitable.
         if (!isFusionProfitable(sibLoadOpInst, sibStoreOpInst, dstAffineForOp,
                                 depthSliceUnions, maxLegalFusionDepth,
-                                &bestDstLoopDepth, computeToleranceThreshold))
+                                &bestDstLoopDepth, computeToleranceThreshold)) {
+          infeasibleFusions.insert(queryKey);
           continue;
+        }
       }
 
       assert(bestDstLoopDepth > 0 && "Unexpected loop fusion depth");
@@ -1822,15 +2090,24 @@ public:
       // destination loop. Based on this, the fused loop may be optimized
       // further inside `fuseLoops`.
       bool isInnermostInsertion = (bestDstLoopDepth == dstLoopDepthTest);
-      // Fuse computation slice of 'sibLoopNest' into 'dstLoopNest'.
-      mlir::fuseLoops(sibAffineForOp, dstAffineForOp,
-                      depthSliceUnions[bestDstLoopDepth - 1],
-                      isInnermostInsertion);
+      // Fuse computation slice of 'sibLoopNest' into 'dstLoopNest'. The sibling
+      // node is always removed after the fusion, as all its out edges are
+      // moved to 'dstNode'. The 'dstNode' may be replaced if the fusion is
+      // rolled back.
+      if (!fuseNodes(sibId, dstNode->id, depthSliceUnions[bestDstLoopDepth - 1],
+                     /*removeSrcNode=*/true, isInnermostInsertion)) {
+        dstAffineForOp = cast<AffineForOp>(dstNode->op);
+        infeasibleFusions.insert(queryKey);
+        continue;
+      }
+      ++numSiblingFused;
+      markNodeChanged(dstNode->id);
 
       auto dstForInst = cast<AffineForOp>(dstNode->op);
       // Update operation position of fused loop nest (if needed).
       if (insertPointInst != dstForInst.getOperation()) {
         dstForInst->moveBefore(insertPointInst);
+        markLayoutChanged(dstForInst);
       }
       // Update data dependence graph state post fusion.
       updateStateAfterSiblingFusion(sibNode, dstNode);
@@ -1981,6 +2258,7 @@ public:
     if (mdg->getOutEdgeCount(sibNode->id) == 0) {
       Operation *op = sibNode->op;
       mdg->removeNode(sibNode->id);
+      markLayoutChanged(op->getNextNode());
       op->erase();
     }
   }
@@ -2005,6 +2283,18 @@ public:
 } // namespace
 
 void LoopFusion::runOnOperation() {
+  // Initialize the estimator if the estimator-aware profitability analysis is
+  // enabled, where default values are based on Xilinx PYNQ-Z1 board.
+  llvm::json::Object config;
+  std::string errorMessage;
+  if (estimatorAware &&
+      failed(parseTargetSpec(targetSpec, config, errorMessage))) {
+    llvm::errs() << errorMessage << "\n";
+    return signalPassFailure();
+  }
+  auto profile = TargetProfile(&config);
+  auto estimator = ScaleHLSEstimator(profile, true);
+
   getOperation().walk([&](hls::StageLikeInterface stage) {
     if (stage.hasHierarchy())
       return WalkResult::advance();
@@ -2020,7 +2310,8 @@ void LoopFusion::runOnOperation() {
       fastMemorySpaceOpt = fastMemorySpace;
     unsigned localBufSizeThresholdBytes = localBufSizeThreshold * 1024;
     GreedyFusion fusion(&g, localBufSizeThresholdBytes, fastMemorySpaceOpt,
-                        maximalFusion, computeToleranceThreshold);
+                        maximalFusion, computeToleranceThreshold,
+                        estimatorAware ? &estimator : nullptr);
 
     if (affineFusionMode == AffineFusionMode::ProducerConsumer)
       fusion.runProducerConsumerFusionOnly();
@@ -2028,6 +2319,14 @@ void LoopFusion::runOnOperation() {
       fusion.runSiblingFusionOnly();
     else
       fusion.runGreedyFusion();
+
+    numCandidates += fusion.numCandidates;
+    numSliceComputations += fusion.numSliceComputations;
+    numProducerConsumerFused += fusion.numProducerConsumerFused;
+    numSiblingFused += fusion.numSiblingFused;
+    numPrivateMemrefs += fusion.numPrivateMemrefs;
+    numMemoizedQueries += fusion.numMemoizedQueries;
+    numEstimatorRejected += fusion.numEstimatorRejected;
     return WalkResult::advance();
   });
 }
@@ -5,22 +5,390 @@
 //===----------------------------------------------------------------------===//
 
 #include "mlir/Dialect/Affine/Analysis/AffineAnalysis.h"
+#include "mlir/Dialect/Affine/Analysis/AffineStructures.h"
 #include "mlir/Dialect/Affine/Analysis/Utils.h"
 #include "mlir/Dialect/Affine/LoopUtils.h"
 #include "scalehls/Transforms/Passes.h"
 #include "scalehls/Transforms/Utils.h"
+#include "llvm/ADT/MapVector.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/MathExtras.h"
+#include <numeric>
 
 #define DEBUG_TYPE "scalehls"
 
 using namespace mlir;
 using namespace scalehls;
 
-/// TODO: support to pass in permutation map.
+//===----------------------------------------------------------------------===//
+// Loop Order Cost Model
+//===----------------------------------------------------------------------===//
+
+bool LoopOrderCost::operator<(const LoopOrderCost &rhs) const {
+  return std::make_tuple(getII(), numNonBurstAccesses, reuseDistance,
+                         carriedDepth) <
+         std::make_tuple(rhs.getII(), rhs.numNonBurstAccesses,
+                         rhs.reuseDistance, rhs.carriedDepth);
+}
+
+/// The nominal latency of a loop-carried memory recurrence, i.e. a load that
+/// feeds a store through a few operations. Only the ratio between loop orders
+/// matters, so it doesn't need to be accurate.
+static constexpr unsigned kRecurrenceLatency = 4;
+
+/// The assumed trip count of loops with unknown bounds. Such loops are assumed
+/// to be long, such that pipelining them is not mistaken as cheap.
+static constexpr int64_t kUnknownTripCount = 1024;
+
+static int64_t saturatingMul(int64_t lhs, int64_t rhs) {
+  int64_t result;
+  return llvm::MulOverflow(lhs, rhs, result) ? INT64_MAX : result;
+}
+
+static int64_t saturatingAdd(int64_t lhs, int64_t rhs) {
+  int64_t result;
+  return llvm::AddOverflow(lhs, rhs, result) ? INT64_MAX : result;
+}
 
-/// Optimize loop order. Loops associated with memory access dependencies are
-/// moved to an as outer as possible location of the input loop band. If
-/// "reverse" is true, as inner as possible.
+namespace {
+/// The band information shared by the cost evaluation of all loop orders. All
+/// dependencies and access strides are analyzed once in the original order,
+/// and each loop order is evaluated by permuting them.
+class LoopOrderModel {
+public:
+  explicit LoopOrderModel(AffineLoopBand &band);
+
+  /// Return whether the permutation preserves all dependencies and loop bound
+  /// operands. The result should still be confirmed with
+  /// isValidLoopInterchangePermutation before permuting the loops.
+  bool isLegal(ArrayRef<unsigned> permMap) const;
+
+  LoopOrderCost getCost(ArrayRef<unsigned> permMap) const;
+
+  /// Get the loops carrying dependencies, sorted by their minimum distance.
+  SmallVector<unsigned, 8> getCarryingLoops() const;
+
+private:
+  struct Access {
+    Value memref;
+    /// The coefficients of each band loop in each memref dimension, which are
+    /// only valid if the access can be flattened.
+    SmallVector<SmallVector<int64_t, 4>, 8> coeffs;
+    bool isLinear = true;
+
+    bool isInvariantTo(unsigned loc) const {
+      return isLinear && llvm::all_of(coeffs[loc],
+                                      [](int64_t coeff) { return !coeff; });
+    }
+  };
+
+  struct Memory {
+    bool isExternal = false;
+    unsigned numPorts = 2;
+    /// The factors of cyclic partitions in each dimension.
+    SmallVector<int64_t, 4> cyclicFactors;
+  };
+
+  unsigned depth;
+  SmallVector<int64_t, 8> tripCounts;
+  /// The band loops whose induction variables are used by the bounds of each
+  /// band loop.
+  SmallVector<SmallVector<unsigned, 2>, 8> boundDeps;
+  /// The distance bounds of each dependency on each band loop.
+  SmallVector<SmallVector<DependenceComponent, 8>, 16> dependencies;
+  SmallVector<Access, 16> accesses;
+  llvm::SmallMapVector<Value, Memory, 8> memories;
+};
+} // namespace
+
+LoopOrderModel::LoopOrderModel(AffineLoopBand &band) : depth(band.size()) {
+  for (auto loop : band)
+    tripCounts.push_back(getAverageTripCount(loop).value_or(kUnknownTripCount));
+
+  for (auto loop : band) {
+    SmallVector<unsigned, 2> deps;
+    auto operands = llvm::to_vector(loop.getLowerBoundOperands());
+    llvm::append_range(operands, loop.getUpperBoundOperands());
+    for (unsigned loc = 0; loc < depth; ++loc)
+      if (llvm::is_contained(operands, band[loc].getInductionVar()))
+        deps.push_back(loc);
+    boundDeps.push_back(deps);
+  }
+
+  // Collect all load and store operations for each memory in the loop block,
+  // and calculate the number of common surrouding loops for later uses.
+  auto &loopBlock = *band.back().getBody();
+  MemAccessesMap loadStoresMap;
+  getMemAccessesMap(loopBlock, loadStoresMap);
+  auto commonLoopDepth = getNumCommonSurroundingLoops(
+      *loopBlock.begin(), *std::next(loopBlock.begin()));
+  unsigned startDepth = commonLoopDepth - depth + 1;
+
+  for (auto &pair : loadStoresMap) {
+    auto memref = pair.first;
+    auto &memory = memories[memref];
+    if (auto type = memref.getType().dyn_cast<MemRefType>()) {
+      auto kind = MemoryKind(type.getMemorySpaceAsInt());
+      memory.isExternal = isDram(kind);
+      memory.numPorts = isRam1P(kind) ? 1 : 2;
+
+      auto layoutMap = type.getLayout().getAffineMap();
+      SmallVector<int64_t, 8> factors;
+      getPartitionFactors(type, &factors);
+      for (unsigned dim = 0; dim < factors.size(); ++dim)
+        memory.cyclicFactors.push_back(
+            layoutMap.getResult(dim).getKind() == AffineExprKind::Mod
+                ? factors[dim]
+                : 1);
+    }
+
+    // Flatten the access functions to get the coefficients of each loop.
+    for (auto op : pair.second) {
+      MemRefAccess memAccess(op);
+      AffineValueMap accessMap;
+      memAccess.getAccessMap(&accessMap);
+      auto map = accessMap.getAffineMap();
+      auto operands = accessMap.getOperands();
+
+      Access access;
+      access.memref = memref;
+      access.coeffs.resize(depth);
+      for (auto expr : map.getResults()) {
+        SmallVector<int64_t, 8> flatExpr;
+        if (failed(getFlattenedAffineExpr(expr, map.getNumDims(),
+                                          map.getNumSymbols(), &flatExpr)) ||
+            flatExpr.size() != operands.size() + 1) {
+          access.isLinear = false;
+          break;
+        }
+        for (unsigned loc = 0; loc < depth; ++loc) {
+          auto it = llvm::find(operands, band[loc].getInductionVar());
+          access.coeffs[loc].push_back(
+              it == operands.end() ? 0 : flatExpr[it - operands.begin()]);
+        }
+      }
+      accesses.push_back(access);
+    }
+
+    // Collect the dependencies carried by the band loops between each pair of
+    // accesses, at least one of which is a store.
+    for (auto srcOp : pair.second)
+      for (auto dstOp : pair.second) {
+        if (!isa<AffineWriteOpInterface>(srcOp) &&
+            !isa<AffineWriteOpInterface>(dstOp))
+          continue;
+        MemRefAccess srcAccess(srcOp);
+        MemRefAccess dstAccess(dstOp);
+        for (unsigned d = startDepth; d <= commonLoopDepth; ++d) {
+          FlatAffineValueConstraints depConstrs;
+          SmallVector<DependenceComponent, 2> depComps;
+          DependenceResult result = checkMemrefAccessDependence(
+              srcAccess, dstAccess, d, &depConstrs, &depComps);
+          if (hasDependence(result))
+            dependencies.push_back(SmallVector<DependenceComponent, 8>(
+                depComps.begin() + startDepth - 1,
+                depComps.begin() + startDepth - 1 + depth));
+        }
+      }
+  }
+}
+
+bool LoopOrderModel::isLegal(ArrayRef<unsigned> permMap) const {
+  for (unsigned loc = 0; loc < depth; ++loc)
+    for (auto dep : boundDeps[loc])
+      if (permMap[dep] >= permMap[loc])
+        return false;
+
+  // The first non-zero distance in the permuted order must be positive.
+  SmallVector<unsigned, 8> invPermMap(depth);
+  for (unsigned loc = 0; loc < depth; ++loc)
+    invPermMap[permMap[loc]] = loc;
+  for (auto &dependence : dependencies)
+    for (auto loc : invPermMap) {
+      auto &comp = dependence[loc];
+      if (!comp.lb || comp.lb.value() < 0)
+        return false;
+      if (comp.lb.value() > 0)
+        break;
+    }
+  return true;
+}
+
+LoopOrderCost LoopOrderModel::getCost(ArrayRef<unsigned> permMap) const {
+  LoopOrderCost cost;
+  SmallVector<unsigned, 8> invPermMap(depth);
+  for (unsigned loc = 0; loc < depth; ++loc)
+    invPermMap[permMap[loc]] = loc;
+  auto pipeLoc = invPermMap.back();
+
+  // A dependency is carried by the outermost loop with a non-zero distance in
+  // the permuted order. Dependencies carried by the pipelined loop limit its
+  // II, and the others are preferred to be carried by outer loops.
+  for (auto &dependence : dependencies)
+    for (auto loc : invPermMap) {
+      auto &comp = dependence[loc];
+      if (comp.lb && comp.ub && !comp.lb.value() && !comp.ub.value())
+        continue;
+      cost.carriedDepth += permMap[loc];
+      if (loc == pipeLoc && comp.ub && comp.ub.value() > 0) {
+        auto distance = std::max(comp.lb.value_or(1), (int64_t)1);
+        cost.dependenceII =
+            std::max(cost.dependenceII,
+                     unsigned((kRecurrenceLatency + distance - 1) / distance));
+      }
+      break;
+    }
+
+  int64_t numIters = 1;
+  for (auto tripCount : tripCounts)
+    numIters = saturatingMul(numIters, tripCount);
+
+  llvm::SmallDenseMap<Value, unsigned, 8> numConflictAccesses;
+  llvm::SmallDenseMap<Value, int64_t, 8> reuseDistances;
+  for (auto &access : accesses) {
+    auto &memory = memories.find(access.memref)->second;
+
+    // The reuse distance is the number of iterations between two accesses to
+    // the same element, i.e. the iterations of all loops inner to the
+    // innermost loop that the access is invariant to.
+    int64_t reuseDistance = numIters;
+    for (int64_t loc = depth - 1; loc >= 0; --loc)
+      if (access.isInvariantTo(invPermMap[loc])) {
+        reuseDistance = 1;
+        for (unsigned innerLoc = loc + 1; innerLoc < depth; ++innerLoc)
+          reuseDistance =
+              saturatingMul(reuseDistance, tripCounts[invPermMap[innerLoc]]);
+        break;
+      }
+    auto &memrefReuseDistance = reuseDistances[access.memref];
+    memrefReuseDistance = std::max(memrefReuseDistance, reuseDistance);
+
+    // Accesses invariant to the pipelined loop are reused in registers.
+    if (access.isInvariantTo(pipeLoc))
+      continue;
+    auto &coeffs = access.coeffs[pipeLoc];
+
+    // Accesses to external memories can be bursted only if the pipelined loop
+    // walks the innermost dimension contiguously.
+    if (memory.isExternal) {
+      if (!access.isLinear || coeffs.back() != 1 ||
+          llvm::any_of(ArrayRef<int64_t>(coeffs).drop_back(),
+                       [](int64_t coeff) { return coeff; }))
+        ++cost.numNonBurstAccesses;
+      continue;
+    }
+
+    // Accesses rotating over cyclic partitions with the pipelined loop don't
+    // compete for the ports of the same partition.
+    bool isRotating = access.isLinear;
+    if (isRotating) {
+      isRotating = false;
+      for (unsigned dim = 0; dim < memory.cyclicFactors.size(); ++dim)
+        if (memory.cyclicFactors[dim] > 1 &&
+            coeffs[dim] % memory.cyclicFactors[dim])
+          isRotating = true;
+    }
+    if (!isRotating)
+      ++numConflictAccesses[access.memref];
+  }
+
+  for (auto &pair : numConflictAccesses) {
+    auto numPorts = memories.find(pair.first)->second.numPorts;
+    cost.portII =
+        std::max(cost.portII, (pair.second + numPorts - 1) / numPorts);
+  }
+  for (auto &pair : reuseDistances)
+    cost.reuseDistance = saturatingAdd(cost.reuseDistance, pair.second);
+  return cost;
+}
+
+SmallVector<unsigned, 8> LoopOrderModel::getCarryingLoops() const {
+  SmallVector<int64_t, 8> minDistances(depth, INT64_MAX);
+  for (auto &dependence : dependencies)
+    for (unsigned loc = 0; loc < depth; ++loc) {
+      auto &comp = dependence[loc];
+      if (comp.ub && comp.ub.value() > 0) {
+        auto distance = std::max(comp.lb.value_or(1), (int64_t)1);
+        minDistances[loc] = std::min(minDistances[loc], distance);
+      }
+    }
+
+  SmallVector<unsigned, 8> loops;
+  for (unsigned loc = 0; loc < depth; ++loc)
+    if (minDistances[loc] < INT64_MAX)
+      loops.push_back(loc);
+  llvm::stable_sort(loops, [&](unsigned a, unsigned b) {
+    return minDistances[a] < minDistances[b];
+  });
+  return loops;
+}
+
+/// Score the legal loop orders of the perfect loop band, where the innermost
+/// loop is considered to be pipelined, and return them in "candidates" sorted
+/// from the best to the worst. All permutations are scored if the band has no
+/// more than "maxExhaustiveDepth" loops. Otherwise, each loop is only tried as
+/// the pipelined loop with dependency carrying loops hoisted outermost.
+bool scalehls::getLoopOrderCandidates(
+    AffineLoopBand &band, SmallVectorImpl<LoopOrderCandidate> &candidates,
+    unsigned maxExhaustiveDepth) {
+  assert(!band.empty() && "no loops provided");
+  if (!isPerfectlyNested(band))
+    return false;
+
+  auto model = LoopOrderModel(band);
+  auto depth = band.size();
+  auto addCandidate = [&](ArrayRef<unsigned> permMap) {
+    if (llvm::any_of(candidates, [&](const LoopOrderCandidate &candidate) {
+          return ArrayRef<unsigned>(candidate.first) == permMap;
+        }))
+      return;
+    if (model.isLegal(permMap))
+      candidates.push_back({SmallVector<unsigned, 8>(permMap.begin(),
+                                                     permMap.end()),
+                            model.getCost(permMap)});
+  };
+
+  SmallVector<unsigned, 8> permMap(depth);
+  std::iota(permMap.begin(), permMap.end(), 0);
+  if (depth <= maxExhaustiveDepth) {
+    do
+      addCandidate(permMap);
+    while (std::next_permutation(permMap.begin(), permMap.end()));
+  } else {
+    addCandidate(permMap);
+    auto carryingLoops = model.getCarryingLoops();
+    for (unsigned pipeLoc = 0; pipeLoc < depth; ++pipeLoc) {
+      SmallVector<unsigned, 8> order;
+      for (auto loc : carryingLoops)
+        if (loc != pipeLoc)
+          order.push_back(loc);
+      for (unsigned loc = 0; loc < depth; ++loc)
+        if (loc != pipeLoc && !llvm::is_contained(order, loc))
+          order.push_back(loc);
+      order.push_back(pipeLoc);
+
+      for (unsigned newLoc = 0; newLoc < depth; ++newLoc)
+        permMap[order[newLoc]] = newLoc;
+      addCandidate(permMap);
+    }
+  }
+
+  llvm::stable_sort(candidates, [](const LoopOrderCandidate &a,
+                                   const LoopOrderCandidate &b) {
+    return a.second < b.second;
+  });
+  return true;
+}
+
+//===----------------------------------------------------------------------===//
+// Loop Order Optimization
+//===----------------------------------------------------------------------===//
+
+/// Optimize loop order. If "permMap" is provided, the band is permuted with it
+/// if legal. Otherwise, unless "reverse" is set, the legal loop orders are
+/// scored with the cost model and the best one is applied. If "reverse" is
+/// true, loops associated with memory access dependencies are moved to an as
+/// inner as possible location of the input loop band.
 bool scalehls::applyAffineLoopOrderOpt(AffineLoopBand &band,
                                        ArrayRef<unsigned> permMap,
                                        bool reverse) {
@@ -41,6 +409,32 @@ bool scalehls::applyAffineLoopOrderOpt(AffineLoopBand &band,
     return true;
   }
 
+  if (!reverse) {
+    SmallVector<LoopOrderCandidate, 16> candidates;
+    getLoopOrderCandidates(band, candidates);
+    for (auto &candidate : candidates) {
+      auto &candidatePermMap = candidate.first;
+      if (!isValidLoopInterchangePermutation(band, candidatePermMap))
+        continue;
+
+      LLVM_DEBUG(llvm::dbgs() << "(";);
+      LLVM_DEBUG(for (unsigned i = 0, e = candidatePermMap.size(); i < e; ++i) {
+        llvm::dbgs() << candidatePermMap[i];
+        if (i != e - 1)
+          llvm::dbgs() << ",";
+      });
+      LLVM_DEBUG(llvm::dbgs() << ") II " << candidate.second.getII() << "\n";);
+
+      if (llvm::is_sorted(candidatePermMap))
+        return true;
+      auto newRoot = band[permuteLoops(band, candidatePermMap)];
+      band.clear();
+      getLoopBandFromOutermost(newRoot, band);
+      band.resize(bandDepth);
+      return true;
+    }
+  }
+
   // Collect all load and store operations for each memory in the loop block,
   // and calculate the number of common surrouding loops for later uses.
   MemAccessesMap loadStoresMap;
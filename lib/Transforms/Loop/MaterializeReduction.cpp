@@ -18,7 +18,7 @@ struct MaterializeReductionPattern : public OpRewritePattern<AffineForOp> {
   LogicalResult matchAndRewrite(AffineForOp loop,
                                 PatternRewriter &rewriter) const override {
     if (!loop.getNumIterOperands())
-      return success();
+      return failure();
     auto loc = rewriter.getUnknownLoc();
     auto yield = cast<AffineYieldOp>(loop.getBody()->getTerminator());
 
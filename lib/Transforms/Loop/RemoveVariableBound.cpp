@@ -4,7 +4,9 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Dialect/Affine/Analysis/LoopAnalysis.h"
 #include "mlir/Dialect/Affine/LoopUtils.h"
+#include "mlir/Dialect/Affine/Utils.h"
 #include "mlir/IR/IntegerSet.h"
 #include "scalehls/Transforms/Passes.h"
 #include "scalehls/Transforms/Utils.h"
@@ -12,89 +14,240 @@
 using namespace mlir;
 using namespace scalehls;
 
-/// Apply remove variable bound to all inner loops of the input loop.
-bool scalehls::applyRemoveVariableBound(AffineLoopBand &band) {
-  assert(!band.empty() && "no loops provided");
+/// Calculate the lower and upper bound of the loop bound, which is the minimum
+/// (upper bound) or maximum (lower bound) of all results of the bound map.
+static Optional<std::pair<int64_t, int64_t>>
+getBoundOfLoopBound(AffineMap map, ValueRange operands, bool isUpper) {
+  Optional<std::pair<int64_t, int64_t>> bound;
+  for (unsigned i = 0, e = map.getNumResults(); i < e; ++i) {
+    auto resultBound = getBoundOfAffineMap(map.getSubMap({i}), operands);
+    if (!resultBound)
+      return Optional<std::pair<int64_t, int64_t>>();
+    if (!bound) {
+      bound = resultBound;
+      continue;
+    }
+    auto lhs = bound.value();
+    auto rhs = resultBound.value();
+    if (isUpper)
+      bound = std::pair<int64_t, int64_t>(std::min(lhs.first, rhs.first),
+                                          std::min(lhs.second, rhs.second));
+    else
+      bound = std::pair<int64_t, int64_t>(std::max(lhs.first, rhs.first),
+                                          std::max(lhs.second, rhs.second));
+  }
+  return bound;
+}
 
-  auto innermostLoop = band.back();
+/// Replace the variable upper or lower bound of the loop with its constant
+/// maximum or minimum, and guard the body of the innermost loop with an
+/// AffineIf operation checking all results of the original bound map.
+static bool guardVariableBound(AffineForOp loop, AffineForOp innermostLoop,
+                               bool isUpper) {
+  auto map = isUpper ? loop.getUpperBoundMap() : loop.getLowerBoundMap();
+  auto operands = isUpper ? loop.getUpperBoundOperands()
+                          : loop.getLowerBoundOperands();
+  auto bound = getBoundOfLoopBound(map, operands, isUpper);
+  if (!bound)
+    return false;
+
+  // Collect all components for creating AffineIf operation.
   auto builder = OpBuilder(innermostLoop);
+  auto iv = builder.getAffineDimExpr(map.getNumDims());
+  SmallVector<AffineExpr, 4> ifExprs;
+  for (auto result : map.getResults())
+    ifExprs.push_back(isUpper ? result - iv - 1 : iv - result);
+  auto ifCondition =
+      IntegerSet::get(map.getNumDims() + 1, 0, ifExprs,
+                      SmallVector<bool, 4>(ifExprs.size(), false));
+  auto ifOperands = SmallVector<Value, 4>(operands);
+  ifOperands.push_back(loop.getInductionVar());
 
-  // Remove all vairable loop bound if possible.
-  for (auto loop : band) {
-    if (!loop.hasConstantUpperBound()) {
-      // TODO: support variable upper bound with more than one result in the
-      // getBoundOfAffineValueMap() method.
-      if (auto bound = getBoundOfAffineMap(loop.getUpperBoundMap(),
-                                           loop.getUpperBoundOperands())) {
-        // Collect all components for creating AffineIf operation.
-        auto upperMap = loop.getUpperBoundMap();
-        auto ifExpr = upperMap.getResult(0) -
-                      builder.getAffineDimExpr(upperMap.getNumDims()) - 1;
-        auto ifCondition = IntegerSet::get(upperMap.getNumDims() + 1, 0, ifExpr,
-                                           /*eqFlags=*/false);
-        auto ifOperands = SmallVector<Value, 4>(loop.getUpperBoundOperands());
-        ifOperands.push_back(loop.getInductionVar());
-
-        // Create if operation in the front of the innermost perfect loop.
-        builder.setInsertionPointToStart(innermostLoop.getBody());
-        auto ifOp =
-            builder.create<AffineIfOp>(loop.getLoc(), ifCondition, ifOperands,
-                                       /*withElseRegion=*/false);
-
-        // Move all operations in the innermost perfect loop into the new
-        // created AffineIf region.
-        auto &ifBlock = ifOp.getThenBlock()->getOperations();
-        auto &loopBlock = innermostLoop.getBody()->getOperations();
-        ifBlock.splice(ifBlock.begin(), loopBlock, std::next(loopBlock.begin()),
-                       std::prev(loopBlock.end(), 1));
-
-        // Set constant variable bound.
-        auto maximum = bound.value().second;
-        loop.setConstantUpperBound(maximum);
-      } else
-        return false;
-    }
+  // Create if operation in the front of the innermost perfect loop.
+  builder.setInsertionPointToStart(innermostLoop.getBody());
+  auto ifOp = builder.create<AffineIfOp>(loop.getLoc(), ifCondition, ifOperands,
+                                         /*withElseRegion=*/false);
 
-    if (!loop.hasConstantLowerBound()) {
-      // TODO: support variable lower bound with more than one result in the
-      // getBoundOfAffineValueMap() method.
-      if (auto bound = getBoundOfAffineMap(loop.getLowerBoundMap(),
-                                           loop.getLowerBoundOperands())) {
-        // Collect all components for creating AffineIf operation.
-        auto lowerMap = loop.getLowerBoundMap();
-        auto ifExpr = builder.getAffineDimExpr(lowerMap.getNumDims()) -
-                      lowerMap.getResult(0);
-        auto ifCondition = IntegerSet::get(lowerMap.getNumDims() + 1, 0, ifExpr,
-                                           /*eqFlags=*/false);
-        auto ifOperands = SmallVector<Value, 4>(loop.getLowerBoundOperands());
-        ifOperands.push_back(loop.getInductionVar());
-
-        // Create if operation in the front of the innermost perfect loop.
-        builder.setInsertionPointToStart(innermostLoop.getBody());
-        auto ifOp =
-            builder.create<AffineIfOp>(loop.getLoc(), ifCondition, ifOperands,
-                                       /*withElseRegion=*/false);
-
-        // Move all operations in the innermost perfect loop into the new
-        // created AffineIf region.
-        auto &ifBlock = ifOp.getThenBlock()->getOperations();
-        auto &loopBlock = innermostLoop.getBody()->getOperations();
-        ifBlock.splice(ifBlock.begin(), loopBlock, std::next(loopBlock.begin()),
-                       std::prev(loopBlock.end(), 1));
-
-        // Set constant variable bound.
-        auto minimum = bound.value().first;
-        loop.setConstantLowerBound(minimum);
-      } else
+  // Move all operations in the innermost perfect loop into the new created
+  // AffineIf region.
+  auto &ifBlock = ifOp.getThenBlock()->getOperations();
+  auto &loopBlock = innermostLoop.getBody()->getOperations();
+  ifBlock.splice(ifBlock.begin(), loopBlock, std::next(loopBlock.begin()),
+                 std::prev(loopBlock.end(), 1));
+
+  // Set constant variable bound.
+  if (isUpper)
+    loop.setConstantUpperBound(bound.value().second);
+  else
+    loop.setConstantLowerBound(bound.value().first);
+  return true;
+}
+
+/// Fold the constant operands of the loop bounds into the bound maps.
+static void foldConstantBoundOperands(AffineForOp loop) {
+  auto lbMap = loop.getLowerBoundMap();
+  SmallVector<Value, 4> lbOperands(loop.getLowerBoundOperands());
+  canonicalizeMapAndOperands(&lbMap, &lbOperands);
+  loop.setLowerBound(lbOperands, simplifyAffineMap(lbMap));
+
+  auto ubMap = loop.getUpperBoundMap();
+  SmallVector<Value, 4> ubOperands(loop.getUpperBoundOperands());
+  canonicalizeMapAndOperands(&ubMap, &ubOperands);
+  loop.setUpperBound(ubOperands, simplifyAffineMap(ubMap));
+}
+
+/// The maximum trip count of the outer loop enumerated by splitIterationSpace.
+static constexpr uint64_t kMaxSplitTripCount = 1024;
+
+/// Split the iteration space of the outer loop of which the induction variable
+/// is the only operand of the multi-result bound of "band[loopIdx]", such that
+/// the bound has only one result in each part. For example, the point loop
+/// "for (j = i; j < min(i + 4, 10); ++j)" under "for (i = 0; i < 10; i += 4)"
+/// is split into full tiles with "i" in [0, 8) and a remainder tile with "i"
+/// equal to 8. The outer loop must be the outermost loop of "band". The band
+/// of the remainder part is pushed back to "newBands".
+static bool splitIterationSpace(AffineLoopBand &band, unsigned loopIdx,
+                                bool isUpper,
+                                SmallVectorImpl<AffineLoopBand> &newBands) {
+  auto loop = band[loopIdx];
+  auto map = isUpper ? loop.getUpperBoundMap() : loop.getLowerBoundMap();
+  SmallVector<Value, 4> operands(isUpper ? loop.getUpperBoundOperands()
+                                         : loop.getLowerBoundOperands());
+  if (map.getNumResults() < 2 || operands.empty() ||
+      !isForInductionVar(operands.front()) ||
+      llvm::any_of(operands, [&](Value v) { return v != operands.front(); }))
+    return false;
+
+  // Only the outermost loop is split, as cloning an inner loop of the band
+  // would make the band imperfect.
+  auto outer = getForInductionVarOwner(operands.front());
+  if (outer != band.front() || outer->getParentOfType<AffineForOp>() ||
+      !outer.hasConstantBounds())
+    return false;
+
+  // Find the segments of the outer iteration space where the bound is
+  // determined by the same result. The iteration space is enumerated, thus is
+  // bounded to limit the compile time.
+  auto tripCount = getConstantTripCount(outer);
+  if (!tripCount || tripCount.value() > kMaxSplitTripCount)
+    return false;
+  SmallVector<std::pair<int64_t, unsigned>, 2> segments;
+  for (auto iv = outer.getConstantLowerBound(),
+            ub = outer.getConstantUpperBound();
+       iv < ub; iv += outer.getStep()) {
+    auto ivExpr = getAffineConstantExpr(iv, loop.getContext());
+    SmallVector<AffineExpr, 4> dimReplacements(map.getNumDims(), ivExpr);
+    SmallVector<AffineExpr, 4> symReplacements(map.getNumSymbols(), ivExpr);
+
+    Optional<std::pair<int64_t, unsigned>> selected;
+    for (auto result : llvm::enumerate(map.getResults())) {
+      auto value = result.value()
+                       .replaceDimsAndSymbols(dimReplacements, symReplacements)
+                       .dyn_cast<AffineConstantExpr>();
+      if (!value)
         return false;
+      if (!selected || (isUpper && value.getValue() < selected->first) ||
+          (!isUpper && value.getValue() > selected->first))
+        selected = std::pair<int64_t, unsigned>(value.getValue(),
+                                                result.index());
     }
+    if (segments.empty() || segments.back().second != selected->second)
+      segments.push_back({iv, selected->second});
+    if (segments.size() > 2)
+      return false;
+  }
+  if (segments.empty())
+    return false;
+
+  auto setBound = [&](AffineForOp target, unsigned resultIdx) {
+    SmallVector<Value, 4> targetOperands(isUpper
+                                             ? target.getUpperBoundOperands()
+                                             : target.getLowerBoundOperands());
+    if (isUpper)
+      target.setUpperBound(targetOperands, map.getSubMap({resultIdx}));
+    else
+      target.setLowerBound(targetOperands, map.getSubMap({resultIdx}));
+  };
+
+  // If the bound is always determined by the same result, simply drop all
+  // other results.
+  if (segments.size() == 1) {
+    setBound(loop, segments.front().second);
+    return true;
+  }
+
+  // Otherwise, clone the outer loop for the second part of the iteration space
+  // and set the bound of each part separately.
+  auto splitPoint = segments.back().first;
+  auto builder = OpBuilder(outer);
+  builder.setInsertionPointAfter(outer);
+  auto cloneOuter = cast<AffineForOp>(builder.clone(*outer));
+  outer.setConstantUpperBound(splitPoint);
+  cloneOuter.setConstantLowerBound(splitPoint);
+
+  AffineLoopBand cloneBand;
+  getLoopBandFromOutermost(cloneOuter, cloneBand);
+  setBound(loop, segments.front().second);
+  setBound(cloneBand[loopIdx], segments.back().second);
+
+  // Promote the remainder loop if it only has one iteration, such that the
+  // bounds of its inner loops become constant.
+  if (succeeded(promoteIfSingleIteration(cloneOuter))) {
+    cloneBand.erase(cloneBand.begin());
+    for (auto cloneLoop : cloneBand)
+      foldConstantBoundOperands(cloneLoop);
   }
+  if (!cloneBand.empty())
+    newBands.push_back(cloneBand);
   return true;
 }
 
+/// Apply remove variable bound to all inner loops of the input loop. If
+/// "splitIterSpace" is true, loops with constant trip count are normalized and
+/// multi-result bounds are split into full tiles plus a remainder before
+/// falling back to AffineIf guards.
+bool scalehls::applyRemoveVariableBound(AffineLoopBand &band,
+                                        bool splitIterSpace) {
+  assert(!band.empty() && "no loops provided");
+  auto innermostLoop = band.back();
+
+  // Remove all vairable loop bound if possible.
+  SmallVector<AffineLoopBand, 4> newBands;
+  for (unsigned i = 0, e = band.size(); i < e; ++i) {
+    auto loop = band[i];
+    if (splitIterSpace && !loop.hasConstantBounds()) {
+      if (!loop.hasConstantUpperBound())
+        splitIterationSpace(band, i, /*isUpper=*/true, newBands);
+      if (!loop.hasConstantLowerBound())
+        splitIterationSpace(band, i, /*isUpper=*/false, newBands);
+      if (getConstantTripCount(loop))
+        (void)normalizeAffineFor(loop);
+    }
+
+    if (!loop.hasConstantUpperBound())
+      if (!guardVariableBound(loop, innermostLoop, /*isUpper=*/true))
+        return false;
+
+    if (!loop.hasConstantLowerBound())
+      if (!guardVariableBound(loop, innermostLoop, /*isUpper=*/false))
+        return false;
+  }
+
+  // Remove the variable bounds of the bands split from the original band.
+  bool succeed = true;
+  for (auto &newBand : newBands)
+    succeed &= applyRemoveVariableBound(newBand, splitIterSpace);
+  return succeed;
+}
+
 namespace {
 struct RemoveVariableBound
     : public RemoveVariableBoundBase<RemoveVariableBound> {
+  RemoveVariableBound() = default;
+  RemoveVariableBound(bool argSplitIterSpace) {
+    splitIterSpace = argSplitIterSpace;
+  }
+
   void runOnOperation() override {
     // Collect all target loop bands.
     AffineLoopBands targetBands;
@@ -102,11 +255,12 @@ struct RemoveVariableBound
 
     // Apply loop order optimization to each loop band.
     for (auto &band : targetBands)
-      applyRemoveVariableBound(band);
+      applyRemoveVariableBound(band, splitIterSpace);
   }
 };
 } // namespace
 
-std::unique_ptr<Pass> scalehls::createRemoveVariableBoundPass() {
-  return std::make_unique<RemoveVariableBound>();
+std::unique_ptr<Pass>
+scalehls::createRemoveVariableBoundPass(bool splitIterSpace) {
+  return std::make_unique<RemoveVariableBound>(splitIterSpace);
 }
@@ -4,17 +4,266 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/Dialect/Affine/Analysis/AffineStructures.h"
 #include "mlir/Dialect/Affine/Analysis/Utils.h"
 #include "mlir/Dialect/Affine/Utils.h"
 #include "mlir/IR/Dominance.h"
 #include "mlir/IR/IntegerSet.h"
 #include "scalehls/Dialect/HLS/Utils.h"
 #include "scalehls/Transforms/Passes.h"
+#include "llvm/Support/Allocator.h"
 #include <algorithm>
+#include <numeric>
 
 using namespace mlir;
 using namespace scalehls;
 
+namespace {
+/// An index of the affine accesses in a function. Each access function is
+/// fully composed and flattened into the coefficients of its operands, which
+/// are sorted to make the result independent of the operand order. Accesses
+/// with the same memref, operands, and coefficients share a "linear id", and
+/// accesses that also have the same constant terms share a "class id". The
+/// accesses in the same class are mathematically equivalent, while two
+/// accesses with the same linear id but different class ids never access the
+/// same element in the same iteration. Accesses that can't be flattened (e.g.
+/// with mod or floordiv) or vector accesses get their own unique ids.
+class AffineAccessIndex {
+public:
+  struct AccessInfo {
+    Value memref;
+    unsigned linearId;
+    unsigned classId;
+    bool isLinear;
+  };
+
+  explicit AffineAccessIndex(func::FuncOp func) {
+    // Index the accesses of each memref in the order of its users, such that
+    // the candidates are visited in the same order as walking the users.
+    llvm::SmallDenseSet<Value, 16> visitedMemrefs;
+    func.walk([&](Operation *op) {
+      if (!isa<mlir::AffineReadOpInterface, mlir::AffineWriteOpInterface>(op))
+        return;
+      auto memref = MemRefAccess(op).memref;
+      if (!visitedMemrefs.insert(memref).second)
+        return;
+      for (auto *user : memref.getUsers())
+        if (isa<mlir::AffineReadOpInterface, mlir::AffineWriteOpInterface>(
+                user))
+          addAccess(user);
+    });
+  }
+
+  /// Index an affine load or store, which is either collected when the index
+  /// is constructed or created afterwards.
+  void addAccess(Operation *op) {
+    if (accessInfos.count(op))
+      return;
+    MemRefAccess access(op);
+    AffineValueMap accessMap;
+    access.getAccessMap(&accessMap);
+    auto map = accessMap.getAffineMap();
+    auto operands = accessMap.getOperands();
+
+    // Flatten each access expression into the coefficients of the operands
+    // followed by the constant term.
+    SmallVector<SmallVector<int64_t, 8>, 4> flatExprs;
+    bool isLinear = !isa<AffineVectorLoadOp, AffineVectorStoreOp>(op);
+    for (auto expr : map.getResults()) {
+      if (!isLinear)
+        break;
+      SmallVector<int64_t, 8> flatExpr;
+      if (failed(getFlattenedAffineExpr(expr, map.getNumDims(),
+                                        map.getNumSymbols(), &flatExpr)) ||
+          flatExpr.size() != operands.size() + 1)
+        isLinear = false;
+      flatExprs.push_back(flatExpr);
+    }
+
+    AccessInfo info{access.memref, 0, 0, isLinear};
+    if (!isLinear) {
+      info.linearId = intern({kUniqueTag, getOpaqueId(op)});
+      info.classId = info.linearId;
+      nonlinearAccesses[info.memref].push_back(op);
+    } else {
+      SmallVector<unsigned, 8> order(operands.size());
+      std::iota(order.begin(), order.end(), 0);
+      llvm::sort(order, [&](unsigned a, unsigned b) {
+        return operands[a].getAsOpaquePointer() <
+               operands[b].getAsOpaquePointer();
+      });
+
+      SmallVector<int64_t, 32> key({kLinearTag, getOpaqueId(info.memref)});
+      for (auto i : order)
+        key.push_back(getOpaqueId(operands[i]));
+      for (auto &flatExpr : flatExprs)
+        for (auto i : order)
+          key.push_back(flatExpr[i]);
+      info.linearId = intern(key);
+
+      key[0] = kClassTag;
+      for (auto &flatExpr : flatExprs)
+        key.push_back(flatExpr.back());
+      info.classId = intern(key);
+    }
+    accessInfos[op] = info;
+    classAccesses[info.classId].push_back(op);
+    memrefAccesses[info.memref].push_back(op);
+  }
+
+  /// Return the access information of `op` if it is indexed.
+  const AccessInfo *getInfo(Operation *op) const {
+    auto it = accessInfos.find(op);
+    return it == accessInfos.end() ? nullptr : &it->second;
+  }
+
+  /// Return the accesses that may be mathematically equivalent to `op`, which
+  /// still need to be confirmed with MemRefAccess equality. The result may
+  /// contain `op` itself.
+  SmallVector<Operation *, 8> getCandidates(Operation *op) const {
+    SmallVector<Operation *, 8> candidates;
+    auto info = getInfo(op);
+    if (!info) {
+      for (auto *user : MemRefAccess(op).memref.getUsers())
+        if (isa<mlir::AffineReadOpInterface, mlir::AffineWriteOpInterface>(
+                user))
+          candidates.push_back(user);
+      return candidates;
+    }
+    if (!info->isLinear) {
+      candidates.append(memrefAccesses.lookup(info->memref));
+      return candidates;
+    }
+    candidates.append(classAccesses.lookup(info->classId));
+    candidates.append(nonlinearAccesses.lookup(info->memref));
+    return candidates;
+  }
+
+private:
+  enum : int64_t { kLinearTag, kClassTag, kUniqueTag };
+
+  static int64_t getOpaqueId(const void *ptr) {
+    return reinterpret_cast<intptr_t>(ptr);
+  }
+  static int64_t getOpaqueId(Value value) {
+    return getOpaqueId(value.getAsOpaquePointer());
+  }
+
+  unsigned intern(ArrayRef<int64_t> key) {
+    auto it = keyIds.find(key);
+    if (it != keyIds.end())
+      return it->second;
+    unsigned id = keyIds.size();
+    keyIds.insert({key.copy(allocator), id});
+    return id;
+  }
+
+  llvm::BumpPtrAllocator allocator;
+  DenseMap<ArrayRef<int64_t>, unsigned> keyIds;
+
+  DenseMap<Operation *, AccessInfo> accessInfos;
+  DenseMap<unsigned, SmallVector<Operation *, 4>> classAccesses;
+  DenseMap<Value, SmallVector<Operation *, 4>> memrefAccesses;
+  DenseMap<Value, SmallVector<Operation *, 4>> nonlinearAccesses;
+};
+
+/// An index of the operations that may have the memory effect `EffectType` in
+/// each block, which answers whether there is an intervening effect between
+/// two operations of the same block without walking all operations between
+/// them. Only the operations that are not proved irrelevant by the index are
+/// checked with `mayHaveInterveningEffect`, so the result is identical to
+/// `hasNoInterveningEffect`. Queries across blocks fall back to the latter.
+template <typename EffectType> class InterveningEffectIndex {
+public:
+  explicit InterveningEffectIndex(const AffineAccessIndex &accesses)
+      : accesses(accesses) {}
+
+  bool hasNoInterveningEffect(Operation *start, Operation *memOp,
+                              Value memref) {
+    auto block = memOp->getBlock();
+    auto memOpInfo = accesses.getInfo(memOp);
+    if (start->getBlock() != block || !start->isBeforeInBlock(memOp) ||
+        !memOpInfo || memOpInfo->memref != memref)
+      return scalehls::hasNoInterveningEffect<EffectType>(start, memOp,
+                                                          memref);
+
+    // Check the given operations located between `start` and `memOp`.
+    auto mayIntervene = [&](ArrayRef<Operation *> ops) {
+      auto it = llvm::partition_point(ops, [&](Operation *op) {
+        return op == start || op->isBeforeInBlock(start);
+      });
+      for (; it != ops.end() && (*it)->isBeforeInBlock(memOp); ++it)
+        if (mayHaveInterveningEffect<EffectType>(*it, start, memOp, memref))
+          return true;
+      return false;
+    };
+
+    // Accesses sharing the linear id of `memOp` but in other classes never
+    // touch the element accessed by `memOp` in the same iteration, which is
+    // the only dependence checked for operations in the same block.
+    auto &info = getBlockInfo(block);
+    if (mayIntervene(info.genericOps) ||
+        mayIntervene(lookupOrEmpty(info.classOps, memOpInfo->classId)))
+      return false;
+    for (auto linearId : lookupOrEmpty(info.memrefLinearIds, memref))
+      if (linearId != memOpInfo->linearId &&
+          mayIntervene(lookupOrEmpty(info.linearOps, linearId)))
+        return false;
+    return true;
+  }
+
+  /// Drop the index of `block`, which must be called whenever operations are
+  /// created, moved, or erased in the block.
+  void invalidate(Block *block) { blockInfos.erase(block); }
+
+private:
+  struct BlockInfo {
+    /// Operations that may have the effect on any memref.
+    SmallVector<Operation *, 8> genericOps;
+    /// Affine accesses having the effect, grouped by linear and class ids.
+    DenseMap<unsigned, SmallVector<Operation *, 4>> linearOps;
+    DenseMap<unsigned, SmallVector<Operation *, 4>> classOps;
+    /// The linear ids of the affine accesses on each memref.
+    DenseMap<Value, SmallVector<unsigned, 4>> memrefLinearIds;
+  };
+
+  template <typename KeyT, typename ValueT>
+  static ArrayRef<ValueT>
+  lookupOrEmpty(const DenseMap<KeyT, SmallVector<ValueT, 4>> &map, KeyT key) {
+    auto it = map.find(key);
+    return it == map.end() ? ArrayRef<ValueT>() : ArrayRef<ValueT>(it->second);
+  }
+
+  BlockInfo &getBlockInfo(Block *block) {
+    auto it = blockInfos.find(block);
+    if (it != blockInfos.end())
+      return it->second;
+
+    auto &info = blockInfos[block];
+    for (auto &op : *block) {
+      auto memEffect = dyn_cast<MemoryEffectOpInterface>(op);
+      if (memEffect && !memEffect.hasEffect<EffectType>())
+        continue;
+
+      auto opInfo = memEffect ? accesses.getInfo(&op) : nullptr;
+      if (!opInfo) {
+        info.genericOps.push_back(&op);
+        continue;
+      }
+      auto &linearOps = info.linearOps[opInfo->linearId];
+      if (linearOps.empty())
+        info.memrefLinearIds[opInfo->memref].push_back(opInfo->linearId);
+      linearOps.push_back(&op);
+      info.classOps[opInfo->classId].push_back(&op);
+    }
+    return info;
+  }
+
+  const AffineAccessIndex &accesses;
+  DenseMap<Block *, BlockInfo> blockInfos;
+};
+} // namespace
+
 /// A helper to check whether an ifOp is valid to be replaced with select.
 bool isValid(AffineIfOp ifOp, Operation *targetOp) {
   return !ifOp.hasElse() && ifOp.getThenBlock()->getOperations().size() == 2 &&
@@ -32,14 +281,15 @@ static mlir::AffineReadOpInterface
 forwardStoreToLoad(mlir::AffineReadOpInterface loadOp,
                    SmallVectorImpl<Operation *> &loadOpsToErase,
                    SmallPtrSetImpl<Value> &memrefsToErase,
-                   DominanceInfo &domInfo) {
+                   DominanceInfo &domInfo, AffineAccessIndex &accesses,
+                   InterveningEffectIndex<MemoryEffects::Write> &writes) {
 
   // The store op candidate for forwarding that satisfies all conditions
   // to replace the load, if any.
   mlir::AffineWriteOpInterface lastWriteStoreOp = nullptr;
 
-  for (auto *user : loadOp.getMemRef().getUsers()) {
-    auto storeOp = dyn_cast<mlir::AffineWriteOpInterface>(user);
+  for (auto *candidate : accesses.getCandidates(loadOp)) {
+    auto storeOp = dyn_cast<mlir::AffineWriteOpInterface>(candidate);
     if (!storeOp)
       continue;
     MemRefAccess srcAccess(storeOp);
@@ -72,8 +322,7 @@ forwardStoreToLoad(mlir::AffineReadOpInterface loadOp,
 
     // 3. Ensure there is no intermediate operation which could replace the
     // value in memory.
-    if (!hasNoInterveningEffect<MemoryEffects::Write>(startOp, loadOp,
-                                                      loadOp.getMemRef()))
+    if (!writes.hasNoInterveningEffect(startOp, loadOp, loadOp.getMemRef()))
       continue;
 
     // We now have a candidate for forwarding.
@@ -95,12 +344,15 @@ forwardStoreToLoad(mlir::AffineReadOpInterface loadOp,
   if (!domInfo.dominates(lastWriteStoreOp, loadOp)) {
     // Special case when the store is inside of an if statement.
     auto ifOp = lastWriteStoreOp->getParentOfType<mlir::AffineIfOp>();
+    writes.invalidate(ifOp->getBlock());
+    writes.invalidate(lastWriteStoreOp->getBlock());
     lastWriteStoreOp->moveBefore(ifOp);
 
     // Create a load and select op as the new value to write.
     auto builder = OpBuilder(ifOp);
     builder.setInsertionPoint(lastWriteStoreOp);
     auto newLoad = cast<mlir::AffineReadOpInterface>(builder.clone(*loadOp));
+    accesses.addAccess(newLoad);
     auto select = builder.create<hls::AffineSelectOp>(
         ifOp.getLoc(), ifOp.getIntegerSet(), ifOp.getOperands(), storeVal,
         newLoad.getValue());
@@ -133,11 +385,14 @@ forwardStoreToLoad(mlir::AffineReadOpInterface loadOp,
 static void findUnusedStore(mlir::AffineWriteOpInterface writeA,
                             SmallVectorImpl<Operation *> &opsToErase,
                             SmallPtrSetImpl<Value> &memrefsToErase,
-                            PostDominanceInfo &postDominanceInfo) {
+                            PostDominanceInfo &postDominanceInfo,
+                            AffineAccessIndex &accesses,
+                            InterveningEffectIndex<MemoryEffects::Read> &reads,
+                            DenseMap<Value, bool> &writeOnlyMemrefs) {
   auto memref = writeA.getMemRef();
-  for (Operation *user : writeA.getMemRef().getUsers()) {
+  for (auto *candidate : accesses.getCandidates(writeA)) {
     // Only consider writing operations.
-    auto writeB = dyn_cast<mlir::AffineWriteOpInterface>(user);
+    auto writeB = dyn_cast<mlir::AffineWriteOpInterface>(candidate);
     if (!writeB)
       continue;
 
@@ -179,12 +434,13 @@ static void findUnusedStore(mlir::AffineWriteOpInterface writeA,
 
     // There cannot be an operation which reads from memory between
     // the two writes.
-    if (!hasNoInterveningEffect<MemoryEffects::Read>(targetA, writeB,
-                                                     writeB.getMemRef()))
+    if (!reads.hasNoInterveningEffect(targetA, writeB, writeB.getMemRef()))
       continue;
 
     if (targetA == writeA && targetB != writeB) {
       auto ifOp = cast<AffineIfOp>(targetB);
+      reads.invalidate(ifOp->getBlock());
+      reads.invalidate(writeB->getBlock());
       writeB->moveBefore(ifOp);
 
       auto builder = OpBuilder(ifOp);
@@ -201,10 +457,16 @@ static void findUnusedStore(mlir::AffineWriteOpInterface writeA,
     break;
   }
 
-  if (llvm::all_of(memref.getUsers(), [&](Operation *ownerOp) {
-        return isa<mlir::AffineWriteOpInterface>(ownerOp) ||
-               hasSingleEffect<MemoryEffects::Free>(ownerOp, memref);
-      }))
+  // The users of the memref are not changed while walking the stores, so
+  // whether the memref is only written or freed is computed once.
+  auto writeOnly = writeOnlyMemrefs.try_emplace(memref, false);
+  if (writeOnly.second)
+    writeOnly.first->second =
+        llvm::all_of(memref.getUsers(), [&](Operation *ownerOp) {
+          return isa<mlir::AffineWriteOpInterface>(ownerOp) ||
+                 hasSingleEffect<MemoryEffects::Free>(ownerOp, memref);
+        });
+  if (writeOnly.first->second)
     memrefsToErase.insert(memref);
 }
 
@@ -216,7 +478,8 @@ static void findUnusedStore(mlir::AffineWriteOpInterface writeA,
 // 3) There is no write between loadA and loadB.
 static void loadCSE(mlir::AffineReadOpInterface loadA,
                     SmallVectorImpl<Operation *> &loadOpsToErase,
-                    DominanceInfo &domInfo) {
+                    DominanceInfo &domInfo, AffineAccessIndex &accesses,
+                    InterveningEffectIndex<MemoryEffects::Write> &writes) {
   // FIXME: This is not safe!!! After task is created from affine, we should not
   // apply this as the dependencies cannot be identified correctly.
   // if (auto buffer = loadA.getMemRef().getDefiningOp<BufferOp>())
@@ -241,8 +504,8 @@ static void loadCSE(mlir::AffineReadOpInterface loadA,
   //     }
 
   SmallVector<mlir::AffineReadOpInterface, 4> loadCandidates;
-  for (auto *user : loadA.getMemRef().getUsers()) {
-    auto loadB = dyn_cast<mlir::AffineReadOpInterface>(user);
+  for (auto *candidate : accesses.getCandidates(loadA)) {
+    auto loadB = dyn_cast<mlir::AffineReadOpInterface>(candidate);
     if (!loadB || loadB == loadA)
       continue;
 
@@ -259,8 +522,8 @@ static void loadCSE(mlir::AffineReadOpInterface loadA,
       continue;
 
     // 3. There is no write between loadA and loadB.
-    if (!hasNoInterveningEffect<MemoryEffects::Write>(loadB.getOperation(),
-                                                      loadA, loadA.getMemRef()))
+    if (!writes.hasNoInterveningEffect(loadB.getOperation(), loadA,
+                                       loadA.getMemRef()))
       continue;
 
     // Check if two values have the same shape. This is needed for affine vector
@@ -317,7 +580,19 @@ static void loadCSE(mlir::AffineReadOpInterface loadA,
 // currently only eliminates the stores only if no other loads/uses (other
 // than dealloc) remain.
 //
-static bool applyAffineStoreForward(func::FuncOp func) {
+namespace {
+/// Counters of the store forwarding, which are reported as pass statistics.
+struct StoreForwardStats {
+  unsigned numForwardedStores = 0;
+  unsigned numConditionalForwards = 0;
+  unsigned numEliminatedLoads = 0;
+  unsigned numEliminatedStores = 0;
+  unsigned numErasedMemrefs = 0;
+};
+} // namespace
+
+static bool applyAffineStoreForward(func::FuncOp func,
+                                    StoreForwardStats &stats) {
   DominanceInfo domInfo(func);
   PostDominanceInfo postDomInfo(func);
 
@@ -327,20 +602,32 @@ static bool applyAffineStoreForward(func::FuncOp func) {
   // A list of memref's that are potentially dead / could be eliminated.
   SmallPtrSet<Value, 4> memrefsToErase;
 
-  // Walk all load's and perform store to load forwarding.
+  // Walk all load's and perform store to load forwarding. The candidates and
+  // intervening writes are looked up from the access index rather than
+  // walking all users of the memref and all operations in between.
+  auto loadAccesses = AffineAccessIndex(func);
+  auto writes = InterveningEffectIndex<MemoryEffects::Write>(loadAccesses);
   func.walk([&](mlir::AffineReadOpInterface loadOp) {
     auto currentLoadOp = loadOp;
     auto newLoadOp = mlir::AffineReadOpInterface();
     while (1) {
       newLoadOp = forwardStoreToLoad(currentLoadOp, opsToErase, memrefsToErase,
-                                     domInfo);
+                                     domInfo, loadAccesses, writes);
       // If the current load op is erased or failed to transform, break.
-      if (!newLoadOp || newLoadOp == currentLoadOp)
+      if (!newLoadOp) {
+        ++stats.numForwardedStores;
+        break;
+      }
+      if (newLoadOp == currentLoadOp)
         break;
+      ++stats.numConditionalForwards;
       currentLoadOp = newLoadOp;
     }
-    if (newLoadOp)
-      loadCSE(newLoadOp, opsToErase, domInfo);
+    if (newLoadOp) {
+      auto numOpsToErase = opsToErase.size();
+      loadCSE(newLoadOp, opsToErase, domInfo, loadAccesses, writes);
+      stats.numEliminatedLoads += opsToErase.size() - numOpsToErase;
+    }
   });
 
   // Erase all load op's whose results were replaced with store fwd'ed ones.
@@ -348,11 +635,17 @@ static bool applyAffineStoreForward(func::FuncOp func) {
     op->erase();
   opsToErase.clear();
 
-  // Walk all store's and perform unused store elimination
+  // Walk all store's and perform unused store elimination. The index is
+  // rebuilt as the forwarded loads have been erased.
+  auto storeAccesses = AffineAccessIndex(func);
+  auto reads = InterveningEffectIndex<MemoryEffects::Read>(storeAccesses);
+  DenseMap<Value, bool> writeOnlyMemrefs;
   func.walk([&](mlir::AffineWriteOpInterface storeOp) {
-    findUnusedStore(storeOp, opsToErase, memrefsToErase, postDomInfo);
+    findUnusedStore(storeOp, opsToErase, memrefsToErase, postDomInfo,
+                    storeAccesses, reads, writeOnlyMemrefs);
   });
   // Erase all store op's which don't impact the program
+  stats.numEliminatedStores += opsToErase.size();
   for (auto *op : opsToErase)
     op->erase();
 
@@ -377,13 +670,23 @@ static bool applyAffineStoreForward(func::FuncOp func) {
     for (auto *user : llvm::make_early_inc_range(memref.getUsers()))
       user->erase();
     defOp->erase();
+    ++stats.numErasedMemrefs;
   }
   return true;
 }
 
 namespace {
 struct AffineStoreForward : public AffineStoreForwardBase<AffineStoreForward> {
-  void runOnOperation() override { applyAffineStoreForward(getOperation()); }
+  void runOnOperation() override {
+    StoreForwardStats stats;
+    applyAffineStoreForward(getOperation(), stats);
+
+    numForwardedStores += stats.numForwardedStores;
+    numConditionalForwards += stats.numConditionalForwards;
+    numEliminatedLoads += stats.numEliminatedLoads;
+    numEliminatedStores += stats.numEliminatedStores;
+    numErasedMemrefs += stats.numErasedMemrefs;
+  }
 };
 } // namespace
 
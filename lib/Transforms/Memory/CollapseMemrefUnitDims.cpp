@@ -80,10 +80,21 @@ struct CollapseFuncMemref : public OpRewritePattern<func::FuncOp> {
           auto tensorType = RankedTensorType::get(memrefType.getShape(),
                                                   memrefType.getElementType());
 
-          SmallVector<Attribute> attrs;
-          for (auto attr : constBuffer.getValue().getValues<Attribute>())
-            attrs.push_back(attr);
-          constBuffer.setValueAttr(DenseElementsAttr::get(tensorType, attrs));
+          // Reshape the value without iterating its elements. Resource values
+          // keep referring to the same blob, such that no data is copied.
+          auto value = constBuffer.getValue();
+          if (auto denseValue = value.dyn_cast<DenseElementsAttr>())
+            constBuffer.setValueAttr(denseValue.reshape(tensorType));
+          else if (auto resourceValue =
+                       value.dyn_cast<DenseResourceElementsAttr>())
+            constBuffer.setValueAttr(DenseResourceElementsAttr::get(
+                tensorType, resourceValue.getRawHandle()));
+          else {
+            SmallVector<Attribute> attrs;
+            for (auto attr : value.getValues<Attribute>())
+              attrs.push_back(attr);
+            constBuffer.setValueAttr(DenseElementsAttr::get(tensorType, attrs));
+          }
         }
       }
     });
@@ -0,0 +1,582 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright 2020-2021 The ScaleHLS Authors.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/Dialect/Affine/LoopUtils.h"
+#include "mlir/IR/AffineExprVisitor.h"
+#include "mlir/IR/IntegerSet.h"
+#include "scalehls/Transforms/Passes.h"
+#include "scalehls/Transforms/Utils.h"
+#include "llvm/ADT/MapVector.h"
+
+using namespace mlir;
+using namespace scalehls;
+using namespace hls;
+
+namespace {
+/// Represent a stencil access pattern of a memref in a row loop and a column
+/// loop, where each load reads "memref[..., row * rowStride + rowOffset,
+/// col * colStride + colOffset]" and all other indices are invariant to the two
+/// loops.
+struct StencilPattern {
+  Value memref;
+  SmallVector<std::tuple<AffineLoadOp, int64_t, int64_t>, 16> loads;
+
+  /// The access map and operands of the first load, which are used as the
+  /// template of the streaming read.
+  AffineMap map;
+  SmallVector<Value, 4> operands;
+  unsigned rowPos;
+  unsigned colPos;
+  int64_t rowStride;
+  int64_t colStride;
+
+  int64_t minRowOffset = 0;
+  int64_t minColOffset = 0;
+  int64_t kernelRows = 0;
+  int64_t kernelCols = 0;
+};
+} // namespace
+
+/// Match the access map of the load with the stencil pattern. On success,
+/// return the positions, positive strides, and constant offsets of the row and
+/// column results.
+static bool matchStencilLoad(AffineLoadOp load, AffineForOp rowLoop,
+                             AffineForOp colLoop, unsigned &rowPos,
+                             unsigned &colPos, int64_t &rowStride,
+                             int64_t &colStride, int64_t &rowOffset,
+                             int64_t &colOffset) {
+  auto map = load.getAffineMap();
+  auto operands = load.getMapOperands();
+  bool hasRow = false;
+  bool hasCol = false;
+
+  for (auto expr : llvm::enumerate(map.getResults())) {
+    SimpleAffineExprFlattener flattener(map.getNumDims(), map.getNumSymbols());
+    flattener.walkPostOrder(expr.value());
+    auto flattenedExpr = flattener.operandExprStack.back();
+    if (flattenedExpr.size() != map.getNumInputs() + 1)
+      return false;
+
+    int64_t rowCoeff = 0;
+    int64_t colCoeff = 0;
+    bool hasVariantOperand = false;
+    for (auto operand : llvm::enumerate(operands)) {
+      auto coeff = flattenedExpr[operand.index()];
+      if (!coeff)
+        continue;
+      if (operand.value() == rowLoop.getInductionVar())
+        rowCoeff += coeff;
+      else if (operand.value() == colLoop.getInductionVar())
+        colCoeff += coeff;
+      else if (!rowLoop.isDefinedOutsideOfLoop(operand.value()))
+        hasVariantOperand = true;
+    }
+    if (hasVariantOperand)
+      return false;
+
+    // Besides the row and column results, all other results must be invariant
+    // to the row and column loops.
+    bool isPureOffset = llvm::all_of(
+        llvm::enumerate(ArrayRef<int64_t>(flattenedExpr).drop_back()),
+        [&](auto coeff) {
+          auto operand = operands[coeff.index()];
+          return !coeff.value() || operand == rowLoop.getInductionVar() ||
+                 operand == colLoop.getInductionVar();
+        });
+    if (rowCoeff == 0 && colCoeff == 0)
+      continue;
+    if (rowCoeff > 0 && colCoeff == 0 && isPureOffset && !hasRow) {
+      rowPos = expr.index();
+      rowStride = rowCoeff;
+      rowOffset = flattenedExpr.back();
+      hasRow = true;
+    } else if (rowCoeff == 0 && colCoeff > 0 && isPureOffset && !hasCol) {
+      colPos = expr.index();
+      colStride = colCoeff;
+      colOffset = flattenedExpr.back();
+      hasCol = true;
+    } else
+      return false;
+  }
+  return hasRow && hasCol;
+}
+
+/// Find the memref with the most loads that can be served by a line buffer in
+/// the body of the column loop.
+static Optional<StencilPattern> getStencilPattern(AffineForOp rowLoop,
+                                                  AffineForOp colLoop) {
+  llvm::MapVector<Value, SmallVector<AffineLoadOp, 16>> loadsMap;
+  for (auto load : colLoop.getBody()->getOps<AffineLoadOp>())
+    loadsMap[load.getMemRef()].push_back(load);
+
+  Optional<StencilPattern> bestPattern;
+  for (auto &p : loadsMap) {
+    auto memref = p.first;
+    auto &loads = p.second;
+
+    // The memref must be only read by the loads in the column loop.
+    if (llvm::any_of(memref.getUsers(), [&](Operation *user) {
+          return rowLoop->isAncestor(user) &&
+                 !llvm::is_contained(loads, dyn_cast<AffineLoadOp>(user));
+        }))
+      continue;
+
+    StencilPattern pattern;
+    pattern.memref = memref;
+    pattern.map = loads.front().getAffineMap();
+    pattern.operands = SmallVector<Value, 4>(loads.front().getMapOperands());
+
+    bool isStencil = true;
+    int64_t maxRowOffset = 0;
+    int64_t maxColOffset = 0;
+    for (auto load : loads) {
+      unsigned rowPos, colPos;
+      int64_t rowStride, colStride, rowOffset, colOffset;
+      if (!matchStencilLoad(load, rowLoop, colLoop, rowPos, colPos, rowStride,
+                            colStride, rowOffset, colOffset)) {
+        isStencil = false;
+        break;
+      }
+
+      // All loads must share the same strides and invariant indices.
+      auto map = load.getAffineMap();
+      if (load == loads.front()) {
+        pattern.rowPos = rowPos;
+        pattern.colPos = colPos;
+        pattern.rowStride = rowStride;
+        pattern.colStride = colStride;
+        pattern.minRowOffset = maxRowOffset = rowOffset;
+        pattern.minColOffset = maxColOffset = colOffset;
+      } else if (rowPos != pattern.rowPos || colPos != pattern.colPos ||
+                 rowStride != pattern.rowStride ||
+                 colStride != pattern.colStride ||
+                 map.getNumDims() != pattern.map.getNumDims() ||
+                 map.getNumSymbols() != pattern.map.getNumSymbols() ||
+                 !llvm::equal(load.getMapOperands(), pattern.operands) ||
+                 llvm::any_of(llvm::seq(0u, map.getNumResults()), [&](auto i) {
+                   return i != rowPos && i != colPos &&
+                          map.getResult(i) != pattern.map.getResult(i);
+                 })) {
+        isStencil = false;
+        break;
+      }
+
+      pattern.minRowOffset = std::min(pattern.minRowOffset, rowOffset);
+      pattern.minColOffset = std::min(pattern.minColOffset, colOffset);
+      maxRowOffset = std::max(maxRowOffset, rowOffset);
+      maxColOffset = std::max(maxColOffset, colOffset);
+      pattern.loads.push_back({load, rowOffset, colOffset});
+    }
+    if (!isStencil)
+      continue;
+
+    pattern.kernelRows = maxRowOffset - pattern.minRowOffset + 1;
+    pattern.kernelCols = maxColOffset - pattern.minColOffset + 1;
+    if (pattern.kernelRows * pattern.kernelCols <= 1)
+      continue;
+    if (!bestPattern || pattern.loads.size() > bestPattern->loads.size())
+      bestPattern = pattern;
+  }
+  return bestPattern;
+}
+
+/// Find the rolled kernel loops of a stencil in the band, e.g., the kh and kw
+/// loops of convolutions and poolings. A kernel loop is a reduction loop with
+/// constant bounds, whose induction variable is only added to the induction
+/// variable of the row or column loop in the indices of a memref. On success,
+/// return the row, column, and kernel loops of the memref with the most loads.
+static bool getRolledStencilLoops(AffineLoopBand &band, AffineForOp &rowLoop,
+                                  AffineForOp &colLoop,
+                                  SmallVectorImpl<AffineForOp> &kernelLoops) {
+  auto getBandLoop = [&](Value operand) {
+    auto loop = getForInductionVarOwner(operand);
+    return loop && llvm::is_contained(band, loop) ? loop : AffineForOp();
+  };
+
+  // The induction variables of reduction loops don't index any store.
+  llvm::SmallDenseSet<Operation *, 8> storeLoops;
+  band.back().walk([&](AffineStoreOp store) {
+    for (auto operand : store.getMapOperands())
+      if (auto loop = getBandLoop(operand))
+        storeLoops.insert(loop);
+  });
+
+  llvm::MapVector<Value, SmallVector<AffineLoadOp, 16>> loadsMap;
+  band.back().walk(
+      [&](AffineLoadOp load) { loadsMap[load.getMemRef()].push_back(load); });
+
+  unsigned maxNumLoads = 0;
+  for (auto &p : loadsMap) {
+    auto &loads = p.second;
+    if (loads.size() <= maxNumLoads)
+      continue;
+
+    // The loop added to the kernel loops in each index of the memref, and the
+    // reduction loops that index the memref in other ways.
+    SmallVector<AffineForOp, 4> outerLoops;
+    llvm::SmallSetVector<Operation *, 4> kernels;
+    llvm::SmallDenseSet<Operation *, 4> nonKernels;
+
+    bool isStencil = true;
+    for (auto load : loads) {
+      auto map = load.getAffineMap();
+      auto operands = load.getMapOperands();
+      outerLoops.resize(map.getNumResults());
+
+      for (auto expr : llvm::enumerate(map.getResults())) {
+        SimpleAffineExprFlattener flattener(map.getNumDims(),
+                                            map.getNumSymbols());
+        flattener.walkPostOrder(expr.value());
+        auto flattenedExpr = flattener.operandExprStack.back();
+        if (flattenedExpr.size() != map.getNumInputs() + 1) {
+          isStencil = false;
+          break;
+        }
+
+        AffineForOp outerLoop;
+        SmallVector<Operation *, 4> reductions;
+        bool isPositive = true;
+        for (auto operand : llvm::enumerate(operands)) {
+          auto coeff = flattenedExpr[operand.index()];
+          auto loop = getBandLoop(operand.value());
+          if (!coeff || !loop)
+            continue;
+          isPositive &= coeff > 0;
+          if (!storeLoops.count(loop) && loop.hasConstantBounds())
+            reductions.push_back(loop);
+          else if (!outerLoop)
+            outerLoop = loop;
+          else
+            isPositive = false;
+        }
+
+        if (reductions.empty())
+          continue;
+        if (!outerLoop) {
+          nonKernels.insert(reductions.begin(), reductions.end());
+          continue;
+        }
+        if (!isPositive || !storeLoops.count(outerLoop) ||
+            (outerLoops[expr.index()] &&
+             outerLoops[expr.index()] != outerLoop)) {
+          isStencil = false;
+          break;
+        }
+        outerLoops[expr.index()] = outerLoop;
+        kernels.insert(reductions.begin(), reductions.end());
+      }
+      if (!isStencil)
+        break;
+    }
+
+    SmallVector<AffineForOp, 2> stencilLoops;
+    for (auto loop : outerLoops)
+      if (loop)
+        stencilLoops.push_back(loop);
+    if (!isStencil || stencilLoops.size() != 2 ||
+        stencilLoops[0] == stencilLoops[1] ||
+        llvm::any_of(kernels, [&](Operation *kernel) {
+          return nonKernels.count(kernel);
+        }))
+      continue;
+
+    maxNumLoads = loads.size();
+    rowLoop = stencilLoops[0];
+    colLoop = stencilLoops[1];
+    kernelLoops.clear();
+    for (auto loop : band)
+      if (kernels.count(loop))
+        kernelLoops.push_back(loop);
+  }
+  return maxNumLoads != 0;
+}
+
+/// Permute the band such that the kernel loops are innermost and directly
+/// nested in the row and column loops, and fully unroll the kernel loops. The
+/// load indices are composed afterwards, such that the stencil offsets are
+/// exposed as constants. Return false if the permutation is illegal.
+static bool unrollKernelLoops(AffineLoopBand &band, AffineForOp rowLoop,
+                              AffineForOp colLoop,
+                              ArrayRef<AffineForOp> kernelLoops) {
+  if (!isPerfectlyNested(band))
+    return false;
+
+  SmallVector<AffineForOp, 8> newBand;
+  for (auto loop : band)
+    if (loop != rowLoop && loop != colLoop &&
+        !llvm::is_contained(kernelLoops, loop))
+      newBand.push_back(loop);
+  newBand.append({rowLoop, colLoop});
+  newBand.append(kernelLoops.begin(), kernelLoops.end());
+
+  SmallVector<unsigned, 8> permMap;
+  for (auto loop : band)
+    permMap.push_back(llvm::find(newBand, loop) - newBand.begin());
+  if (!llvm::is_sorted(permMap)) {
+    if (!isValidLoopInterchangePermutation(band, permMap))
+      return false;
+    permuteLoops(band, permMap);
+    band.assign(newBand.begin(), newBand.end());
+  }
+
+  for (auto loop : llvm::reverse(kernelLoops))
+    if (failed(loopUnrollFull(loop)))
+      return false;
+
+  colLoop.walk([&](AffineLoadOp load) {
+    auto map = load.getAffineMap();
+    SmallVector<Value, 4> operands(load.getMapOperands());
+    fullyComposeAffineMapAndOperands(&map, &operands);
+    canonicalizeMapAndOperands(&map, &operands);
+    OpBuilder builder(load);
+    auto newLoad = builder.create<AffineLoadOp>(
+        load.getLoc(), load.getMemRef(), map, operands);
+    load.replaceAllUsesWith(newLoad.getResult());
+    load.erase();
+  });
+  for (auto apply :
+       llvm::make_early_inc_range(colLoop.getBody()->getOps<AffineApplyOp>()))
+    if (apply.use_empty())
+      apply.erase();
+  band.resize(band.size() - kernelLoops.size());
+  return true;
+}
+
+/// Copy the attributes and directives of the original loop to the new loop,
+/// except the bounds and step of the loop. The parallel attribute is dropped
+/// because the line buffer carries dependencies between iterations.
+static void copyLoopAttrs(AffineForOp loop, AffineForOp newLoop) {
+  for (auto attr : loop->getAttrs()) {
+    auto name = attr.getName().getValue();
+    if (name == AffineForOp::getLowerBoundAttrStrName() ||
+        name == AffineForOp::getUpperBoundAttrStrName() ||
+        name == AffineForOp::getStepAttrStrName() || name == "parallel")
+      continue;
+    newLoop->setAttr(attr.getName(), attr.getValue());
+  }
+}
+
+/// Rewrite the row and column loops to stream the input memref in the row
+/// major order, where each element is read exactly once. The last rows are
+/// held by a line buffer and the current stencil window is held by a window
+/// buffer. For example, a 3x3 stencil with a stride of S:
+///   for (h = 0; h < H; ++h)
+///     for (w = 0; w < W; ++w)
+///       ... = A[h * S + i][w * S + j] ...;  // i, j in [0, 3)
+///
+/// Is transformed to:
+///   for (h = 0; h < (H - 1) * S + 3; ++h)
+///     for (w = 0; w < (W - 1) * S + 3; ++w) {
+///       column = {line[0][w], line[1][w], A[h][w]};
+///       line[0][w] = column[1]; line[1][w] = column[2];
+///       shift window left and set window[*][2] = column;
+///       if (h >= 2 && (h - 2) % S == 0 && w >= 2 && (w - 2) % S == 0)
+///         ... = window[i][j] ...;
+///     }
+static void applyLineBuffer(AffineForOp rowLoop, AffineForOp colLoop,
+                            StencilPattern &pattern, OpBuilder &builder) {
+  auto loc = rowLoop.getLoc();
+  auto context = rowLoop.getContext();
+  auto kernelRows = pattern.kernelRows;
+  auto kernelCols = pattern.kernelCols;
+  auto rowStride = pattern.rowStride;
+  auto colStride = pattern.colStride;
+  auto numRows =
+      (rowLoop.getConstantUpperBound() - 1) * rowStride + kernelRows;
+  auto numCols =
+      (colLoop.getConstantUpperBound() - 1) * colStride + kernelCols;
+  auto memrefType = pattern.memref.getType().cast<MemRefType>();
+  auto elementType = memrefType.getElementType();
+
+  // Create the line buffer and window buffer before the loop band.
+  Value lineBuf;
+  if (kernelRows > 1) {
+    auto lineBufType =
+        MemRefType::get({kernelRows - 1, numCols}, elementType);
+    lineBuf = builder.create<BufferOp>(loc, lineBufType).getMemref();
+  }
+  auto windowType = MemRefType::get({kernelRows, kernelCols}, elementType);
+  auto window = builder.create<BufferOp>(loc, windowType).getMemref();
+
+  // Create the streaming loops in place of the original loops, which inherit
+  // the attributes and directives of the original loops.
+  builder.setInsertionPoint(rowLoop);
+  auto newRowLoop = builder.create<AffineForOp>(loc, 0, numRows);
+  copyLoopAttrs(rowLoop, newRowLoop);
+  builder.setInsertionPointToStart(newRowLoop.getBody());
+  auto newColLoop = builder.create<AffineForOp>(loc, 0, numCols);
+  copyLoopAttrs(colLoop, newColLoop);
+  builder.setInsertionPointToStart(newColLoop.getBody());
+  auto row = newRowLoop.getInductionVar();
+  auto col = newColLoop.getInductionVar();
+
+  // Read the input element in the row major order. The new induction variables
+  // are appended as two dims after the original dims, and the original row and
+  // column induction variables are no longer used by the map.
+  auto numDims = pattern.map.getNumDims();
+  SmallVector<AffineExpr, 4> readExprs;
+  for (auto expr : llvm::enumerate(pattern.map.getResults())) {
+    if (expr.index() == pattern.rowPos)
+      readExprs.push_back(getAffineDimExpr(numDims, context) +
+                          pattern.minRowOffset);
+    else if (expr.index() == pattern.colPos)
+      readExprs.push_back(getAffineDimExpr(numDims + 1, context) +
+                          pattern.minColOffset);
+    else
+      readExprs.push_back(expr.value());
+  }
+  auto readMap = AffineMap::get(numDims + 2, pattern.map.getNumSymbols(),
+                                readExprs, context);
+  SmallVector<Value, 8> readOperands;
+  for (auto operand : ArrayRef<Value>(pattern.operands).take_front(numDims))
+    readOperands.push_back(operand == rowLoop.getInductionVar()   ? row
+                           : operand == colLoop.getInductionVar() ? col
+                                                                  : operand);
+  readOperands.append({row, col});
+  readOperands.append(pattern.operands.begin() + numDims,
+                      pattern.operands.end());
+  canonicalizeMapAndOperands(&readMap, &readOperands);
+  auto value = builder.create<AffineLoadOp>(loc, pattern.memref, readMap,
+                                            readOperands);
+
+  // Read the current column from the line buffer and shift it up.
+  auto getColMap = [&](int64_t rowIdx) {
+    return AffineMap::get(1, 0,
+                          {getAffineConstantExpr(rowIdx, context),
+                           getAffineDimExpr(0, context)},
+                          context);
+  };
+  SmallVector<Value, 8> column;
+  for (int64_t i = 0; i < kernelRows - 1; ++i)
+    column.push_back(
+        builder.create<AffineLoadOp>(loc, lineBuf, getColMap(i), col));
+  column.push_back(value);
+  for (int64_t i = 0; i < kernelRows - 1; ++i)
+    builder.create<AffineStoreOp>(loc, column[i + 1], lineBuf, getColMap(i),
+                                  col);
+
+  // Shift the window left and insert the current column.
+  auto getWindowMap = [&](int64_t rowIdx, int64_t colIdx) {
+    return AffineMap::get(0, 0,
+                          {getAffineConstantExpr(rowIdx, context),
+                           getAffineConstantExpr(colIdx, context)},
+                          context);
+  };
+  for (int64_t i = 0; i < kernelRows; ++i) {
+    for (int64_t j = 0; j < kernelCols - 1; ++j) {
+      auto shifted = builder.create<AffineLoadOp>(
+          loc, window, getWindowMap(i, j + 1), ValueRange());
+      builder.create<AffineStoreOp>(loc, shifted, window, getWindowMap(i, j),
+                                    ValueRange());
+    }
+    builder.create<AffineStoreOp>(loc, column[i], window,
+                                  getWindowMap(i, kernelCols - 1),
+                                  ValueRange());
+  }
+
+  // Only compute when the window is filled with valid elements and is aligned
+  // with the strides.
+  auto rowExpr = getAffineDimExpr(0, context) - (kernelRows - 1);
+  auto colExpr = getAffineDimExpr(1, context) - (kernelCols - 1);
+  SmallVector<AffineExpr, 4> constraints({rowExpr, colExpr});
+  SmallVector<bool, 4> eqFlags({false, false});
+  if (rowStride > 1) {
+    constraints.push_back(rowExpr % rowStride);
+    eqFlags.push_back(true);
+  }
+  if (colStride > 1) {
+    constraints.push_back(colExpr % colStride);
+    eqFlags.push_back(true);
+  }
+  auto ifCondition = IntegerSet::get(2, 0, constraints, eqFlags);
+  auto ifOp = builder.create<AffineIfOp>(loc, ifCondition,
+                                         ValueRange({row, col}),
+                                         /*withElseRegion=*/false);
+  builder.setInsertionPointToStart(ifOp.getThenBlock());
+
+  // Map the original induction variables and stencil loads to the window.
+  BlockAndValueMapping mapping;
+  mapping.map(rowLoop.getInductionVar(),
+              builder.create<AffineApplyOp>(
+                  loc, AffineMap::get(2, 0, rowExpr.floorDiv(rowStride)),
+                  ValueRange({row, col})));
+  mapping.map(colLoop.getInductionVar(),
+              builder.create<AffineApplyOp>(
+                  loc, AffineMap::get(2, 0, colExpr.floorDiv(colStride)),
+                  ValueRange({row, col})));
+  llvm::SmallDenseMap<Operation *, std::pair<int64_t, int64_t>> loadOffsets;
+  for (auto &load : pattern.loads)
+    loadOffsets[std::get<0>(load)] = {std::get<1>(load), std::get<2>(load)};
+
+  for (auto &op : colLoop.getBody()->without_terminator()) {
+    auto it = loadOffsets.find(&op);
+    if (it == loadOffsets.end()) {
+      builder.clone(op, mapping);
+      continue;
+    }
+    auto windowLoad = builder.create<AffineLoadOp>(
+        loc, window,
+        getWindowMap(it->second.first - pattern.minRowOffset,
+                     it->second.second - pattern.minColOffset),
+        ValueRange());
+    mapping.map(op.getResult(0), windowLoad.getResult());
+  }
+  rowLoop.erase();
+}
+
+namespace {
+struct CreateLineBuffer : public CreateLineBufferBase<CreateLineBuffer> {
+  void runOnOperation() override {
+    auto func = getOperation();
+
+    // Collect all target loop bands.
+    AffineLoopBands targetBands;
+    getLoopBands(func.front(), targetBands);
+
+    for (auto &band : targetBands) {
+      if (band.size() < 2)
+        continue;
+
+      // The row and column loops are the two innermost loops, or the loops
+      // added to the rolled kernel loops of a stencil. They must be normalized
+      // and have constant trip counts.
+      AffineForOp rowLoop, colLoop;
+      SmallVector<AffineForOp, 4> kernelLoops;
+      if (!getRolledStencilLoops(band, rowLoop, colLoop, kernelLoops)) {
+        rowLoop = band[band.size() - 2];
+        colLoop = band.back();
+      }
+      if (llvm::any_of(ArrayRef<AffineForOp>({rowLoop, colLoop}),
+                       [](AffineForOp loop) {
+                         return !loop.hasConstantBounds() ||
+                                loop.getConstantLowerBound() != 0 ||
+                                loop.getStep() != 1;
+                       }))
+        continue;
+
+      // The kernel loops are moved innermost and fully unrolled, such that the
+      // row and column loops become the two innermost loops.
+      if (!kernelLoops.empty() &&
+          !unrollKernelLoops(band, rowLoop, colLoop, kernelLoops))
+        continue;
+
+      auto pattern = getStencilPattern(rowLoop, colLoop);
+      if (!pattern)
+        continue;
+
+      // Buffers are created before the outermost loop, such that the band is
+      // still perfectly nested.
+      auto builder = OpBuilder(band.front());
+      applyLineBuffer(rowLoop, colLoop, pattern.value(), builder);
+      ++numLineBuffers;
+    }
+  }
+};
+} // namespace
+
+std::unique_ptr<Pass> scalehls::createCreateLineBufferPass() {
+  return std::make_unique<CreateLineBuffer>();
+}
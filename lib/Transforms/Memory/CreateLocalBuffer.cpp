@@ -16,14 +16,49 @@ namespace {
 struct CreateLocalBuffer
     : public scalehls::CreateLocalBufferBase<CreateLocalBuffer> {
   CreateLocalBuffer() = default;
-  CreateLocalBuffer(bool argExternalBufferOnly, bool argRegisterOnly) {
+  CreateLocalBuffer(bool argExternalBufferOnly, bool argRegisterOnly,
+                    bool argDoubleBuffer, unsigned argBramBudget) {
     externalBufferOnly = argExternalBufferOnly;
     registerOnly = argRegisterOnly;
+    doubleBuffer = argDoubleBuffer;
+    bramBudget = argBramBudget;
+  }
+
+  /// Turn local buffers inside of loops into ping-pong buffers under the BRAM
+  /// budget. Once the copies are lowered to loops, they are partitioned into
+  /// separate dataflow tasks from the computation inside of the loop over
+  /// tiles. With two buffer copies, the prefetch of the next tile and the write
+  /// back of the previous tile can overlap with the computation of the current
+  /// tile. Smaller buffers are doubled first to overlap as many transfers as
+  /// possible.
+  void applyDoubleBuffer(func::FuncOp func, ArrayRef<BufferOp> localBufs) {
+    unsigned numBram = 0;
+    func.walk([&](BufferOp buf) {
+      if (!isExternalBuffer(buf.getMemref()))
+        numBram += getNumBram(buf.getType()) * buf.getDepth();
+    });
+
+    SmallVector<BufferOp, 8> candidates;
+    for (auto buf : localBufs)
+      if (isa<mlir::AffineForOp>(buf->getParentOp()))
+        candidates.push_back(buf);
+    llvm::stable_sort(candidates, [](BufferOp a, BufferOp b) {
+      return getNumBram(a.getType()) < getNumBram(b.getType());
+    });
+
+    for (auto buf : candidates) {
+      auto bufNumBram = getNumBram(buf.getType());
+      if (bramBudget && numBram + bufNumBram > bramBudget)
+        break;
+      numBram += bufNumBram;
+      buf.setDepthAttr(OpBuilder(buf).getI32IntegerAttr(2));
+    }
   }
 
   void runOnOperation() override {
     auto func = getOperation();
     auto builder = OpBuilder(func);
+    SmallVector<BufferOp, 8> localBufs;
 
     func.walk([&](memref::SubViewOp subview) {
       if (externalBufferOnly && !isExternalBuffer(subview.getSource()))
@@ -49,6 +84,7 @@ struct CreateLocalBuffer
       builder.setInsertionPointAfter(subview);
       auto buf = builder.create<BufferOp>(loc, bufType);
       subview.getResult().replaceAllUsesWith(buf);
+      localBufs.push_back(buf);
 
       // If the global buffer has initial value, set it to the local buffer.
       auto globalBuf = findBufferOp(subview.getSource());
@@ -64,12 +100,17 @@ struct CreateLocalBuffer
       }
       return WalkResult::advance();
     });
+
+    if (doubleBuffer)
+      applyDoubleBuffer(func, localBufs);
   }
 };
 } // namespace
 
 std::unique_ptr<Pass>
 scalehls::createCreateLocalBufferPass(bool externalBufferOnly,
-                                      bool registerOnly) {
-  return std::make_unique<CreateLocalBuffer>(externalBufferOnly, registerOnly);
+                                      bool registerOnly, bool doubleBuffer,
+                                      unsigned bramBudget) {
+  return std::make_unique<CreateLocalBuffer>(externalBufferOnly, registerOnly,
+                                             doubleBuffer, bramBudget);
 }
@@ -16,15 +16,72 @@ namespace {
 struct CreateMemrefSubview
     : public scalehls::CreateMemrefSubviewBase<CreateMemrefSubview> {
   CreateMemrefSubview() = default;
-  CreateMemrefSubview(CreateSubviewMode argCreateSubviewMode) {
+  CreateMemrefSubview(CreateSubviewMode argCreateSubviewMode,
+                      bool argHaloWindow) {
     createSubviewMode = argCreateSubviewMode;
+    haloWindow = argHaloWindow;
   }
 
   void runOnOperation() override;
 };
 } // namespace
 
-static void createSubviewBeforeLoopBand(AffineLoopBand band) {
+/// Split the local expression "(dynamic + point) floordiv divisor", where the
+/// numerator is a linear combination of point loop induction variables and
+/// dynamic variables, into an offset part "dynamic floordiv divisor" and a
+/// halo part that is the difference between the local expression and the
+/// offset part. Return the static maximum of the halo part, which is the extent
+/// of the overlapping window accessed by the point loops. Return None if the
+/// local expression cannot be split.
+static Optional<int64_t>
+splitHaloLocalExpr(AffineExpr localExpr,
+                   const llvm::SmallDenseSet<unsigned, 8> &pointDims,
+                   unsigned numDims, unsigned numSymbols, ValueRange operands,
+                   AffineExpr &offsetExpr, AffineExpr &haloExpr) {
+  auto binaryExpr = localExpr.dyn_cast<AffineBinaryOpExpr>();
+  if (!binaryExpr || localExpr.getKind() != AffineExprKind::FloorDiv)
+    return Optional<int64_t>();
+  auto divisor = binaryExpr.getRHS().dyn_cast<AffineConstantExpr>();
+  if (!divisor || divisor.getValue() <= 0)
+    return Optional<int64_t>();
+
+  // The numerator must be linear, such that it can be separated into the point
+  // part and the dynamic part.
+  auto numerator = binaryExpr.getLHS();
+  SimpleAffineExprFlattener flattener(numDims, numSymbols);
+  flattener.walkPostOrder(numerator);
+  auto flattenedExpr = flattener.operandExprStack.back();
+  if (flattenedExpr.size() != numDims + numSymbols + 1)
+    return Optional<int64_t>();
+
+  auto context = localExpr.getContext();
+  auto pointExpr = getAffineConstantExpr(0, context);
+  SmallVector<AffineExpr, 4> dimReplacements;
+  for (unsigned i = 0; i < numDims; ++i) {
+    auto dim = getAffineDimExpr(i, context);
+    if (pointDims.count(i)) {
+      pointExpr = pointExpr + dim * flattenedExpr[i];
+      dimReplacements.push_back(getAffineConstantExpr(0, context));
+    } else
+      dimReplacements.push_back(dim);
+  }
+
+  // The point part must start from zero, and its maximum determines the
+  // extent of the halo.
+  auto pointBounds = getBoundOfAffineMap(
+      AffineMap::get(numDims, numSymbols, pointExpr), operands);
+  if (!pointBounds || pointBounds.value().first != 0)
+    return Optional<int64_t>();
+
+  auto dynamicLocalExpr = localExpr.replaceDims(dimReplacements);
+  offsetExpr = dynamicLocalExpr;
+  haloExpr = localExpr - dynamicLocalExpr;
+  return (pointBounds.value().second + divisor.getValue() - 1) /
+             divisor.getValue() +
+         1;
+}
+
+static void createSubviewBeforeLoopBand(AffineLoopBand band, bool haloWindow) {
   assert(!band.empty() && "loop band must not be empty");
   auto b = OpBuilder(band.front());
   auto loc = b.getUnknownLoc();
@@ -67,15 +124,21 @@ static void createSubviewBeforeLoopBand(AffineLoopBand band) {
 
     auto numDims = map.getNumDims();
     auto numSymbols = map.getNumSymbols();
+    auto memrefType = memref.getType().cast<MemRefType>();
     SmallVector<AffineExpr, 4> accessExprs;
     SmallVector<OpFoldResult, 4> bufOffsets;
     SmallVector<OpFoldResult, 4> bufSizes;
     SmallVector<OpFoldResult, 4> bufStrides;
 
+    // Clamped offsets of halo windows, which are passed to the new memory
+    // access map as additional dimensions.
+    SmallVector<Value, 4> clampedOffsets;
+
     // Traverse the memory access index of each dimension to construct the
     // sizes, offsets, and strids of the memref subview. Also, construct the
     // new memory access indices.
     for (auto expr : map.getResults()) {
+      auto memDim = accessExprs.size();
       if (!expr.isPureAffine())
         return WalkResult::advance();
 
@@ -90,6 +153,8 @@ static void createSubviewBeforeLoopBand(AffineLoopBand band) {
       // Otherwise, it is added to th offset-expr.
       auto offsetExpr = b.getAffineConstantExpr(flattenedExpr.back());
       auto sizeExpr = b.getAffineConstantExpr(0);
+      auto haloExpr = b.getAffineConstantExpr(0);
+      int64_t haloSize = 0;
       for (unsigned i = 0, e = numDims + numSymbols; i < e; ++i) {
         auto factor = flattenedExpr[i];
         auto id = i < numDims ? b.getAffineDimExpr(i)
@@ -104,7 +169,9 @@ static void createSubviewBeforeLoopBand(AffineLoopBand band) {
       // induction variables or dynamic variables, it is added to the
       // size-expr or offset-expr, respectively. Otherwise, the size of the
       // local buffer will be dynamically shaped, which is not supported by
-      // HLS thus is skipped.
+      // HLS thus is skipped. If halo window is enabled, such local exprs (e.g.,
+      // strided sliding windows) are split into an offset and a halo with a
+      // static maximum size.
       for (unsigned i = numDims + numSymbols, e = flattenedExpr.size() - 1;
            i < e; ++i) {
         auto localExpr = flattener.localExprs[i - numDims - numSymbols];
@@ -126,29 +193,49 @@ static void createSubviewBeforeLoopBand(AffineLoopBand band) {
           sizeExpr = sizeExpr + localExpr * factor;
         else if (!hasPointLoopVar && hasDynamicVar)
           offsetExpr = offsetExpr + localExpr * factor;
-        else if (hasPointLoopVar && hasDynamicVar)
-          return WalkResult::advance();
-        else
+        else if (hasPointLoopVar && hasDynamicVar) {
+          AffineExpr localOffsetExpr, localHaloExpr;
+          auto localHaloSize =
+              haloWindow && factor > 0
+                  ? splitHaloLocalExpr(localExpr, pointDims, numDims,
+                                       numSymbols, operands, localOffsetExpr,
+                                       localHaloExpr)
+                  : Optional<int64_t>();
+          if (!localHaloSize)
+            return WalkResult::advance();
+          offsetExpr = offsetExpr + localOffsetExpr * factor;
+          haloExpr = haloExpr + localHaloExpr * factor;
+          haloSize += (localHaloSize.value() - 1) * factor;
+        } else
           llvm_unreachable("unexpected local expression");
       }
 
-      // The stride is simply the largest divisor of the size-expr.
+      // The stride is simply the largest divisor of the size-expr. Halo
+      // windows are always accessed with a unit stride.
+      bool hasHalo = haloSize != 0;
       auto divisor = std::max((int64_t)1, sizeExpr.getLargestKnownDivisor());
+      if (hasHalo)
+        divisor = 1;
       bufStrides.push_back(b.getI64IntegerAttr(divisor));
 
       // Now we need to determine the size of the resulting memref.
       sizeExpr = sizeExpr.floorDiv(divisor);
-      accessExprs.push_back(sizeExpr);
       AffineValueMap sizeMap(AffineMap::get(numDims, numSymbols, sizeExpr),
                              operands);
       (void)sizeMap.canonicalize();
 
-      // Take the upper bound as the size of the current dimension.
+      // Take the upper bound as the size of the current dimension. With halo
+      // windows, a non-zero lower bound is folded into the offset.
       auto bounds = getBoundOfAffineMap(sizeMap.getAffineMap(),
                                         ValueRange(sizeMap.getOperands()));
-      if (!bounds.has_value() || bounds.value().first != 0)
+      if (!bounds.has_value() || (bounds.value().first != 0 && !haloWindow))
         return WalkResult::advance();
-      bufSizes.push_back(b.getI64IntegerAttr(bounds.value().second + 1));
+      auto minimum = bounds.value().first;
+      auto size = bounds.value().second - minimum + haloSize + 1;
+      sizeExpr = sizeExpr - minimum + haloExpr;
+      offsetExpr = offsetExpr + minimum * divisor;
+      accessExprs.push_back(sizeExpr);
+      bufSizes.push_back(b.getI64IntegerAttr(size));
 
       // Now we can construct the affine apply for the offset of the current
       // memory dimension.
@@ -158,6 +245,36 @@ static void createSubviewBeforeLoopBand(AffineLoopBand band) {
       auto offsetOp = b.create<AffineApplyOp>(loc, offsetMap.getAffineMap(),
                                               offsetMap.getOperands());
       bufOffsets.push_back(offsetOp.getResult());
+      if (!hasHalo)
+        continue;
+
+      // The halo window is sized for the worst case of all tiles, thus may
+      // run past the end of the memref in the tail tile. In that case, the
+      // offset is clamped such that the window ends at the boundary, and the
+      // access is rebased on the clamped offset. As the original access is in
+      // bounds, it always falls into the clamped window.
+      auto offsetBounds = getBoundOfAffineMap(
+          offsetMap.getAffineMap(), ValueRange(offsetMap.getOperands()));
+      if (offsetBounds.has_value() && !memrefType.isDynamicDim(memDim) &&
+          offsetBounds.value().second + size <= memrefType.getDimSize(memDim))
+        continue;
+      if (memrefType.isDynamicDim(memDim) ||
+          memrefType.getDimSize(memDim) < size)
+        return WalkResult::advance();
+
+      auto offsetMapExpr = offsetMap.getAffineMap().getResult(0);
+      auto clampedMap = AffineMap::get(
+          offsetMap.getAffineMap().getNumDims(),
+          offsetMap.getAffineMap().getNumSymbols(),
+          {offsetMapExpr, b.getAffineConstantExpr(
+                              memrefType.getDimSize(memDim) - size)},
+          b.getContext());
+      auto clampedOp =
+          b.create<AffineMinOp>(loc, clampedMap, offsetMap.getOperands());
+      bufOffsets.back() = clampedOp.getResult();
+      accessExprs.back() =
+          expr - b.getAffineDimExpr(numDims + clampedOffsets.size());
+      clampedOffsets.push_back(clampedOp.getResult());
     }
 
     // Finally, create the subview op with the constructed offsets (values
@@ -170,10 +287,21 @@ static void createSubviewBeforeLoopBand(AffineLoopBand band) {
       return use.getOwner() == op;
     });
 
-    // Update memory access maps of the current op.
+    // Update memory access maps of the current op. Clamped offsets are
+    // inserted between the original dimension and symbol operands.
     auto accessMap =
-        AffineMap::get(numDims, numSymbols, accessExprs, map.getContext());
+        AffineMap::get(numDims + clampedOffsets.size(), numSymbols,
+                       accessExprs, map.getContext());
     op->setAttr("map", AffineMapAttr::get(accessMap));
+    if (!clampedOffsets.empty()) {
+      auto numOtherOperands = op->getNumOperands() - operands.size();
+      SmallVector<Value, 8> newOperands(
+          op->getOperands().take_front(numOtherOperands));
+      newOperands.append(operands.begin(), operands.begin() + numDims);
+      newOperands.append(clampedOffsets.begin(), clampedOffsets.end());
+      newOperands.append(operands.begin() + numDims, operands.end());
+      op->setOperands(newOperands);
+    }
     return WalkResult::advance();
   });
 }
@@ -196,19 +324,20 @@ void CreateMemrefSubview::runOnOperation() {
       if (!getTileAndPointLoopBand(band, tileBand, pointBand) ||
           pointBand.empty())
         continue;
-      createSubviewBeforeLoopBand(pointBand);
+      createSubviewBeforeLoopBand(pointBand, haloWindow);
     } else if (createSubviewMode == CreateSubviewMode::Reduction) {
       AffineLoopBand parallelBand;
       AffineLoopBand reductionBand;
       if (!getParallelAndReductionLoopBand(band, parallelBand, reductionBand) ||
           reductionBand.empty())
         continue;
-      createSubviewBeforeLoopBand(reductionBand);
+      createSubviewBeforeLoopBand(reductionBand, haloWindow);
     }
   }
 }
 
 std::unique_ptr<Pass>
-scalehls::createCreateMemrefSubviewPass(CreateSubviewMode createSubviewMode) {
-  return std::make_unique<CreateMemrefSubview>(createSubviewMode);
+scalehls::createCreateMemrefSubviewPass(CreateSubviewMode createSubviewMode,
+                                        bool haloWindow) {
+  return std::make_unique<CreateMemrefSubview>(createSubviewMode, haloWindow);
 }
@@ -5,9 +5,11 @@
 //===----------------------------------------------------------------------===//
 
 #include "mlir/Dialect/Affine/Analysis/AffineAnalysis.h"
+#include "mlir/Dialect/Affine/Analysis/LoopAnalysis.h"
 #include "mlir/IR/Dominance.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "scalehls/Dialect/HLS/Utils.h"
+#include "scalehls/Transforms/Estimator.h"
 #include "scalehls/Transforms/Passes.h"
 #include "llvm/Support/Debug.h"
 
@@ -15,6 +17,7 @@
 
 using namespace mlir;
 using namespace scalehls;
+using namespace hls;
 
 /// Find a chain of commutative operators starting from "headOps" and ended with
 /// the "store". "headOps" is a list of single-use operations starting with "op"
@@ -74,8 +77,8 @@ static bool findCommutativeChain(Operation *op, AffineWriteOpInterface store,
 ///
 /// In this way, the distance between the source store and destination
 /// load is effectively reduced, such that potentially the initial
-/// interval can be reduced as well.
-/// TODO: It's possible to reshape the chain to a tree here.
+/// interval can be reduced as well. Under fast-math, a reduction chain can be
+/// further interleaved into partial accumulators, see interleaveReduction.
 
 /// "opsToMove" contains the operations to be moved along the "chain".
 static bool optimizeCommutativeChain(SmallVectorImpl<Operation *> &headOps,
@@ -117,9 +120,151 @@ static bool optimizeCommutativeChain(SmallVectorImpl<Operation *> &headOps,
   return true;
 }
 
+/// Return the identity value of the reduction. Only floating-point reductions
+/// are supported, as integer reductions are already finished in one cycle.
+static FloatAttr getReductionIdentity(Operation *op) {
+  auto type = op->getResult(0).getType();
+  if (isa<arith::AddFOp>(op))
+    return FloatAttr::get(type, 0.0);
+  if (isa<arith::MulFOp>(op))
+    return FloatAttr::get(type, 1.0);
+  return FloatAttr();
+}
+
+/// Interleave the loop-carried reduction from "dstLoad" to "srcStore" into
+/// "numPartials" accumulators, such that the dependency distance of the
+/// reduction becomes "numPartials" iterations. For example:
+///   for (i = 0; i < N; ++i)
+///     dst += A[i];
+///
+/// Is transformed to:
+///   partial[P] = {0, 0, ...};
+///   for (i = 0; i < N; ++i)
+///     partial[i % P] += A[i];
+///   dst += ((partial[0] + partial[1]) + (partial[2] + partial[3])) ...;
+///
+/// This reassociates the reduction, thus is only legal under fast-math.
+static void interleaveReduction(AffineForOp loop, AffineReadOpInterface dstLoad,
+                                AffineWriteOpInterface srcStore,
+                                Operation *reduceOp, FloatAttr identity,
+                                unsigned numPartials,
+                                PatternRewriter &rewriter) {
+  auto loc = loop.getLoc();
+  auto type = dstLoad.getValue().getType();
+
+  // Create the partial accumulator buffer and initialize it with the identity
+  // value of the reduction.
+  rewriter.setInsertionPoint(loop);
+  auto partialType = MemRefType::get({(int64_t)numPartials}, type);
+  auto partial = rewriter.create<BufferOp>(loc, partialType);
+  auto init = rewriter.create<arith::ConstantOp>(loc, identity);
+  for (unsigned i = 0; i < numPartials; ++i)
+    rewriter.create<AffineStoreOp>(loc, init, partial,
+                                   rewriter.getConstantAffineMap(i),
+                                   ValueRange());
+
+  // Redirect the loop-carried accesses to the accumulator indexed by the
+  // normalized induction variable modulo the number of accumulators.
+  auto iv = rewriter.getAffineDimExpr(0);
+  auto indexMap = AffineMap::get(
+      1, 0,
+      (iv - loop.getConstantLowerBound()).floorDiv(loop.getStep()) %
+          numPartials);
+  auto dstMemref = dstLoad.getMemRef();
+  auto dstMap = dstLoad.getAffineMap();
+  SmallVector<Value, 4> dstOperands(dstLoad.getMapOperands());
+  auto srcMap = srcStore.getAffineMap();
+  SmallVector<Value, 4> srcOperands(srcStore.getMapOperands());
+
+  rewriter.setInsertionPoint(dstLoad);
+  rewriter.replaceOpWithNewOp<AffineLoadOp>(dstLoad, partial, indexMap,
+                                            loop.getInductionVar());
+  rewriter.setInsertionPoint(srcStore);
+  rewriter.replaceOpWithNewOp<AffineStoreOp>(
+      srcStore, srcStore.getValueToStore(), partial, indexMap,
+      loop.getInductionVar());
+
+  // Combine all accumulators and the original value with a balanced tree after
+  // the loop, and write back the result.
+  rewriter.setInsertionPointAfter(loop);
+  SmallVector<Value, 16> values;
+  for (unsigned i = 0; i < numPartials; ++i)
+    values.push_back(rewriter.create<AffineLoadOp>(
+        loc, partial, rewriter.getConstantAffineMap(i), ValueRange()));
+  values.push_back(
+      rewriter.create<AffineLoadOp>(loc, dstMemref, dstMap, dstOperands));
+
+  while (values.size() > 1) {
+    SmallVector<Value, 16> newValues;
+    for (unsigned i = 0, e = values.size(); i < e; i += 2) {
+      if (i + 1 == e) {
+        newValues.push_back(values[i]);
+        continue;
+      }
+      auto combineOp = rewriter.clone(*reduceOp);
+      combineOp->setOperands({values[i], values[i + 1]});
+      newValues.push_back(combineOp->getResult(0));
+    }
+    values = std::move(newValues);
+  }
+  rewriter.create<AffineStoreOp>(loc, values.front(), dstMemref, srcMap,
+                                 srcOperands);
+}
+
 namespace {
 struct ReduceInitialIntervalPattern : public OpRewritePattern<AffineForOp> {
-  using OpRewritePattern<AffineForOp>::OpRewritePattern;
+  ReduceInitialIntervalPattern(MLIRContext *context, bool fastMath,
+                               unsigned numPartials,
+                               llvm::StringMap<int64_t> &latencyMap)
+      : OpRewritePattern<AffineForOp>(context), fastMath(fastMath),
+        numPartials(numPartials), latencyMap(latencyMap) {}
+
+  /// Try to interleave the reduction chain into partial accumulators. The
+  /// number of accumulators is set to the latency of the reduction operator
+  /// if not specified, which is enough to achieve an II of one.
+  bool tryInterleaveReduction(AffineForOp loop, AffineReadOpInterface dstLoad,
+                              AffineWriteOpInterface srcStore,
+                              ArrayRef<Operation *> headOps,
+                              ArrayRef<Operation *> chainOps,
+                              PatternRewriter &rewriter) const {
+    if (!fastMath || headOps.size() != 1 || chainOps.empty() ||
+        !loop.getOps<AffineForOp>().empty() ||
+        !loop.hasConstantLowerBound())
+      return false;
+
+    // All operators on the chain must be the same associative reduction, and
+    // the intermediate results must not be used outside of the chain.
+    auto reduceOp = chainOps.front();
+    auto identity = getReductionIdentity(reduceOp);
+    if (!identity || llvm::any_of(chainOps, [&](Operation *op) {
+          return op->getName() != reduceOp->getName() || !op->hasOneUse();
+        }))
+      return false;
+
+    // The reduction target must be invariant to the loop and only accessed by
+    // the load and store in the loop.
+    auto isDefinedOutside = [&](Value v) {
+      return loop.isDefinedOutsideOfLoop(v);
+    };
+    if (!llvm::all_of(dstLoad.getMapOperands(), isDefinedOutside) ||
+        !llvm::all_of(srcStore.getMapOperands(), isDefinedOutside) ||
+        llvm::any_of(dstLoad.getMemRef().getUsers(), [&](Operation *user) {
+          return loop->isProperAncestor(user) && user != dstLoad &&
+                 user != srcStore;
+        }))
+      return false;
+
+    auto factor = numPartials ? (int64_t)numPartials
+                              : latencyMap.lookup(getOperatorKey(reduceOp));
+    if (auto tripCount = getConstantTripCount(loop))
+      factor = std::min(factor, (int64_t)tripCount.value());
+    if (factor <= 1)
+      return false;
+
+    interleaveReduction(loop, dstLoad, srcStore, reduceOp, identity, factor,
+                        rewriter);
+    return true;
+  }
 
   LogicalResult matchAndRewrite(AffineForOp loop,
                                 PatternRewriter &rewriter) const override {
@@ -136,7 +281,8 @@ struct ReduceInitialIntervalPattern : public OpRewritePattern<AffineForOp> {
 
       // Only if a load depends on a dominated store (a back dependence), the
       // associated II constraint is possible to be optimized.
-      for (unsigned i = 0, e = accesses.size(); i < e; ++i) {
+      bool hasInterleaved = false;
+      for (unsigned i = 0, e = accesses.size(); i < e && !hasInterleaved; ++i) {
         auto dstLoad = dyn_cast<AffineReadOpInterface>(accesses[i]);
         if (!dstLoad)
           continue;
@@ -154,11 +300,18 @@ struct ReduceInitialIntervalPattern : public OpRewritePattern<AffineForOp> {
 
           SmallVector<Operation *, 32> chainOps;
           SmallVector<Operation *, 4> headOps({dstLoad});
-          if (findCommutativeChain(dstLoad, srcStore, headOps, chainOps))
+          if (findCommutativeChain(dstLoad, srcStore, headOps, chainOps)) {
+            if (tryInterleaveReduction(loop, dstLoad, srcStore, headOps,
+                                       chainOps, rewriter)) {
+              LLVM_DEBUG(llvm::dbgs() << "Interleave succeeded\n");
+              hasChanged = hasInterleaved = true;
+              break;
+            }
             if (optimizeCommutativeChain(headOps, chainOps, rewriter)) {
               LLVM_DEBUG(llvm::dbgs() << "Optimize succeeded\n");
               hasChanged = true;
             }
+          }
 
           // We only consider the first dominated store op.
           break;
@@ -167,22 +320,39 @@ struct ReduceInitialIntervalPattern : public OpRewritePattern<AffineForOp> {
     }
     return success(hasChanged);
   }
+
+private:
+  bool fastMath;
+  unsigned numPartials;
+  llvm::StringMap<int64_t> &latencyMap;
 };
 } //  namespace
 
 namespace {
 struct ReduceInitialInterval
     : public ReduceInitialIntervalBase<ReduceInitialInterval> {
+  ReduceInitialInterval() = default;
+  ReduceInitialInterval(bool argFastMath, unsigned argNumPartials) {
+    fastMath = argFastMath;
+    numPartials = argNumPartials;
+  }
+
   void runOnOperation() override {
     auto func = getOperation();
+    llvm::json::Object configObj;
+    llvm::StringMap<int64_t> latencyMap;
+    getLatencyMap(&configObj, latencyMap);
+
     mlir::RewritePatternSet patterns(func.getContext());
-    patterns.add<ReduceInitialIntervalPattern>(func.getContext());
+    patterns.add<ReduceInitialIntervalPattern>(func.getContext(), fastMath,
+                                               numPartials, latencyMap);
     (void)applyPatternsAndFoldGreedily(func, std::move(patterns),
                                        {false, true, 1});
   }
 };
 } // namespace
 
-std::unique_ptr<Pass> scalehls::createReduceInitialIntervalPass() {
-  return std::make_unique<ReduceInitialInterval>();
+std::unique_ptr<Pass>
+scalehls::createReduceInitialIntervalPass(bool fastMath, unsigned numPartials) {
+  return std::make_unique<ReduceInitialInterval>(fastMath, numPartials);
 }
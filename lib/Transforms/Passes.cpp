@@ -59,8 +59,8 @@ void scalehls::registerScaleHLSDSEPipeline() {
 }
 
 void scalehls::addCreateSubviewPasses(OpPassManager &pm,
-                                      CreateSubviewMode mode) {
-  pm.addPass(scalehls::createCreateMemrefSubviewPass(mode));
+                                      CreateSubviewMode mode, bool haloWindow) {
+  pm.addPass(scalehls::createCreateMemrefSubviewPass(mode, haloWindow));
   pm.addPass(mlir::createCSEPass());
   pm.addPass(mlir::createCanonicalizerPass());
 }
@@ -107,6 +107,16 @@ struct ScaleFlowPyTorchPipelineOptions
       *this, "correlation-aware", llvm::cl::init(true),
       llvm::cl::desc("Whether to consider node correlation in the transform")};
 
+  Option<bool> opAware{
+      *this, "op-aware", llvm::cl::init(false),
+      llvm::cl::desc("Weight node complexity with operator latency and memory "
+                     "ports")};
+
+  Option<std::string> targetSpec{
+      *this, "target-spec", llvm::cl::init(""),
+      llvm::cl::desc("File path: target backend specifications used by the "
+                     "estimators")};
+
   Option<bool> placeExternalBuffer{
       *this, "place-external-buffer", llvm::cl::init(true),
       llvm::cl::desc("Place buffers in external memories")};
@@ -115,6 +125,58 @@ struct ScaleFlowPyTorchPipelineOptions
       *this, "balance-dataflow", llvm::cl::init(true),
       llvm::cl::desc("Whether to balance the dataflow")};
 
+  Option<bool> haloWindow{
+      *this, "halo-window", llvm::cl::init(false),
+      llvm::cl::desc("Create local buffers for overlapping sliding windows")};
+
+  Option<bool> lineBuffer{
+      *this, "line-buffer", llvm::cl::init(false),
+      llvm::cl::desc("Create line buffers for stencil access patterns")};
+
+  Option<bool> doubleBuffer{
+      *this, "double-buffer", llvm::cl::init(false),
+      llvm::cl::desc("Ping-pong local buffers to overlap tile transfers")};
+
+  Option<unsigned> bramBudget{
+      *this, "bram-budget", llvm::cl::init(0),
+      llvm::cl::desc("The BRAM18K budget of double buffering and buffer "
+                     "duplication (set 0 to disable the budget)")};
+
+  Option<bool> costAwareLegalize{
+      *this, "cost-aware-legalize", llvm::cl::init(false),
+      llvm::cl::desc("Duplicate or copy buffers instead of merging dataflow "
+                     "nodes when the estimated II is reduced")};
+
+  Option<bool> splitIterSpace{
+      *this, "split-iter-space", llvm::cl::init(false),
+      llvm::cl::desc("Split the iteration space into full tiles plus a "
+                     "remainder when removing variable loop bounds")};
+
+  Option<bool> fastMath{
+      *this, "fast-math", llvm::cl::init(false),
+      llvm::cl::desc("Reassociate floating-point reductions into partial "
+                     "accumulators to reduce the II")};
+
+  Option<unsigned> numPartials{
+      *this, "num-partials", llvm::cl::init(0),
+      llvm::cl::desc("The number of partial accumulators of each reduction "
+                     "under fast-math (set 0 to use the operator latency)")};
+
+  Option<bool> estimatorAwareInline{
+      *this, "estimator-aware-inline", llvm::cl::init(false),
+      llvm::cl::desc("Inline dataflow nodes with the estimator when "
+                     "converting dataflow to functions")};
+
+  Option<unsigned> maxCallOverhead{
+      *this, "max-call-overhead", llvm::cl::init(1),
+      llvm::cl::desc("The maximum percentage of the call overhead in the "
+                     "latency of an outlined node")};
+
+  Option<bool> dedupFuncs{
+      *this, "dedup-funcs", llvm::cl::init(false),
+      llvm::cl::desc("Merge structurally equivalent functions after "
+                     "converting dataflow to functions")};
+
   Option<bool> axiInterface{*this, "axi-interface", llvm::cl::init(true),
                             llvm::cl::desc("Create AXI interface")};
 
@@ -230,8 +292,11 @@ void scalehls::registerScaleFlowPyTorchPipeline() {
           return;
 
         // Local buffer allocation.
-        scalehls::addCreateSubviewPasses(pm);
-        pm.addPass(scalehls::createCreateLocalBufferPass());
+        scalehls::addCreateSubviewPasses(pm, CreateSubviewMode::Point,
+                                         opts.haloWindow);
+        pm.addPass(scalehls::createCreateLocalBufferPass(
+            /*externalBufferOnly=*/true, /*registerOnly=*/false,
+            opts.doubleBuffer, opts.bramBudget));
         pm.addPass(scalehls::createLowerCopyToAffinePass());
         pm.addPass(memref::createFoldMemRefAliasOpsPass());
         pm.addPass(mlir::createSimplifyAffineStructuresPass());
@@ -264,12 +329,18 @@ void scalehls::registerScaleFlowPyTorchPipeline() {
         if (opts.debugPoint == 10)
           return;
 
+        // Create line buffers before the stencil loops are unrolled.
+        if (opts.lineBuffer)
+          pm.addPass(scalehls::createCreateLineBufferPass());
+
         // Parallelize dataflow.
         pm.addPass(scalehls::createParallelizeDataflowNodePass(
             opts.loopUnrollFactor, /*unrollPointLoopOnly=*/true,
-            opts.complexityAware, opts.correlationAware));
+            opts.complexityAware, opts.correlationAware, opts.opAware,
+            opts.targetSpec));
         pm.addPass(mlir::createSimplifyAffineStructuresPass());
-        pm.addPass(scalehls::createLegalizeDataflowPass());
+        pm.addPass(scalehls::createLegalizeDataflowPass(
+            opts.costAwareLegalize, opts.bramBudget, opts.targetSpec));
         pm.addPass(mlir::createCanonicalizerPass());
 
         if (opts.debugPoint == 11)
@@ -278,7 +349,10 @@ void scalehls::registerScaleFlowPyTorchPipeline() {
         // Memory optimization.
         pm.addPass(scalehls::createSimplifyAffineIfPass());
         pm.addPass(scalehls::createAffineStoreForwardPass());
-        pm.addPass(scalehls::createReduceInitialIntervalPass());
+        if (opts.fastMath)
+          pm.addPass(scalehls::createMaterializeReductionPass());
+        pm.addPass(scalehls::createReduceInitialIntervalPass(opts.fastMath,
+                                                             opts.numPartials));
         pm.addPass(mlir::createCanonicalizerPass());
 
         if (opts.debugPoint == 12)
@@ -286,7 +360,11 @@ void scalehls::registerScaleFlowPyTorchPipeline() {
 
         // Convert dataflow to func.
         pm.addPass(scalehls::createCreateTokenStreamPass());
-        pm.addPass(scalehls::createConvertDataflowToFuncPass());
+        pm.addPass(scalehls::createConvertDataflowToFuncPass(
+            /*splitExternalAccess=*/true, opts.estimatorAwareInline,
+            opts.maxCallOverhead, opts.targetSpec));
+        if (opts.dedupFuncs)
+          pm.addPass(scalehls::createFuncDeduplicationPass());
         pm.addPass(mlir::createCanonicalizerPass());
 
         if (opts.debugPoint == 13)
@@ -332,7 +410,9 @@ void scalehls::registerScaleFlowPyTorchPipelinePost() {
 
         // Convert dataflow to func.
         pm.addPass(scalehls::createCreateTokenStreamPass());
-        pm.addPass(scalehls::createConvertDataflowToFuncPass());
+        pm.addPass(scalehls::createConvertDataflowToFuncPass(
+            /*splitExternalAccess=*/true, opts.estimatorAwareInline,
+            opts.maxCallOverhead, opts.targetSpec));
         pm.addPass(mlir::createCanonicalizerPass());
 
         if (opts.debugPoint == 13)
@@ -390,7 +470,8 @@ void scalehls::registerScaleFlowCppPipeline() {
         pm.addPass(scalehls::createFuncPreprocessPass(opts.hlsTopFunc));
         // pm.addPass(bufferization::createBufferLoopHoistingPass());
         pm.addPass(scalehls::createAffineLoopPerfectionPass());
-        pm.addPass(scalehls::createRemoveVariableBoundPass());
+        pm.addPass(
+            scalehls::createRemoveVariableBoundPass(opts.splitIterSpace));
         pm.addPass(scalehls::createAffineLoopOrderOptPass());
         // pm.addPass(scalehls::createAffineLoopTilePass(opts.loopTileSize));
         pm.addPass(mlir::createSimplifyAffineStructuresPass());
@@ -437,7 +518,8 @@ void scalehls::registerScaleFlowCppPipeline() {
         if (opts.loopUnrollFactor) {
           pm.addPass(scalehls::createParallelizeDataflowNodePass(
               opts.loopUnrollFactor, /*unrollPointLoopOnly=*/true,
-              opts.complexityAware, opts.correlationAware));
+              opts.complexityAware, opts.correlationAware, opts.opAware,
+              opts.targetSpec));
           pm.addPass(mlir::createSimplifyAffineStructuresPass());
           pm.addPass(mlir::createCanonicalizerPass());
         }
@@ -456,7 +538,9 @@ void scalehls::registerScaleFlowCppPipeline() {
 
         // Convert dataflow to func.
         pm.addPass(scalehls::createCreateTokenStreamPass());
-        pm.addPass(scalehls::createConvertDataflowToFuncPass());
+        pm.addPass(scalehls::createConvertDataflowToFuncPass(
+            /*splitExternalAccess=*/true, opts.estimatorAwareInline,
+            opts.maxCallOverhead, opts.targetSpec));
         pm.addPass(mlir::createCanonicalizerPass());
 
         if (opts.debugPoint == 13)
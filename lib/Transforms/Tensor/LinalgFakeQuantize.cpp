@@ -4,6 +4,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "mlir/IR/AsmState.h"
 #include "mlir/Transforms/GreedyPatternRewriteDriver.h"
 #include "scalehls/Transforms/Passes.h"
 
@@ -87,12 +88,25 @@ struct LinalgFakeQuantize : public LinalgFakeQuantizeBase<LinalgFakeQuantize> {
   }
 
   template <typename ValueType>
-  DenseIntElementsAttr generateRandomValues(Type quanType, unsigned size) {
+  TypedAttr generateRandomValues(Type quanType, unsigned size) {
     unsigned maxValue = std::pow(2, quanBits.getValue());
-    SmallVector<ValueType, 64> values;
+    if (!resourceWeights) {
+      SmallVector<ValueType, 64> values;
+      for (unsigned i = 0; i < size; ++i)
+        values.push_back(std::rand() % maxValue);
+      return DenseIntElementsAttr::get(quanType, values);
+    }
+
+    // Values are directly generated into the blob, which is owned by the
+    // resource manager of the context rather than being uniqued.
+    auto blob = HeapAsmResourceBlob::allocate(size * sizeof(ValueType),
+                                              alignof(ValueType));
+    auto data = reinterpret_cast<ValueType *>(blob.getMutableData().data());
     for (unsigned i = 0; i < size; ++i)
-      values.push_back(std::rand() % maxValue);
-    return DenseIntElementsAttr::get(quanType, values);
+      data[i] = std::rand() % maxValue;
+    return DenseResourceElementsAttr::get(quanType.cast<ShapedType>(),
+                                          "fake_weight", std::move(blob))
+        .cast<TypedAttr>();
   }
 
   void runOnOperation() override {
@@ -128,22 +142,23 @@ struct LinalgFakeQuantize : public LinalgFakeQuantizeBase<LinalgFakeQuantize> {
 
           // Convert tensor typed constant values. At this point, we have known
           // that the tensor has floating-point elements.
-          if (constant.getValue().getType().isa<RankedTensorType>()) {
-            auto denseAttr = constant.getValue().cast<DenseElementsAttr>();
-            DenseIntElementsAttr attr;
+          if (auto tensorType =
+                  constant.getValue().getType().dyn_cast<RankedTensorType>()) {
+            auto size = tensorType.getNumElements();
+            TypedAttr attr;
 
             switch (quanBits.getValue()) {
             case 8:
-              attr = generateRandomValues<int8_t>(quanType, denseAttr.size());
+              attr = generateRandomValues<int8_t>(quanType, size);
               break;
             case 16:
-              attr = generateRandomValues<int16_t>(quanType, denseAttr.size());
+              attr = generateRandomValues<int16_t>(quanType, size);
               break;
             case 32:
-              attr = generateRandomValues<int32_t>(quanType, denseAttr.size());
+              attr = generateRandomValues<int32_t>(quanType, size);
               break;
             case 64:
-              attr = generateRandomValues<int64_t>(quanType, denseAttr.size());
+              attr = generateRandomValues<int64_t>(quanType, size);
               break;
             default:
               return WalkResult::interrupt();
@@ -46,12 +46,11 @@ struct TosaFakeQuantize : public TosaFakeQuantizeBase<TosaFakeQuantize> {
 
           if (auto constant = dyn_cast<tosa::ConstOp>(op)) {
             // Because we are not trying to really quantize the model, here we
-            // just assign a fake value to the constant operation.
-            SmallVector<int8_t, 64> list(constant.getValue().size(), fakeIdx++);
-            // for (auto value : constant.valueAttr().getValues<float>())
-            //   list.push_back(value);
-
-            auto quantValue = DenseIntElementsAttr::get(quantType, list);
+            // just assign a fake value to the constant operation. The value is
+            // directly created as a splat, such that no buffer of the size of
+            // the weight is ever allocated.
+            auto quantValue = DenseElementsAttr::get(
+                quantType.cast<ShapedType>(), fakeIdx++);
             constant->setAttr(constant.getValueAttrName(), quantValue);
           }
 
@@ -12,6 +12,9 @@
 #include "scalehls/Dialect/HLS/Utils.h"
 #include "scalehls/Dialect/HLS/Visitor.h"
 #include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace mlir;
@@ -21,6 +24,14 @@ static llvm::cl::opt<bool> emitVitisDirectives("emit-vitis-directives",
                                                llvm::cl::init(false));
 static llvm::cl::opt<bool> enforceFalseDependency("enforce-false-dependency",
                                                   llvm::cl::init(false));
+static llvm::cl::opt<std::string> emitWeightDir("emit-weight-dir",
+                                                llvm::cl::init(""));
+static llvm::cl::opt<std::string> emitWeightFormat("emit-weight-format",
+                                                   llvm::cl::init("dat"));
+static llvm::cl::opt<unsigned> emitWeightThreshold("emit-weight-threshold",
+                                                   llvm::cl::init(1024));
+static llvm::cl::opt<bool> emitTestbench("emit-testbench",
+                                         llvm::cl::init(false));
 
 //===----------------------------------------------------------------------===//
 // Utils
@@ -167,6 +178,21 @@ SmallString<8> ScaleHLSEmitterBase::addAlias(Value val, Value alias) {
   return valName;
 }
 
+/// Return the macro defined in math.h for the non-finite floating-point value.
+static StringRef getNonFiniteString(double value) {
+  if (std::isnan(value))
+    return "NAN";
+  return value > 0 ? "INFINITY" : "-INFINITY";
+}
+
+/// Write the floating-point value with enough digits to be read back exactly.
+static void writeFloat(raw_ostream &os, double value, bool isDouble) {
+  if (std::isfinite(value))
+    os << llvm::format(isDouble ? "%.17g" : "%.9g", value);
+  else
+    os << getNonFiniteString(value);
+}
+
 static SmallString<8> getConstantString(Type type, Attribute attr) {
   SmallString<8> string;
   if (type.isInteger(1)) {
@@ -182,15 +208,13 @@ static SmallString<8> getConstantString(Type type, Attribute attr) {
     if (floatType.getWidth() == 32) {
       string.append("(float)");
       auto value = attr.cast<FloatAttr>().getValue().convertToFloat();
-      string.append(std::isfinite(value)
-                        ? std::to_string(value)
-                        : (value > 0 ? "INFINITY" : "-INFINITY"));
+      string.append(std::isfinite(value) ? std::to_string(value)
+                                         : getNonFiniteString(value).str());
     } else if (floatType.getWidth() == 64) {
       string.append("(double)");
       auto value = attr.cast<FloatAttr>().getValue().convertToDouble();
-      string.append(std::isfinite(value)
-                        ? std::to_string(value)
-                        : (value > 0 ? "INFINITY" : "-INFINITY"));
+      string.append(std::isfinite(value) ? std::to_string(value)
+                                         : getNonFiniteString(value).str());
     }
   } else if (auto intType = type.dyn_cast<IntegerType>()) {
     std::string signedness = "";
@@ -215,6 +239,93 @@ static SmallString<8> getConstantString(Type type, Attribute attr) {
   return string;
 }
 
+/// Return whether the elements of the type can be written into an external
+/// weight file, i.e., the type is f32, f64, integer, or index.
+static bool isWritableElementType(Type type) {
+  return type.isF32() || type.isF64() || type.isIntOrIndex();
+}
+
+/// Write the elements of a non-splat dense attribute into a comma-separated
+/// list, which can be included as the initializer of a C++ array. Elements are
+/// accessed with their native types instead of being wrapped as attributes.
+/// Return false if the element type is not supported.
+static bool writeDenseElements(raw_ostream &os, DenseElementsAttr attr) {
+  auto type = attr.getElementType();
+  if (!isWritableElementType(type))
+    return false;
+  int64_t elementIdx = 0;
+  auto writeSeparator = [&]() {
+    if (elementIdx++ != 0)
+      os << (elementIdx % 16 == 1 ? ",\n" : ", ");
+  };
+
+  if (type.isF32()) {
+    for (auto value : attr.getValues<float>()) {
+      writeSeparator();
+      writeFloat(os, value, /*isDouble=*/false);
+    }
+  } else if (type.isF64()) {
+    for (auto value : attr.getValues<double>()) {
+      writeSeparator();
+      writeFloat(os, value, /*isDouble=*/true);
+    }
+  } else {
+    for (auto value : attr.getValues<APInt>()) {
+      writeSeparator();
+      if (type.isUnsignedInteger() || type.isInteger(1))
+        os << value.getZExtValue();
+      else
+        os << value.getSExtValue();
+    }
+  }
+  os << "\n";
+  return true;
+}
+
+/// Write the elements of a dense resource blob into a comma-separated list. The
+/// elements are densely packed with their natural sizes, where i1 elements
+/// take one byte. Return false if the element type is not supported.
+static bool writeRawElements(raw_ostream &os, Type type, ArrayRef<char> data) {
+  if (!isWritableElementType(type))
+    return false;
+  unsigned width = type.isIndex() ? 64 : type.getIntOrFloatBitWidth();
+  if (width == 1)
+    width = 8;
+  if (width % 8 != 0 || !llvm::isPowerOf2_32(width) || width > 64)
+    return false;
+  auto numBytes = width / 8;
+  bool isUnsigned = type.isUnsignedInteger() || type.isInteger(1);
+
+  for (size_t offset = 0, idx = 0; offset + numBytes <= data.size();
+       offset += numBytes, ++idx) {
+    if (idx != 0)
+      os << (idx % 16 == 0 ? ",\n" : ", ");
+    auto ptr = data.data() + offset;
+
+    if (type.isF32() || type.isF64()) {
+      double value;
+      if (type.isF32()) {
+        float floatValue;
+        memcpy(&floatValue, ptr, sizeof(float));
+        value = floatValue;
+      } else
+        memcpy(&value, ptr, sizeof(double));
+      writeFloat(os, value, type.isF64());
+      continue;
+    }
+
+    uint64_t bits = 0;
+    memcpy(&bits, ptr, numBytes);
+    auto value = APInt(numBytes * 8, bits);
+    if (isUnsigned)
+      os << value.getZExtValue();
+    else
+      os << value.getSExtValue();
+  }
+  os << "\n";
+  return true;
+}
+
 SmallString<8> ScaleHLSEmitterBase::getName(Value val) {
   // For constant scalar operations, the constant number will be returned rather
   // than the value name.
@@ -241,10 +352,12 @@ public:
 
   /// HLS dialect operation emitters.
   void emitConstBuffer(ConstBufferOp op);
+  void emitPingPongBuffer(BufferOp op);
   void emitStreamChannel(StreamOp op);
   void emitStreamRead(StreamReadOp op);
   void emitStreamWrite(StreamWriteOp op);
   void emitAxiPort(AxiPortOp op);
+  void emitAxiPack(AxiPackOp op);
   void emitPrimMul(PrimMulOp op);
   template <typename AssignOpType> void emitAssign(AssignOpType op);
   void emitAffineSelect(hls::AffineSelectOp op);
@@ -288,6 +401,9 @@ public:
   /// Special expression emitters.
   void emitSelect(arith::SelectOp op);
   template <typename OpType> void emitConstant(OpType op);
+  void emitExternalConstant(Operation *op, Value array, ElementsAttr attr);
+  void emitResourceConstant(Operation *op, Value array,
+                            DenseResourceElementsAttr attr);
 
   /// Top-level MLIR module emitter.
   void emitModule(ModuleOp module);
@@ -311,6 +427,9 @@ private:
   void emitArrayDirectives(Value memref);
   void emitFunctionDirectives(func::FuncOp func, ArrayRef<Value> portList);
   void emitFunction(func::FuncOp func);
+  void emitTestbenchPort(Value port);
+  void emitTestbenchData(Value port, StringRef helper, StringRef fileName);
+  void emitTestbench(func::FuncOp func);
 };
 } // namespace
 
@@ -411,6 +530,8 @@ public:
   bool visitOp(BufferOp op) {
     if (op.getDepth() == 1)
       return emitter.emitAlloc(op), true;
+    if (!isExternalBuffer(op.getMemref()))
+      return emitter.emitPingPongBuffer(op), true;
     return op.emitOpError("only support depth of 1"), false;
   }
   bool visitOp(ConstBufferOp op) { return emitter.emitConstBuffer(op), true; }
@@ -419,7 +540,7 @@ public:
   bool visitOp(StreamWriteOp op) { return emitter.emitStreamWrite(op), true; }
   bool visitOp(AxiBundleOp op) { return true; }
   bool visitOp(AxiPortOp op) { return emitter.emitAxiPort(op), true; }
-  bool visitOp(AxiPackOp op) { return false; }
+  bool visitOp(AxiPackOp op) { return emitter.emitAxiPack(op), true; }
   bool visitOp(PrimMulOp op) { return emitter.emitPrimMul(op), true; }
   bool visitOp(PrimCastOp op) { return emitter.emitAssign(op), true; }
   bool visitOp(hls::AffineSelectOp op) {
@@ -634,6 +755,17 @@ void ModuleEmitter::emitConstBuffer(ConstBufferOp op) {
   emitArrayDirectives(op.getResult());
 }
 
+/// On-chip buffers with a depth larger than one are ping-pong buffers between
+/// dataflow processes, which are implemented as PIPOs by the HLS tool.
+void ModuleEmitter::emitPingPongBuffer(BufferOp op) {
+  emitAlloc(op);
+  if (emitVitisDirectives.getValue()) {
+    indent() << "#pragma HLS stream variable=";
+    emitValue(op.getMemref());
+    os << " type=pipo depth=" << op.getDepth() << "\n";
+  }
+}
+
 void ModuleEmitter::emitStreamChannel(StreamOp op) {
   indent();
   emitValue(op.getChannel());
@@ -710,6 +842,12 @@ void ModuleEmitter::emitAxiPort(AxiPortOp op) {
   os << "\n";
 }
 
+/// AXI packs only appear in the runtime function, where the packed value is
+/// directly passed to the top function.
+void ModuleEmitter::emitAxiPack(AxiPackOp op) {
+  addAlias(op.getValue(), op.getAxi());
+}
+
 void ModuleEmitter::emitPrimMul(PrimMulOp op) {
   if (op.isPackMul()) {
     // Declare the result C array.
@@ -1532,6 +1670,10 @@ template <typename OpType> void ModuleEmitter::emitConstant(OpType op) {
     return;
 
   if (auto denseAttr = op.getValue().template dyn_cast<DenseElementsAttr>()) {
+    if (!emitWeightDir.empty() &&
+        denseAttr.getNumElements() >= emitWeightThreshold)
+      return emitExternalConstant(op, op.getResult(), denseAttr);
+
     indent();
     emitArrayDecl(op.getResult());
     os << " = {";
@@ -1549,10 +1691,140 @@ template <typename OpType> void ModuleEmitter::emitConstant(OpType op) {
     }
     os << "};";
     emitInfoAndNewLine(op);
+  } else if (auto resourceAttr =
+                 op.getValue()
+                     .template dyn_cast<DenseResourceElementsAttr>()) {
+    emitResourceConstant(op, op.getResult(), resourceAttr);
   } else
     emitError(op, "has unsupported constant type.");
 }
 
+/// Emit a constant array whose elements are stored in a dense resource blob.
+/// The blob is never converted into a dense attribute, but directly written
+/// into the initializer list or the external weight file.
+void ModuleEmitter::emitResourceConstant(Operation *op, Value array,
+                                         DenseResourceElementsAttr attr) {
+  auto blob = attr.getRawHandle().getBlob();
+  if (!blob) {
+    emitError(op, Twine("has unavailable resource ") +
+                      attr.getRawHandle().getKey());
+    return;
+  }
+  if (!emitWeightDir.empty() && attr.getNumElements() >= emitWeightThreshold)
+    return emitExternalConstant(op, array, attr);
+
+  indent();
+  emitArrayDecl(array);
+  os << " = {\n";
+  if (!writeRawElements(os, attr.getElementType(), blob->getData()))
+    emitError(op, "has unsupported resource element type.");
+  indent() << "};";
+  emitInfoAndNewLine(op);
+}
+
+/// Emit a large constant array, whose elements are written into an external
+/// file under "emit-weight-dir" rather than an inline initializer list. With
+/// the "dat" format, the file is included as the initializer of the array,
+/// which is synthesizable as a ROM. With the "bin" format, the raw data of the
+/// attribute is dumped and loaded at runtime, which is only for C simulation.
+/// Both dense and dense resource attributes are supported.
+void ModuleEmitter::emitExternalConstant(Operation *op, Value array,
+                                         ElementsAttr attr) {
+  auto type = attr.getElementType();
+  auto denseAttr = attr.dyn_cast<DenseElementsAttr>();
+  auto resourceAttr = attr.dyn_cast<DenseResourceElementsAttr>();
+  assert((denseAttr || resourceAttr) && "unexpected elements attribute");
+
+  // Splat constants are initialized by a loop, such that the elements are
+  // never iterated in the emitter.
+  if (denseAttr && denseAttr.isSplat()) {
+    auto string =
+        getConstantString(type, denseAttr.getSplatValue<Attribute>());
+    if (string.empty())
+      op->emitOpError("constant has invalid value");
+    auto rank = emitNestedLoopHeader(array);
+    indent();
+    emitValue(array, rank);
+    os << " = " << string << ";";
+    emitInfoAndNewLine(op);
+    emitNestedLoopFooter(rank);
+    return;
+  }
+
+  // Other element types, e.g., f16 and bf16, have no native C++ type whose
+  // values can be written, which would otherwise leave the ROM zero-filled.
+  if (!isWritableElementType(type)) {
+    emitError(op, "has unsupported weight element type.");
+    return;
+  }
+
+  // The raw data can be directly dumped only if its layout is identical to the
+  // C++ array, which holds for float and double types.
+  bool isBinary = emitWeightFormat == "bin" && (type.isF32() || type.isF64());
+  if (!isBinary && emitWeightFormat != "dat" && emitWeightFormat != "bin") {
+    emitError(op, "has unknown weight format " + emitWeightFormat.getValue());
+    return;
+  }
+
+  indent();
+  emitArrayDecl(array);
+  auto func = op->getParentOfType<func::FuncOp>();
+  SmallString<128> path(emitWeightDir.getValue());
+  llvm::sys::path::append(path, func.getName() + "_" + getName(array) +
+                                    (isBinary ? ".bin" : ".dat"));
+
+  // The path is made absolute, such that the weight file can be found by the
+  // include directive and the loader no matter where the generated C++ file is
+  // placed and run.
+  if (auto error = llvm::sys::fs::make_absolute(path)) {
+    emitError(op, Twine("failed to resolve ") + path + ": " + error.message());
+    return;
+  }
+
+  std::error_code error;
+  llvm::raw_fd_ostream file(path, error, llvm::sys::fs::OF_None);
+  if (error) {
+    emitError(op, Twine("failed to open ") + path + ": " + error.message());
+    return;
+  }
+
+  if (isBinary) {
+    auto rawData = denseAttr ? denseAttr.getRawData()
+                             : resourceAttr.getRawHandle().getBlob()->getData();
+    file.write(rawData.data(), rawData.size());
+    os << ";";
+    emitInfoAndNewLine(op);
+    os << "#ifndef __SYNTHESIS__\n";
+    indent() << "{\n";
+    addIndent();
+    indent() << "FILE *file = fopen(\"" << path << "\", \"rb\");\n";
+    indent() << "if (!file || fread(" << getName(array) << ", sizeof("
+             << getName(array) << "), 1, file) != 1) {\n";
+    addIndent();
+    indent() << "fprintf(stderr, \"failed to load " << path << "\\n\");\n";
+    indent() << "exit(EXIT_FAILURE);\n";
+    reduceIndent();
+    indent() << "}\n";
+    indent() << "fclose(file);\n";
+    reduceIndent();
+    indent() << "}\n";
+    os << "#endif\n";
+  } else {
+    bool success = false;
+    if (denseAttr)
+      success = writeDenseElements(file, denseAttr);
+    else
+      success = writeRawElements(
+          file, type, resourceAttr.getRawHandle().getBlob()->getData());
+    if (!success)
+      emitError(op, "has unsupported weight element type.");
+    os << " = {\n";
+    os << "#include \"" << path << "\"\n";
+    indent() << "};";
+    emitInfoAndNewLine(op);
+  }
+}
+
 /// C++ component emitters.
 void ModuleEmitter::emitValue(Value val, unsigned rank, bool isPtr,
                               bool isRef) {
@@ -1952,6 +2224,164 @@ void ModuleEmitter::emitFunction(func::FuncOp func) {
   os << "\n";
 }
 
+/// Declare a port of the top function in the testbench. Arrays are declared as
+/// static to avoid overflowing the stack with large inputs.
+void ModuleEmitter::emitTestbenchPort(Value port) {
+  auto type = port.getType().dyn_cast<ShapedType>();
+  if (port.getType().isa<StreamType, AxiType>() ||
+      (type && !type.hasStaticShape())) {
+    emitError(port.getParentBlock()->getParentOp(),
+              "has unsupported testbench port type");
+    return;
+  }
+
+  indent() << "static ";
+  if (isDeclared(port)) {
+    os << getTypeName(port) << " " << getName(port);
+    if (type)
+      for (auto &shape : type.getShape())
+        os << "[" << shape << "]";
+  } else if (type)
+    emitArrayDecl(port);
+  else
+    emitValue(port);
+  os << ";\n";
+}
+
+/// Load or check the data of a port with the given helper. Data files store
+/// f64 elements as double, other floating-point elements as float, and all
+/// other elements as int64_t, which is the same format read and written by
+/// scalehls-run.
+void ModuleEmitter::emitTestbenchData(Value port, StringRef helper,
+                                      StringRef fileName) {
+  int64_t numElements = 1;
+  auto elementType = port.getType();
+  if (auto type = port.getType().dyn_cast<ShapedType>()) {
+    numElements = type.getNumElements();
+    elementType = type.getElementType();
+  }
+  auto fileTypeName = elementType.isF64()            ? "double"
+                      : elementType.isa<FloatType>() ? "float"
+                                                     : "int64_t";
+
+  indent() << helper << "<" << fileTypeName << ">(dir, \"" << fileName
+           << "\", ";
+  if (port.getType().isa<ShapedType>())
+    os << "(" << getTypeName(port) << " *)" << getName(port);
+  else
+    os << "&" << getName(port);
+  os << ", " << numElements << ");\n";
+}
+
+/// Emit a self-checking C-simulation testbench driven by the runtime function
+/// or, if there is no runtime function, the top function. The i-th argument is
+/// loaded from "<dir>/arg<i>.bin" and filled with pseudo-random data if the
+/// file doesn't exist. After calling the kernel, each argument and result is
+/// compared against "<dir>/arg<i>.golden.bin" or "<dir>/res<i>.golden.bin" if
+/// the file exists, where "<dir>" is the first command line argument.
+void ModuleEmitter::emitTestbench(func::FuncOp func) {
+  os << R"XXX(
+//===----------------------------------------------------------------------===//
+// C-Simulation Testbench
+//===----------------------------------------------------------------------===//
+
+#ifndef __SYNTHESIS__
+#include <stdio.h>
+#include <stdlib.h>
+
+template <typename FileT, typename T>
+static void scalehls_tb_load(const char *dir, const char *name, T *data,
+                             size_t num) {
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/%s.bin", dir, name);
+  FILE *file = fopen(path, "rb");
+  if (!file) {
+    for (size_t i = 0; i < num; ++i)
+      data[i] = (T)(FileT)(rand() % 16);
+    return;
+  }
+  for (size_t i = 0; i < num; ++i) {
+    FileT value = 0;
+    if (fread(&value, sizeof(FileT), 1, file) != 1)
+      break;
+    data[i] = (T)value;
+  }
+  fclose(file);
+}
+
+template <typename FileT, typename T>
+static unsigned scalehls_tb_check(const char *dir, const char *name, T *data,
+                                  size_t num) {
+  char path[1024];
+  snprintf(path, sizeof(path), "%s/%s.golden.bin", dir, name);
+  FILE *file = fopen(path, "rb");
+  if (!file)
+    return 0;
+  unsigned numErrors = 0;
+  for (size_t i = 0; i < num; ++i) {
+    FileT golden = 0;
+    if (fread(&golden, sizeof(FileT), 1, file) != 1)
+      break;
+    double value = (double)data[i];
+    if (fabs(value - (double)golden) > 1e-3 + 1e-3 * fabs((double)golden))
+      if (numErrors++ < 10)
+        printf("%s[%zu]: %f != %f\n", name, i, value, (double)golden);
+  }
+  fclose(file);
+  return numErrors;
+}
+
+int main(int argc, char **argv) {
+  const char *dir = argc > 1 ? argv[1] : ".";
+)XXX";
+  addIndent();
+
+  // Declare and load all arguments.
+  for (auto arg : func.getArguments())
+    emitTestbenchPort(arg);
+  for (auto arg : func.getArguments())
+    emitTestbenchData(arg, "scalehls_tb_load",
+                      "arg" + std::to_string(arg.getArgNumber()));
+
+  // Call the kernel. The runtime function is directly emitted, while the call
+  // of the top function is manually constructed.
+  SmallVector<Value, 4> results;
+  if (hasRuntimeAttr(func)) {
+    emitBlock(func.front());
+    auto returnOp = cast<func::ReturnOp>(func.front().getTerminator());
+    results.append(returnOp.operand_begin(), returnOp.operand_end());
+  } else if (func.getNumResults() == 0) {
+    indent() << func.getName() << "(";
+    llvm::interleaveComma(func.getArguments(), os,
+                          [&](Value arg) { os << getName(arg); });
+    os << ");\n";
+  } else
+    emitError(func, "has results, which requires a runtime function");
+
+  // Check all arguments and results against the golden data.
+  indent() << "unsigned numErrors = 0;\n";
+  for (auto arg : func.getArguments()) {
+    indent() << "numErrors +=\n";
+    addIndent();
+    emitTestbenchData(arg, "scalehls_tb_check",
+                      "arg" + std::to_string(arg.getArgNumber()));
+    reduceIndent();
+  }
+  for (auto result : llvm::enumerate(results)) {
+    indent() << "numErrors +=\n";
+    addIndent();
+    emitTestbenchData(result.value(), "scalehls_tb_check",
+                      "res" + std::to_string(result.index()));
+    reduceIndent();
+  }
+  indent() << "printf(\"%s: %u mismatches\\n\", numErrors ? \"FAIL\" : "
+              "\"PASS\", numErrors);\n";
+  indent() << "return numErrors != 0;\n";
+
+  reduceIndent();
+  os << "}\n#endif\n";
+}
+
 /// Top-level MLIR module emitter.
 void ModuleEmitter::emitModule(ModuleOp module) {
   os << R"XXX(
@@ -1975,6 +2405,10 @@ using namespace std;
 
 )XXX";
 
+  // Emit the headers required by loading binary weights.
+  if (!emitWeightDir.empty() && emitWeightFormat == "bin")
+    os << "#include <stdio.h>\n#include <stdlib.h>\n\n";
+
   // Emit the multiplication primitive if required.
   if (module.walk([](PrimMulOp op) {
         return op.isPackMul() ? WalkResult::interrupt() : WalkResult::advance();
@@ -2011,6 +2445,18 @@ void pack_mul(int8_t A[2], int8_t B, int16_t C[2]) {
     } else if (!isa<ml_program::GlobalOp>(op))
       emitError(&op, "is unsupported operation");
   }
+
+  // Emit the testbench, which is driven by the runtime function if exists.
+  if (emitTestbench) {
+    func::FuncOp driver;
+    for (auto func : module.getOps<func::FuncOp>())
+      if (hasRuntimeAttr(func) || (!driver && hasTopFuncAttr(func)))
+        driver = func;
+    if (driver)
+      emitTestbench(driver);
+    else
+      emitError(module, "has no runtime or top function for testbench");
+  }
 }
 
 //===----------------------------------------------------------------------===//
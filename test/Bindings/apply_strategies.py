@@ -0,0 +1,51 @@
+# REQUIRES: bindings_python
+# RUN: %PYTHON %s | FileCheck %s
+
+import mlir.ir
+from mlir.dialects import func as func_dialect
+import numpy as np
+import scalehls
+
+ctx = mlir.ir.Context()
+scalehls.register_dialects(ctx)
+mod = mlir.ir.Module.parse("""
+func.func @kernel(%arg0: memref<16x16xi32>, %arg1: memref<16x16xi32>) {
+  affine.for %i = 0 to 16 {
+    affine.for %j = 0 to 16 {
+      %0 = affine.load %arg0[%i, %j] : memref<16x16xi32>
+      %1 = arith.muli %0, %0 : i32
+      affine.store %1, %arg1[%i, %j] : memref<16x16xi32>
+    }
+  }
+  return
+}
+""", ctx)
+func = mod.body.operations[0]
+
+# Each strategy is applied to its own clone of the function, while the original
+# function is kept untouched.
+strategies = [(0, np.array([1, 4], dtype=np.int64), 1, 1),
+              (0, np.array([2, 2], dtype=np.int64), 1, 2)]
+for clone, success in scalehls.apply_strategies(func, strategies):
+    # CHECK: kernel_strategy0 True
+    # CHECK-NEXT: kernel_strategy1 True
+    print(mlir.ir.StringAttr(clone.attributes["sym_name"]).value, success)
+
+# Invalid strategies are rejected before any clone is created.
+try:
+    scalehls.apply_strategies(func, [(1, np.array([1, 1]), 1, 1)])
+except ValueError as e:
+    # CHECK-NEXT: ValueError: invalid loop band index
+    print("ValueError:", e)
+
+# CHECK-NEXT: True
+print(mod.operation.verify())
+
+# CHECK-LABEL: func.func @kernel(
+# CHECK-NOT:     loop_directive
+# CHECK-LABEL: func.func @kernel_strategy0(
+# CHECK:         loop_directive = #hls.ld<pipeline=true, targetII=1
+# CHECK-LABEL: func.func @kernel_strategy1(
+# CHECK:         loop_directive = #hls.ld<pipeline=true, targetII=2
+# CHECK-NOT:   func.func
+print(mod)
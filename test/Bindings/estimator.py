@@ -0,0 +1,50 @@
+# REQUIRES: bindings_python
+# RUN: %PYTHON %s | FileCheck %s
+
+import mlir.ir
+from mlir.dialects import func as func_dialect
+import scalehls
+
+ctx = mlir.ir.Context()
+scalehls.register_dialects(ctx)
+mod = mlir.ir.Module.parse("""
+func.func @kernel(%arg0: memref<16x16xi32>, %arg1: memref<16x16xi32>) {
+  affine.for %i = 0 to 16 {
+    affine.for %j = 0 to 16 {
+      %0 = affine.load %arg0[%i, %j] : memref<16x16xi32>
+      %1 = arith.muli %0, %0 : i32
+      affine.store %1, %arg1[%i, %j] : memref<16x16xi32>
+    }
+  }
+  return
+}
+""", ctx)
+func = mod.body.operations[0]
+estimator = scalehls.Estimator()
+
+# The function is estimated in the first row, followed by its only loop band.
+# Each row holds the latency, interval, DSP, and BRAM.
+qor = estimator.estimate_func(func)
+# CHECK: (2, 4) int64
+print(qor.shape, qor.dtype)
+# CHECK-NEXT: True
+print(bool((qor >= 0).all()))
+# CHECK-NEXT: True
+print(bool(qor[0][0] >= qor[1][0]))
+
+# Each loop of the band is estimated from the outermost one, where the outer
+# loop runs the inner loop 16 times.
+bands = scalehls.LoopBandList(func)
+band = next(iter(bands))
+qor = estimator.estimate_band(band)
+# CHECK-NEXT: (2, 4)
+print(qor.shape)
+# CHECK-NEXT: True
+print(bool(qor[0][0] >= qor[1][0] * 16))
+
+# Target specs that can't be loaded are reported as Python errors.
+try:
+    scalehls.Estimator("non-existent-spec.json")
+except ValueError as e:
+    # CHECK-NEXT: ValueError: cannot open input file 'non-existent-spec.json'
+    print("ValueError:", e)
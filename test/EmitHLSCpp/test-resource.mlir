@@ -0,0 +1,18 @@
+// RUN: scalehls-translate -scalehls-emit-hlscpp %s | FileCheck %s
+
+func.func @test_resource(%arg0: memref<4xi32>) {
+  // CHECK: int32_t [[VAL_0:.*]][4] = {
+  // CHECK-NEXT: 1, 2, 3, -4
+  // CHECK-NEXT: };
+  %0 = hls.dataflow.const_buffer {value = dense_resource<weights> : tensor<4xi32>} : memref<4xi32>
+  memref.copy %0, %arg0 : memref<4xi32> to memref<4xi32>
+  return
+}
+
+{-#
+  dialect_resources: {
+    builtin: {
+      weights: "0x04000000010000000200000003000000FCFFFFFF"
+    }
+  }
+#-}
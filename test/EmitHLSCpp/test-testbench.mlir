@@ -0,0 +1,40 @@
+// RUN: scalehls-translate -scalehls-emit-hlscpp -emit-testbench %s | FileCheck %s
+
+// CHECK: void kernel(
+// CHECK-NEXT: float [[ARG0:v[0-9]+]][4],
+// CHECK-NEXT: ap_int<8> [[ARG1:v[0-9]+]][4],
+// CHECK-NEXT: double [[ARG2:v[0-9]+]]
+func.func @kernel(%arg0: memref<4xf32>, %arg1: memref<4xi8>, %arg2: f64) attributes {top_func} {
+  affine.for %i = 0 to 4 {
+    %0 = affine.load %arg0[%i] : memref<4xf32>
+    %1 = arith.addf %0, %0 : f32
+    affine.store %1, %arg0[%i] : memref<4xf32>
+  }
+  return
+}
+
+// The floating-point data are stored with their native types, while the
+// integer data are stored as int64_t.
+// CHECK: #ifndef __SYNTHESIS__
+// CHECK: static void scalehls_tb_load(
+// CHECK: static unsigned scalehls_tb_check(
+// CHECK: int main(int argc, char **argv) {
+// CHECK-NEXT: const char *dir = argc > 1 ? argv[1] : ".";
+// CHECK-NEXT: static float [[ARG0]][4];
+// CHECK-NEXT: static ap_int<8> [[ARG1]][4];
+// CHECK-NEXT: static double [[ARG2]];
+// CHECK-NEXT: scalehls_tb_load<float>(dir, "arg0", (float *)[[ARG0]], 4);
+// CHECK-NEXT: scalehls_tb_load<int64_t>(dir, "arg1", (ap_int<8> *)[[ARG1]], 4);
+// CHECK-NEXT: scalehls_tb_load<double>(dir, "arg2", &[[ARG2]], 1);
+// CHECK-NEXT: kernel([[ARG0]], [[ARG1]], [[ARG2]]);
+// CHECK-NEXT: unsigned numErrors = 0;
+// CHECK-NEXT: numErrors +=
+// CHECK-NEXT: scalehls_tb_check<float>(dir, "arg0", (float *)[[ARG0]], 4);
+// CHECK-NEXT: numErrors +=
+// CHECK-NEXT: scalehls_tb_check<int64_t>(dir, "arg1", (ap_int<8> *)[[ARG1]], 4);
+// CHECK-NEXT: numErrors +=
+// CHECK-NEXT: scalehls_tb_check<double>(dir, "arg2", &[[ARG2]], 1);
+// CHECK-NEXT: printf("%s: %u mismatches\n", numErrors ? "FAIL" : "PASS", numErrors);
+// CHECK-NEXT: return numErrors != 0;
+// CHECK-NEXT: }
+// CHECK-NEXT: #endif
@@ -0,0 +1,9 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: not scalehls-translate -scalehls-emit-hlscpp -emit-weight-dir=%t -emit-weight-threshold=4 %s 2>&1 | FileCheck %s
+
+func.func @test_weights_error(%arg0: memref<4xf16>) {
+  // CHECK: error: has unsupported weight element type.
+  %0 = hls.dataflow.const_buffer {value = dense<[1.0, 2.0, 3.0, 4.0]> : tensor<4xf16>} : memref<4xf16>
+  memref.copy %0, %arg0 : memref<4xf16> to memref<4xf16>
+  return
+}
@@ -0,0 +1,58 @@
+// RUN: rm -rf %t && mkdir -p %t
+// RUN: scalehls-translate -scalehls-emit-hlscpp -emit-weight-dir=%t -emit-weight-threshold=4 %s | FileCheck %s --check-prefix=DAT
+// RUN: FileCheck %s --check-prefix=DAT-F32 < %t/test_weights_v3.dat
+// RUN: FileCheck %s --check-prefix=DAT-I32 < %t/test_weights_v5.dat
+// RUN: scalehls-translate -scalehls-emit-hlscpp -emit-weight-dir=%t -emit-weight-threshold=4 -emit-weight-format=bin %s | FileCheck %s --check-prefix=BIN
+// RUN: scalehls-translate -scalehls-emit-hlscpp %s | FileCheck %s --check-prefix=INLINE
+
+// DAT-F32: 1, NAN, INFINITY, -INFINITY
+// DAT-I32: 1, 2, 3, -4
+
+// DAT-NOT: #include <stdlib.h>
+// BIN: #include <stdio.h>
+// BIN-NEXT: #include <stdlib.h>
+
+func.func @test_weights(%arg0: memref<4xf32>, %arg1: memref<2xi32>, %arg2: memref<4xi32>) {
+  // DAT: float [[F32:v3]][4] = {
+  // DAT-NEXT: #include "{{/.*}}test_weights_[[F32]].dat"
+  // DAT-NEXT: };
+
+  // BIN: float [[F32:v3]][4];
+  // BIN-NEXT: #ifndef __SYNTHESIS__
+  // BIN-NEXT: {
+  // BIN-NEXT: FILE *file = fopen("{{/.*}}test_weights_[[F32]].bin", "rb");
+  // BIN-NEXT: if (!file || fread([[F32]], sizeof([[F32]]), 1, file) != 1) {
+  // BIN-NEXT: fprintf(stderr, "failed to load {{/.*}}test_weights_[[F32]].bin\n");
+  // BIN-NEXT: exit(EXIT_FAILURE);
+  // BIN-NEXT: }
+  // BIN-NEXT: fclose(file);
+  // BIN-NEXT: }
+  // BIN-NEXT: #endif
+
+  // INLINE: float {{v[0-9]+}}[4] = {(float)1.000000, (float)NAN, (float)INFINITY, (float)-INFINITY};
+  %0 = hls.dataflow.const_buffer {value = dense<[1.0, 0x7FC00000, 0x7F800000, 0xFF800000]> : tensor<4xf32>} : memref<4xf32>
+  memref.copy %0, %arg0 : memref<4xf32> to memref<4xf32>
+
+  // Constants below the threshold are always kept inline.
+  // DAT: int32_t {{v[0-9]+}}[2] = {(ap_int<32>)1, (ap_int<32>)2};
+  // BIN: int32_t {{v[0-9]+}}[2] = {(ap_int<32>)1, (ap_int<32>)2};
+  %1 = hls.dataflow.const_buffer {value = dense<[1, 2]> : tensor<2xi32>} : memref<2xi32>
+  memref.copy %1, %arg1 : memref<2xi32> to memref<2xi32>
+
+  // Integer weights are always written in the dat format.
+  // DAT: int32_t [[I32:v5]][4] = {
+  // DAT-NEXT: #include "{{/.*}}test_weights_[[I32]].dat"
+  // BIN: int32_t [[I32:v5]][4] = {
+  // BIN-NEXT: #include "{{/.*}}test_weights_[[I32]].dat"
+  %2 = hls.dataflow.const_buffer {value = dense_resource<weights> : tensor<4xi32>} : memref<4xi32>
+  memref.copy %2, %arg2 : memref<4xi32> to memref<4xi32>
+  return
+}
+
+{-#
+  dialect_resources: {
+    builtin: {
+      weights: "0x04000000010000000200000003000000FCFFFFFF"
+    }
+  }
+#-}
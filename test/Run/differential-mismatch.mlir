@@ -0,0 +1,17 @@
+// RUN: sed 's/arith.constant 1 : i32/arith.constant 2 : i32/' %s > %t
+// RUN: not scalehls-run %s -compare=%t | FileCheck %s
+
+// The snapshot adds a different constant, thus every element of the output
+// mismatches and the runner exits with failure.
+// CHECK: FAIL: 16 mismatches
+module {
+  func.func @add(%A: memref<16xi32>, %B: memref<16xi32>) attributes {top_func} {
+    %c1_i32 = arith.constant 1 : i32
+    affine.for %i = 0 to 16 {
+      %0 = affine.load %A[%i] : memref<16xi32>
+      %1 = arith.addi %0, %c1_i32 : i32
+      affine.store %1, %B[%i] : memref<16xi32>
+    }
+    return
+  }
+}
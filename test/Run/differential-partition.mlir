@@ -0,0 +1,30 @@
+// RUN: scalehls-opt -scalehls-array-partition %s > %t
+// RUN: FileCheck %s --check-prefix=LAYOUT < %t
+// RUN: scalehls-run %s -compare=%t | FileCheck %s
+
+// The local buffer is cyclically partitioned in the snapshot, which must not
+// change the placement of its elements.
+// LAYOUT: #[[CYCLIC:.+]] = affine_map<(d0) -> (d0 mod 4, d0 floordiv 4)>
+// LAYOUT: memref.alloc() : memref<16xi32, #[[CYCLIC]]>
+// CHECK: PASS: 0 mismatches
+module {
+  func.func @sum(%arg0: memref<16xi32>, %arg1: memref<4xi32>) attributes {top_func} {
+    %0 = memref.alloc() : memref<16xi32>
+    affine.for %arg2 = 0 to 16 {
+      %1 = affine.load %arg0[%arg2] : memref<16xi32>
+      %2 = arith.muli %1, %1 : i32
+      affine.store %2, %0[%arg2] : memref<16xi32>
+    }
+    affine.for %arg2 = 0 to 4 {
+      %1 = affine.load %0[%arg2 * 4] : memref<16xi32>
+      %2 = affine.load %0[%arg2 * 4 + 1] : memref<16xi32>
+      %3 = affine.load %0[%arg2 * 4 + 2] : memref<16xi32>
+      %4 = affine.load %0[%arg2 * 4 + 3] : memref<16xi32>
+      %5 = arith.addi %1, %2 : i32
+      %6 = arith.addi %3, %4 : i32
+      %7 = arith.addi %5, %6 : i32
+      affine.store %7, %arg1[%arg2] : memref<4xi32>
+    }
+    return
+  }
+}
@@ -0,0 +1,34 @@
+// RUN: scalehls-opt -scalehls-create-token-stream %s > %t
+// RUN: FileCheck %s --check-prefix=STREAM < %t
+// RUN: scalehls-run %s -compare=%t | FileCheck %s
+
+// The DRAM buffer %arg2 is synchronized through a token stream, which is
+// written by the producer and read by the consumer in the snapshot.
+// STREAM: hls.dataflow.stream
+// STREAM: hls.dataflow.stream_write
+// STREAM: hls.dataflow.stream_read
+// CHECK: PASS: 0 mismatches
+module {
+  func.func @forward(%arg0: memref<16xi32, 12>, %arg1: memref<16xi32, 12>, %arg2: memref<16xi32, 12>) attributes {top_func} {
+    hls.dataflow.schedule legal(%arg0, %arg1, %arg2) : memref<16xi32, 12>, memref<16xi32, 12>, memref<16xi32, 12> {
+    ^bb0(%arg3: memref<16xi32, 12>, %arg4: memref<16xi32, 12>, %arg5: memref<16xi32, 12>):
+      hls.dataflow.node(%arg3) -> (%arg5) {inputTaps = [0 : i32], level = 1 : i32} : (memref<16xi32, 12>) -> memref<16xi32, 12> {
+      ^bb0(%arg6: memref<16xi32, 12>, %arg7: memref<16xi32, 12>):
+        affine.for %arg8 = 0 to 16 {
+          %0 = affine.load %arg6[%arg8] : memref<16xi32, 12>
+          %1 = arith.muli %0, %0 : i32
+          affine.store %1, %arg7[%arg8] : memref<16xi32, 12>
+        }
+      }
+      hls.dataflow.node(%arg5) -> (%arg4) {inputTaps = [0 : i32], level = 0 : i32} : (memref<16xi32, 12>) -> memref<16xi32, 12> {
+      ^bb0(%arg6: memref<16xi32, 12>, %arg7: memref<16xi32, 12>):
+        affine.for %arg8 = 0 to 16 {
+          %0 = affine.load %arg6[%arg8] : memref<16xi32, 12>
+          %1 = arith.addi %0, %0 : i32
+          affine.store %1, %arg7[%arg8] : memref<16xi32, 12>
+        }
+      }
+    }
+    return
+  }
+}
@@ -0,0 +1,21 @@
+// RUN: scalehls-opt -scalehls-affine-loop-tile="tile-size=4" %s > %t
+// RUN: scalehls-run %s -compare=%t | FileCheck %s
+
+// CHECK: PASS: 0 mismatches
+module {
+  func.func @gemm(%A: memref<16x12xf32>, %B: memref<12x8xf32>, %C: memref<16x8xf32>) attributes {top_func} {
+    affine.for %i = 0 to 16 {
+      affine.for %j = 0 to 8 {
+        affine.for %k = 0 to 12 {
+          %0 = affine.load %A[%i, %k] : memref<16x12xf32>
+          %1 = affine.load %B[%k, %j] : memref<12x8xf32>
+          %2 = affine.load %C[%i, %j] : memref<16x8xf32>
+          %3 = arith.mulf %0, %1 : f32
+          %4 = arith.addf %2, %3 : f32
+          affine.store %4, %C[%i, %j] : memref<16x8xf32>
+        }
+      }
+    }
+    return
+  }
+}
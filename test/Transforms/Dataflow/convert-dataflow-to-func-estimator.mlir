@@ -0,0 +1,61 @@
+// RUN: scalehls-opt -scalehls-convert-dataflow-to-func="split-external-access=false estimator-aware" %s | FileCheck %s
+
+// The short copy node is inlined as the call overhead dominates its latency,
+// while the long node is kept. The single multiplier node is inlined, but the
+// two equivalent multiplier nodes are kept, such that they can be merged into
+// one function and share the DSPs.
+// CHECK-DAG: func.func @forward_node{{[0-9]+}}(%arg0: memref<4xi8>, %arg1: memref<4xi8>) attributes {inline} {
+// CHECK-DAG: func.func @forward_node{{[0-9]+}}(%arg0: memref<1024xi8>, %arg1: memref<1024xi8>) {
+// CHECK-DAG: func.func @forward_node{{[0-9]+}}(%arg0: memref<8xi32>, %arg1: memref<8xi32>) attributes {inline} {
+// CHECK-DAG: func.func @forward_node{{[0-9]+}}(%arg0: memref<4xi32>, %arg1: memref<4xi32>) {
+// CHECK-DAG: func.func @forward_node{{[0-9]+}}(%arg0: memref<4xi32>, %arg1: memref<4xi32>) {
+// CHECK: func.func @forward
+func.func @forward(%arg0: memref<4xi8>, %arg1: memref<4xi8>, %arg2: memref<1024xi8>, %arg3: memref<1024xi8>, %arg4: memref<8xi32>, %arg5: memref<8xi32>, %arg6: memref<4xi32>, %arg7: memref<4xi32>, %arg8: memref<4xi32>) {
+  hls.dataflow.schedule(%arg0, %arg1, %arg2, %arg3, %arg4, %arg5, %arg6, %arg7, %arg8) : memref<4xi8>, memref<4xi8>, memref<1024xi8>, memref<1024xi8>, memref<8xi32>, memref<8xi32>, memref<4xi32>, memref<4xi32>, memref<4xi32> {
+  ^bb0(%arg9: memref<4xi8>, %arg10: memref<4xi8>, %arg11: memref<1024xi8>, %arg12: memref<1024xi8>, %arg13: memref<8xi32>, %arg14: memref<8xi32>, %arg15: memref<4xi32>, %arg16: memref<4xi32>, %arg17: memref<4xi32>):
+    hls.dataflow.node(%arg9) -> (%arg10) {inputTaps = [0 : i32], level = 4 : i32} : (memref<4xi8>) -> memref<4xi8> {
+    ^bb0(%arg18: memref<4xi8>, %arg19: memref<4xi8>):
+      affine.for %arg20 = 0 to 4 {
+        %0 = affine.load %arg18[%arg20] : memref<4xi8>
+        affine.store %0, %arg19[%arg20] : memref<4xi8>
+      }
+    }
+    hls.dataflow.node(%arg11) -> (%arg12) {inputTaps = [0 : i32], level = 3 : i32} : (memref<1024xi8>) -> memref<1024xi8> {
+    ^bb0(%arg18: memref<1024xi8>, %arg19: memref<1024xi8>):
+      %c1_i8 = arith.constant 1 : i8
+      affine.for %arg20 = 0 to 1024 {
+        %0 = affine.load %arg18[%arg20] : memref<1024xi8>
+        %1 = arith.addi %0, %c1_i8 : i8
+        affine.store %1, %arg19[%arg20] : memref<1024xi8>
+      }
+    }
+    hls.dataflow.node(%arg13) -> (%arg14) {inputTaps = [0 : i32], level = 2 : i32} : (memref<8xi32>) -> memref<8xi32> {
+    ^bb0(%arg18: memref<8xi32>, %arg19: memref<8xi32>):
+      %c3_i32 = arith.constant 3 : i32
+      affine.for %arg20 = 0 to 8 {
+        %0 = affine.load %arg18[%arg20] : memref<8xi32>
+        %1 = arith.muli %0, %c3_i32 : i32
+        affine.store %1, %arg19[%arg20] : memref<8xi32>
+      }
+    }
+    hls.dataflow.node(%arg15) -> (%arg16) {inputTaps = [0 : i32], level = 1 : i32} : (memref<4xi32>) -> memref<4xi32> {
+    ^bb0(%arg18: memref<4xi32>, %arg19: memref<4xi32>):
+      %c3_i32 = arith.constant 3 : i32
+      affine.for %arg20 = 0 to 4 {
+        %0 = affine.load %arg18[%arg20] : memref<4xi32>
+        %1 = arith.muli %0, %c3_i32 : i32
+        affine.store %1, %arg19[%arg20] : memref<4xi32>
+      }
+    }
+    hls.dataflow.node(%arg16) -> (%arg17) {inputTaps = [0 : i32], level = 0 : i32} : (memref<4xi32>) -> memref<4xi32> {
+    ^bb0(%arg18: memref<4xi32>, %arg19: memref<4xi32>):
+      %c5_i32 = arith.constant 5 : i32
+      affine.for %arg20 = 0 to 4 {
+        %0 = affine.load %arg18[%arg20] : memref<4xi32>
+        %1 = arith.muli %0, %c5_i32 : i32
+        affine.store %1, %arg19[%arg20] : memref<4xi32>
+      }
+    }
+  }
+  return
+}
@@ -0,0 +1,100 @@
+// RUN: scalehls-opt -scalehls-legalize-dataflow %s | FileCheck %s --check-prefix=MERGE
+// RUN: scalehls-opt -scalehls-legalize-dataflow="cost-aware" %s | FileCheck %s --check-prefix=COST
+// RUN: scalehls-opt -scalehls-legalize-dataflow="cost-aware bram-budget=1" %s | FileCheck %s --check-prefix=MERGE
+
+// The two consumers of the const buffer are merged by default. With the cost
+// model, the const buffer is duplicated for each consumer instead, such that
+// the consumers still overlap, unless the extra BRAM exceeds the budget.
+// MERGE-LABEL: func.func @duplicate
+// MERGE:         hls.dataflow.const_buffer
+// MERGE-NOT:     hls.dataflow.const_buffer
+// MERGE:         hls.dataflow.node
+// MERGE-NOT:     hls.dataflow.node
+// MERGE:         return
+
+// COST-LABEL: func.func @duplicate
+// COST:         hls.dataflow.schedule legal
+// COST:         %[[CST0:.+]] = hls.dataflow.const_buffer {value = dense<1> : tensor<64xi32>} : memref<64xi32, 7>
+// COST:         %[[CST1:.+]] = hls.dataflow.const_buffer {value = dense<1> : tensor<64xi32>} : memref<64xi32, 7>
+// COST:         hls.dataflow.node(%{{.+}}, %[[CST0]]) -> (%{{.+}}) {inputTaps = [0 : i32, 0 : i32], level = 0 : i32}
+// COST:         hls.dataflow.node(%{{.+}}, %[[CST1]]) -> (%{{.+}}) {inputTaps = [0 : i32, 0 : i32], level = 0 : i32}
+func.func @duplicate(%arg0: memref<64xi32, 12>, %arg1: memref<64xi32, 12>, %arg2: memref<64xi32, 12>, %arg3: memref<64xi32, 12>) {
+  hls.dataflow.schedule(%arg0, %arg1, %arg2, %arg3) : memref<64xi32, 12>, memref<64xi32, 12>, memref<64xi32, 12>, memref<64xi32, 12> {
+  ^bb0(%arg4: memref<64xi32, 12>, %arg5: memref<64xi32, 12>, %arg6: memref<64xi32, 12>, %arg7: memref<64xi32, 12>):
+    %0 = hls.dataflow.const_buffer {value = dense<1> : tensor<64xi32>} : memref<64xi32, 7>
+    hls.dataflow.node(%arg4, %0) -> (%arg6) {inputTaps = [0 : i32, 0 : i32], level = 0 : i32} : (memref<64xi32, 12>, memref<64xi32, 7>) -> memref<64xi32, 12> {
+    ^bb0(%arg8: memref<64xi32, 12>, %arg9: memref<64xi32, 7>, %arg10: memref<64xi32, 12>):
+      affine.for %arg11 = 0 to 64 {
+        %1 = affine.load %arg8[%arg11] : memref<64xi32, 12>
+        %2 = affine.load %arg9[%arg11] : memref<64xi32, 7>
+        %3 = arith.addi %1, %2 : i32
+        affine.store %3, %arg10[%arg11] : memref<64xi32, 12>
+      }
+    }
+    hls.dataflow.node(%arg5, %0) -> (%arg7) {inputTaps = [0 : i32, 0 : i32], level = 0 : i32} : (memref<64xi32, 12>, memref<64xi32, 7>) -> memref<64xi32, 12> {
+    ^bb0(%arg8: memref<64xi32, 12>, %arg9: memref<64xi32, 7>, %arg10: memref<64xi32, 12>):
+      affine.for %arg11 = 0 to 64 {
+        %1 = affine.load %arg8[%arg11] : memref<64xi32, 12>
+        %2 = affine.load %arg9[%arg11] : memref<64xi32, 7>
+        %3 = arith.muli %1, %2 : i32
+        affine.store %3, %arg10[%arg11] : memref<64xi32, 12>
+      }
+    }
+  }
+  return
+}
+
+// The output of the level 2 node bypasses level 1. By default, the bypassed
+// levels are merged into one node. With the cost model, the output is passed
+// through a copy node at level 1 instead, which is faster than running the
+// two bypassed nodes sequentially.
+// MERGE-LABEL: func.func @bypass
+// MERGE:         hls.dataflow.node
+// MERGE-SAME:      level = 2 : i32
+// MERGE:         hls.dataflow.node
+// MERGE-NOT:     hls.dataflow.node
+// MERGE-NOT:     memref.copy
+// MERGE:         return
+
+// COST-LABEL: func.func @bypass
+// COST:         %[[BUF:.+]] = hls.dataflow.buffer {depth = 1 : i32} : memref<64xi32, 7>
+// COST:         hls.dataflow.buffer {depth = 1 : i32} : memref<64xi32, 7>
+// COST:         %[[COPY:.+]] = hls.dataflow.buffer {depth = 1 : i32} : memref<64xi32, 7>
+// COST:         hls.dataflow.node(%{{.+}}) -> (%[[BUF]]) {inputTaps = [0 : i32], level = 2 : i32}
+// COST:         hls.dataflow.node(%[[BUF]]) -> (%[[COPY]]) {inputTaps = [0 : i32], level = 1 : i32}
+// COST-NEXT:    ^bb0(%[[SRC:[a-z0-9]+]]: memref<64xi32, 7>, %[[DST:[a-z0-9]+]]: memref<64xi32, 7>):
+// COST-NEXT:      memref.copy %[[SRC]], %[[DST]] : memref<64xi32, 7> to memref<64xi32, 7>
+// COST:         hls.dataflow.node({{.+}}) -> ({{.+}}) {inputTaps = [0 : i32], level = 1 : i32}
+// COST:         hls.dataflow.node(%[[COPY]], %{{.+}}) -> (%{{.+}}) {inputTaps = [0 : i32, 0 : i32], level = 0 : i32}
+func.func @bypass(%arg0: memref<64xi32, 12>, %arg1: memref<64xi32, 12>, %arg2: memref<64xi32, 12>) {
+  hls.dataflow.schedule(%arg0, %arg1, %arg2) : memref<64xi32, 12>, memref<64xi32, 12>, memref<64xi32, 12> {
+  ^bb0(%arg3: memref<64xi32, 12>, %arg4: memref<64xi32, 12>, %arg5: memref<64xi32, 12>):
+    %0 = hls.dataflow.buffer {depth = 1 : i32} : memref<64xi32, 7>
+    %1 = hls.dataflow.buffer {depth = 1 : i32} : memref<64xi32, 7>
+    hls.dataflow.node(%arg3) -> (%0) {inputTaps = [0 : i32], level = 2 : i32} : (memref<64xi32, 12>) -> memref<64xi32, 7> {
+    ^bb0(%arg6: memref<64xi32, 12>, %arg7: memref<64xi32, 7>):
+      affine.for %arg8 = 0 to 64 {
+        %2 = affine.load %arg6[%arg8] : memref<64xi32, 12>
+        affine.store %2, %arg7[%arg8] : memref<64xi32, 7>
+      }
+    }
+    hls.dataflow.node(%arg4) -> (%1) {inputTaps = [0 : i32], level = 1 : i32} : (memref<64xi32, 12>) -> memref<64xi32, 7> {
+    ^bb0(%arg6: memref<64xi32, 12>, %arg7: memref<64xi32, 7>):
+      affine.for %arg8 = 0 to 64 {
+        %2 = affine.load %arg6[%arg8] : memref<64xi32, 12>
+        %3 = arith.muli %2, %2 : i32
+        affine.store %3, %arg7[%arg8] : memref<64xi32, 7>
+      }
+    }
+    hls.dataflow.node(%0, %1) -> (%arg5) {inputTaps = [0 : i32, 0 : i32], level = 0 : i32} : (memref<64xi32, 7>, memref<64xi32, 7>) -> memref<64xi32, 12> {
+    ^bb0(%arg6: memref<64xi32, 7>, %arg7: memref<64xi32, 7>, %arg8: memref<64xi32, 12>):
+      affine.for %arg9 = 0 to 64 {
+        %2 = affine.load %arg6[%arg9] : memref<64xi32, 7>
+        %3 = affine.load %arg7[%arg9] : memref<64xi32, 7>
+        %4 = arith.addi %2, %3 : i32
+        affine.store %4, %arg8[%arg9] : memref<64xi32, 12>
+      }
+    }
+  }
+  return
+}
@@ -0,0 +1,66 @@
+// RUN: scalehls-opt -scalehls-parallelize-dataflow-node="max-unroll-factor=4" %s | FileCheck %s
+
+// The nodes form a chain A -> B -> C, where B transposes %0 into %1 and %2.
+// A and C are not correlated directly, but the rows of A are transitively
+// correlated with the columns of C through B. B is the most correlated node
+// and visited first, but it is four times less complex and thus not unrolled,
+// which leaves the loop classes unconstrained. C is visited next and unrolls
+// its column and reduction loops by 2. A is aligned with C through B, thus its
+// row loop instead of its column loop is unrolled by 2.
+// CHECK-LABEL: func.func @forward
+// CHECK:         hls.dataflow.node
+// CHECK:           affine.for %{{.+}} = 0 to 16 step 2 {
+// CHECK-NEXT:        affine.for %{{.+}} = 0 to 8 {
+// CHECK-NEXT:          affine.for %{{.+}} = 0 to 4 step 2 {
+// CHECK-COUNT-4:         affine.store
+// CHECK:         hls.dataflow.node
+// CHECK:           affine.for %{{.+}} = 0 to 8 {
+// CHECK-NEXT:        affine.for %{{.+}} = 0 to 16 {
+// CHECK:         hls.dataflow.node
+// CHECK:           affine.for %{{.+}} = 0 to 8 {
+// CHECK-NEXT:        affine.for %{{.+}} = 0 to 16 step 2 {
+// CHECK-NEXT:          affine.for %{{.+}} = 0 to 4 step 2 {
+// CHECK-COUNT-4:         arith.addf
+func.func @forward(%arg0: memref<16x8x4xf32>, %arg1: memref<8x16x4xf32>) {
+  hls.dataflow.schedule(%arg0, %arg1) : memref<16x8x4xf32>, memref<8x16x4xf32> {
+  ^bb0(%arg2: memref<16x8x4xf32>, %arg3: memref<8x16x4xf32>):
+    %0 = hls.dataflow.buffer {depth = 1 : i32} : memref<16x8xf32, 7>
+    hls.dataflow.node(%arg2) -> (%0) {inputTaps = [0 : i32], level = 2 : i32} : (memref<16x8x4xf32>) -> memref<16x8xf32, 7> {
+    ^bb0(%arg4: memref<16x8x4xf32>, %arg5: memref<16x8xf32, 7>):
+      affine.for %arg6 = 0 to 16 {
+        affine.for %arg7 = 0 to 8 {
+          affine.for %arg8 = 0 to 4 {
+            %3 = affine.load %arg4[%arg6, %arg7, %arg8] : memref<16x8x4xf32>
+            affine.store %3, %arg5[%arg6, %arg7] : memref<16x8xf32, 7>
+          }
+        }
+      }
+    }
+    %1 = hls.dataflow.buffer {depth = 1 : i32} : memref<8x16xf32, 7>
+    %2 = hls.dataflow.buffer {depth = 1 : i32} : memref<8x16xf32, 7>
+    hls.dataflow.node(%0) -> (%1, %2) {inputTaps = [0 : i32], level = 1 : i32} : (memref<16x8xf32, 7>) -> (memref<8x16xf32, 7>, memref<8x16xf32, 7>) {
+    ^bb0(%arg4: memref<16x8xf32, 7>, %arg5: memref<8x16xf32, 7>, %arg6: memref<8x16xf32, 7>):
+      affine.for %arg7 = 0 to 8 {
+        affine.for %arg8 = 0 to 16 {
+          %3 = affine.load %arg4[%arg8, %arg7] : memref<16x8xf32, 7>
+          affine.store %3, %arg5[%arg7, %arg8] : memref<8x16xf32, 7>
+          affine.store %3, %arg6[%arg7, %arg8] : memref<8x16xf32, 7>
+        }
+      }
+    }
+    hls.dataflow.node(%1, %2) -> (%arg3) {inputTaps = [0 : i32, 0 : i32], level = 0 : i32} : (memref<8x16xf32, 7>, memref<8x16xf32, 7>) -> memref<8x16x4xf32> {
+    ^bb0(%arg4: memref<8x16xf32, 7>, %arg5: memref<8x16xf32, 7>, %arg6: memref<8x16x4xf32>):
+      affine.for %arg7 = 0 to 8 {
+        affine.for %arg8 = 0 to 16 {
+          affine.for %arg9 = 0 to 4 {
+            %3 = affine.load %arg4[%arg7, %arg8] : memref<8x16xf32, 7>
+            %4 = affine.load %arg5[%arg7, %arg8] : memref<8x16xf32, 7>
+            %5 = arith.addf %3, %4 : f32
+            affine.store %5, %arg6[%arg7, %arg8, %arg9] : memref<8x16x4xf32>
+          }
+        }
+      }
+    }
+  }
+  return
+}
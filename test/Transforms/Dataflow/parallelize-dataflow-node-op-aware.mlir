@@ -0,0 +1,41 @@
+// RUN: scalehls-opt -scalehls-parallelize-dataflow-node="max-unroll-factor=8 correlation-aware=false" %s | FileCheck %s --check-prefix=TRIP
+// RUN: scalehls-opt -scalehls-parallelize-dataflow-node="max-unroll-factor=8 correlation-aware=false op-aware" %s | FileCheck %s --check-prefix=OP
+
+// Counting loop trips only, both nodes are equally complex and unrolled by the
+// maximum factor. With operators weighted, the divider node is twice as
+// complex as the adder node (16 x 18 vs. 16 x 9 with the default profile), thus
+// the adder node is unrolled by half of the factor.
+// TRIP-LABEL: func.func @forward
+// TRIP:         affine.for %{{.+}} = 0 to 16 step 8 {
+// TRIP:           arith.addf
+// TRIP:         affine.for %{{.+}} = 0 to 16 step 8 {
+// TRIP:           arith.divf
+
+// OP-LABEL:   func.func @forward
+// OP:           affine.for %{{.+}} = 0 to 16 step 4 {
+// OP-COUNT-4:     arith.addf
+// OP-NOT:         arith.addf
+// OP:           affine.for %{{.+}} = 0 to 16 step 8 {
+// OP-COUNT-8:     arith.divf
+func.func @forward(%arg0: memref<16xf32>, %arg1: memref<16xf32>, %arg2: memref<16xf32>, %arg3: memref<16xf32>) {
+  hls.dataflow.schedule(%arg0, %arg1, %arg2, %arg3) : memref<16xf32>, memref<16xf32>, memref<16xf32>, memref<16xf32> {
+  ^bb0(%arg4: memref<16xf32>, %arg5: memref<16xf32>, %arg6: memref<16xf32>, %arg7: memref<16xf32>):
+    hls.dataflow.node(%arg4) -> (%arg5) {inputTaps = [0 : i32], level = 1 : i32} : (memref<16xf32>) -> memref<16xf32> {
+    ^bb0(%arg8: memref<16xf32>, %arg9: memref<16xf32>):
+      affine.for %arg10 = 0 to 16 {
+        %0 = affine.load %arg8[%arg10] : memref<16xf32>
+        %1 = arith.addf %0, %0 : f32
+        affine.store %1, %arg9[%arg10] : memref<16xf32>
+      }
+    }
+    hls.dataflow.node(%arg6) -> (%arg7) {inputTaps = [0 : i32], level = 0 : i32} : (memref<16xf32>) -> memref<16xf32> {
+    ^bb0(%arg8: memref<16xf32>, %arg9: memref<16xf32>):
+      affine.for %arg10 = 0 to 16 {
+        %0 = affine.load %arg8[%arg10] : memref<16xf32>
+        %1 = arith.divf %0, %0 : f32
+        affine.store %1, %arg9[%arg10] : memref<16xf32>
+      }
+    }
+  }
+  return
+}
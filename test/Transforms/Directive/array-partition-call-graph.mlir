@@ -0,0 +1,88 @@
+// RUN: scalehls-opt -scalehls-array-partition %s | FileCheck %s
+// RUN: scalehls-opt -scalehls-array-partition -mlir-disable-threading %s | FileCheck %s
+
+// The functions are partitioned level by level from the leaf function. The
+// factor of %arg1 found in @leaf is propagated up to @mid and @top, while the
+// larger factor of %arg0 found in @mid overrides the one found in @leaf, and
+// is propagated down to @leaf through its signature. @left and @right are in
+// the same level as @leaf and share %2 of @top, but find conflicting factors
+// of their arguments. The larger one is picked by @top and propagated down to
+// both of them. The result is the same when the functions of each level are
+// partitioned serially.
+// CHECK-DAG: #[[CYCLIC2:.+]] = affine_map<(d0) -> (d0 mod 2, d0 floordiv 2)>
+// CHECK-DAG: #[[CYCLIC4:.+]] = affine_map<(d0) -> (d0 mod 4, d0 floordiv 4)>
+
+// CHECK: func.func @leaf(%arg0: memref<16xi32, #[[CYCLIC4]]>, %arg1: memref<16xi32, #[[CYCLIC2]]>) {
+func.func @leaf(%arg0: memref<16xi32>, %arg1: memref<16xi32>) {
+  affine.for %arg2 = 0 to 8 {
+    %0 = affine.load %arg0[%arg2 * 2] : memref<16xi32>
+    %1 = affine.load %arg0[%arg2 * 2 + 1] : memref<16xi32>
+    affine.store %1, %arg1[%arg2 * 2] : memref<16xi32>
+    affine.store %0, %arg1[%arg2 * 2 + 1] : memref<16xi32>
+  }
+  return
+}
+
+// CHECK: func.func @mid(%arg0: memref<16xi32, #[[CYCLIC4]]>, %arg1: memref<16xi32, #[[CYCLIC2]]>, %arg2: memref<4xi32>) {
+// CHECK:   call @leaf(%arg0, %arg1) : (memref<16xi32, #[[CYCLIC4]]>, memref<16xi32, #[[CYCLIC2]]>) -> ()
+func.func @mid(%arg0: memref<16xi32>, %arg1: memref<16xi32>, %arg2: memref<4xi32>) {
+  call @leaf(%arg0, %arg1) : (memref<16xi32>, memref<16xi32>) -> ()
+  affine.for %arg3 = 0 to 4 {
+    %0 = affine.load %arg0[%arg3 * 4] : memref<16xi32>
+    %1 = affine.load %arg0[%arg3 * 4 + 1] : memref<16xi32>
+    %2 = affine.load %arg0[%arg3 * 4 + 2] : memref<16xi32>
+    %3 = affine.load %arg0[%arg3 * 4 + 3] : memref<16xi32>
+    %4 = arith.addi %0, %1 : i32
+    %5 = arith.addi %2, %3 : i32
+    %6 = arith.addi %4, %5 : i32
+    affine.store %6, %arg2[%arg3] : memref<4xi32>
+  }
+  return
+}
+
+// CHECK: func.func @left(%arg0: memref<16xi32, #[[CYCLIC4]]>, %arg1: memref<8xi32>) {
+func.func @left(%arg0: memref<16xi32>, %arg1: memref<8xi32>) {
+  affine.for %arg2 = 0 to 8 {
+    %0 = affine.load %arg0[%arg2 * 2] : memref<16xi32>
+    %1 = affine.load %arg0[%arg2 * 2 + 1] : memref<16xi32>
+    %2 = arith.addi %0, %1 : i32
+    affine.store %2, %arg1[%arg2] : memref<8xi32>
+  }
+  return
+}
+
+// CHECK: func.func @right(%arg0: memref<16xi32, #[[CYCLIC4]]>, %arg1: memref<4xi32>) {
+func.func @right(%arg0: memref<16xi32>, %arg1: memref<4xi32>) {
+  affine.for %arg2 = 0 to 4 {
+    %0 = affine.load %arg0[%arg2 * 4] : memref<16xi32>
+    %1 = affine.load %arg0[%arg2 * 4 + 1] : memref<16xi32>
+    %2 = affine.load %arg0[%arg2 * 4 + 2] : memref<16xi32>
+    %3 = affine.load %arg0[%arg2 * 4 + 3] : memref<16xi32>
+    %4 = arith.addi %0, %1 : i32
+    %5 = arith.addi %2, %3 : i32
+    %6 = arith.addi %4, %5 : i32
+    affine.store %6, %arg1[%arg2] : memref<4xi32>
+  }
+  return
+}
+
+// CHECK: func.func @top(%arg0: memref<4xi32>) attributes {top_func} {
+// CHECK:   %[[BUF0:.+]] = memref.alloc() : memref<16xi32, #[[CYCLIC4]]>
+// CHECK:   %[[BUF1:.+]] = memref.alloc() : memref<16xi32, #[[CYCLIC2]]>
+// CHECK:   %[[BUF2:.+]] = memref.alloc() : memref<16xi32, #[[CYCLIC4]]>
+// CHECK:   %[[BUF3:.+]] = memref.alloc() : memref<8xi32>
+// CHECK:   %[[BUF4:.+]] = memref.alloc() : memref<4xi32>
+// CHECK:   call @mid(%[[BUF0]], %[[BUF1]], %arg0) : (memref<16xi32, #[[CYCLIC4]]>, memref<16xi32, #[[CYCLIC2]]>, memref<4xi32>) -> ()
+// CHECK:   call @left(%[[BUF2]], %[[BUF3]]) : (memref<16xi32, #[[CYCLIC4]]>, memref<8xi32>) -> ()
+// CHECK:   call @right(%[[BUF2]], %[[BUF4]]) : (memref<16xi32, #[[CYCLIC4]]>, memref<4xi32>) -> ()
+func.func @top(%arg0: memref<4xi32>) attributes {top_func} {
+  %0 = memref.alloc() : memref<16xi32>
+  %1 = memref.alloc() : memref<16xi32>
+  %2 = memref.alloc() : memref<16xi32>
+  %3 = memref.alloc() : memref<8xi32>
+  %4 = memref.alloc() : memref<4xi32>
+  call @mid(%0, %1, %arg0) : (memref<16xi32>, memref<16xi32>, memref<4xi32>) -> ()
+  call @left(%2, %3) : (memref<16xi32>, memref<8xi32>) -> ()
+  call @right(%2, %4) : (memref<16xi32>, memref<4xi32>) -> ()
+  return
+}
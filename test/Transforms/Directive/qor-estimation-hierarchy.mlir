@@ -0,0 +1,34 @@
+// RUN: scalehls-opt -scalehls-qor-estimation="target-spec=%S/config.json" %s | FileCheck %s
+
+module {
+  // CHECK: func.func @mul({{.*}}resource = #hls.r<lut=0, dsp=3, bram=0>, timing = #hls.t<0 -> 6, 6, 6>
+  func.func @mul(%arg0: f32, %arg1: f32) -> f32 {
+    %0 = arith.mulf %arg0, %arg1 : f32
+    return %0 : f32
+  }
+
+  // Sequential calls share one instance of the sub-function.
+  // CHECK: func.func @sequential({{.*}}resource = #hls.r<lut=0, dsp=3, bram=0>, timing = #hls.t<0 -> 14, 14, 14>
+  func.func @sequential(%arg0: f32, %arg1: f32) -> f32 attributes {top_func} {
+    %0 = func.call @mul(%arg0, %arg1) : (f32, f32) -> f32
+    %1 = func.call @mul(%0, %arg1) : (f32, f32) -> f32
+    return %1 : f32
+  }
+
+  // Overlapped calls require one instance each.
+  // CHECK: func.func @parallel({{.*}}resource = #hls.r<lut=0, dsp=6, bram=0>, timing = #hls.t<0 -> 8, 8, 8>
+  func.func @parallel(%arg0: f32, %arg1: f32) -> (f32, f32) attributes {top_func} {
+    %0 = func.call @mul(%arg0, %arg1) : (f32, f32) -> f32
+    %1 = func.call @mul(%arg1, %arg0) : (f32, f32) -> f32
+    return %0, %1 : f32, f32
+  }
+
+  // Each stage of a dataflow region is a separate instance, and the interval
+  // is bounded by the slowest stage.
+  // CHECK: func.func @dataflow({{.*}}resource = #hls.r<lut=0, dsp=6, bram=0>, timing = #hls.t<0 -> 14, 14, 6>
+  func.func @dataflow(%arg0: f32, %arg1: f32) -> f32 attributes {func_directive = #hls.fd<pipeline=false, targetInterval=1, dataflow=true>, top_func} {
+    %0 = func.call @mul(%arg0, %arg1) : (f32, f32) -> f32
+    %1 = func.call @mul(%0, %arg1) : (f32, f32) -> f32
+    return %1 : f32
+  }
+}
@@ -0,0 +1,30 @@
+// RUN: scalehls-opt -scalehls-qor-estimation="target-spec=%S/config.json" %s | FileCheck %s
+
+module {
+  // The 16-bit multiplier and divider are interpolated from the characterized
+  // bit widths, while the adder is combinational and takes no cycle.
+  // CHECK: func.func @integer({{.*}}resource = #hls.r<lut=0, dsp=1, bram=0>, timing = #hls.t<0 -> 25, 25, 25>
+  func.func @integer(%arg0: i16, %arg1: i16) -> i16 attributes {top_func} {
+    %0 = arith.muli %arg0, %arg1 : i16
+    %1 = arith.divui %0, %arg1 : i16
+    %2 = arith.addi %1, %arg0 : i16
+    return %2 : i16
+  }
+
+  // CHECK: func.func @double({{.*}}resource = #hls.r<lut=0, dsp=11, bram=0>, timing = #hls.t<0 -> 9, 9, 9>
+  func.func @double(%arg0: f64, %arg1: f64) -> f64 attributes {top_func} {
+    %0 = arith.mulf %arg0, %arg1 : f64
+    return %0 : f64
+  }
+
+  // Three 64-bit adders are chained in one 10ns cycle, while the fourth one
+  // exceeds the clock period and is registered in the cycle before.
+  // CHECK: func.func @chain({{.*}}resource = #hls.r<lut=0, dsp=0, bram=0>, timing = #hls.t<0 -> 3, 3, 3>
+  func.func @chain(%arg0: i64, %arg1: i64) -> i64 attributes {top_func} {
+    %0 = arith.addi %arg0, %arg1 : i64
+    %1 = arith.addi %0, %arg1 : i64
+    %2 = arith.addi %1, %arg1 : i64
+    %3 = arith.addi %2, %arg1 : i64
+    return %3 : i64
+  }
+}
@@ -0,0 +1,68 @@
+// RUN: scalehls-opt -scalehls-affine-loop-fusion="fusion-compute-tolerance=100.0 fusion-estimator-aware" %s | FileCheck %s
+
+// The fused loop nest saves the latency of one loop nest and is kept.
+// CHECK-LABEL: func.func @accept
+// CHECK:       hls.dataflow.task {
+// CHECK:         affine.for
+// CHECK-NOT:     affine.for
+// CHECK:           arith.muli
+// CHECK-NOT:     affine.for
+// CHECK:           arith.addi
+// CHECK-NOT:     affine.for
+// CHECK:       return
+func.func @accept(%arg0: memref<16xi32>, %arg1: memref<16xi32>) {
+  %c1_i32 = arith.constant 1 : i32
+  hls.dataflow.dispatch {
+    hls.dataflow.task {
+      %0 = hls.dataflow.buffer {depth = 1 : i32} : memref<16xi32>
+      affine.for %i = 0 to 16 {
+        %1 = affine.load %arg0[%i] : memref<16xi32>
+        %2 = arith.muli %1, %1 : i32
+        affine.store %2, %0[%i] : memref<16xi32>
+      }
+      affine.for %i = 0 to 16 {
+        %1 = affine.load %0[%i] : memref<16xi32>
+        %2 = arith.addi %1, %c1_i32 : i32
+        affine.store %2, %arg1[%i] : memref<16xi32>
+      }
+    }
+  }
+  return
+}
+
+// The fused loop nest recomputes the producer in every iteration of the outer
+// loop, which is estimated to be slower and is rolled back.
+// CHECK-LABEL: func.func @rollback
+// CHECK:       hls.dataflow.task {
+// CHECK:         %[[BUF:.+]] = hls.dataflow.buffer {depth = 1 : i32} : memref<16xi32>
+// CHECK:         affine.for %[[I:.+]] = 0 to 16 {
+// CHECK:           arith.muli
+// CHECK:           affine.store %{{.+}}, %[[BUF]][%[[I]]] : memref<16xi32>
+// CHECK:         }
+// CHECK:         affine.for %[[J:.+]] = 0 to 16 {
+// CHECK-NEXT:      affine.for %[[K:.+]] = 0 to 16 {
+// CHECK-NOT:         arith.muli
+// CHECK:             affine.load %[[BUF]][%[[K]]] : memref<16xi32>
+// CHECK:             arith.addi
+// CHECK:             affine.store %{{.+}}, %arg1[%[[J]]] : memref<16xi32>
+func.func @rollback(%arg0: memref<16xi32>, %arg1: memref<16xi32>) {
+  hls.dataflow.dispatch {
+    hls.dataflow.task {
+      %0 = hls.dataflow.buffer {depth = 1 : i32} : memref<16xi32>
+      affine.for %i = 0 to 16 {
+        %1 = affine.load %arg0[%i] : memref<16xi32>
+        %2 = arith.muli %1, %1 : i32
+        affine.store %2, %0[%i] : memref<16xi32>
+      }
+      affine.for %j = 0 to 16 {
+        affine.for %k = 0 to 16 {
+          %1 = affine.load %0[%k] : memref<16xi32>
+          %2 = affine.load %arg1[%j] : memref<16xi32>
+          %3 = arith.addi %1, %2 : i32
+          affine.store %3, %arg1[%j] : memref<16xi32>
+        }
+      }
+    }
+  }
+  return
+}
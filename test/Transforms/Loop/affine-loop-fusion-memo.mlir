@@ -0,0 +1,51 @@
+// RUN: scalehls-opt -scalehls-affine-loop-fusion="fusion-compute-tolerance=100.0" %s | FileCheck %s
+
+// The two producers of the third loop nest are fused into it in sequence. The
+// fusion of the second producer erases it from in between the first producer
+// and the consumer, which must invalidate the memoized queries of the two, and
+// the fused consumer is then fused into the last loop nest. All loop nests end
+// up in a single one.
+// CHECK-LABEL: func.func @chain
+// CHECK:       hls.dataflow.task {
+// CHECK:         affine.for
+// CHECK-NOT:     affine.for
+// CHECK-DAG:       arith.muli
+// CHECK-DAG:       arith.subi
+// CHECK-NOT:     affine.for
+// CHECK:           arith.addi
+// CHECK-NOT:     affine.for
+// CHECK:           arith.shli
+// CHECK-NOT:     affine.for
+// CHECK:       return
+func.func @chain(%arg0: memref<16xi32>, %arg1: memref<16xi32>, %arg2: memref<16xi32>) {
+  %c1_i32 = arith.constant 1 : i32
+  hls.dataflow.dispatch {
+    hls.dataflow.task {
+      %0 = hls.dataflow.buffer {depth = 1 : i32} : memref<16xi32>
+      %1 = hls.dataflow.buffer {depth = 1 : i32} : memref<16xi32>
+      %2 = hls.dataflow.buffer {depth = 1 : i32} : memref<16xi32>
+      affine.for %i = 0 to 16 {
+        %3 = affine.load %arg0[%i] : memref<16xi32>
+        %4 = arith.muli %3, %3 : i32
+        affine.store %4, %0[%i] : memref<16xi32>
+      }
+      affine.for %i = 0 to 16 {
+        %3 = affine.load %arg1[%i] : memref<16xi32>
+        %4 = arith.subi %3, %c1_i32 : i32
+        affine.store %4, %1[%i] : memref<16xi32>
+      }
+      affine.for %i = 0 to 16 {
+        %3 = affine.load %0[%i] : memref<16xi32>
+        %4 = affine.load %1[%i] : memref<16xi32>
+        %5 = arith.addi %3, %4 : i32
+        affine.store %5, %2[%i] : memref<16xi32>
+      }
+      affine.for %i = 0 to 16 {
+        %3 = affine.load %2[%i] : memref<16xi32>
+        %4 = arith.shli %3, %c1_i32 : i32
+        affine.store %4, %arg2[%i] : memref<16xi32>
+      }
+    }
+  }
+  return
+}
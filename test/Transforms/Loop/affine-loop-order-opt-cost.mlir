@@ -0,0 +1,39 @@
+// RUN: scalehls-opt -scalehls-affine-loop-order-opt %s | FileCheck %s
+
+// Pipelining the short loop only costs a reuse distance of 4 iterations on
+// %arg1, which is shorter than the 16 iterations on %arg0 of the other order.
+// CHECK-LABEL: func.func @short_bound
+// CHECK:         affine.for %[[I:.+]] = 0 to 16 {
+// CHECK-NEXT:      affine.for %[[J:.+]] = 0 to 4 {
+// CHECK-NEXT:        affine.load %arg0[%[[I]]] : memref<16xf32>
+// CHECK-NEXT:        affine.load %arg1[%[[J]]] : memref<4xf32>
+func.func @short_bound(%arg0: memref<16xf32>, %arg1: memref<4xf32>, %arg2: memref<16x4xf32>) {
+  affine.for %i = 0 to 16 {
+    affine.for %j = 0 to 4 {
+      %0 = affine.load %arg0[%i] : memref<16xf32>
+      %1 = affine.load %arg1[%j] : memref<4xf32>
+      %2 = arith.mulf %0, %1 : f32
+      affine.store %2, %arg2[%i, %j] : memref<16x4xf32>
+    }
+  }
+  return
+}
+
+// The loop with an unknown bound is assumed to be long, and is hoisted out of
+// the pipelined loop.
+// CHECK-LABEL: func.func @unknown_bound
+// CHECK:         affine.for %[[J:.+]] = 0 to %arg3 {
+// CHECK-NEXT:      affine.for %[[I:.+]] = 0 to 16 {
+// CHECK-NEXT:        affine.load %arg0[%[[I]]] : memref<16xf32>
+// CHECK-NEXT:        affine.load %arg1[%[[J]]] : memref<?xf32>
+func.func @unknown_bound(%arg0: memref<16xf32>, %arg1: memref<?xf32>, %arg2: memref<16x?xf32>, %arg3: index) {
+  affine.for %i = 0 to 16 {
+    affine.for %j = 0 to %arg3 {
+      %0 = affine.load %arg0[%i] : memref<16xf32>
+      %1 = affine.load %arg1[%j] : memref<?xf32>
+      %2 = arith.mulf %0, %1 : f32
+      affine.store %2, %arg2[%i, %j] : memref<16x?xf32>
+    }
+  }
+  return
+}
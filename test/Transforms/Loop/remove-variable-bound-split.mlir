@@ -0,0 +1,74 @@
+// RUN: scalehls-opt -scalehls-remove-variable-bound %s | FileCheck %s --check-prefix=GUARD
+// RUN: scalehls-opt -scalehls-remove-variable-bound="split-iter-space" %s | FileCheck %s --check-prefix=SPLIT
+
+#lb = affine_map<(d0) -> (d0)>
+#ub = affine_map<(d0) -> (d0 + 4, 10)>
+
+// The maximum of the upper bound is reached with the lower bound of %i and the
+// upper bound of %j, which must be included in the corner enumeration.
+// GUARD-LABEL: func.func @corner
+// GUARD:         affine.for %[[I:.+]] = 0 to 4 {
+// GUARD:           affine.for %[[J:.+]] = 0 to 4 {
+// GUARD:             affine.for %[[K:.+]] = 0 to 7 {
+// GUARD:               affine.if #{{.+}}(%[[I]], %[[J]], %[[K]]) {
+func.func @corner(%arg0: memref<8xf32>) {
+  affine.for %i = 0 to 4 {
+    affine.for %j = 0 to 4 {
+      affine.for %k = 0 to affine_map<(d0, d1) -> (d1 - d0 + 4)>(%i, %j) {
+        %0 = affine.load %arg0[%k] : memref<8xf32>
+        %1 = arith.addf %0, %0 : f32
+        affine.store %1, %arg0[%k] : memref<8xf32>
+      }
+    }
+  }
+  return
+}
+
+// The tiled loop is split into full tiles and a remainder tile, where no guard
+// is created.
+// SPLIT-LABEL: func.func @tile_remainder
+// SPLIT-SAME:    %[[ARG0:.+]]: memref<10xf32>
+// SPLIT-NOT:     affine.if
+// SPLIT:         affine.for %[[I:.+]] = 0 to 8 step 4 {
+// SPLIT:           affine.for %[[J:.+]] = 0 to 4 {
+// SPLIT:             %[[IDX:.+]] = affine.apply #{{.+}}({{.*}}%[[J]]{{.*}})
+// SPLIT:             affine.load %[[ARG0]][%[[IDX]]] : memref<10xf32>
+// SPLIT:           }
+// SPLIT:         }
+// SPLIT:         affine.for %[[R:.+]] = 8 to 10 {
+// SPLIT:           affine.load %[[ARG0]][%[[R]]] : memref<10xf32>
+// SPLIT:         }
+// SPLIT-NOT:     affine.if
+// SPLIT:         return
+func.func @tile_remainder(%arg0: memref<10xf32>) {
+  affine.for %i = 0 to 10 step 4 {
+    affine.for %j = #lb(%i) to min #ub(%i) {
+      %0 = affine.load %arg0[%j] : memref<10xf32>
+      %1 = arith.addf %0, %0 : f32
+      affine.store %1, %arg0[%j] : memref<10xf32>
+    }
+  }
+  return
+}
+
+// The tiled loop is not the outermost loop of the band, thus is not split to
+// keep the band perfect. Guards are created instead.
+// SPLIT-LABEL: func.func @inner_tile
+// SPLIT:         affine.for %{{.+}} = 0 to 2 {
+// SPLIT-NEXT:      affine.for %{{.+}} = 0 to 10 step 4 {
+// SPLIT-NEXT:        affine.for %{{.+}} = 0 to 10 {
+// SPLIT-NEXT:          affine.if
+// SPLIT-NOT:     affine.for %{{.+}} = 8 to 10
+// SPLIT:         return
+func.func @inner_tile(%arg0: memref<10xf32>) {
+  affine.for %a = 0 to 2 {
+    affine.for %i = 0 to 10 step 4 {
+      affine.for %j = #lb(%i) to min #ub(%i) {
+        %0 = affine.load %arg0[%j] : memref<10xf32>
+        %1 = arith.addf %0, %0 : f32
+        affine.store %1, %arg0[%j] : memref<10xf32>
+      }
+    }
+  }
+  return
+}
@@ -0,0 +1,49 @@
+// RUN: scalehls-opt -scalehls-affine-store-forward %s | FileCheck %s
+
+// The store to %arg0[%arg4 + 1] shares the linear part of the load but has a
+// different constant offset, thus it never touches the loaded element and the
+// store to %arg0[%arg4] is forwarded across it.
+// CHECK-LABEL: func.func @forward_across_unrelated_store
+// CHECK:         affine.for %arg4 = 0 to 15 {
+// CHECK-NEXT:      affine.store %arg2, %arg0[%arg4] : memref<16xi32>
+// CHECK-NEXT:      affine.store %arg3, %arg0[%arg4 + 1] : memref<16xi32>
+// CHECK-NEXT:      affine.store %arg2, %arg1[%arg4] : memref<16xi32>
+// CHECK-NEXT:    }
+func.func @forward_across_unrelated_store(%arg0: memref<16xi32>, %arg1: memref<16xi32>, %arg2: i32, %arg3: i32) {
+  affine.for %arg4 = 0 to 15 {
+    affine.store %arg2, %arg0[%arg4] : memref<16xi32>
+    affine.store %arg3, %arg0[%arg4 + 1] : memref<16xi32>
+    %0 = affine.load %arg0[%arg4] : memref<16xi32>
+    affine.store %0, %arg1[%arg4] : memref<16xi32>
+  }
+  return
+}
+
+// The store to %arg0[symbol(%arg1)] may alias with the loaded element, thus
+// the store to %arg0[0] can't be forwarded.
+// CHECK-LABEL: func.func @blocked_by_aliasing_store
+// CHECK:         affine.store %arg2, %arg0[0] : memref<16xi32>
+// CHECK-NEXT:    affine.store %arg3, %arg0[symbol(%arg1)] : memref<16xi32>
+// CHECK-NEXT:    %[[LOAD:.+]] = affine.load %arg0[0] : memref<16xi32>
+// CHECK-NEXT:    return %[[LOAD]] : i32
+func.func @blocked_by_aliasing_store(%arg0: memref<16xi32>, %arg1: index, %arg2: i32, %arg3: i32) -> i32 {
+  affine.store %arg2, %arg0[0] : memref<16xi32>
+  affine.store %arg3, %arg0[symbol(%arg1)] : memref<16xi32>
+  %0 = affine.load %arg0[0] : memref<16xi32>
+  return %0 : i32
+}
+
+func.func private @external(memref<16xi32>)
+
+// The call may write any element of %arg0, thus the store can't be forwarded.
+// CHECK-LABEL: func.func @blocked_by_call
+// CHECK:         affine.store %arg1, %arg0[0] : memref<16xi32>
+// CHECK-NEXT:    call @external(%arg0) : (memref<16xi32>) -> ()
+// CHECK-NEXT:    %[[LOAD:.+]] = affine.load %arg0[0] : memref<16xi32>
+// CHECK-NEXT:    return %[[LOAD]] : i32
+func.func @blocked_by_call(%arg0: memref<16xi32>, %arg1: i32) -> i32 {
+  affine.store %arg1, %arg0[0] : memref<16xi32>
+  call @external(%arg0) : (memref<16xi32>) -> ()
+  %0 = affine.load %arg0[0] : memref<16xi32>
+  return %0 : i32
+}
@@ -0,0 +1,32 @@
+// RUN: scalehls-opt -scalehls-collapse-memref-unit-dims %s | FileCheck %s
+
+// CHECK-LABEL: func.func @forward
+// CHECK-SAME:    %[[ARG0:.+]]: memref<4xi32>
+func.func @forward(%arg0: memref<4xi32>) {
+  // Dense values are reshaped, while resource values keep referring to the
+  // same blob.
+  // CHECK: %[[DENSE:.+]] = hls.dataflow.const_buffer {value = dense<[1, 2, 3, 4]> : tensor<4xi32>} : memref<4xi32>
+  // CHECK: %[[RESOURCE:.+]] = hls.dataflow.const_buffer {value = dense_resource<weights> : tensor<4xi32>} : memref<4xi32>
+  %0 = hls.dataflow.const_buffer {value = dense<[[1, 2, 3, 4]]> : tensor<1x4xi32>} : memref<1x4xi32>
+  %1 = hls.dataflow.const_buffer {value = dense_resource<weights> : tensor<1x4xi32>} : memref<1x4xi32>
+
+  // CHECK: affine.for %[[I:.+]] = 0 to 4 {
+  // CHECK:   affine.load %[[DENSE]][%[[I]]] : memref<4xi32>
+  // CHECK:   affine.load %[[RESOURCE]][%[[I]]] : memref<4xi32>
+  affine.for %i = 0 to 4 {
+    %2 = affine.load %0[0, %i] : memref<1x4xi32>
+    %3 = affine.load %1[0, %i] : memref<1x4xi32>
+    %4 = arith.addi %2, %3 : i32
+    affine.store %4, %arg0[%i] : memref<4xi32>
+  }
+  return
+}
+
+// CHECK: weights: "0x04000000010000000200000003000000FCFFFFFF"
+{-#
+  dialect_resources: {
+    builtin: {
+      weights: "0x04000000010000000200000003000000FCFFFFFF"
+    }
+  }
+#-}
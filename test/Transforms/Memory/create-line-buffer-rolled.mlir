@@ -0,0 +1,81 @@
+// RUN: scalehls-opt -scalehls-affine-loop-order-opt -scalehls-create-line-buffer %s | FileCheck %s
+
+// The nests are lowered from linalg.pooling_nchw_max and
+// linalg.conv_2d_nchw_fchw, where the kernel loops are rolled and may be
+// reordered by the loop order optimization. The kernel loops are moved
+// innermost and fully unrolled, and the output row and column loops are
+// rewritten to stream the input through a line buffer.
+
+// CHECK-LABEL: func.func @pool
+// CHECK:         %[[LINE:.+]] = hls.dataflow.buffer {depth = 1 : i32} : memref<1x8xf32>
+// CHECK:         %[[WINDOW:.+]] = hls.dataflow.buffer {depth = 1 : i32} : memref<2x2xf32>
+// CHECK-NOT:     affine.for %{{.+}} = 0 to 2 {
+// CHECK:         affine.for %[[H:.+]] = 0 to 8 {
+// CHECK-NEXT:      affine.for %[[W:.+]] = 0 to 8 {
+// CHECK-NEXT:        affine.load %arg0[%{{.+}}, %{{.+}}, %[[H]], %[[W]]] : memref<1x4x8x8xf32>
+// CHECK:             affine.if
+// CHECK-NOT:           affine.load %arg0
+// CHECK-DAG:           affine.load %[[WINDOW]][0, 0] : memref<2x2xf32>
+// CHECK-DAG:           affine.load %[[WINDOW]][0, 1] : memref<2x2xf32>
+// CHECK-DAG:           affine.load %[[WINDOW]][1, 0] : memref<2x2xf32>
+// CHECK-DAG:           affine.load %[[WINDOW]][1, 1] : memref<2x2xf32>
+// CHECK:               arith.maxf
+// CHECK-NOT:         affine.for
+// CHECK:         return
+func.func @pool(%arg0: memref<1x4x8x8xf32>, %arg1: memref<1x4x4x4xf32>) {
+  affine.for %n = 0 to 1 {
+    affine.for %c = 0 to 4 {
+      affine.for %oh = 0 to 4 {
+        affine.for %ow = 0 to 4 {
+          affine.for %kh = 0 to 2 {
+            affine.for %kw = 0 to 2 {
+              %0 = affine.load %arg0[%n, %c, %oh * 2 + %kh, %ow * 2 + %kw] : memref<1x4x8x8xf32>
+              %1 = affine.load %arg1[%n, %c, %oh, %ow] : memref<1x4x4x4xf32>
+              %2 = arith.maxf %1, %0 : f32
+              affine.store %2, %arg1[%n, %c, %oh, %ow] : memref<1x4x4x4xf32>
+            }
+          }
+        }
+      }
+    }
+  }
+  return
+}
+
+// The input channel loop is a reduction loop but not a kernel loop, thus it is
+// moved out of the row and column loops and a line buffer is used per channel.
+// CHECK-LABEL: func.func @conv
+// CHECK:         %[[LINE:.+]] = hls.dataflow.buffer {depth = 1 : i32} : memref<2x6xf32>
+// CHECK:         %[[WINDOW:.+]] = hls.dataflow.buffer {depth = 1 : i32} : memref<3x3xf32>
+// CHECK-NOT:     affine.for %{{.+}} = 0 to 3 {
+// CHECK:         affine.for %[[H:.+]] = 0 to 6 {
+// CHECK-NEXT:      affine.for %[[W:.+]] = 0 to 6 {
+// CHECK-NEXT:        affine.load %arg0[%{{.+}}, %{{.+}}, %[[H]], %[[W]]] : memref<1x2x6x6xf32>
+// CHECK:             affine.if
+// CHECK-NOT:           affine.load %arg0
+// CHECK-COUNT-9:       affine.load %[[WINDOW]]
+// CHECK-NOT:         affine.for
+// CHECK:         return
+func.func @conv(%arg0: memref<1x2x6x6xf32>, %arg1: memref<2x2x3x3xf32>, %arg2: memref<1x2x4x4xf32>) {
+  affine.for %n = 0 to 1 {
+    affine.for %f = 0 to 2 {
+      affine.for %oh = 0 to 4 {
+        affine.for %ow = 0 to 4 {
+          affine.for %c = 0 to 2 {
+            affine.for %kh = 0 to 3 {
+              affine.for %kw = 0 to 3 {
+                %0 = affine.load %arg0[%n, %c, %oh + %kh, %ow + %kw] : memref<1x2x6x6xf32>
+                %1 = affine.load %arg1[%f, %c, %kh, %kw] : memref<2x2x3x3xf32>
+                %2 = affine.load %arg2[%n, %f, %oh, %ow] : memref<1x2x4x4xf32>
+                %3 = arith.mulf %0, %1 : f32
+                %4 = arith.addf %2, %3 : f32
+                affine.store %4, %arg2[%n, %f, %oh, %ow] : memref<1x2x4x4xf32>
+              }
+            }
+          }
+        }
+      }
+    }
+  }
+  return
+}
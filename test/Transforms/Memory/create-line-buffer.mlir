@@ -0,0 +1,125 @@
+// RUN: scalehls-opt -scalehls-create-line-buffer %s | FileCheck %s
+
+// CHECK-DAG: #[[ROW:.+]] = affine_map<(d0, d1) -> (d0 - 2)>
+// CHECK-DAG: #[[COL:.+]] = affine_map<(d0, d1) -> (d1 - 2)>
+// CHECK-DAG: #[[POOL_ROW:.+]] = affine_map<(d0, d1) -> ((d0 - 1) floordiv 2)>
+// CHECK-DAG: #[[POOL_COL:.+]] = affine_map<(d0, d1) -> ((d1 - 1) floordiv 2)>
+// CHECK-DAG: #[[SET:.+]] = affine_set<(d0, d1) : (d0 - 2 >= 0, d1 - 2 >= 0)>
+// CHECK-DAG: #[[POOL_SET:.+]] = affine_set<(d0, d1) : (d0 - 1 >= 0, d1 - 1 >= 0, (d0 - 1) mod 2 == 0, (d1 - 1) mod 2 == 0)>
+
+// CHECK-LABEL: func.func @stencil
+// CHECK-SAME:    %[[ARG0:.+]]: memref<10x10xf32>, %[[ARG1:.+]]: memref<8x8xf32>
+// CHECK:         %[[LINE:.+]] = hls.dataflow.buffer {depth = 1 : i32} : memref<2x10xf32>
+// CHECK:         %[[WINDOW:.+]] = hls.dataflow.buffer {depth = 1 : i32} : memref<3x3xf32>
+// CHECK:         affine.for %[[H:.+]] = 0 to 10 {
+// CHECK:           affine.for %[[W:.+]] = 0 to 10 {
+// CHECK:             %[[V:.+]] = affine.load %[[ARG0]][%[[H]], %[[W]]] : memref<10x10xf32>
+// CHECK:             %[[L0:.+]] = affine.load %[[LINE]][0, %[[W]]] : memref<2x10xf32>
+// CHECK:             %[[L1:.+]] = affine.load %[[LINE]][1, %[[W]]] : memref<2x10xf32>
+// CHECK:             affine.store %[[L1]], %[[LINE]][0, %[[W]]] : memref<2x10xf32>
+// CHECK:             affine.store %[[V]], %[[LINE]][1, %[[W]]] : memref<2x10xf32>
+// CHECK:             affine.store %[[L0]], %[[WINDOW]][0, 2] : memref<3x3xf32>
+// CHECK:             affine.store %[[L1]], %[[WINDOW]][1, 2] : memref<3x3xf32>
+// CHECK:             affine.store %[[V]], %[[WINDOW]][2, 2] : memref<3x3xf32>
+// CHECK:             affine.if #[[SET]](%[[H]], %[[W]]) {
+// CHECK:               %[[I:.+]] = affine.apply #[[ROW]](%[[H]], %[[W]])
+// CHECK:               %[[J:.+]] = affine.apply #[[COL]](%[[H]], %[[W]])
+// CHECK-NOT:           affine.load %[[ARG0]]
+// CHECK:               affine.load %[[WINDOW]][0, 0] : memref<3x3xf32>
+// CHECK:               affine.load %[[WINDOW]][2, 2] : memref<3x3xf32>
+// CHECK:               affine.store %{{.+}}, %[[ARG1]][%[[I]], %[[J]]] : memref<8x8xf32>
+// CHECK:             }
+// CHECK:           } {point}
+// CHECK-NOT:       parallel
+// CHECK:         } {point}
+func.func @stencil(%arg0: memref<10x10xf32>, %arg1: memref<8x8xf32>) {
+  affine.for %h = 0 to 8 {
+    affine.for %w = 0 to 8 {
+      %0 = affine.load %arg0[%h, %w] : memref<10x10xf32>
+      %1 = affine.load %arg0[%h, %w + 1] : memref<10x10xf32>
+      %2 = affine.load %arg0[%h, %w + 2] : memref<10x10xf32>
+      %3 = affine.load %arg0[%h + 1, %w] : memref<10x10xf32>
+      %4 = affine.load %arg0[%h + 1, %w + 1] : memref<10x10xf32>
+      %5 = affine.load %arg0[%h + 1, %w + 2] : memref<10x10xf32>
+      %6 = affine.load %arg0[%h + 2, %w] : memref<10x10xf32>
+      %7 = affine.load %arg0[%h + 2, %w + 1] : memref<10x10xf32>
+      %8 = affine.load %arg0[%h + 2, %w + 2] : memref<10x10xf32>
+      %9 = arith.addf %0, %1 : f32
+      %10 = arith.addf %9, %2 : f32
+      %11 = arith.addf %10, %3 : f32
+      %12 = arith.addf %11, %4 : f32
+      %13 = arith.addf %12, %5 : f32
+      %14 = arith.addf %13, %6 : f32
+      %15 = arith.addf %14, %7 : f32
+      %16 = arith.addf %15, %8 : f32
+      affine.store %16, %arg1[%h, %w] : memref<8x8xf32>
+    } {parallel, point}
+  } {parallel, point}
+  return
+}
+
+// The strided windows of a pooling are computed in every other iteration of
+// the streaming loops.
+// CHECK-LABEL: func.func @pooling
+// CHECK-SAME:    %[[ARG0:.+]]: memref<8x8xf32>, %[[ARG1:.+]]: memref<4x4xf32>
+// CHECK:         %[[LINE:.+]] = hls.dataflow.buffer {depth = 1 : i32} : memref<1x8xf32>
+// CHECK:         %[[WINDOW:.+]] = hls.dataflow.buffer {depth = 1 : i32} : memref<2x2xf32>
+// CHECK:         affine.for %[[H:.+]] = 0 to 8 {
+// CHECK:           affine.for %[[W:.+]] = 0 to 8 {
+// CHECK:             affine.load %[[ARG0]][%[[H]], %[[W]]] : memref<8x8xf32>
+// CHECK:             affine.if #[[POOL_SET]](%[[H]], %[[W]]) {
+// CHECK:               %[[I:.+]] = affine.apply #[[POOL_ROW]](%[[H]], %[[W]])
+// CHECK:               %[[J:.+]] = affine.apply #[[POOL_COL]](%[[H]], %[[W]])
+// CHECK-NOT:           affine.load %[[ARG0]]
+// CHECK:               arith.maxf
+// CHECK:               affine.store %{{.+}}, %[[ARG1]][%[[I]], %[[J]]] : memref<4x4xf32>
+func.func @pooling(%arg0: memref<8x8xf32>, %arg1: memref<4x4xf32>) {
+  affine.for %h = 0 to 4 {
+    affine.for %w = 0 to 4 {
+      %0 = affine.load %arg0[%h * 2, %w * 2] : memref<8x8xf32>
+      %1 = affine.load %arg0[%h * 2, %w * 2 + 1] : memref<8x8xf32>
+      %2 = affine.load %arg0[%h * 2 + 1, %w * 2] : memref<8x8xf32>
+      %3 = affine.load %arg0[%h * 2 + 1, %w * 2 + 1] : memref<8x8xf32>
+      %4 = arith.maxf %0, %1 : f32
+      %5 = arith.maxf %2, %3 : f32
+      %6 = arith.maxf %4, %5 : f32
+      affine.store %6, %arg1[%h, %w] : memref<4x4xf32>
+    }
+  }
+  return
+}
+
+// A reversed access can't be streamed in the row major order.
+// CHECK-LABEL: func.func @reversed_coeff
+// CHECK-NOT:     hls.dataflow.buffer
+// CHECK:         affine.for %{{.+}} = 0 to 8 {
+// CHECK:         return
+func.func @reversed_coeff(%arg0: memref<10x10xf32>, %arg1: memref<8x8xf32>) {
+  affine.for %h = 0 to 8 {
+    affine.for %w = 0 to 8 {
+      %0 = affine.load %arg0[-%h + 9, %w] : memref<10x10xf32>
+      %1 = affine.load %arg0[-%h + 8, %w + 1] : memref<10x10xf32>
+      %2 = arith.addf %0, %1 : f32
+      affine.store %2, %arg1[%h, %w] : memref<8x8xf32>
+    }
+  }
+  return
+}
+
+// Loops with variable bounds or non-unit steps are not streamed.
+// CHECK-LABEL: func.func @variable_bound
+// CHECK-NOT:     hls.dataflow.buffer
+// CHECK:         affine.for %{{.+}} = 0 to %{{.+}} {
+// CHECK:           affine.for %{{.+}} = 0 to 8 step 2 {
+// CHECK:         return
+func.func @variable_bound(%arg0: memref<10x10xf32>, %arg1: memref<8x8xf32>, %arg2: index) {
+  affine.for %h = 0 to %arg2 {
+    affine.for %w = 0 to 8 step 2 {
+      %0 = affine.load %arg0[%h, %w] : memref<10x10xf32>
+      %1 = affine.load %arg0[%h + 1, %w + 1] : memref<10x10xf32>
+      %2 = arith.addf %0, %1 : f32
+      affine.store %2, %arg1[%h, %w] : memref<8x8xf32>
+    }
+  }
+  return
+}
@@ -0,0 +1,46 @@
+// RUN: scalehls-opt -scalehls-create-local-buffer="double-buffer" %s | FileCheck %s --check-prefix=DOUBLE
+// RUN: scalehls-opt -scalehls-create-local-buffer="double-buffer bram-budget=4" %s | FileCheck %s --check-prefix=BUDGET
+
+#map = affine_map<(d0) -> (d0 * 16)>
+
+// Without a budget, both local buffers inside of the tile loop are doubled.
+// With a budget of 4 BRAMs, only the smaller input buffer of 1 BRAM is doubled
+// on top of the 3 BRAMs of single buffers, and the output buffer stays single.
+// DOUBLE-LABEL: func.func @tiles
+// DOUBLE:         affine.for
+// DOUBLE:           hls.dataflow.buffer {depth = 2 : i32} : memref<16x64xi8, 7>
+// DOUBLE:           hls.dataflow.buffer {depth = 2 : i32} : memref<16x64xi32, 7>
+
+// BUDGET-LABEL: func.func @tiles
+// BUDGET:         affine.for
+// BUDGET:           hls.dataflow.buffer {depth = 2 : i32} : memref<16x64xi8, 7>
+// BUDGET:           hls.dataflow.buffer {depth = 1 : i32} : memref<16x64xi32, 7>
+func.func @tiles(%arg0: memref<64x64xi8, 12>, %arg1: memref<64x64xi32, 12>) {
+  affine.for %arg2 = 0 to 4 {
+    %0 = affine.apply #map(%arg2)
+    %subview = memref.subview %arg0[%0, 0] [16, 64] [1, 1] : memref<64x64xi8, 12> to memref<16x64xi8, strided<[64, 1], offset: ?>, 12>
+    %subview_0 = memref.subview %arg1[%0, 0] [16, 64] [1, 1] : memref<64x64xi32, 12> to memref<16x64xi32, strided<[64, 1], offset: ?>, 12>
+    affine.for %arg3 = 0 to 16 {
+      affine.for %arg4 = 0 to 64 {
+        %1 = affine.load %subview[%arg3, %arg4] : memref<16x64xi8, strided<[64, 1], offset: ?>, 12>
+        %2 = arith.extsi %1 : i8 to i32
+        affine.store %2, %subview_0[%arg3, %arg4] : memref<16x64xi32, strided<[64, 1], offset: ?>, 12>
+      }
+    }
+  }
+  return
+}
+
+// Local buffers outside of loops are not doubled.
+// DOUBLE-LABEL: func.func @single
+// DOUBLE:         hls.dataflow.buffer {depth = 1 : i32} : memref<16x64xi8, 7>
+func.func @single(%arg0: memref<64x64xi8, 12>, %arg1: memref<16x64xi8, 12>) {
+  %subview = memref.subview %arg0[0, 0] [16, 64] [1, 1] : memref<64x64xi8, 12> to memref<16x64xi8, strided<[64, 1]>, 12>
+  affine.for %arg2 = 0 to 16 {
+    affine.for %arg3 = 0 to 64 {
+      %0 = affine.load %subview[%arg2, %arg3] : memref<16x64xi8, strided<[64, 1]>, 12>
+      affine.store %0, %arg1[%arg2, %arg3] : memref<16x64xi8, 12>
+    }
+  }
+  return
+}
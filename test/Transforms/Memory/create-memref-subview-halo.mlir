@@ -0,0 +1,43 @@
+// RUN: scalehls-opt -scalehls-create-memref-subview="halo-window" %s | FileCheck %s
+
+// CHECK-DAG: #[[OFFSET:.+]] = affine_map<(d0) -> ((d0 * 3) floordiv 2)>
+// CHECK-DAG: #[[CLAMP:.+]] = affine_map<(d0) -> ((d0 * 3) floordiv 2, 2)>
+
+// The three-element window of the tail tile starts from 3, which would run
+// past the end of the memref. The offset is clamped to 2 and the access is
+// rebased on the clamped offset.
+// CHECK-LABEL: func.func @tail_tile
+// CHECK-SAME:    %[[ARG0:.+]]: memref<5xf32>
+// CHECK:         affine.for %[[I:.+]] = 0 to 3 {
+// CHECK:           affine.apply #[[OFFSET]](%[[I]])
+// CHECK:           %[[MIN:.+]] = affine.min #[[CLAMP]](%[[I]])
+// CHECK:           %[[VIEW:.+]] = memref.subview %[[ARG0]][%[[MIN]]] [3] [1]
+// CHECK:           affine.for %[[P:.+]] = 0 to 4 {
+// CHECK:             affine.load %[[VIEW]][{{.*}}%[[MIN]]{{.*}}] : memref<3xf32, strided<[1], offset: ?>>
+func.func @tail_tile(%arg0: memref<5xf32>, %arg1: memref<3x4xf32>) {
+  affine.for %i = 0 to 3 {
+    affine.for %p = 0 to 4 {
+      %0 = affine.load %arg0[(%i * 3 + %p) floordiv 2] : memref<5xf32>
+      affine.store %0, %arg1[%i, %p] : memref<3x4xf32>
+    } {point}
+  }
+  return
+}
+
+// All windows are in bounds, thus the offset is not clamped.
+// CHECK-LABEL: func.func @in_bounds
+// CHECK-SAME:    %[[ARG0:.+]]: memref<6xf32>
+// CHECK-NOT:     affine.min
+// CHECK:         %[[OFF:.+]] = affine.apply #[[OFFSET]](%{{.+}})
+// CHECK:         memref.subview %[[ARG0]][%[[OFF]]] [3] [1]
+// CHECK-NOT:     affine.min
+// CHECK:         return
+func.func @in_bounds(%arg0: memref<6xf32>, %arg1: memref<3x4xf32>) {
+  affine.for %i = 0 to 3 {
+    affine.for %p = 0 to 4 {
+      %0 = affine.load %arg0[(%i * 3 + %p) floordiv 2] : memref<6xf32>
+      affine.store %0, %arg1[%i, %p] : memref<3x4xf32>
+    } {point}
+  }
+  return
+}
@@ -0,0 +1,90 @@
+// RUN: scalehls-opt -scalehls-materialize-reduction -scalehls-reduce-initial-interval="fast-math num-partials=4" %s | FileCheck %s
+
+// The reduction materialized from the iteration argument is interleaved into
+// four partial accumulators, such that the loop-carried dependency distance
+// of the accumulation is four iterations.
+// CHECK-LABEL: func.func @dot
+// CHECK-SAME:    %[[A:.+]]: memref<16xf32>, %[[B:.+]]: memref<16xf32>, %[[INIT:.+]]: f32
+// CHECK-DAG:     %[[ZERO:.+]] = arith.constant 0.000000e+00 : f32
+// CHECK-DAG:     %[[ACC:.+]] = hls.dataflow.buffer {{.*}}: memref<1xf32>
+// CHECK-DAG:     %[[PARTIAL:.+]] = hls.dataflow.buffer {{.*}}: memref<4xf32>
+// CHECK:         affine.store %[[ZERO]], %[[PARTIAL]][0] : memref<4xf32>
+// CHECK-NEXT:    affine.store %[[ZERO]], %[[PARTIAL]][1] : memref<4xf32>
+// CHECK-NEXT:    affine.store %[[ZERO]], %[[PARTIAL]][2] : memref<4xf32>
+// CHECK-NEXT:    affine.store %[[ZERO]], %[[PARTIAL]][3] : memref<4xf32>
+// CHECK:         affine.for %[[I:.+]] = 0 to 16 {
+// CHECK:           %[[P:.+]] = affine.load %[[PARTIAL]][%[[I]] mod 4] : memref<4xf32>
+// CHECK:           %[[MUL:.+]] = arith.mulf
+// CHECK:           %[[SUM:.+]] = arith.addf %[[P]], %[[MUL]] : f32
+// CHECK:           affine.store %[[SUM]], %[[PARTIAL]][%[[I]] mod 4] : memref<4xf32>
+// CHECK:         }
+// CHECK:         %[[P0:.+]] = affine.load %[[PARTIAL]][0] : memref<4xf32>
+// CHECK:         %[[P1:.+]] = affine.load %[[PARTIAL]][1] : memref<4xf32>
+// CHECK:         %[[P2:.+]] = affine.load %[[PARTIAL]][2] : memref<4xf32>
+// CHECK:         %[[P3:.+]] = affine.load %[[PARTIAL]][3] : memref<4xf32>
+// CHECK:         %[[DST:.+]] = affine.load %[[ACC]][0] : memref<1xf32>
+// CHECK:         %[[S01:.+]] = arith.addf %[[P0]], %[[P1]] : f32
+// CHECK:         %[[S23:.+]] = arith.addf %[[P2]], %[[P3]] : f32
+// CHECK:         %[[S0123:.+]] = arith.addf %[[S01]], %[[S23]] : f32
+// CHECK:         %[[TOTAL:.+]] = arith.addf %[[S0123]], %[[DST]] : f32
+// CHECK:         affine.store %[[TOTAL]], %[[ACC]][0] : memref<1xf32>
+// CHECK:         %[[RES:.+]] = affine.load %[[ACC]][0] : memref<1xf32>
+// CHECK:         return %[[RES]] : f32
+func.func @dot(%arg0: memref<16xf32>, %arg1: memref<16xf32>, %arg2: f32) -> f32 {
+  %0 = affine.for %i = 0 to 16 iter_args(%acc = %arg2) -> (f32) {
+    %1 = affine.load %arg0[%i] : memref<16xf32>
+    %2 = affine.load %arg1[%i] : memref<16xf32>
+    %3 = arith.mulf %1, %2 : f32
+    %4 = arith.addf %acc, %3 : f32
+    affine.yield %4 : f32
+  }
+  return %0 : f32
+}
+
+// The number of accumulators is bounded by the trip count of the reduction
+// loop. The accumulators are re-initialized for each output pixel.
+// CHECK-LABEL: func.func @conv
+// CHECK-SAME:    %[[OUT:[^:]+]]: memref<16xf32>)
+// CHECK:         affine.for %[[I:.+]] = 0 to 16 {
+// CHECK:           %[[PARTIAL:.+]] = hls.dataflow.buffer {{.*}}: memref<3xf32>
+// CHECK:           affine.store %{{.+}}, %[[PARTIAL]][0] : memref<3xf32>
+// CHECK:           affine.store %{{.+}}, %[[PARTIAL]][2] : memref<3xf32>
+// CHECK:           affine.for %[[K:.+]] = 0 to 3 {
+// CHECK:             affine.load %[[PARTIAL]][%[[K]] mod 3] : memref<3xf32>
+// CHECK:             affine.store %{{.+}}, %[[PARTIAL]][%[[K]] mod 3] : memref<3xf32>
+// CHECK:           }
+// CHECK:           %[[P0:.+]] = affine.load %[[PARTIAL]][0] : memref<3xf32>
+// CHECK:           %[[P1:.+]] = affine.load %[[PARTIAL]][1] : memref<3xf32>
+// CHECK:           %[[P2:.+]] = affine.load %[[PARTIAL]][2] : memref<3xf32>
+// CHECK:           %[[DST:.+]] = affine.load %[[OUT]][%[[I]]] : memref<16xf32>
+// CHECK:           %[[S01:.+]] = arith.addf %[[P0]], %[[P1]] : f32
+// CHECK:           %[[S2:.+]] = arith.addf %[[P2]], %[[DST]] : f32
+// CHECK:           %[[TOTAL:.+]] = arith.addf %[[S01]], %[[S2]] : f32
+// CHECK:           affine.store %[[TOTAL]], %[[OUT]][%[[I]]] : memref<16xf32>
+func.func @conv(%arg0: memref<18xf32>, %arg1: memref<3xf32>, %arg2: memref<16xf32>) {
+  affine.for %i = 0 to 16 {
+    affine.for %k = 0 to 3 {
+      %0 = affine.load %arg0[%i + %k] : memref<18xf32>
+      %1 = affine.load %arg1[%k] : memref<3xf32>
+      %2 = arith.mulf %0, %1 : f32
+      %3 = affine.load %arg2[%i] : memref<16xf32>
+      %4 = arith.addf %3, %2 : f32
+      affine.store %4, %arg2[%i] : memref<16xf32>
+    }
+  }
+  return
+}
+
+// Integer reductions are finished in one cycle and are not interleaved.
+// CHECK-LABEL: func.func @integer
+// CHECK-NOT:     mod
+// CHECK:         return
+func.func @integer(%arg0: memref<16xi32>, %arg1: memref<1xi32>) {
+  affine.for %i = 0 to 16 {
+    %0 = affine.load %arg0[%i] : memref<16xi32>
+    %1 = affine.load %arg1[0] : memref<1xi32>
+    %2 = arith.addi %1, %0 : i32
+    affine.store %2, %arg1[0] : memref<1xi32>
+  }
+  return
+}
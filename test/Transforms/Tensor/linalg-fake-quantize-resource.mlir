@@ -0,0 +1,16 @@
+// RUN: scalehls-opt -scalehls-linalg-fake-quantize="resource-weights" %s | FileCheck %s
+
+// CHECK-LABEL: func.func @forward
+// CHECK-SAME:    (%[[ARG0:.+]]: tensor<4xi8>) -> tensor<4xi8>
+// CHECK:         %[[CST:.+]] = arith.constant dense_resource<[[BLOB:fake_weight.*]]> : tensor<4xi8>
+// CHECK:         %[[ADD:.+]] = arith.addi %[[ARG0]], %[[CST]] : tensor<4xi8>
+// CHECK:         return %[[ADD]] : tensor<4xi8>
+func.func @forward(%arg0: tensor<4xf32>) -> tensor<4xf32> {
+  %cst = arith.constant dense<[1.0, 2.0, 3.0, 4.0]> : tensor<4xf32>
+  %0 = arith.addf %arg0, %cst : tensor<4xf32>
+  return %0 : tensor<4xf32>
+}
+
+// The random weights are written into a blob with one byte per element.
+// CHECK: dialect_resources
+// CHECK: [[BLOB]]: "0x01000000{{[0-9A-F]+}}"
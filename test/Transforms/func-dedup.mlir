@@ -0,0 +1,93 @@
+// RUN: scalehls-opt -scalehls-func-dedup %s | FileCheck %s
+
+module {
+  // Structurally identical functions are merged into the first one.
+  // CHECK: func.func @sub0(%arg0: memref<16xf32>) {
+  // CHECK-NOT: func.func @sub1
+  func.func @sub0(%arg0: memref<16xf32>) {
+    affine.for %i = 0 to 16 {
+      %0 = affine.load %arg0[%i] : memref<16xf32>
+      %1 = arith.addf %0, %0 : f32
+      affine.store %1, %arg0[%i] : memref<16xf32>
+    }
+    return
+  }
+  func.func @sub1(%arg0: memref<16xf32>) {
+    affine.for %i = 0 to 16 {
+      %0 = affine.load %arg0[%i] : memref<16xf32>
+      %1 = arith.addf %0, %0 : f32
+      affine.store %1, %arg0[%i] : memref<16xf32>
+    }
+    return
+  }
+
+  // Functions only differing in constants are merged, where the constants are
+  // lifted into arguments.
+  // CHECK: func.func @scale0(%arg0: memref<16xf32>, %arg1: f32) {
+  // CHECK-NOT: arith.constant
+  // CHECK:   arith.mulf %{{.+}}, %arg1 : f32
+  // CHECK-NOT: func.func @scale1
+  func.func @scale0(%arg0: memref<16xf32>) {
+    %cst = arith.constant 2.000000e+00 : f32
+    affine.for %i = 0 to 16 {
+      %0 = affine.load %arg0[%i] : memref<16xf32>
+      %1 = arith.mulf %0, %cst : f32
+      affine.store %1, %arg0[%i] : memref<16xf32>
+    }
+    return
+  }
+  func.func @scale1(%arg0: memref<16xf32>) {
+    %cst = arith.constant 3.000000e+00 : f32
+    affine.for %i = 0 to 16 {
+      %0 = affine.load %arg0[%i] : memref<16xf32>
+      %1 = arith.mulf %0, %cst : f32
+      affine.store %1, %arg0[%i] : memref<16xf32>
+    }
+    return
+  }
+
+  // Index constants defining loop bounds are not lifted, such that the bounds
+  // are kept static.
+  // CHECK: func.func @bound0(%arg0: memref<16xf32>) {
+  // CHECK:   %c8 = arith.constant 8 : index
+  // CHECK: func.func @bound1(%arg0: memref<16xf32>) {
+  // CHECK:   %c16 = arith.constant 16 : index
+  func.func @bound0(%arg0: memref<16xf32>) {
+    %c8 = arith.constant 8 : index
+    affine.for %i = 0 to %c8 {
+      %0 = affine.load %arg0[%i] : memref<16xf32>
+      %1 = arith.addf %0, %0 : f32
+      affine.store %1, %arg0[%i] : memref<16xf32>
+    }
+    return
+  }
+  func.func @bound1(%arg0: memref<16xf32>) {
+    %c16 = arith.constant 16 : index
+    affine.for %i = 0 to %c16 {
+      %0 = affine.load %arg0[%i] : memref<16xf32>
+      %1 = arith.addf %0, %0 : f32
+      affine.store %1, %arg0[%i] : memref<16xf32>
+    }
+    return
+  }
+
+  // All calls are redirected with their attributes kept.
+  // CHECK: func.func @top(%arg0: memref<16xf32>) attributes {top_func} {
+  // CHECK:   call @sub0(%arg0) : (memref<16xf32>) -> ()
+  // CHECK:   call @sub0(%arg0) {inline} : (memref<16xf32>) -> ()
+  // CHECK:   %[[CST0:.+]] = arith.constant 2.000000e+00 : f32
+  // CHECK:   call @scale0(%arg0, %[[CST0]]) : (memref<16xf32>, f32) -> ()
+  // CHECK:   %[[CST1:.+]] = arith.constant 3.000000e+00 : f32
+  // CHECK:   call @scale0(%arg0, %[[CST1]]) {foo = 1 : i32} : (memref<16xf32>, f32) -> ()
+  // CHECK:   call @bound0(%arg0) : (memref<16xf32>) -> ()
+  // CHECK:   call @bound1(%arg0) : (memref<16xf32>) -> ()
+  func.func @top(%arg0: memref<16xf32>) attributes {top_func} {
+    call @sub0(%arg0) : (memref<16xf32>) -> ()
+    call @sub1(%arg0) {inline} : (memref<16xf32>) -> ()
+    call @scale0(%arg0) : (memref<16xf32>) -> ()
+    call @scale1(%arg0) {foo = 1 : i32} : (memref<16xf32>) -> ()
+    call @bound0(%arg0) : (memref<16xf32>) -> ()
+    call @bound1(%arg0) : (memref<16xf32>) -> ()
+    return
+  }
+}
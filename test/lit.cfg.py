@@ -68,6 +68,7 @@ tool_dirs = [config.scalehls_tools_dir, config.polygeist_tools_dir,
 tools = [
     'pyscalehls.py',
     'scalehls-opt',
+    'scalehls-run',
     'scalehls-translate',
     'cgeist'
 ]
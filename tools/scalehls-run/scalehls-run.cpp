@@ -0,0 +1,1228 @@
+//===----------------------------------------------------------------------===//
+//
+// Copyright 2020-2021 The ScaleHLS Authors.
+//
+//===----------------------------------------------------------------------===//
+
+#include "mlir/IR/BuiltinOps.h"
+#include "mlir/Parser/Parser.h"
+#include "mlir/Support/FileUtilities.h"
+#include "mlir/Support/MathExtras.h"
+#include "scalehls/Dialect/HLS/Utils.h"
+#include "scalehls/InitAllDialects.h"
+#include "llvm/ADT/TypeSwitch.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/InitLLVM.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/SourceMgr.h"
+#include <cmath>
+#include <deque>
+#include <random>
+
+using namespace mlir;
+using namespace scalehls;
+using namespace hls;
+
+static llvm::cl::opt<std::string> inputFilename(llvm::cl::Positional,
+                                                llvm::cl::desc("<input file>"),
+                                                llvm::cl::init("-"));
+
+static llvm::cl::opt<std::string> compareFilename(
+    "compare",
+    llvm::cl::desc("Run another IR snapshot with the same inputs and compare "
+                   "the outputs of the two runs"),
+    llvm::cl::init(""));
+
+static llvm::cl::opt<std::string>
+    funcName("func",
+             llvm::cl::desc("The function to run, which is the runtime "
+                            "function or the top function by default"),
+             llvm::cl::init(""));
+
+static llvm::cl::opt<std::string> inputDir(
+    "input-dir",
+    llvm::cl::desc("The directory of input data files, where arguments "
+                   "without a data file are randomly initialized"),
+    llvm::cl::init(""));
+
+static llvm::cl::opt<std::string> outputDir(
+    "output-dir",
+    llvm::cl::desc("The directory to write the inputs and golden outputs"),
+    llvm::cl::init(""));
+
+static llvm::cl::opt<unsigned>
+    seed("seed", llvm::cl::desc("The seed of random inputs"),
+         llvm::cl::init(0));
+
+static llvm::cl::opt<double>
+    tolerance("tolerance",
+              llvm::cl::desc("The relative and absolute tolerance of the "
+                             "output comparison"),
+              llvm::cl::init(1e-3));
+
+//===----------------------------------------------------------------------===//
+// Runtime Values
+//===----------------------------------------------------------------------===//
+
+namespace {
+struct Buffer;
+struct RtValue;
+using Stream = std::deque<RtValue>;
+
+/// A runtime value, which is an integer (including index and i1), a float, a
+/// memref buffer, or a stream channel.
+struct RtValue {
+  int64_t i = 0;
+  double f = 0;
+  std::shared_ptr<Buffer> buffer;
+  std::shared_ptr<Stream> stream;
+};
+
+/// The flat storage of a buffer. Float elements are held as double and
+/// rounded to the element type after each operation.
+struct Storage {
+  std::vector<int64_t> ints;
+  std::vector<double> floats;
+};
+
+/// A strided view of a flat storage. Indices are always the logical indices of
+/// the memref, such that layout maps, e.g., partition layouts, don't affect the
+/// data placement.
+struct Buffer {
+  Buffer(MemRefType type) : elementType(type.getElementType()) {
+    shape.append(type.getShape().begin(), type.getShape().end());
+    strides.resize(shape.size());
+    int64_t stride = 1;
+    for (int64_t d = shape.size() - 1; d >= 0; --d)
+      strides[d] = stride, stride *= shape[d];
+    storage = std::make_shared<Storage>();
+    if (isFloat())
+      storage->floats.resize(stride, 0);
+    else
+      storage->ints.resize(stride, 0);
+  }
+  Buffer(const Buffer &) = default;
+
+  bool isFloat() const { return elementType.isa<FloatType>(); }
+  int64_t getNumElements() const {
+    int64_t num = 1;
+    for (auto size : shape)
+      num *= size;
+    return num;
+  }
+
+  /// Call the function with the storage index of each element following the
+  /// row-major order of the logical shape.
+  void forEachElement(llvm::function_ref<void(int64_t)> func) const {
+    if (llvm::is_contained(shape, 0))
+      return;
+    SmallVector<int64_t, 4> indices(shape.size(), 0);
+    while (true) {
+      int64_t index = offset;
+      for (unsigned d = 0, e = shape.size(); d < e; ++d)
+        index += indices[d] * strides[d];
+      func(index);
+
+      int64_t d = shape.size() - 1;
+      for (; d >= 0; --d) {
+        if (++indices[d] < shape[d])
+          break;
+        indices[d] = 0;
+      }
+      if (d < 0)
+        return;
+    }
+  }
+
+  RtValue load(int64_t index) const {
+    RtValue value;
+    if (isFloat())
+      value.f = storage->floats[index];
+    else
+      value.i = storage->ints[index];
+    return value;
+  }
+  void store(int64_t index, const RtValue &value) {
+    if (isFloat())
+      storage->floats[index] = value.f;
+    else
+      storage->ints[index] = value.i;
+  }
+
+  Type elementType;
+  SmallVector<int64_t, 4> shape;
+  SmallVector<int64_t, 4> strides;
+  int64_t offset = 0;
+  std::shared_ptr<Storage> storage;
+};
+} // namespace
+
+static unsigned getIntWidth(Type type) {
+  if (auto intType = type.dyn_cast<IntegerType>())
+    return intType.getWidth();
+  return 64;
+}
+
+/// Wrap the value into the bit width of the integer type with sign extension,
+/// where i1 values are kept as 0 or 1.
+static int64_t wrapInt(Type type, int64_t value) {
+  auto width = getIntWidth(type);
+  if (width >= 64)
+    return value;
+  if (width == 1)
+    return value & 1;
+  return llvm::SignExtend64(value, width);
+}
+
+/// Return the zero-extended value of the integer type.
+static uint64_t zextInt(Type type, int64_t value) {
+  auto width = getIntWidth(type);
+  if (width >= 64)
+    return value;
+  return (uint64_t)value & llvm::maskTrailingOnes<uint64_t>(width);
+}
+
+static double wrapFloat(Type type, double value) {
+  if (type.isF64())
+    return value;
+  return (double)(float)value;
+}
+
+static RtValue getScalar(Type type, Attribute attr) {
+  RtValue value;
+  if (auto floatAttr = attr.dyn_cast<FloatAttr>())
+    value.f = wrapFloat(type, floatAttr.getValueAsDouble());
+  else if (auto intAttr = attr.dyn_cast<IntegerAttr>())
+    value.i = wrapInt(type, intAttr.getValue().getSExtValue());
+  return value;
+}
+
+/// Initialize the buffer with the dense elements attribute.
+static void initBuffer(Buffer &buffer, DenseElementsAttr attr) {
+  auto type = buffer.elementType;
+  if (attr.isSplat()) {
+    auto value = getScalar(type, attr.getSplatValue<Attribute>());
+    buffer.forEachElement([&](int64_t index) { buffer.store(index, value); });
+    return;
+  }
+  if (buffer.isFloat()) {
+    auto it = attr.getValues<APFloat>().begin();
+    buffer.forEachElement([&](int64_t index) {
+      buffer.storage->floats[index] =
+          wrapFloat(type, (*it++).convertToDouble());
+    });
+  } else {
+    auto it = attr.getValues<APInt>().begin();
+    buffer.forEachElement([&](int64_t index) {
+      buffer.storage->ints[index] = wrapInt(type, (*it++).getSExtValue());
+    });
+  }
+}
+
+/// Initialize the buffer with the dense resource elements attribute, whose
+/// elements are densely packed with their natural sizes and i1 elements take
+/// one byte. The blob is directly read without being converted.
+static LogicalResult initBuffer(Buffer &buffer,
+                                DenseResourceElementsAttr attr) {
+  auto blob = attr.getRawHandle().getBlob();
+  auto type = buffer.elementType;
+  if (!blob || !(type.isF32() || type.isF64() || type.isIntOrIndex()))
+    return failure();
+  unsigned width = type.isIndex() ? 64 : type.getIntOrFloatBitWidth();
+  auto numBytes = std::max(width, 8u) / 8;
+  if (width > 64 || (width > 1 && width % 8) ||
+      blob->getData().size() < attr.getNumElements() * numBytes)
+    return failure();
+
+  auto data = blob->getData().data();
+  int64_t offset = 0;
+  buffer.forEachElement([&](int64_t index) {
+    auto ptr = data + offset;
+    offset += numBytes;
+    if (type.isF32()) {
+      float value;
+      memcpy(&value, ptr, sizeof(float));
+      buffer.storage->floats[index] = value;
+    } else if (type.isF64()) {
+      memcpy(&buffer.storage->floats[index], ptr, sizeof(double));
+    } else {
+      uint64_t bits = 0;
+      memcpy(&bits, ptr, numBytes);
+      buffer.storage->ints[index] = wrapInt(type, bits);
+    }
+  });
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// Interpreter
+//===----------------------------------------------------------------------===//
+
+namespace {
+using ValueMap = DenseMap<Value, RtValue>;
+
+/// A reference interpreter of the affine, scf, arith, math, memref, and HLS
+/// dataflow operations. Dataflow nodes are executed sequentially in program
+/// order and stream channels are modeled as unbounded FIFOs.
+class Interpreter {
+public:
+  explicit Interpreter(ModuleOp module) : module(module) {}
+
+  LogicalResult runFunc(func::FuncOp func, ArrayRef<RtValue> args,
+                        SmallVectorImpl<RtValue> &results);
+
+private:
+  LogicalResult runBlock(Block &block, ArrayRef<RtValue> args, ValueMap &map,
+                         SmallVectorImpl<RtValue> *yields = nullptr);
+  LogicalResult runRegion(Region &region, ArrayRef<RtValue> args,
+                          ValueMap &map, Operation *op);
+  LogicalResult runOp(Operation *op, ValueMap &map);
+
+  LogicalResult runAffineFor(AffineForOp op, ValueMap &map);
+  LogicalResult runScfFor(scf::ForOp op, ValueMap &map);
+  LogicalResult runCall(func::CallOp op, ValueMap &map);
+  LogicalResult runSubView(memref::SubViewOp op, ValueMap &map);
+  LogicalResult runReshape(Operation *op, ValueMap &map);
+  LogicalResult runCopy(memref::CopyOp op, ValueMap &map);
+  LogicalResult runGetGlobal(memref::GetGlobalOp op, ValueMap &map);
+  LogicalResult runArithOp(Operation *op, ValueMap &map);
+
+  /// Return the storage index of the logical indices, or failure if any index
+  /// is out of bounds.
+  FailureOr<int64_t> getIndex(Operation *op, const Buffer &buffer,
+                              ArrayRef<int64_t> indices);
+
+  SmallVector<int64_t, 4> getInts(ValueRange values, ValueMap &map) {
+    SmallVector<int64_t, 4> ints;
+    for (auto value : values)
+      ints.push_back(map[value].i);
+    return ints;
+  }
+
+  ModuleOp module;
+  llvm::StringMap<std::shared_ptr<Buffer>> globals;
+};
+} // namespace
+
+/// Evaluate the affine expression with the given dimension and symbol values.
+static int64_t evalAffineExpr(AffineExpr expr, ArrayRef<int64_t> dims,
+                              ArrayRef<int64_t> syms) {
+  switch (expr.getKind()) {
+  case AffineExprKind::Constant:
+    return expr.cast<AffineConstantExpr>().getValue();
+  case AffineExprKind::DimId:
+    return dims[expr.cast<AffineDimExpr>().getPosition()];
+  case AffineExprKind::SymbolId:
+    return syms[expr.cast<AffineSymbolExpr>().getPosition()];
+  default:
+    break;
+  }
+  auto binary = expr.cast<AffineBinaryOpExpr>();
+  auto lhs = evalAffineExpr(binary.getLHS(), dims, syms);
+  auto rhs = evalAffineExpr(binary.getRHS(), dims, syms);
+  switch (expr.getKind()) {
+  case AffineExprKind::Add:
+    return lhs + rhs;
+  case AffineExprKind::Mul:
+    return lhs * rhs;
+  case AffineExprKind::Mod:
+    return mod(lhs, rhs);
+  case AffineExprKind::FloorDiv:
+    return floorDiv(lhs, rhs);
+  case AffineExprKind::CeilDiv:
+    return ceilDiv(lhs, rhs);
+  default:
+    llvm_unreachable("unexpected affine expression kind");
+  }
+}
+
+static SmallVector<int64_t, 4> evalAffineMap(AffineMap map,
+                                             ArrayRef<int64_t> operands) {
+  auto dims = operands.take_front(map.getNumDims());
+  auto syms = operands.drop_front(map.getNumDims());
+  SmallVector<int64_t, 4> results;
+  for (auto expr : map.getResults())
+    results.push_back(evalAffineExpr(expr, dims, syms));
+  return results;
+}
+
+static bool evalIntegerSet(IntegerSet set, ArrayRef<int64_t> operands) {
+  auto dims = operands.take_front(set.getNumDims());
+  auto syms = operands.drop_front(set.getNumDims());
+  for (unsigned i = 0, e = set.getNumConstraints(); i < e; ++i) {
+    auto value = evalAffineExpr(set.getConstraint(i), dims, syms);
+    if (set.isEq(i) ? value != 0 : value < 0)
+      return false;
+  }
+  return true;
+}
+
+FailureOr<int64_t> Interpreter::getIndex(Operation *op, const Buffer &buffer,
+                                         ArrayRef<int64_t> indices) {
+  int64_t index = buffer.offset;
+  for (unsigned d = 0, e = indices.size(); d < e; ++d) {
+    if (indices[d] < 0 || indices[d] >= buffer.shape[d])
+      return op->emitError("accesses out of bounds at dimension ")
+             << d << " with index " << indices[d], failure();
+    index += indices[d] * buffer.strides[d];
+  }
+  return index;
+}
+
+LogicalResult Interpreter::runFunc(func::FuncOp func, ArrayRef<RtValue> args,
+                                   SmallVectorImpl<RtValue> &results) {
+  if (func.isExternal())
+    return func.emitError("is external and cannot be interpreted");
+  ValueMap map;
+  return runBlock(func.front(), args, map, &results);
+}
+
+LogicalResult Interpreter::runBlock(Block &block, ArrayRef<RtValue> args,
+                                    ValueMap &map,
+                                    SmallVectorImpl<RtValue> *yields) {
+  for (auto t : llvm::zip(block.getArguments(), args))
+    map[std::get<0>(t)] = std::get<1>(t);
+
+  for (auto &op : block) {
+    if (op.hasTrait<OpTrait::IsTerminator>()) {
+      if (yields)
+        for (auto operand : op.getOperands())
+          yields->push_back(map[operand]);
+      return success();
+    }
+    if (failed(runOp(&op, map)))
+      return failure();
+  }
+  return success();
+}
+
+/// Run the region and map the yielded values to the results of the op.
+LogicalResult Interpreter::runRegion(Region &region, ArrayRef<RtValue> args,
+                                     ValueMap &map, Operation *op) {
+  SmallVector<RtValue, 4> yields;
+  if (failed(runBlock(region.front(), args, map, &yields)))
+    return failure();
+  for (auto t : llvm::zip(op->getResults(), yields))
+    map[std::get<0>(t)] = std::get<1>(t);
+  return success();
+}
+
+LogicalResult Interpreter::runAffineFor(AffineForOp op, ValueMap &map) {
+  auto lbs = evalAffineMap(op.getLowerBoundMap(),
+                           getInts(op.getLowerBoundOperands(), map));
+  auto ubs = evalAffineMap(op.getUpperBoundMap(),
+                           getInts(op.getUpperBoundOperands(), map));
+  auto lb = *std::max_element(lbs.begin(), lbs.end());
+  auto ub = *std::min_element(ubs.begin(), ubs.end());
+
+  SmallVector<RtValue, 4> iterArgs;
+  for (auto operand : op.getIterOperands())
+    iterArgs.push_back(map[operand]);
+
+  for (auto iv = lb; iv < ub; iv += op.getStep()) {
+    SmallVector<RtValue, 4> args;
+    args.push_back(RtValue());
+    args.back().i = iv;
+    args.append(iterArgs.begin(), iterArgs.end());
+    iterArgs.clear();
+    if (failed(runBlock(*op.getBody(), args, map, &iterArgs)))
+      return failure();
+  }
+  for (auto t : llvm::zip(op.getResults(), iterArgs))
+    map[std::get<0>(t)] = std::get<1>(t);
+  return success();
+}
+
+LogicalResult Interpreter::runScfFor(scf::ForOp op, ValueMap &map) {
+  auto lb = map[op.getLowerBound()].i;
+  auto ub = map[op.getUpperBound()].i;
+  auto step = map[op.getStep()].i;
+  if (step <= 0)
+    return op.emitError("has non-positive step"), failure();
+
+  SmallVector<RtValue, 4> iterArgs;
+  for (auto operand : op.getInitArgs())
+    iterArgs.push_back(map[operand]);
+
+  for (auto iv = lb; iv < ub; iv += step) {
+    SmallVector<RtValue, 4> args;
+    args.push_back(RtValue());
+    args.back().i = iv;
+    args.append(iterArgs.begin(), iterArgs.end());
+    iterArgs.clear();
+    if (failed(runBlock(*op.getBody(), args, map, &iterArgs)))
+      return failure();
+  }
+  for (auto t : llvm::zip(op.getResults(), iterArgs))
+    map[std::get<0>(t)] = std::get<1>(t);
+  return success();
+}
+
+LogicalResult Interpreter::runCall(func::CallOp op, ValueMap &map) {
+  auto callee = module.lookupSymbol<func::FuncOp>(op.getCallee());
+  if (!callee)
+    return op.emitError("has unknown callee"), failure();
+
+  SmallVector<RtValue, 8> args;
+  for (auto operand : op.getOperands())
+    args.push_back(map[operand]);
+  SmallVector<RtValue, 4> results;
+  if (failed(runFunc(callee, args, results)))
+    return failure();
+  for (auto t : llvm::zip(op.getResults(), results))
+    map[std::get<0>(t)] = std::get<1>(t);
+  return success();
+}
+
+LogicalResult Interpreter::runSubView(memref::SubViewOp op, ValueMap &map) {
+  auto getInt = [&](OpFoldResult ofr) {
+    if (auto attr = ofr.dyn_cast<Attribute>())
+      return attr.cast<IntegerAttr>().getInt();
+    return map[ofr.get<Value>()].i;
+  };
+
+  auto &source = *map[op.getSource()].buffer;
+  auto view = std::make_shared<Buffer>(source);
+  view->shape.clear();
+  view->strides.clear();
+  auto droppedDims = op.getDroppedDims();
+  auto offsets = op.getMixedOffsets();
+  auto sizes = op.getMixedSizes();
+  auto strides = op.getMixedStrides();
+  for (unsigned d = 0, e = offsets.size(); d < e; ++d) {
+    view->offset += getInt(offsets[d]) * source.strides[d];
+    if (droppedDims.test(d))
+      continue;
+    view->shape.push_back(getInt(sizes[d]));
+    view->strides.push_back(getInt(strides[d]) * source.strides[d]);
+  }
+  map[op.getResult()].buffer = view;
+  return success();
+}
+
+/// Reshape operations share the storage of the source buffer, which must be
+/// contiguous.
+LogicalResult Interpreter::runReshape(Operation *op, ValueMap &map) {
+  auto &source = *map[op->getOperand(0)].buffer;
+  auto type = op->getResult(0).getType().dyn_cast<MemRefType>();
+  if (!type || !type.hasStaticShape())
+    return op->emitError("has unsupported result type"), failure();
+
+  auto view = std::make_shared<Buffer>(source);
+  auto contiguous = Buffer(MemRefType::get(source.shape, source.elementType));
+  if (source.strides != contiguous.strides)
+    return op->emitError("reshapes a non-contiguous buffer"), failure();
+
+  auto result = Buffer(type);
+  view->shape = result.shape;
+  view->strides = result.strides;
+  map[op->getResult(0)].buffer = view;
+  return success();
+}
+
+LogicalResult Interpreter::runCopy(memref::CopyOp op, ValueMap &map) {
+  auto &source = *map[op.getSource()].buffer;
+  auto &target = *map[op.getTarget()].buffer;
+  if (source.shape != target.shape)
+    return op.emitError("has mismatched shapes"), failure();
+
+  SmallVector<int64_t, 64> indices;
+  source.forEachElement([&](int64_t index) { indices.push_back(index); });
+  auto it = indices.begin();
+  target.forEachElement(
+      [&](int64_t index) { target.store(index, source.load(*it++)); });
+  return success();
+}
+
+LogicalResult Interpreter::runGetGlobal(memref::GetGlobalOp op,
+                                        ValueMap &map) {
+  auto &buffer = globals[op.getName()];
+  if (!buffer) {
+    auto global = module.lookupSymbol<memref::GlobalOp>(op.getName());
+    if (!global)
+      return op.emitError("has unknown global memref"), failure();
+    buffer = std::make_shared<Buffer>(op.getType());
+    if (auto initValue = global.getInitialValue()) {
+      if (auto denseAttr = initValue.value().dyn_cast<DenseElementsAttr>())
+        initBuffer(*buffer, denseAttr);
+      else if (auto resourceAttr =
+                   initValue.value().dyn_cast<DenseResourceElementsAttr>())
+        if (failed(initBuffer(*buffer, resourceAttr)))
+          return op.emitError("has unsupported initial value"), failure();
+    }
+  }
+  map[op.getResult()].buffer = buffer;
+  return success();
+}
+
+/// Run scalar arith and math operations.
+LogicalResult Interpreter::runArithOp(Operation *op, ValueMap &map) {
+  if (op->getNumResults() != 1)
+    return op->emitError("is not supported by the interpreter"), failure();
+  auto resultType = op->getResult(0).getType();
+  auto operandType = op->getNumOperands() ? op->getOperand(0).getType()
+                                          : resultType;
+  auto lhs = op->getNumOperands() > 0 ? map[op->getOperand(0)] : RtValue();
+  auto rhs = op->getNumOperands() > 1 ? map[op->getOperand(1)] : RtValue();
+  auto lhsU = zextInt(operandType, lhs.i);
+  auto rhsU = zextInt(operandType, rhs.i);
+  auto &result = map[op->getResult(0)];
+
+  auto setInt = [&](int64_t value) {
+    result.i = wrapInt(resultType, value);
+    return success();
+  };
+  auto setFloat = [&](double value) {
+    result.f = wrapFloat(resultType, value);
+    return success();
+  };
+  auto checkDivisor = [&]() {
+    if (rhs.i == 0)
+      return op->emitError("divides by zero"), failure();
+    return success();
+  };
+
+  return llvm::TypeSwitch<Operation *, LogicalResult>(op)
+      // Integer operations.
+      .Case<arith::AddIOp>([&](auto) { return setInt(lhsU + rhsU); })
+      .Case<arith::SubIOp>([&](auto) { return setInt(lhsU - rhsU); })
+      .Case<arith::MulIOp>([&](auto) { return setInt(lhsU * rhsU); })
+      .Case<arith::DivSIOp>([&](auto) {
+        return failed(checkDivisor()) ? failure() : setInt(lhs.i / rhs.i);
+      })
+      .Case<arith::DivUIOp>([&](auto) {
+        return failed(checkDivisor()) ? failure() : setInt(lhsU / rhsU);
+      })
+      .Case<arith::RemSIOp>([&](auto) {
+        return failed(checkDivisor()) ? failure() : setInt(lhs.i % rhs.i);
+      })
+      .Case<arith::RemUIOp>([&](auto) {
+        return failed(checkDivisor()) ? failure() : setInt(lhsU % rhsU);
+      })
+      .Case<arith::FloorDivSIOp>([&](auto) {
+        return failed(checkDivisor()) ? failure()
+                                      : setInt(floorDiv(lhs.i, rhs.i));
+      })
+      .Case<arith::CeilDivSIOp>([&](auto) {
+        return failed(checkDivisor()) ? failure()
+                                      : setInt(ceilDiv(lhs.i, rhs.i));
+      })
+      .Case<arith::AndIOp>([&](auto) { return setInt(lhs.i & rhs.i); })
+      .Case<arith::OrIOp>([&](auto) { return setInt(lhs.i | rhs.i); })
+      .Case<arith::XOrIOp>([&](auto) { return setInt(lhs.i ^ rhs.i); })
+      .Case<arith::ShLIOp>([&](auto) { return setInt(lhsU << (rhsU & 63)); })
+      .Case<arith::ShRSIOp>([&](auto) { return setInt(lhs.i >> (rhsU & 63)); })
+      .Case<arith::ShRUIOp>([&](auto) { return setInt(lhsU >> (rhsU & 63)); })
+      .Case<arith::MaxSIOp>(
+          [&](auto) { return setInt(std::max(lhs.i, rhs.i)); })
+      .Case<arith::MinSIOp>(
+          [&](auto) { return setInt(std::min(lhs.i, rhs.i)); })
+      .Case<arith::MaxUIOp>([&](auto) { return setInt(std::max(lhsU, rhsU)); })
+      .Case<arith::MinUIOp>([&](auto) { return setInt(std::min(lhsU, rhsU)); })
+      .Case<math::AbsIOp>([&](auto) { return setInt(std::abs(lhs.i)); })
+      .Case<arith::CmpIOp>([&](arith::CmpIOp cmp) {
+        switch (cmp.getPredicate()) {
+        case arith::CmpIPredicate::eq:
+          return setInt(lhs.i == rhs.i);
+        case arith::CmpIPredicate::ne:
+          return setInt(lhs.i != rhs.i);
+        case arith::CmpIPredicate::slt:
+          return setInt(lhs.i < rhs.i);
+        case arith::CmpIPredicate::sle:
+          return setInt(lhs.i <= rhs.i);
+        case arith::CmpIPredicate::sgt:
+          return setInt(lhs.i > rhs.i);
+        case arith::CmpIPredicate::sge:
+          return setInt(lhs.i >= rhs.i);
+        case arith::CmpIPredicate::ult:
+          return setInt(lhsU < rhsU);
+        case arith::CmpIPredicate::ule:
+          return setInt(lhsU <= rhsU);
+        case arith::CmpIPredicate::ugt:
+          return setInt(lhsU > rhsU);
+        case arith::CmpIPredicate::uge:
+          return setInt(lhsU >= rhsU);
+        }
+        llvm_unreachable("unexpected predicate");
+      })
+
+      // Float operations.
+      .Case<arith::AddFOp>([&](auto) { return setFloat(lhs.f + rhs.f); })
+      .Case<arith::SubFOp>([&](auto) { return setFloat(lhs.f - rhs.f); })
+      .Case<arith::MulFOp>([&](auto) { return setFloat(lhs.f * rhs.f); })
+      .Case<arith::DivFOp>([&](auto) { return setFloat(lhs.f / rhs.f); })
+      .Case<arith::RemFOp>(
+          [&](auto) { return setFloat(std::fmod(lhs.f, rhs.f)); })
+      .Case<arith::MaxFOp>(
+          [&](auto) { return setFloat(std::max(lhs.f, rhs.f)); })
+      .Case<arith::MinFOp>(
+          [&](auto) { return setFloat(std::min(lhs.f, rhs.f)); })
+      .Case<arith::NegFOp>([&](auto) { return setFloat(-lhs.f); })
+      .Case<math::AbsFOp>([&](auto) { return setFloat(std::fabs(lhs.f)); })
+      .Case<math::ExpOp>([&](auto) { return setFloat(std::exp(lhs.f)); })
+      .Case<math::LogOp>([&](auto) { return setFloat(std::log(lhs.f)); })
+      .Case<math::SqrtOp>([&](auto) { return setFloat(std::sqrt(lhs.f)); })
+      .Case<math::RsqrtOp>(
+          [&](auto) { return setFloat(1.0 / std::sqrt(lhs.f)); })
+      .Case<math::TanhOp>([&](auto) { return setFloat(std::tanh(lhs.f)); })
+      .Case<math::SinOp>([&](auto) { return setFloat(std::sin(lhs.f)); })
+      .Case<math::CosOp>([&](auto) { return setFloat(std::cos(lhs.f)); })
+      .Case<math::CeilOp>([&](auto) { return setFloat(std::ceil(lhs.f)); })
+      .Case<math::PowFOp>(
+          [&](auto) { return setFloat(std::pow(lhs.f, rhs.f)); })
+      .Case<arith::CmpFOp>([&](arith::CmpFOp cmp) {
+        auto unordered = std::isnan(lhs.f) || std::isnan(rhs.f);
+        switch (cmp.getPredicate()) {
+        case arith::CmpFPredicate::AlwaysFalse:
+          return setInt(false);
+        case arith::CmpFPredicate::OEQ:
+          return setInt(!unordered && lhs.f == rhs.f);
+        case arith::CmpFPredicate::OGT:
+          return setInt(!unordered && lhs.f > rhs.f);
+        case arith::CmpFPredicate::OGE:
+          return setInt(!unordered && lhs.f >= rhs.f);
+        case arith::CmpFPredicate::OLT:
+          return setInt(!unordered && lhs.f < rhs.f);
+        case arith::CmpFPredicate::OLE:
+          return setInt(!unordered && lhs.f <= rhs.f);
+        case arith::CmpFPredicate::ONE:
+          return setInt(!unordered && lhs.f != rhs.f);
+        case arith::CmpFPredicate::ORD:
+          return setInt(!unordered);
+        case arith::CmpFPredicate::UEQ:
+          return setInt(unordered || lhs.f == rhs.f);
+        case arith::CmpFPredicate::UGT:
+          return setInt(unordered || lhs.f > rhs.f);
+        case arith::CmpFPredicate::UGE:
+          return setInt(unordered || lhs.f >= rhs.f);
+        case arith::CmpFPredicate::ULT:
+          return setInt(unordered || lhs.f < rhs.f);
+        case arith::CmpFPredicate::ULE:
+          return setInt(unordered || lhs.f <= rhs.f);
+        case arith::CmpFPredicate::UNE:
+          return setInt(unordered || lhs.f != rhs.f);
+        case arith::CmpFPredicate::UNO:
+          return setInt(unordered);
+        case arith::CmpFPredicate::AlwaysTrue:
+          return setInt(true);
+        }
+        llvm_unreachable("unexpected predicate");
+      })
+
+      // Cast operations.
+      .Case<arith::IndexCastOp, arith::ExtSIOp, arith::TruncIOp>(
+          [&](auto) { return setInt(lhs.i); })
+      .Case<arith::ExtUIOp>([&](auto) { return setInt(lhsU); })
+      .Case<arith::SIToFPOp>([&](auto) { return setFloat((double)lhs.i); })
+      .Case<arith::UIToFPOp>([&](auto) { return setFloat((double)lhsU); })
+      .Case<arith::FPToSIOp>([&](auto) { return setInt((int64_t)lhs.f); })
+      .Case<arith::FPToUIOp>(
+          [&](auto) { return setInt((int64_t)(uint64_t)lhs.f); })
+      .Case<arith::ExtFOp, arith::TruncFOp>(
+          [&](auto) { return setFloat(lhs.f); })
+      .Case<hls::PrimCastOp>([&](auto) {
+        if (resultType.isa<FloatType>())
+          return setFloat(operandType.isa<FloatType>() ? lhs.f
+                                                       : (double)lhs.i);
+        return setInt(operandType.isa<FloatType>() ? (int64_t)lhs.f : lhs.i);
+      })
+      .Default([&](Operation *op) {
+        return op->emitError("is not supported by the interpreter"),
+               failure();
+      });
+}
+
+LogicalResult Interpreter::runOp(Operation *op, ValueMap &map) {
+  // Vector and tensor operations are not supported.
+  auto isScalarOrMemref = [](Type type) {
+    return !type.isa<VectorType, TensorType>();
+  };
+  if (!llvm::all_of(op->getOperandTypes(), isScalarOrMemref) ||
+      !llvm::all_of(op->getResultTypes(), isScalarOrMemref))
+    return op->emitError("has unsupported vector or tensor type"), failure();
+
+  auto loadStore = [&](Operation *op, Value memref, ArrayRef<int64_t> indices,
+                       Value valueToStore) -> LogicalResult {
+    auto &buffer = *map[memref].buffer;
+    auto index = getIndex(op, buffer, indices);
+    if (failed(index))
+      return failure();
+    if (valueToStore)
+      buffer.store(*index, map[valueToStore]);
+    else
+      map[op->getResult(0)] = buffer.load(*index);
+    return success();
+  };
+
+  auto allocBuffer = [&](Operation *op) -> LogicalResult {
+    auto type = op->getResult(0).getType().cast<MemRefType>();
+    if (!type.hasStaticShape())
+      return op->emitError("has dynamic shape"), failure();
+    map[op->getResult(0)].buffer = std::make_shared<Buffer>(type);
+    return success();
+  };
+
+  return llvm::TypeSwitch<Operation *, LogicalResult>(op)
+      // Affine operations.
+      .Case<AffineForOp>([&](auto op) { return runAffineFor(op, map); })
+      .Case<AffineIfOp>([&](AffineIfOp op) {
+        auto cond = evalIntegerSet(op.getIntegerSet(),
+                                   getInts(op.getOperands(), map));
+        if (!cond && !op.hasElse())
+          return success();
+        return runRegion(cond ? op.getThenRegion() : op.getElseRegion(), {},
+                         map, op);
+      })
+      .Case<AffineLoadOp>([&](AffineLoadOp op) {
+        auto indices =
+            evalAffineMap(op.getAffineMap(), getInts(op.getMapOperands(), map));
+        return loadStore(op, op.getMemRef(), indices, nullptr);
+      })
+      .Case<AffineStoreOp>([&](AffineStoreOp op) {
+        auto indices =
+            evalAffineMap(op.getAffineMap(), getInts(op.getMapOperands(), map));
+        return loadStore(op, op.getMemRef(), indices, op.getValueToStore());
+      })
+      .Case<AffineApplyOp>([&](AffineApplyOp op) {
+        map[op.getResult()].i = evalAffineMap(
+            op.getAffineMap(), getInts(op.getMapOperands(), map))[0];
+        return success();
+      })
+      .Case<AffineMinOp>([&](AffineMinOp op) {
+        auto results =
+            evalAffineMap(op.getAffineMap(), getInts(op.getOperands(), map));
+        map[op.getResult()].i =
+            *std::min_element(results.begin(), results.end());
+        return success();
+      })
+      .Case<AffineMaxOp>([&](AffineMaxOp op) {
+        auto results =
+            evalAffineMap(op.getAffineMap(), getInts(op.getOperands(), map));
+        map[op.getResult()].i =
+            *std::max_element(results.begin(), results.end());
+        return success();
+      })
+      .Case<hls::AffineSelectOp>([&](hls::AffineSelectOp op) {
+        auto cond =
+            evalIntegerSet(op.getIntegerSet(), getInts(op.getArgs(), map));
+        auto value = map[cond ? op.getTrueValue() : op.getFalseValue()];
+        map[op.getResult()] = value;
+        return success();
+      })
+
+      // SCF and function operations.
+      .Case<scf::ForOp>([&](auto op) { return runScfFor(op, map); })
+      .Case<scf::IfOp>([&](scf::IfOp op) {
+        auto cond = map[op.getCondition()].i;
+        if (!cond && op.getElseRegion().empty())
+          return success();
+        return runRegion(cond ? op.getThenRegion() : op.getElseRegion(), {},
+                         map, op);
+      })
+      .Case<func::CallOp>([&](auto op) { return runCall(op, map); })
+
+      // Arith constant and select operations.
+      .Case<arith::ConstantOp>([&](arith::ConstantOp op) {
+        map[op.getResult()] = getScalar(op.getType(), op.getValue());
+        return success();
+      })
+      .Case<arith::SelectOp>([&](arith::SelectOp op) {
+        auto cond = map[op.getCondition()].i;
+        auto value = map[cond ? op.getTrueValue() : op.getFalseValue()];
+        map[op.getResult()] = value;
+        return success();
+      })
+
+      // Memref operations.
+      .Case<memref::AllocOp, memref::AllocaOp>(
+          [&](Operation *op) { return allocBuffer(op); })
+      .Case<memref::LoadOp>([&](memref::LoadOp op) {
+        return loadStore(op, op.getMemRef(), getInts(op.getIndices(), map),
+                         nullptr);
+      })
+      .Case<memref::StoreOp>([&](memref::StoreOp op) {
+        return loadStore(op, op.getMemRef(), getInts(op.getIndices(), map),
+                         op.getValueToStore());
+      })
+      .Case<memref::CopyOp>([&](auto op) { return runCopy(op, map); })
+      .Case<memref::SubViewOp>([&](auto op) { return runSubView(op, map); })
+      .Case<memref::CollapseShapeOp, memref::ExpandShapeOp, memref::ReshapeOp,
+            memref::CastOp>([&](Operation *op) { return runReshape(op, map); })
+      .Case<memref::GetGlobalOp>(
+          [&](auto op) { return runGetGlobal(op, map); })
+      .Case<memref::DeallocOp>([&](auto) { return success(); })
+
+      // HLS dataflow operations.
+      .Case<BufferOp>([&](BufferOp op) {
+        if (failed(allocBuffer(op)))
+          return failure();
+        if (auto initValue = op.getInitValue()) {
+          auto &buffer = *map[op.getResult()].buffer;
+          auto value = getScalar(buffer.elementType, initValue.value());
+          buffer.forEachElement(
+              [&](int64_t index) { buffer.store(index, value); });
+        }
+        return success();
+      })
+      .Case<ConstBufferOp>([&](ConstBufferOp op) {
+        if (failed(allocBuffer(op)))
+          return op.emitError("has unsupported value"), failure();
+        auto &buffer = *map[op.getResult()].buffer;
+        if (auto denseAttr = op.getValue().dyn_cast<DenseElementsAttr>())
+          return initBuffer(buffer, denseAttr), success();
+        auto resourceAttr = op.getValue().dyn_cast<DenseResourceElementsAttr>();
+        if (!resourceAttr || failed(initBuffer(buffer, resourceAttr)))
+          return op.emitError("has unsupported value"), failure();
+        return success();
+      })
+      .Case<StreamOp>([&](StreamOp op) {
+        map[op.getResult()].stream = std::make_shared<Stream>();
+        return success();
+      })
+      .Case<StreamReadOp>([&](StreamReadOp op) {
+        auto &stream = *map[op.getChannel()].stream;
+        if (stream.empty())
+          return op.emitError("reads an empty stream"), failure();
+        if (op.getResult())
+          map[op.getResult()] = stream.front();
+        stream.pop_front();
+        return success();
+      })
+      .Case<StreamWriteOp>([&](StreamWriteOp op) {
+        map[op.getChannel()].stream->push_back(map[op.getValue()]);
+        return success();
+      })
+      .Case<ScheduleOp, NodeOp, DispatchOp, TaskOp>([&](Operation *op) {
+        SmallVector<RtValue, 8> args;
+        if (op->hasTrait<OpTrait::IsIsolatedFromAbove>())
+          for (auto operand : op->getOperands())
+            args.push_back(map[operand]);
+        return runRegion(op->getRegion(0), args, map, op);
+      })
+      .Case<AxiBundleOp>([&](auto) { return success(); })
+      .Case<AxiPortOp>([&](AxiPortOp op) {
+        auto value = map[op.getAxi()];
+        map[op.getValue()] = value;
+        return success();
+      })
+      .Case<AxiPackOp>([&](AxiPackOp op) {
+        auto value = map[op.getValue()];
+        map[op.getAxi()] = value;
+        return success();
+      })
+      .Default([&](Operation *op) { return runArithOp(op, map); });
+}
+
+//===----------------------------------------------------------------------===//
+// Data Files
+//===----------------------------------------------------------------------===//
+
+/// Data files store f64 elements as double, other floating-point elements
+/// (e.g., f16 and bf16) as float, and all other elements as int64_t, which is
+/// the same format loaded and checked by the emitted C-simulation testbench.
+template <typename FileT>
+static bool readElements(llvm::MemoryBuffer &file, const Buffer &buffer,
+                         llvm::function_ref<void(int64_t, FileT)> func) {
+  if (file.getBufferSize() != buffer.getNumElements() * sizeof(FileT))
+    return false;
+  auto data = reinterpret_cast<const FileT *>(file.getBufferStart());
+  buffer.forEachElement([&](int64_t index) { func(index, *data++); });
+  return true;
+}
+
+static LogicalResult readData(StringRef path, Type type, RtValue &value) {
+  std::string errorMessage;
+  auto file = openInputFile(path, &errorMessage);
+  if (!file)
+    return failure();
+
+  auto buffer = value.buffer;
+  if (!buffer) {
+    buffer = std::make_shared<Buffer>(MemRefType::get({}, type));
+    buffer->store(0, value);
+  }
+
+  bool success = true;
+  auto elementType = buffer->elementType;
+  if (elementType.isF64())
+    success = readElements<double>(*file, *buffer, [&](int64_t i, double v) {
+      buffer->storage->floats[i] = v;
+    });
+  else if (elementType.isa<FloatType>())
+    success = readElements<float>(*file, *buffer, [&](int64_t i, float v) {
+      buffer->storage->floats[i] = v;
+    });
+  else
+    success = readElements<int64_t>(*file, *buffer, [&](int64_t i, int64_t v) {
+      buffer->storage->ints[i] = wrapInt(elementType, v);
+    });
+  if (!success) {
+    llvm::errs() << "data file " << path << " has mismatched size\n";
+    return failure();
+  }
+  if (!value.buffer)
+    value = buffer->load(0);
+  return mlir::success();
+}
+
+static LogicalResult writeData(StringRef path, Type type,
+                               const RtValue &value) {
+  std::error_code error;
+  llvm::raw_fd_ostream file(path, error, llvm::sys::fs::OF_None);
+  if (error) {
+    llvm::errs() << "failed to open " << path << ": " << error.message()
+                 << "\n";
+    return failure();
+  }
+
+  auto buffer = value.buffer;
+  if (!buffer) {
+    buffer = std::make_shared<Buffer>(MemRefType::get({}, type));
+    buffer->store(0, value);
+  }
+  auto elementType = buffer->elementType;
+  buffer->forEachElement([&](int64_t index) {
+    if (elementType.isF64()) {
+      double v = buffer->storage->floats[index];
+      file.write(reinterpret_cast<const char *>(&v), sizeof(v));
+    } else if (elementType.isa<FloatType>()) {
+      float v = buffer->storage->floats[index];
+      file.write(reinterpret_cast<const char *>(&v), sizeof(v));
+    } else {
+      int64_t v = buffer->storage->ints[index];
+      file.write(reinterpret_cast<const char *>(&v), sizeof(v));
+    }
+  });
+  return success();
+}
+
+//===----------------------------------------------------------------------===//
+// Entry of scalehls-run
+//===----------------------------------------------------------------------===//
+
+/// Get the function to run. Default to the runtime function, the top function,
+/// or the only defined function in order.
+static func::FuncOp getEntryFunc(ModuleOp module) {
+  if (!funcName.empty())
+    return module.lookupSymbol<func::FuncOp>(funcName);
+  if (auto func = getRuntimeFunc(module))
+    return func;
+  if (auto func = getTopFunc(module))
+    return func;
+  func::FuncOp entry;
+  for (auto func : module.getOps<func::FuncOp>())
+    if (!func.isExternal()) {
+      if (entry)
+        return func::FuncOp();
+      entry = func;
+    }
+  return entry;
+}
+
+/// Create the inputs of the function, which are loaded from the input directory
+/// or randomly initialized with small integers. Small integers keep float
+/// arithmetic mostly exact, such that reassociated reductions still match.
+static LogicalResult createInputs(func::FuncOp func,
+                                  SmallVectorImpl<RtValue> &inputs) {
+  std::mt19937_64 generator(seed);
+  std::uniform_int_distribution<int64_t> distribution(-4, 4);
+
+  for (auto arg : func.getArguments()) {
+    RtValue value;
+    auto type = arg.getType();
+    if (auto memrefType = type.dyn_cast<MemRefType>()) {
+      if (!memrefType.hasStaticShape())
+        return func.emitError("has dynamic shaped argument"), failure();
+      value.buffer = std::make_shared<Buffer>(memrefType);
+      auto &buffer = *value.buffer;
+      buffer.forEachElement([&](int64_t index) {
+        RtValue element;
+        element.i = wrapInt(buffer.elementType, distribution(generator));
+        element.f = distribution(generator);
+        buffer.store(index, element);
+      });
+    } else if (type.isIntOrIndexOrFloat()) {
+      value.i = wrapInt(type, distribution(generator));
+      value.f = distribution(generator);
+    } else
+      return func.emitError("has unsupported argument type"), failure();
+
+    if (!inputDir.empty()) {
+      SmallString<128> path(inputDir.getValue());
+      llvm::sys::path::append(path,
+                              "arg" + std::to_string(arg.getArgNumber()) +
+                                  ".bin");
+      if (llvm::sys::fs::exists(path) &&
+          failed(readData(path, type, value)))
+        return failure();
+    }
+    inputs.push_back(value);
+  }
+  return success();
+}
+
+/// Deep copy the runtime value such that each run has its own buffers.
+static RtValue cloneValue(const RtValue &value) {
+  auto newValue = value;
+  if (value.buffer) {
+    auto contiguous = Buffer(
+        MemRefType::get(value.buffer->shape, value.buffer->elementType));
+    SmallVector<int64_t, 64> indices;
+    contiguous.forEachElement([&](int64_t index) { indices.push_back(index); });
+    auto it = indices.begin();
+    value.buffer->forEachElement([&](int64_t index) {
+      contiguous.store(*it++, value.buffer->load(index));
+    });
+    newValue.buffer = std::make_shared<Buffer>(contiguous);
+  }
+  return newValue;
+}
+
+static LogicalResult runModule(ModuleOp module, ArrayRef<RtValue> inputs,
+                               SmallVectorImpl<RtValue> &args,
+                               SmallVectorImpl<RtValue> &results) {
+  auto func = getEntryFunc(module);
+  if (!func)
+    return module.emitError("failed to find the function to run"), failure();
+  if (func.getNumArguments() != inputs.size())
+    return func.emitError("has mismatched number of arguments"), failure();
+
+  for (auto input : inputs)
+    args.push_back(cloneValue(input));
+  return Interpreter(module).runFunc(func, args, results);
+}
+
+/// Compare the two values and return the number of mismatched elements.
+static unsigned compareValues(StringRef name, Type type, const RtValue &lhs,
+                              const RtValue &rhs) {
+  auto isFloat = type.isa<FloatType>();
+  if (auto memrefType = type.dyn_cast<MemRefType>())
+    isFloat = memrefType.getElementType().isa<FloatType>();
+
+  auto lhsClone = cloneValue(lhs), rhsClone = cloneValue(rhs);
+  if (!lhsClone.buffer) {
+    lhsClone.buffer = std::make_shared<Buffer>(MemRefType::get({}, type));
+    lhsClone.buffer->store(0, lhs);
+    rhsClone.buffer = std::make_shared<Buffer>(MemRefType::get({}, type));
+    rhsClone.buffer->store(0, rhs);
+  }
+  auto &lhsBuf = *lhsClone.buffer, &rhsBuf = *rhsClone.buffer;
+  if (lhsBuf.shape != rhsBuf.shape) {
+    llvm::errs() << name << ": mismatched shapes\n";
+    return 1;
+  }
+
+  unsigned numErrors = 0;
+  for (int64_t i = 0, e = lhsBuf.getNumElements(); i < e; ++i) {
+    double lhsValue = isFloat ? lhsBuf.storage->floats[i]
+                              : (double)lhsBuf.storage->ints[i];
+    double rhsValue = isFloat ? rhsBuf.storage->floats[i]
+                              : (double)rhsBuf.storage->ints[i];
+    auto diff = std::fabs(lhsValue - rhsValue);
+    if (std::isnan(lhsValue) != std::isnan(rhsValue) ||
+        diff > tolerance + tolerance * std::fabs(rhsValue))
+      if (numErrors++ < 10)
+        llvm::errs() << name << "[" << i << "]: " << lhsValue
+                     << " != " << rhsValue << "\n";
+  }
+  return numErrors;
+}
+
+static OwningOpRef<ModuleOp> parseModule(StringRef filename,
+                                         MLIRContext &context) {
+  std::string errorMessage;
+  auto file = openInputFile(filename, &errorMessage);
+  if (!file) {
+    llvm::errs() << errorMessage << "\n";
+    return nullptr;
+  }
+  llvm::SourceMgr sourceMgr;
+  sourceMgr.AddNewSourceBuffer(std::move(file), llvm::SMLoc());
+  return parseSourceFile<ModuleOp>(sourceMgr, &context);
+}
+
+int main(int argc, char **argv) {
+  llvm::InitLLVM y(argc, argv);
+  llvm::cl::ParseCommandLineOptions(argc, argv, "ScaleHLS Reference Runner");
+
+  DialectRegistry registry;
+  scalehls::registerAllDialects(registry);
+  MLIRContext context(registry);
+  context.loadAllAvailableDialects();
+
+  auto module = parseModule(inputFilename, context);
+  if (!module)
+    return 1;
+  auto func = getEntryFunc(*module);
+  if (!func) {
+    llvm::errs() << "failed to find the function to run\n";
+    return 1;
+  }
+
+  SmallVector<RtValue, 8> inputs;
+  if (failed(createInputs(func, inputs)))
+    return 1;
+
+  SmallVector<RtValue, 8> args, results;
+  if (failed(runModule(*module, inputs, args, results)))
+    return 1;
+
+  // Write the inputs and the golden outputs.
+  if (!outputDir.empty()) {
+    if (auto error = llvm::sys::fs::create_directories(outputDir)) {
+      llvm::errs() << "failed to create " << outputDir << ": "
+                   << error.message() << "\n";
+      return 1;
+    }
+    auto getPath = [&](const Twine &name) {
+      SmallString<128> path(outputDir.getValue());
+      llvm::sys::path::append(path, name);
+      return path;
+    };
+    for (auto arg : func.getArguments()) {
+      auto name = "arg" + std::to_string(arg.getArgNumber());
+      auto idx = arg.getArgNumber();
+      if (failed(writeData(getPath(name + ".bin"), arg.getType(),
+                           inputs[idx])) ||
+          failed(writeData(getPath(name + ".golden.bin"), arg.getType(),
+                           args[idx])))
+        return 1;
+    }
+    for (auto t : llvm::enumerate(llvm::zip(func.getResultTypes(), results)))
+      if (failed(writeData(
+              getPath("res" + std::to_string(t.index()) + ".golden.bin"),
+              std::get<0>(t.value()), std::get<1>(t.value()))))
+        return 1;
+  }
+
+  // Run the other snapshot with the same inputs and compare the outputs,
+  // including all arguments that may be written by the function.
+  if (!compareFilename.empty()) {
+    auto otherModule = parseModule(compareFilename, context);
+    if (!otherModule)
+      return 1;
+
+    SmallVector<RtValue, 8> otherArgs, otherResults;
+    if (failed(runModule(*otherModule, inputs, otherArgs, otherResults)))
+      return 1;
+    if (results.size() != otherResults.size()) {
+      llvm::errs() << "mismatched number of results\n";
+      return 1;
+    }
+
+    unsigned numErrors = 0;
+    for (auto arg : func.getArguments())
+      numErrors += compareValues("arg" + std::to_string(arg.getArgNumber()),
+                                 arg.getType(), args[arg.getArgNumber()],
+                                 otherArgs[arg.getArgNumber()]);
+    for (auto t : llvm::enumerate(func.getResultTypes()))
+      numErrors += compareValues("res" + std::to_string(t.index()), t.value(),
+                                 results[t.index()], otherResults[t.index()]);
+
+    llvm::outs() << (numErrors ? "FAIL" : "PASS") << ": " << numErrors
+                 << " mismatches\n";
+    return numErrors != 0;
+  }
+  return 0;
+}